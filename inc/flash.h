@@ -2,19 +2,23 @@
  * @file flash.h
  * @brief For creating and accessing user areas of flash memory. Note that it is not thread safe so either don't use it with multi-threading
  * or if you need to use it with multi-threading use a dedicated thread that is in charge of interfacing to the flash and queue actions to 
- * this thread. This will serialize flash operations and prevent race conditions.
+ * this thread. This will serialize flash operations and prevent race conditions. flash_async.h provides such a queue.
+ *
+ * All state lives in a flash_ctx_t. The flash_ctx_ functions work on the context they're given so there can be one
+ * per flash device or bank. The functions without a context work on a default context that is built in.
  */
 
 #ifndef INC_FLASH_H_
 #define INC_FLASH_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /* PUBLIC DEFINES */
 
 /**
- * @brief This is the largest amount of data you can read at a time. 
- * It's limited because an internal buffer is used for padding. 
+ * @brief This is the largest amount of data you can write at a time with flash_write. flash_writev,
+ * flash_index_write and flash_index_writev never copy the data into one buffer so they take up to UINT16_MAX bytes.
  * 
  * Maybe this should just be the flash_user page size.
  */
@@ -25,6 +29,42 @@
  */
 #define FLASH_EMPTY_VALUE 0xFF
 
+/**
+ * @brief This is the total number of indices each flash context can have.
+ */
+#define FLASH_MAX_INDICES 4
+
+/**
+ * @brief The number of bytes an erased map needs for a user flash area, see flash_set_erased_map. One bit per word.
+ */
+#define FLASH_ERASED_MAP_SIZE(number_of_pages, page_size, word_size) \
+	((((uint32_t)(number_of_pages) * (page_size) / (word_size)) + 7) / 8)
+
+/**
+ * @brief The number of uint32_t a wear leveling table needs for a user flash area, see flash_set_wear_leveling. An
+ * erase counter for every page, user and spare, where each user page is and which spare pages are free.
+ */
+#define FLASH_WEAR_TABLE_SIZE(number_of_pages, spare_pages) \
+	(2 * (uint32_t)(number_of_pages) + 2 * (uint32_t)(spare_pages) - 2)
+
+#ifdef FLASH_ENABLE_STATS
+/**
+ * @brief The number of buckets in a latency histogram. Bucket 0 counts latencies of 0, bucket n those from 2^(n-1) up
+ * to 2^n - 1 and the last bucket everything longer than that.
+ */
+#define FLASH_STATS_BUCKETS 24
+#endif
+
+/**
+ * @brief Added to the type of a trace event that marks a driver function returning, see flash_trace_type_t.
+ */
+#define FLASH_TRACE_EXIT 0x80
+
+/**
+ * @brief The id in trace events that aren't about an index.
+ */
+#define FLASH_TRACE_NO_ID 0xFF
+
 
 /* PUBLIC TYPES */
 
@@ -46,10 +86,22 @@ typedef enum{
 	FLASH_ENDIANESS_LITTLE	
 }flash_endianess_t;
 
+/**
+ * @brief When an index writes its head and tail to its index page, see flash_index_set_checkpoint.
+ */
+typedef enum{
+	FLASH_CHECKPOINT_EVERY_WRITE,	/**< After every write. The default. */
+	FLASH_CHECKPOINT_RECORDS,		/**< After every so many writes. */
+	FLASH_CHECKPOINT_BYTES,			/**< Once so many bytes have been written. */
+	FLASH_CHECKPOINT_PAGE,			/**< Only when the head moves onto a new page. */
+	FLASH_CHECKPOINT_MANUAL			/**< Only when flash_index_write_index is called. */
+}flash_checkpoint_policy_t;
+
 /**
  * @brief Function pointer type for programming flash. Depending on the size of word_size your user implementation 
  * of this function might need to reconstruct a larger number to write than uint8_t data. Hence it's a pointer to an
- * array.
+ * array. data is always aligned to the word size, or to 8 bytes for words bigger than that, so it can be read a
+ * uint64_t at a time. It may point straight into the caller's buffer.
  * @param write_address The address to write at.
  * @param data The data to be written into memory.
  * @param number_of_words The number of words you want to write to mem.
@@ -74,6 +126,34 @@ typedef flash_status_t (*flash_read_ptr)(uint32_t user_read_address, uint8_t *da
  */
 typedef flash_status_t (*erase_ptr)(uint8_t start_page, uint8_t number_of_pages);
 
+/**
+ * @brief One piece of a scatter-gather write. The pieces are written to flash back to back as if they were
+ * one contiguous buffer.
+ * @param data The bytes of this piece.
+ * @param length The number of bytes in this piece.
+ */
+typedef struct{
+	uint8_t * data;
+	uint16_t length;
+}flash_iovec_t;
+
+/**
+ * @brief Function pointer type for reading a free running tick count, e.g. a millisecond timer. Used to age data
+ * that is waiting in index write buffers. Only differences between ticks are used so it's fine for it to overflow.
+ * @return uint32_t The current tick count.
+ */
+typedef uint32_t (*flash_tick_ptr)(void);
+
+/**
+ * @brief A span of memory mapped flash that can be read in place, see flash_read_view.
+ * @param data The first byte of the span.
+ * @param length The number of bytes in the span.
+ */
+typedef struct{
+	const uint8_t * data;
+	uint32_t length;
+}flash_view_t;
+
 /**
  * @brief Holds state information for the flash module.
  * @param start_page The starting page of the section of flash dedicated to the user.
@@ -97,6 +177,124 @@ typedef struct{
 	flash_endianess_t endianess;
 }flash_area_t;
 
+#ifdef FLASH_ENABLE_STATS
+/**
+ * @brief The calls to the user implemented functions that are counted and timed, see flash_stats_get.
+ */
+typedef enum{
+	FLASH_STATS_READ,
+	FLASH_STATS_WRITE,
+	FLASH_STATS_ERASE,
+	FLASH_STATS_OPERATIONS
+}flash_stats_op_t;
+
+/**
+ * @brief Log scale histogram of how long calls took, in whatever units the stats clock counts.
+ * @param buckets The number of calls in each bucket, see FLASH_STATS_BUCKETS.
+ * @param max The longest call.
+ * @param total All the calls added together, for the mean.
+ */
+typedef struct{
+	uint32_t buckets[FLASH_STATS_BUCKETS];
+	uint32_t max;
+	uint64_t total;
+}flash_histogram_t;
+
+/**
+ * @brief What an index has done, see flash_index_stats_get.
+ * @param user_bytes The bytes handed to the index to write.
+ * @param checkpoint_writes The number of times the head and tail were written to the index page.
+ * @param checkpoint_bytes The bytes those took up on the index page.
+ * @param wraps The number of times the head went round the end of the data space.
+ * @param page_erases The number of data pages erased, as the head got to them or ahead of it.
+ * @param index_page_erases The number of times the index page filled up and was erased.
+ */
+typedef struct{
+	uint64_t user_bytes;
+	uint32_t checkpoint_writes;
+	uint32_t checkpoint_bytes;
+	uint32_t wraps;
+	uint32_t page_erases;
+	uint32_t index_page_erases;
+}flash_index_stats_t;
+
+/**
+ * @brief What a context has done, see flash_stats_get.
+ * @param user_bytes The bytes handed to flash_write, flash_index_write and the like.
+ * @param programmed_bytes The bytes the user write function was asked to program, including padding, index data and
+ * anything wear leveling or garbage collection moved.
+ * @param padding_bytes The bytes of FLASH_EMPTY_VALUE programmed to fill out partial words.
+ * @param read_bytes The bytes the user read function was asked for.
+ * @param calls The number of calls to each user implemented function.
+ * @param failures The number of those that didn't return FLASH_OK.
+ * @param page_erases The number of times each page was erased, by the page number given to the erase function.
+ * @param latency How long the calls to each user implemented function took. Empty without a stats clock.
+ */
+typedef struct{
+	uint64_t user_bytes;
+	uint64_t programmed_bytes;
+	uint64_t padding_bytes;
+	uint64_t read_bytes;
+	uint32_t calls[FLASH_STATS_OPERATIONS];
+	uint32_t failures[FLASH_STATS_OPERATIONS];
+	uint32_t page_erases[UINT8_MAX + 1];
+	flash_histogram_t latency[FLASH_STATS_OPERATIONS];
+}flash_stats_t;
+#endif
+
+/**
+ * @brief What a trace event records, see flash_set_trace. The driver functions are recorded when they are called and,
+ * with FLASH_TRACE_EXIT added, when they return. The rest are recorded once they've happened.
+ */
+typedef enum{
+	FLASH_TRACE_WRITE = 1,			/**< flash_write or flash_writev. address and length as given. */
+	FLASH_TRACE_ERASE_PAGES,		/**< flash_erase_pages. address is the first page, length the number of pages. */
+	FLASH_TRACE_INDEX_WRITE,		/**< flash_index_write or flash_index_writev. address is the head, length as given. */
+	FLASH_TRACE_INDEX_WRITE_INDEX,	/**< flash_index_write_index. address is the head, length the tail. */
+	FLASH_TRACE_USER_READ,			/**< A call to the user read function. address and length as given to it. */
+	FLASH_TRACE_USER_WRITE,			/**< A call to the user write function. address as given, length in bytes. */
+	FLASH_TRACE_USER_ERASE,			/**< A call to the user erase function. address is the first page, length the number of pages. */
+	FLASH_TRACE_WRAP,				/**< An index's head went round the end of its data space. address is the new head. */
+	FLASH_TRACE_CHECKPOINT_MOVE		/**< An index page filled up and was erased so checkpoints start again at address. */
+}flash_trace_type_t;
+
+/**
+ * @brief A trace event. 16 bytes with no padding so a ring of them can be copied off a little endian target as it is
+ * and read with flash_trace_decode.
+ * @param timestamp When it happened by the trace clock. 0 without one.
+ * @param address See flash_trace_type_t.
+ * @param length See flash_trace_type_t.
+ * @param type A flash_trace_type_t, plus FLASH_TRACE_EXIT for a driver function returning.
+ * @param id The index, FLASH_TRACE_NO_ID if it isn't about one.
+ * @param status The flash_status_t returned, FLASH_OK for events that don't return anything.
+ * @param reserved Always 0.
+ */
+typedef struct{
+	uint32_t timestamp;
+	uint32_t address;
+	uint32_t length;
+	uint8_t type;
+	uint8_t id;
+	uint8_t status;
+	uint8_t reserved;
+}flash_trace_event_t;
+
+#ifdef FLASH_ENABLE_TRACE
+/**
+ * @brief A ring of trace events provided by the user, see flash_set_trace.
+ * @param events The ring. NULL when tracing is off.
+ * @param mask The number of events in the ring less one. The number is a power of two.
+ * @param count The number of events recorded since the ring was set. The next one goes at count & mask.
+ * @param clock Optional clock the events are timestamped with.
+ */
+typedef struct{
+	flash_trace_event_t * events;
+	uint32_t mask;
+	uint32_t count;
+	flash_tick_ptr clock;
+}flash_trace_t;
+#endif
+
 /**
  * @brief A given area of flash that is used as a circular buffer. The minimum size of an area in flash
  * is one page.
@@ -112,6 +310,27 @@ typedef struct{
  * @param min_index_addres The minimum address of the index page
  * @param min_index_addres The minimum address of the index page
  * @param index_data_size The number of bytes to represent the head and tail of the index.
+ * @param write_buffer Optional RAM buffer that writes are collected in before they're written to flash.
+ * @param write_buffer_size The size of write_buffer.
+ * @param write_buffer_length The number of bytes waiting in write_buffer.
+ * @param write_buffer_tick Tick count when the oldest data waiting in write_buffer was written.
+ * @param flush_threshold Write the buffer out once at least this many bytes are waiting. 0 to only flush when full.
+ * @param flush_age Write the buffer out once data has waited this many ticks. 0 to never flush on age.
+ * @param erase_ahead_pages The number of pages ahead of the head to keep erased, see flash_index_set_erase_ahead.
+ * @param erased_ahead The number of pages ahead of the head that are erased and ready to write.
+ * @param erase_stalls The number of times a write had to wait for a page to be erased.
+ * @param read_buffer Optional RAM buffer that flash_index_read reads ahead into.
+ * @param read_buffer_size The size of read_buffer.
+ * @param read_buffer_address Where in the data space the data in read_buffer came from.
+ * @param read_buffer_length The number of bytes of data in read_buffer.
+ * @param index_write_address Where on the index page the next index data goes.
+ * @param index_write_address_known Whether index_write_address can be used. If not the index page is searched.
+ * @param checkpoint_policy When the head and tail are written to the index page.
+ * @param checkpoint_every The number of writes or bytes between index writes for the policies that count.
+ * @param checkpoint_records The number of writes since the index was last written.
+ * @param checkpoint_bytes The number of bytes that have gone to flash since the index was last written.
+ * @param checkpoint_crc Whether each head and tail written to the index page is followed by its CRC-32C.
+ * @param stats What the index has done. Only with FLASH_ENABLE_STATS.
  */
 typedef struct{
 	uint32_t head;
@@ -124,8 +343,146 @@ typedef struct{
 	uint32_t max_index_address;
 	uint32_t min_index_address;
 	uint8_t index_data_size;
+	uint8_t * write_buffer;
+	uint16_t write_buffer_size;
+	uint16_t write_buffer_length;
+	uint32_t write_buffer_tick;
+	uint16_t flush_threshold;
+	uint32_t flush_age;
+	uint8_t erase_ahead_pages;
+	uint8_t erased_ahead;
+	uint32_t erase_stalls;
+	uint8_t * read_buffer;
+	uint16_t read_buffer_size;
+	uint32_t read_buffer_address;
+	uint16_t read_buffer_length;
+	uint32_t index_write_address;
+	bool index_write_address_known;
+	flash_checkpoint_policy_t checkpoint_policy;
+	uint32_t checkpoint_every;
+	uint32_t checkpoint_records;
+	uint32_t checkpoint_bytes;
+	bool checkpoint_crc;
+#ifdef FLASH_ENABLE_STATS
+	flash_index_stats_t stats;
+#endif
 }flash_index_t;
 
+/**
+ * @brief A place in the read cache for one page of flash. Provided by the user, see flash_set_read_cache.
+ * @param data The cached copy of the page. A page of the arena.
+ * @param page The page that is cached.
+ * @param last_used When the slot was last read from, for picking the least recently used slot.
+ * @param valid Whether the slot holds a page.
+ */
+typedef struct{
+	uint8_t * data;
+	uint32_t page;
+	uint32_t last_used;
+	bool valid;
+}flash_cache_slot_t;
+
+/**
+ * @brief Wear leveling state, see flash_set_wear_leveling.
+ * @param table User provided erase counters, page map and free spare pages. NULL if wear leveling is off.
+ * @param spare_start_page The first of the pages outside the user area that wear leveling can use.
+ * @param spare_pages The number of spare pages. The first two hold the saved table.
+ * @param threshold How many more erases a page needs than a free one before its data is moved.
+ * @param sequence Sequence number of the newest saved table.
+ * @param meta Which of the two table pages is being written, 0 or 1.
+ * @param meta_offset Where on that page the next table goes.
+ * @param remaps The number of times a page being erased was moved onto a less worn free page.
+ * @param migrations The number of times data that doesn't change was moved onto a worn page.
+ */
+typedef struct{
+	uint32_t * table;
+	uint8_t spare_start_page;
+	uint8_t spare_pages;
+	uint32_t threshold;
+	uint32_t sequence;
+	uint8_t meta;
+	uint32_t meta_offset;
+	uint32_t remaps;
+	uint32_t migrations;
+}flash_wear_t;
+
+/**
+ * @brief How worn the flash is, see flash_get_wear_stats. Covers every page wear leveling uses.
+ * @param pages The number of pages.
+ * @param total_erases The number of erases of all of them together.
+ * @param min_erases Erases of the least worn page.
+ * @param max_erases Erases of the most worn page.
+ * @param mean_erases total_erases over pages, rounded down.
+ * @param remaps The number of times a page being erased was moved onto a less worn free page.
+ * @param migrations The number of times data that doesn't change was moved onto a worn page.
+ * @param remaining_erases How many more page erases there can be before the most worn page reaches its endurance if
+ * the wear carries on being spread the way it has been so far. Divide by the erase rate to get a lifetime.
+ */
+typedef struct{
+	uint32_t pages;
+	uint32_t total_erases;
+	uint32_t min_erases;
+	uint32_t max_erases;
+	uint32_t mean_erases;
+	uint32_t remaps;
+	uint32_t migrations;
+	uint32_t remaining_erases;
+}flash_wear_stats_t;
+
+/**
+ * @brief Everything the flash module knows about one flash device or bank. Each context is independent of every
+ * other so separate devices can be driven from separate threads without locking. Treat the members as private and
+ * set them up with flash_ctx_init.
+ * @param user_flash The user area of this flash.
+ * @param write User implemented write function.
+ * @param read User implemented read function.
+ * @param erase User implemented erase function.
+ * @param tick Optional tick source, see flash_ctx_set_tick_source.
+ * @param padding_buffer For padding out partial words of writes and copying whole words that aren't aligned for the
+ * user write function. word_size is a uint8_t so a word always fits. uint64_t keeps it aligned.
+ * @param indices The registered indices.
+ * @param index_count The number of registered indices.
+ * @param erased_map Optional user provided bitmap of the words of user flash that are known to be erased.
+ * @param erased_map_pages Bitmap of the pages of user flash that erased_map is tracking.
+ * @param cache_slots Optional user provided read cache slots.
+ * @param cache_slot_count The number of read cache slots. 0 for no read cache.
+ * @param cache_clock Counts cache reads, to order slots by when they were used.
+ * @param cache_hits The number of page reads served from the read cache.
+ * @param cache_misses The number of page reads that went to the flash.
+ * @param mapped Where user address 0 can be read directly in memory. NULL if the flash isn't memory mapped.
+ * @param wear Wear leveling state.
+ * @param stats What the context has done. Only with FLASH_ENABLE_STATS.
+ * @param stats_clock Optional clock the calls to the user implemented functions are timed with. Only with
+ * FLASH_ENABLE_STATS.
+ * @param trace Ring of trace events. Only with FLASH_ENABLE_TRACE.
+ */
+typedef struct{
+	flash_area_t user_flash;
+	flash_write_ptr write;
+	flash_read_ptr read;
+	erase_ptr erase;
+	flash_tick_ptr tick;
+	uint64_t padding_buffer[(UINT8_MAX + 1) / sizeof(uint64_t)];
+	flash_index_t indices[FLASH_MAX_INDICES];
+	uint8_t index_count;
+	uint8_t * erased_map;
+	uint8_t erased_map_pages[(UINT8_MAX + 1) / 8];
+	flash_cache_slot_t * cache_slots;
+	uint8_t cache_slot_count;
+	uint32_t cache_clock;
+	uint32_t cache_hits;
+	uint32_t cache_misses;
+	const uint8_t * mapped;
+	flash_wear_t wear;
+#ifdef FLASH_ENABLE_STATS
+	flash_stats_t stats;
+	flash_tick_ptr stats_clock;
+#endif
+#ifdef FLASH_ENABLE_TRACE
+	flash_trace_t trace;
+#endif
+}flash_ctx_t;
+
 
 /* PUBLIC FUNCTION DECLARATIONS */
 
@@ -143,17 +500,219 @@ typedef struct{
  */
 void flash_init(flash_write_ptr write_fn, flash_read_ptr read_fn, erase_ptr erase_fn, uint8_t word_size, uint16_t page_size, uint8_t number_of_pages, uint8_t start_page, uint32_t base_address, flash_endianess_t endianess);
 
+/**
+ * @brief Set the tick source used to age buffered index data. Call after flash_init as that clears it.
+ * 
+ * @param tick_fn User implemented tick function. 0 to turn off flushing on age.
+ */
+void flash_set_tick_source(flash_tick_ptr tick_fn);
+
+/**
+ * @brief Do any work that is due. Writes out buffered index data that has waited longer than its flush_age and
+ * erases pages ahead of index heads, see flash_index_set_erase_ahead. Call it regularly, e.g. from the thread that
+ * owns the flash when it is idle.
+ * 
+ * @return flash_status_t 
+ */
+flash_status_t flash_poll(void);
+
+/**
+ * @brief Give the module a RAM bitmap to remember which words of user flash are erased. Once a page has been erased
+ * through the module every word on it is tracked: writes clear bits and erases set them again. Writes to words that
+ * are known to be written fail with FLASH_NOT_ERASED_ERROR without calling the write function, index page lookups
+ * come from RAM instead of reading the flash and pages that are still erased aren't erased again. Pages that haven't
+ * been erased since the map was set are read from flash as before. Call after flash_init as that clears it.
+ * 
+ * @param map The bitmap. Its contents are cleared. NULL to stop using one.
+ * @param map_size The size of map in bytes. At least FLASH_ERASED_MAP_SIZE of the user flash.
+ * @return flash_status_t 
+ */
+flash_status_t flash_set_erased_map(uint8_t * map, uint32_t map_size);
+
+/**
+ * @brief Check whether some flash is known to be erased, e.g. as a blank check before programming in a user
+ * implemented write function. Needs an erased map, see flash_set_erased_map.
+ * 
+ * @param user_address Word aligned address to start checking at.
+ * @param length The number of bytes to check. Rounded up to whole words.
+ * @return true Every word is known to be erased.
+ * @return false Some word has been written or the erased map doesn't know.
+ */
+bool flash_is_erased(uint32_t user_address, uint32_t length);
+
+/**
+ * @brief Give the module a page level read cache. Reads are served a page at a time from the cache, the least
+ * recently used page is replaced on a miss. Whole page reads that miss go straight to the flash without being cached
+ * so streaming reads don't push out pages that are being read over and over. Writes update cached pages and erases
+ * drop them. Call after flash_init as that clears it.
+ * 
+ * @param slots Places for the cached pages. NULL to stop caching.
+ * @param slot_count The number of slots.
+ * @param arena Memory for the cached pages. Slot n uses the nth page of it.
+ * @param arena_size The size of arena in bytes. At least slot_count pages.
+ * @return flash_status_t 
+ */
+flash_status_t flash_set_read_cache(flash_cache_slot_t * slots, uint8_t slot_count, uint8_t * arena, uint32_t arena_size);
+
+/**
+ * @brief Get the number of page reads served from the read cache and the number that had to go to the flash since
+ * the cache was set.
+ * 
+ * @param hits Set to the number of hits.
+ * @param misses Set to the number of misses.
+ */
+void flash_get_read_cache_counts(uint32_t * hits, uint32_t * misses);
+
+/**
+ * @brief Turn on wear leveling. Each user page is mapped onto a physical page and when a page is erased and another
+ * free page has been erased at least threshold fewer times the page is moved there, so the pages of a busy index,
+ * including its index page, move round the spare pages instead of wearing out where they were registered. Pages whose
+ * data doesn't change are moved onto worn free pages the same way so their pages can take a turn. Addresses and page
+ * numbers given to the module stay the same, only the user implemented functions see where pages really are. Views
+ * that span pages which aren't next to each other any more fail.
+ *
+ * The erase counters and the map are saved to the first two spare pages each time a page moves, see flash_save_wear,
+ * and loaded from there by this function so call it after flash_init and before anything else on every start up.
+ * Erases since the last save are lost if the power goes.
+ *
+ * @param spare_start_page The first spare page. They must be outside the user area.
+ * @param spare_pages The number of spare pages. At least three.
+ * @param threshold How many more erases a page needs than a free page before it moves. At least 1, the table is
+ * saved about once every threshold erases of a busy page.
+ * @param table Memory for the table. NULL to stop wear leveling, the pages stay wherever they have got to.
+ * @param table_size The number of uint32_t in table. At least FLASH_WEAR_TABLE_SIZE of the user flash.
+ * @return flash_status_t FLASH_ERROR if a saved table doesn't fit on a page.
+ */
+flash_status_t flash_set_wear_leveling(uint8_t spare_start_page, uint8_t spare_pages, uint32_t threshold, uint32_t * table, uint32_t table_size);
+
+/**
+ * @brief Save the wear leveling erase counters, e.g. before powering down.
+ *
+ * @return flash_status_t FLASH_ERROR if wear leveling is off.
+ */
+flash_status_t flash_save_wear(void);
+
+/**
+ * @brief Get the number of times a page has been erased since wear leveling was first turned on.
+ *
+ * @param page A physical page, user or spare.
+ * @param count Set to the number of erases.
+ * @return flash_status_t FLASH_ERROR if wear leveling is off or doesn't use the page.
+ */
+flash_status_t flash_get_erase_count(uint8_t page, uint32_t * count);
+
+/**
+ * @brief Get how worn the flash is and how much longer it should last.
+ *
+ * @param endurance The number of erases a page is rated for, e.g. 10000.
+ * @param stats Set to the statistics.
+ * @return flash_status_t FLASH_ERROR if wear leveling is off.
+ */
+flash_status_t flash_get_wear_stats(uint32_t endurance, flash_wear_stats_t * stats);
+
+#ifdef FLASH_ENABLE_STATS
+/**
+ * @brief Set the clock the calls to the user implemented functions are timed with, e.g. a cycle counter or a
+ * microsecond timer. Only differences are used so it's fine for it to overflow. Only with FLASH_ENABLE_STATS, which
+ * has to be defined the same way everywhere flash.h is included. Without it nothing is counted and none of this costs
+ * anything. Call after flash_init as that clears it.
+ *
+ * @param clock_fn User implemented clock. 0 to stop timing.
+ */
+void flash_set_stats_clock(flash_tick_ptr clock_fn);
+
+/**
+ * @brief Get what the module has done since flash_init or flash_stats_reset. Compare user_bytes with
+ * programmed_bytes to see how much of the flash's write budget goes on padding, index data and moving data around.
+ *
+ * @param stats Set to the statistics.
+ */
+void flash_stats_get(flash_stats_t * stats);
+
+/**
+ * @brief Get what an index has done since it was registered or flash_stats_reset.
+ *
+ * @param id The index.
+ * @param stats Set to the statistics.
+ * @return flash_status_t FLASH_ERROR if the index doesn't exist.
+ */
+flash_status_t flash_index_stats_get(uint8_t id, flash_index_stats_t * stats);
+
+/**
+ * @brief Zero the statistics of the module and of every index.
+ */
+void flash_stats_reset(void);
+#endif
+
+#ifdef FLASH_ENABLE_TRACE
+/**
+ * @brief Start recording trace events into a ring, writing over the oldest once it is full. Recording an event is a
+ * few stores so it can be left on in the field. Only with FLASH_ENABLE_TRACE, which has to be defined the same way
+ * everywhere flash.h is included. Without it nothing is recorded and none of this costs anything. Call after
+ * flash_init as that clears it.
+ *
+ * @param events The ring. NULL to stop tracing.
+ * @param event_count The number of events in the ring, a power of two.
+ * @param clock_fn Optional clock to timestamp the events with, e.g. a microsecond timer. 0 for no timestamps.
+ * @return flash_status_t FLASH_ERROR if event_count isn't a power of two.
+ */
+flash_status_t flash_set_trace(flash_trace_event_t * events, uint32_t event_count, flash_tick_ptr clock_fn);
+
+/**
+ * @brief Copy the newest trace events out of the ring, oldest first, e.g. to send them to a host to decode.
+ *
+ * @param events Where to copy them to.
+ * @param size The most events to copy.
+ * @param lost Set to the number of events before the ones copied that have been written over or didn't fit. Can
+ * be NULL.
+ * @return uint32_t The number of events copied.
+ */
+uint32_t flash_trace_copy(flash_trace_event_t * events, uint32_t size, uint32_t * lost);
+#endif
+
 /**
  * @fn flash_status_t flash_write(uint32_t, uint8_t*, uint16_t)
- * @brief Write some bytes out to flash
+ * @brief Write some bytes out to flash. Whole words are written straight from data, only a trailing
+ * partial word is copied so it can be padded out with FLASH_EMPTY_VALUE.
  *
  * @param [in] user_address Where to start writing relative to the user defined flash start.
  * @param [in] data Write bytes from here.
- * @param [in] length The number of double words to read out.
+ * @param [in] length The number of double words to read out. At most FLASH_MAX_WRITE_SIZE bytes.
  * @return Status of execution.
  */
 flash_status_t flash_write(uint32_t user_address, uint8_t * data, uint16_t write_length);
 
+/**
+ * @brief Write several separate buffers out to flash as one contiguous write without copying them into one
+ * buffer first. Words that lie inside a single piece are written straight from it, only words that straddle
+ * two pieces and the trailing partial word are packed together and padded.
+ *
+ * @param [in] user_address Where to start writing relative to the user defined flash start. Must be word aligned.
+ * @param [in] iov The pieces to write in order.
+ * @param [in] iov_count The number of pieces. The pieces add up to at most UINT16_MAX bytes.
+ * @return Status of execution.
+ */
+flash_status_t flash_writev(uint32_t user_address, const flash_iovec_t * iov, uint8_t iov_count);
+
+/**
+ * @brief Tell the module that the flash can be read directly in memory, e.g. XIP flash on an MCU or a memory mapped
+ * image on a host. Needed for views, see flash_read_view. Call after flash_init as that clears it.
+ * 
+ * @param mapped Where user address 0 is mapped, i.e. the memory at base_address. NULL if the flash isn't mapped.
+ */
+void flash_set_memory_map(const uint8_t * mapped);
+
+/**
+ * @brief Get a pointer straight into memory mapped flash instead of copying it out. The view shows whatever is in
+ * the flash, so it changes if that part of the flash is written or erased.
+ * 
+ * @param user_address Where the view starts relative to the user defined flash start.
+ * @param length The number of bytes in the view.
+ * @param view Set to the view.
+ * @return flash_status_t FLASH_ERROR if the flash isn't memory mapped or the view doesn't fit in user flash.
+ */
+flash_status_t flash_read_view(uint32_t user_address, uint32_t length, flash_view_t * view);
+
 /**
  * @fn flash_status_t flash_read(uint32_t, uint8_t*, uint16_t)
  * @brief Read some bytes out of flash.
@@ -165,6 +724,27 @@ flash_status_t flash_write(uint32_t user_address, uint8_t * data, uint16_t write
  */
 flash_status_t flash_read(uint32_t user_read_address, uint8_t * data, uint16_t length);
 
+/**
+ * @brief Write any amount of data to flash. The data is streamed out a page at a time, whole words straight from
+ * data, so it isn't limited by FLASH_MAX_WRITE_SIZE or the uint16_t lengths of the user implemented functions.
+ *
+ * @param [in] user_address Where to start writing relative to the user defined flash start. Must be word aligned.
+ * @param [in] data Write bytes from here.
+ * @param [in] data_length The number of bytes to write. The whole write must fit in the user flash.
+ * @return Status of execution.
+ */
+flash_status_t flash_write_bulk(uint32_t user_address, uint8_t * data, uint32_t data_length);
+
+/**
+ * @brief Read any amount of data out of flash. The read is broken up into at most page sized reads.
+ *
+ * @param [in] user_read_address Where to start reading relative to the user defined flash start.
+ * @param [out] data Read data into this buffer.
+ * @param [in] length The number of bytes to read out.
+ * @return Status of execution.
+ */
+flash_status_t flash_read_bulk(uint32_t user_read_address, uint8_t * data, uint32_t length);
+
 /**
  * @fn flash_status_t flash_erase_page(uint32_t)
  * @brief Erases the page that the given user address is located on.
@@ -185,17 +765,31 @@ flash_status_t flash_erase_pages(uint8_t page_number, uint8_t number_of_pages);
 int flash_index_register(uint8_t start_page, uint8_t end_page);
 
 /**
- * @brief Write some data to flash using an index as a guide of where to write.
+ * @brief Write some data to flash using an index as a guide of where to write. If the index has a write buffer
+ * the data is collected there instead, see flash_index_set_write_buffer.
  * 
  * @param id The id of the index
  * @param data The data to be written.
- * @param word_count The number of words to be written.
+ * @param word_count The number of words to be written. At most UINT16_MAX bytes, not limited by FLASH_MAX_WRITE_SIZE.
  * @return flash_status_t 
  */
 flash_status_t flash_index_write(uint8_t id, uint8_t * data, uint16_t byte_count);
 
 /**
- * @brief Read from flash using index object.
+ * @brief Write several separate buffers to flash as one piece of data using an index as a guide of where to write.
+ * Behaves exactly like flash_index_write on the concatenation of the pieces, including splitting the data when the
+ * index wraps, but the pieces are never copied into one buffer.
+ * 
+ * @param id The id of the index
+ * @param iov The pieces to write in order.
+ * @param iov_count The number of pieces. The pieces add up to at most UINT16_MAX bytes.
+ * @return flash_status_t 
+ */
+flash_status_t flash_index_writev(uint8_t id, const flash_iovec_t * iov, uint8_t iov_count);
+
+/**
+ * @brief Read from flash using index object. The tail wraps back to the start of the data pages when it reaches the
+ * end. If the index has a read ahead buffer the data is served from there, see flash_index_set_read_ahead.
  * 
  * @param id The index to use.
  * @param data Read into this array.
@@ -205,7 +799,129 @@ flash_status_t flash_index_write(uint8_t id, uint8_t * data, uint16_t byte_count
 flash_status_t flash_index_read(uint8_t id, uint8_t * data, uint16_t data_length);
 
 /**
- * @brief Returns the value of head of given index.
+ * @brief Give an index a RAM buffer for flash_index_read to read ahead into. When a read isn't in the buffer it is
+ * filled with as much of the data from the tail up to the head as fits, so draining an index record by record costs
+ * one flash read per buffer full instead of one per record. Anything past the head is read straight from flash.
+ * 
+ * @param id The index.
+ * @param buffer The buffer, e.g. a page. NULL to stop reading ahead.
+ * @param buffer_size The size of the buffer in bytes.
+ * @return flash_status_t 
+ */
+flash_status_t flash_index_set_read_ahead(uint8_t id, uint8_t * buffer, uint16_t buffer_size);
+
+/**
+ * @brief Write any amount of data to an index. The data is streamed in a page at a time and keeps going round the
+ * index until all of it is written. Each page is erased when the head moves onto the start of it. The index is only
+ * written to flash once at the end.
+ * 
+ * @param id The id of the index
+ * @param data The data to be written.
+ * @param data_length The number of bytes to be written.
+ * @return flash_status_t 
+ */
+flash_status_t flash_index_write_bulk(uint8_t id, uint8_t * data, uint32_t data_length);
+
+/**
+ * @brief Read any amount of data from the tail of an index. The read is broken up into at most page sized reads
+ * and the tail wraps back to the start of the data pages when it reaches the end.
+ * 
+ * @param id The index to use.
+ * @param data Read into this array.
+ * @param data_length Number of bytes to read.
+ * @return flash_status_t 
+ */
+flash_status_t flash_index_read_bulk(uint8_t id, uint8_t * data, uint32_t data_length);
+
+/**
+ * @brief Give an index a RAM buffer to collect writes in. Writes are packed into the buffer back to back without
+ * padding and only written to flash, along with the index, when the buffer fills, when flush_threshold bytes are
+ * waiting, when the oldest data has waited flush_age ticks or when flash_index_flush is called. Data waiting in the
+ * buffer is lost if the index is reset, erased or loaded.
+ * 
+ * @param id The index to buffer.
+ * @param buffer The buffer. Must be a whole number of words and no bigger than the index's data space. NULL to write
+ * anything waiting and stop buffering.
+ * @param buffer_size The size of the buffer in bytes, e.g. a word, a row or a page.
+ * @param flush_threshold Write whole words out once this many bytes are waiting. 0 to only write when full.
+ * @param flush_age Write everything out once the oldest data has waited this many ticks. 0 to never write on age.
+ * Needs a tick source, see flash_set_tick_source.
+ * @return flash_status_t 
+ */
+flash_status_t flash_index_set_write_buffer(uint8_t id, uint8_t * buffer, uint16_t buffer_size, uint16_t flush_threshold, uint32_t flush_age);
+
+/**
+ * @brief Write everything waiting in an index's write buffer out to flash, padding any partial word, and write the
+ * index.
+ * 
+ * @param id The index to flush.
+ * @return flash_status_t 
+ */
+flash_status_t flash_index_flush(uint8_t id);
+
+/**
+ * @brief Keep some pages ahead of the head of an index erased so writes don't have to wait for an erase when the head
+ * moves onto a new page. The pages are erased by flash_poll, one per call, so call it when there's nothing else to do.
+ * The data on those pages is lost that much sooner than it would be otherwise.
+ * 
+ * @param id The index.
+ * @param pages The number of pages to keep erased. At most one less than the number of data pages. 0 to turn it off.
+ * @return flash_status_t 
+ */
+flash_status_t flash_index_set_erase_ahead(uint8_t id, uint8_t pages);
+
+/**
+ * @brief The number of times a write to an index had to wait for a page to be erased.
+ * 
+ * @param id The index.
+ * @return uint32_t The count. 0 if the index doesn't exist.
+ */
+uint32_t flash_index_get_erase_stalls(uint8_t id);
+
+/**
+ * @brief Move the head of an index to the start of the next page, leaving the rest of the page it is on erased. Data
+ * waiting in the index's write buffer is written out first. Does nothing if the head is already at the start of a
+ * page.
+ *
+ * @param id The index.
+ * @return flash_status_t
+ */
+flash_status_t flash_index_next_page(uint8_t id);
+
+/**
+ * @brief Choose when an index writes its head and tail to its index page. Writing them after every write doubles the
+ * number of program operations and fills the index page quickly, which then has to be erased.
+ *
+ * With every policy but FLASH_CHECKPOINT_EVERY_WRITE flash_index_load finds the data written after the index by
+ * scanning forward from the head that was loaded to the first erased word or the end of its page. A word of data
+ * that is all FLASH_EMPTY_VALUE ends the scan early. FLASH_CHECKPOINT_RECORDS, FLASH_CHECKPOINT_BYTES and
+ * FLASH_CHECKPOINT_PAGE also write the index each time the head moves onto a new page so the scan finds everything.
+ * With FLASH_CHECKPOINT_MANUAL data written past the end of that page isn't found. Use the same policy every time
+ * the index is loaded.
+ *
+ * @param id The index.
+ * @param policy When to write the index.
+ * @param every The number of writes for FLASH_CHECKPOINT_RECORDS or bytes for FLASH_CHECKPOINT_BYTES. Must not be
+ * 0 for those. Ignored for the others.
+ * @return flash_status_t
+ */
+flash_status_t flash_index_set_checkpoint(uint8_t id, flash_checkpoint_policy_t policy, uint32_t every);
+
+/**
+ * @brief Choose whether the head and tail an index writes to its index page are followed by their CRC-32C. With it on
+ * flash_index_load skips back past index data that was only partly written, e.g. because the power went, or that has
+ * been corrupted, and loads the newest good head and tail instead. The index page is laid out differently with it on
+ * so change it before anything is written to the index page or after flash_index_erase_index, and use the same
+ * setting every time the index is loaded.
+ *
+ * @param id The index.
+ * @param enable true to write and check the CRC.
+ * @return flash_status_t
+ */
+flash_status_t flash_index_set_checkpoint_crc(uint8_t id, bool enable);
+
+/**
+ * @brief Returns the value of head of given index. Includes any data waiting in the index's write buffer.
  * 
  * @param id The index to get head from.
  * @return uint32_t -1 if error.
@@ -214,7 +930,7 @@ uint32_t flash_index_get_head(uint8_t id);
 
 /**
  * @brief User can request to read data from the index space relative to the head of the index.
- * Instead of from the tail.
+ * Instead of from the tail. Data waiting in the index's write buffer is included.
  * 
  * @param id The id of the index to read from.
  * @param position Positive or negative number relative to the head.
@@ -224,6 +940,19 @@ uint32_t flash_index_get_head(uint8_t id);
  */
 flash_status_t flash_index_read_rel_head(uint8_t id, int position, uint8_t * data, uint16_t data_length);
 
+/**
+ * @brief Like flash_index_read_rel_head but gives views straight into memory mapped flash instead of copying.
+ * Data that wraps round the end of the data space comes back as two views, otherwise the second view is empty.
+ * 
+ * @param id The id of the index.
+ * @param position Zero or negative number relative to the head.
+ * @param length The number of bytes to view.
+ * @param views Set to the views, in order.
+ * @return flash_status_t FLASH_ERROR if the flash isn't memory mapped or the data is still in the index's write
+ * buffer, flush the index first.
+ */
+flash_status_t flash_index_view_rel_head(uint8_t id, int position, uint32_t length, flash_view_t views[2]);
+
 /**
  * @brief Erase all data pages in an index.
  * 
@@ -267,11 +996,266 @@ flash_status_t flash_index_get_index_address(uint8_t id, uint32_t *address);
 flash_status_t flash_index_reset(uint8_t id);
 
 /**
- * @brief Load the index data stored in flash into the given index object.
+ * @brief Load the index data stored in flash into the given index object. Depending on the index's checkpoint
+ * policy the head is then moved past any data written after the index was, see flash_index_set_checkpoint.
  * 
  * @param id The index you want to load.
  * @return flash_status_t 
  */
 flash_status_t flash_index_load(uint8_t id);
 
+/* CONTEXT FUNCTION DECLARATIONS */
+
+/**
+ * @brief Get the default context that the functions without a context use, e.g. to hand it to something that takes
+ * a context.
+ *
+ * @return flash_ctx_t* The default context.
+ */
+flash_ctx_t * flash_default_ctx(void);
+
+/**
+ * @brief flash_init on the given context. Clears anything the context held before.
+ */
+void flash_ctx_init(flash_ctx_t * ctx, flash_write_ptr write_fn, flash_read_ptr read_fn, erase_ptr erase_fn, uint8_t word_size, uint16_t page_size, uint8_t number_of_pages, uint8_t start_page, uint32_t base_address, flash_endianess_t endianess);
+
+/**
+ * @brief flash_set_tick_source on the given context.
+ */
+void flash_ctx_set_tick_source(flash_ctx_t * ctx, flash_tick_ptr tick_fn);
+
+/**
+ * @brief flash_poll on the given context.
+ */
+flash_status_t flash_ctx_poll(flash_ctx_t * ctx);
+
+/**
+ * @brief flash_set_erased_map on the given context.
+ */
+flash_status_t flash_ctx_set_erased_map(flash_ctx_t * ctx, uint8_t * map, uint32_t map_size);
+
+/**
+ * @brief flash_is_erased on the given context.
+ */
+bool flash_ctx_is_erased(flash_ctx_t * ctx, uint32_t user_address, uint32_t length);
+
+/**
+ * @brief flash_set_read_cache on the given context.
+ */
+flash_status_t flash_ctx_set_read_cache(flash_ctx_t * ctx, flash_cache_slot_t * slots, uint8_t slot_count, uint8_t * arena, uint32_t arena_size);
+
+/**
+ * @brief flash_get_read_cache_counts on the given context.
+ */
+void flash_ctx_get_read_cache_counts(flash_ctx_t * ctx, uint32_t * hits, uint32_t * misses);
+
+/**
+ * @brief flash_set_wear_leveling on the given context.
+ */
+flash_status_t flash_ctx_set_wear_leveling(flash_ctx_t * ctx, uint8_t spare_start_page, uint8_t spare_pages, uint32_t threshold, uint32_t * table, uint32_t table_size);
+
+/**
+ * @brief flash_save_wear on the given context.
+ */
+flash_status_t flash_ctx_save_wear(flash_ctx_t * ctx);
+
+/**
+ * @brief flash_get_erase_count on the given context.
+ */
+flash_status_t flash_ctx_get_erase_count(flash_ctx_t * ctx, uint8_t page, uint32_t * count);
+
+/**
+ * @brief flash_get_wear_stats on the given context.
+ */
+flash_status_t flash_ctx_get_wear_stats(flash_ctx_t * ctx, uint32_t endurance, flash_wear_stats_t * stats);
+
+#ifdef FLASH_ENABLE_STATS
+/**
+ * @brief flash_set_stats_clock on the given context.
+ */
+void flash_ctx_set_stats_clock(flash_ctx_t * ctx, flash_tick_ptr clock_fn);
+
+/**
+ * @brief flash_stats_get on the given context.
+ */
+void flash_ctx_stats_get(flash_ctx_t * ctx, flash_stats_t * stats);
+
+/**
+ * @brief flash_index_stats_get on the given context.
+ */
+flash_status_t flash_ctx_index_stats_get(flash_ctx_t * ctx, uint8_t id, flash_index_stats_t * stats);
+
+/**
+ * @brief flash_stats_reset on the given context.
+ */
+void flash_ctx_stats_reset(flash_ctx_t * ctx);
+#endif
+
+#ifdef FLASH_ENABLE_TRACE
+/**
+ * @brief flash_set_trace on the given context.
+ */
+flash_status_t flash_ctx_set_trace(flash_ctx_t * ctx, flash_trace_event_t * events, uint32_t event_count, flash_tick_ptr clock_fn);
+
+/**
+ * @brief flash_trace_copy on the given context.
+ */
+uint32_t flash_ctx_trace_copy(flash_ctx_t * ctx, flash_trace_event_t * events, uint32_t size, uint32_t * lost);
+#endif
+
+/**
+ * @brief flash_write on the given context.
+ */
+flash_status_t flash_ctx_write(flash_ctx_t * ctx, uint32_t user_address, uint8_t * data, uint16_t write_length);
+
+/**
+ * @brief flash_writev on the given context.
+ */
+flash_status_t flash_ctx_writev(flash_ctx_t * ctx, uint32_t user_address, const flash_iovec_t * iov, uint8_t iov_count);
+
+/**
+ * @brief flash_set_memory_map on the given context.
+ */
+void flash_ctx_set_memory_map(flash_ctx_t * ctx, const uint8_t * mapped);
+
+/**
+ * @brief flash_read_view on the given context.
+ */
+flash_status_t flash_ctx_read_view(flash_ctx_t * ctx, uint32_t user_address, uint32_t length, flash_view_t * view);
+
+/**
+ * @brief flash_read on the given context.
+ */
+flash_status_t flash_ctx_read(flash_ctx_t * ctx, uint32_t user_read_address, uint8_t * data, uint16_t length);
+
+/**
+ * @brief flash_write_bulk on the given context.
+ */
+flash_status_t flash_ctx_write_bulk(flash_ctx_t * ctx, uint32_t user_address, uint8_t * data, uint32_t data_length);
+
+/**
+ * @brief flash_read_bulk on the given context.
+ */
+flash_status_t flash_ctx_read_bulk(flash_ctx_t * ctx, uint32_t user_read_address, uint8_t * data, uint32_t length);
+
+/**
+ * @brief flash_erase_pages on the given context.
+ */
+flash_status_t flash_ctx_erase_pages(flash_ctx_t * ctx, uint8_t page_number, uint8_t number_of_pages);
+
+/**
+ * @brief flash_index_register on the given context.
+ */
+int flash_ctx_index_register(flash_ctx_t * ctx, uint8_t start_page, uint8_t end_page);
+
+/**
+ * @brief flash_index_write on the given context.
+ */
+flash_status_t flash_ctx_index_write(flash_ctx_t * ctx, uint8_t id, uint8_t * data, uint16_t byte_count);
+
+/**
+ * @brief flash_index_writev on the given context.
+ */
+flash_status_t flash_ctx_index_writev(flash_ctx_t * ctx, uint8_t id, const flash_iovec_t * iov, uint8_t iov_count);
+
+/**
+ * @brief flash_index_read on the given context.
+ */
+flash_status_t flash_ctx_index_read(flash_ctx_t * ctx, uint8_t id, uint8_t * data, uint16_t data_length);
+
+/**
+ * @brief flash_index_set_read_ahead on the given context.
+ */
+flash_status_t flash_ctx_index_set_read_ahead(flash_ctx_t * ctx, uint8_t id, uint8_t * buffer, uint16_t buffer_size);
+
+/**
+ * @brief flash_index_write_bulk on the given context.
+ */
+flash_status_t flash_ctx_index_write_bulk(flash_ctx_t * ctx, uint8_t id, uint8_t * data, uint32_t data_length);
+
+/**
+ * @brief flash_index_read_bulk on the given context.
+ */
+flash_status_t flash_ctx_index_read_bulk(flash_ctx_t * ctx, uint8_t id, uint8_t * data, uint32_t data_length);
+
+/**
+ * @brief flash_index_set_write_buffer on the given context.
+ */
+flash_status_t flash_ctx_index_set_write_buffer(flash_ctx_t * ctx, uint8_t id, uint8_t * buffer, uint16_t buffer_size, uint16_t flush_threshold, uint32_t flush_age);
+
+/**
+ * @brief flash_index_flush on the given context.
+ */
+flash_status_t flash_ctx_index_flush(flash_ctx_t * ctx, uint8_t id);
+
+/**
+ * @brief flash_index_set_erase_ahead on the given context.
+ */
+flash_status_t flash_ctx_index_set_erase_ahead(flash_ctx_t * ctx, uint8_t id, uint8_t pages);
+
+/**
+ * @brief flash_index_get_erase_stalls on the given context.
+ */
+uint32_t flash_ctx_index_get_erase_stalls(flash_ctx_t * ctx, uint8_t id);
+
+/**
+ * @brief flash_index_next_page on the given context.
+ */
+flash_status_t flash_ctx_index_next_page(flash_ctx_t * ctx, uint8_t id);
+
+/**
+ * @brief flash_index_set_checkpoint on the given context.
+ */
+flash_status_t flash_ctx_index_set_checkpoint(flash_ctx_t * ctx, uint8_t id, flash_checkpoint_policy_t policy, uint32_t every);
+
+/**
+ * @brief flash_index_set_checkpoint_crc on the given context.
+ */
+flash_status_t flash_ctx_index_set_checkpoint_crc(flash_ctx_t * ctx, uint8_t id, bool enable);
+
+/**
+ * @brief flash_index_get_head on the given context.
+ */
+uint32_t flash_ctx_index_get_head(flash_ctx_t * ctx, uint8_t id);
+
+/**
+ * @brief flash_index_read_rel_head on the given context.
+ */
+flash_status_t flash_ctx_index_read_rel_head(flash_ctx_t * ctx, uint8_t id, int position, uint8_t * data, uint16_t data_length);
+
+/**
+ * @brief flash_index_view_rel_head on the given context.
+ */
+flash_status_t flash_ctx_index_view_rel_head(flash_ctx_t * ctx, uint8_t id, int position, uint32_t length, flash_view_t views[2]);
+
+/**
+ * @brief flash_index_erase_all_data on the given context.
+ */
+flash_status_t flash_ctx_index_erase_all_data(flash_ctx_t * ctx, uint8_t id);
+
+/**
+ * @brief flash_index_erase_index on the given context.
+ */
+flash_status_t flash_ctx_index_erase_index(flash_ctx_t * ctx, uint8_t id);
+
+/**
+ * @brief flash_index_write_index on the given context.
+ */
+flash_status_t flash_ctx_index_write_index(flash_ctx_t * ctx, uint8_t id);
+
+/**
+ * @brief flash_index_get_index_address on the given context.
+ */
+flash_status_t flash_ctx_index_get_index_address(flash_ctx_t * ctx, uint8_t id, uint32_t *address);
+
+/**
+ * @brief flash_index_reset on the given context.
+ */
+flash_status_t flash_ctx_index_reset(flash_ctx_t * ctx, uint8_t id);
+
+/**
+ * @brief flash_index_load on the given context.
+ */
+flash_status_t flash_ctx_index_load(flash_ctx_t * ctx, uint8_t id);
+
 #endif /* INC_FLASH_H_ */
@@ -0,0 +1,161 @@
+/**
+ * @file flash_async.h
+ * @brief Asynchronous front end for the flash module. Any number of threads or interrupts submit operations to a
+ * bounded lock-free queue and a single worker, the only thing that calls the flash module, carries them out in the
+ * order they were submitted. This serializes flash operations without each user building their own queue.
+ *
+ * Operations are not copied. The operation and any data it points to belong to the flash worker from when they are
+ * submitted until they are complete.
+ */
+
+#ifndef INC_FLASH_ASYNC_H_
+#define INC_FLASH_ASYNC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash.h"
+
+/* PUBLIC TYPES */
+
+/**
+ * @brief The flash module function an operation is carried out with.
+ */
+typedef enum{
+	FLASH_ASYNC_WRITE,				/**< flash_write_bulk(address, data, length) */
+	FLASH_ASYNC_READ,				/**< flash_read_bulk(address, data, length) */
+	FLASH_ASYNC_ERASE,				/**< flash_erase_pages(address, length) */
+	FLASH_ASYNC_INDEX_WRITE,		/**< flash_index_write(id, data, length) */
+	FLASH_ASYNC_INDEX_READ,			/**< flash_index_read(id, data, length) */
+	FLASH_ASYNC_INDEX_READ_REL_HEAD,	/**< flash_index_read_rel_head(id, position, data, length) */
+	FLASH_ASYNC_INDEX_FLUSH			/**< flash_index_flush(id) */
+}flash_async_type_t;
+
+/**
+ * @brief Where an operation is up to.
+ */
+typedef enum{
+	FLASH_ASYNC_IDLE,
+	FLASH_ASYNC_PENDING,
+	FLASH_ASYNC_IN_DONE,	/**< Carried out, the worker is calling done. */
+	FLASH_ASYNC_COMPLETE
+}flash_async_state_t;
+
+typedef struct flash_async_op flash_async_op_t;
+
+/**
+ * @brief Function pointer type for being told that an operation is complete. Called from the worker.
+ * @param op The operation that completed. Its status holds the result.
+ */
+typedef void (*flash_async_done_ptr)(flash_async_op_t * op);
+
+/**
+ * @brief An operation for the flash worker to carry out.
+ * @param type What to do.
+ * @param address Flash address for writes and reads, start page for erases.
+ * @param id Index for index operations.
+ * @param position Position relative to the head for FLASH_ASYNC_INDEX_READ_REL_HEAD.
+ * @param data Data to write or buffer to read into.
+ * @param length Number of bytes to write or read, number of pages for erases.
+ * @param done Optional function called by the worker when the operation is complete, before flash_async_is_complete
+ * says so. The operation can be reused from inside it; if it is submitted again it stays pending.
+ * @param user Anything the submitter wants to get back in done.
+ * @param state Where the operation is up to. Read it with flash_async_is_complete.
+ * @param status Result of the operation once it is complete.
+ */
+struct flash_async_op{
+	flash_async_type_t type;
+	uint32_t address;
+	uint8_t id;
+	int position;
+	uint8_t * data;
+	uint32_t length;
+	flash_async_done_ptr done;
+	void * user;
+	volatile uint8_t state;
+	flash_status_t status;
+};
+
+/**
+ * @brief A place in the queue. Provided by the user, see flash_async_init.
+ * @param op The operation held in this place.
+ * @param sequence Used to hand the place between submitters and the worker without a lock.
+ */
+typedef struct{
+	flash_async_op_t * op;
+	uint32_t sequence;
+}flash_async_slot_t;
+
+/**
+ * @brief A queue of operations for the flash worker.
+ * @param ctx The flash the operations are carried out on.
+ * @param slots The places in the queue.
+ * @param mask Number of slots - 1.
+ * @param enqueue_position Count of operations submitted.
+ * @param dequeue_position Count of operations taken by the worker.
+ */
+typedef struct{
+	flash_ctx_t * ctx;
+	flash_async_slot_t * slots;
+	uint32_t mask;
+	uint32_t enqueue_position;
+	uint32_t dequeue_position;
+}flash_async_t;
+
+/**
+ * @brief Function pointer type for the worker to call when there is nothing in the queue, e.g. to sleep until
+ * something is submitted.
+ * @param queue The queue the worker is draining.
+ * @return true to keep the worker running, false to make flash_async_worker return.
+ */
+typedef bool (*flash_async_idle_ptr)(flash_async_t * queue);
+
+/* PUBLIC FUNCTION DECLARATIONS */
+
+/**
+ * @brief Initialize a queue.
+ * 
+ * @param queue The queue.
+ * @param ctx The flash to carry operations out on, e.g. flash_default_ctx(). Each flash can have its own queue and
+ * worker.
+ * @param slots Places for the queue to use.
+ * @param slot_count The number of places. Must be a power of two. This is the most operations that can be waiting.
+ * @return flash_status_t 
+ */
+flash_status_t flash_async_init(flash_async_t * queue, flash_ctx_t * ctx, flash_async_slot_t * slots, uint32_t slot_count);
+
+/**
+ * @brief Submit an operation to the queue. Safe to call from any number of threads at once.
+ * 
+ * @param queue The queue.
+ * @param op The operation. It must not already be pending.
+ * @return flash_status_t FLASH_ERROR if the queue is full.
+ */
+flash_status_t flash_async_submit(flash_async_t * queue, flash_async_op_t * op);
+
+/**
+ * @brief Check if an operation is complete. Once it is, op->status holds the result.
+ * 
+ * @param op The operation.
+ * @return true The operation is complete.
+ */
+bool flash_async_is_complete(flash_async_op_t * op);
+
+/**
+ * @brief Carry out waiting operations in the order they were submitted. Must only be called from one thread.
+ * 
+ * @param queue The queue.
+ * @param max_ops The most operations to carry out. 0 to keep going until the queue is empty.
+ * @return uint32_t The number of operations carried out.
+ */
+uint32_t flash_async_process(flash_async_t * queue, uint32_t max_ops);
+
+/**
+ * @brief The flash worker loop. Drains the queue, calls flash_poll, then calls idle when there is nothing to do.
+ * Returns when idle returns false.
+ * 
+ * @param queue The queue.
+ * @param idle Called when the queue is empty.
+ */
+void flash_async_worker(flash_async_t * queue, flash_async_idle_ptr idle);
+
+#endif /* INC_FLASH_ASYNC_H_ */
@@ -0,0 +1,58 @@
+/**
+ * @file flash_crc.h
+ * @brief Checksums for data kept in flash.
+ *
+ * flash_crc32c picks the fastest way of calculating the CRC that works here: the CPU's CRC-32C instruction where it
+ * has one (SSE 4.2 on x86, checked at run time, or the ARMv8 CRC extension when it is compiled for), otherwise
+ * slicing-by-8 which looks up 8 tables per 8 bytes. The others can be called directly, e.g. to compare them.
+ */
+
+#ifndef INC_FLASH_CRC_H_
+#define INC_FLASH_CRC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* PUBLIC TYPES */
+
+/**
+ * @brief Ways of calculating a CRC-32C. They all give the same answer.
+ */
+typedef enum{
+	FLASH_CRC_BYTEWISE,	/**< A table lookup per byte. Uses the first 1 KiB of the slicing-by-8 tables. */
+	FLASH_CRC_SLICE8,	/**< 8 table lookups per 8 bytes. 8 KiB of const tables, so they can stay in flash. */
+	FLASH_CRC_HARDWARE	/**< The CPU's CRC-32C instruction. */
+}flash_crc_impl_t;
+
+/* PUBLIC FUNCTION DECLARATIONS */
+
+/**
+ * @brief Calculate the CRC-32C of some data, or carry on calculating it over more data.
+ *
+ * @param crc 0 to start a new CRC, otherwise the CRC of the data that comes before this data.
+ * @param data The data.
+ * @param length The number of bytes of data.
+ * @return uint32_t The CRC of everything so far.
+ */
+uint32_t flash_crc32c(uint32_t crc, const uint8_t * data, uint32_t length);
+
+/**
+ * @brief flash_crc32c calculated a particular way.
+ *
+ * @param impl How to calculate it. FLASH_CRC_HARDWARE falls back to FLASH_CRC_SLICE8 if the CPU can't do it.
+ * @param crc 0 to start a new CRC, otherwise the CRC of the data that comes before this data.
+ * @param data The data.
+ * @param length The number of bytes of data.
+ * @return uint32_t The CRC of everything so far.
+ */
+uint32_t flash_crc32c_impl(flash_crc_impl_t impl, uint32_t crc, const uint8_t * data, uint32_t length);
+
+/**
+ * @brief Check whether the CPU this is running on has a CRC-32C instruction the driver can use.
+ *
+ * @return true FLASH_CRC_HARDWARE uses the CPU.
+ * @return false FLASH_CRC_HARDWARE is slicing-by-8.
+ */
+bool flash_crc_hardware_available(void);
+
+#endif /* INC_FLASH_CRC_H_ */
@@ -0,0 +1,185 @@
+/**
+ * @file flash_kv.h
+ * @brief A key value store on top of an index, e.g. for configuration and calibration values. Every set and delete
+ * is appended to the index as a record, see flash_record.h, so nothing has to be erased to change a value. A hash
+ * table in RAM, with slots provided by the user, remembers where the latest record of each key is so a get is a
+ * couple of reads wherever the key is in flash. Deleting a key appends a tombstone record.
+ *
+ * The data of each record is
+ *
+ *   type (1) | key length (1) | key | value
+ *
+ * where type is FLASH_KV_SET or FLASH_KV_DELETE and a delete has no value.
+ *
+ * The records are never written over the oldest ones so once the index is full sets and deletes fail until space is
+ * made. Don't give the index a write buffer, values are read back from flash.
+ *
+ * Space is made a bit at a time with flash_kv_gc_step, see flash_kv_set_gc. The live records on the oldest page of the
+ * index are copied to a second, cold, index and the page is erased. Records that have been copied once have lived
+ * longer than most so they are kept apart from the new ones and are copied again far less often. The cold index is
+ * collected into itself the same way.
+ */
+
+#ifndef INC_FLASH_KV_H_
+#define INC_FLASH_KV_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash.h"
+#include "flash_record.h"
+
+/* PUBLIC DEFINES */
+
+/**
+ * @brief The longest key that can be stored.
+ */
+#define FLASH_KV_MAX_KEY 32
+
+/**
+ * @brief The number of bytes of a record's data that aren't the key or the value.
+ */
+#define FLASH_KV_OVERHEAD 2
+
+/**
+ * @brief The address in an unused hash table slot.
+ */
+#define FLASH_KV_EMPTY_SLOT 0xFFFFFFFF
+
+/* PUBLIC TYPES */
+
+/**
+ * @brief What a record does to its key.
+ */
+typedef enum{
+	FLASH_KV_SET = 1,		/**< Give the key the value in the record. */
+	FLASH_KV_DELETE = 2		/**< Remove the key. */
+}flash_kv_type_t;
+
+/**
+ * @brief A hash table slot.
+ * @param hash Hash of the key.
+ * @param address Flash address of the latest record of the key. FLASH_KV_EMPTY_SLOT if the slot isn't used.
+ */
+typedef struct{
+	uint32_t hash;
+	uint32_t address;
+}flash_kv_slot_t;
+
+/**
+ * @brief A key value store.
+ * @param log The records the keys and values are kept in.
+ * @param slots Hash table of where the latest record of each key is. Open addressing with linear probing.
+ * @param slot_count The number of slots. There can be up to one fewer keys than this.
+ * @param key_count The number of keys stored.
+ * @param cold Records that have been copied by garbage collection. Not used until flash_kv_set_gc is called.
+ * @param gc_buffer Holds a record while it is copied.
+ * @param gc_buffer_size The size of gc_buffer.
+ * @param gc_free_pages Garbage is collected while log has fewer than this many free pages.
+ * @param gc_log The log whose oldest page is being collected, NULL between pages.
+ * @param gc_address The next record to look at on the page being collected.
+ * @param gc_cold_pages The number of cold pages collected in a row, to tell when the cold index is all live records.
+ */
+typedef struct{
+	flash_record_log_t log;
+	flash_kv_slot_t * slots;
+	uint16_t slot_count;
+	uint16_t key_count;
+	flash_record_log_t cold;
+	uint8_t * gc_buffer;
+	uint16_t gc_buffer_size;
+	uint32_t gc_free_pages;
+	flash_record_log_t * gc_log;
+	uint32_t gc_address;
+	uint32_t gc_cold_pages;
+}flash_kv_t;
+
+/* PUBLIC FUNCTION DECLARATIONS */
+
+/**
+ * @brief Start a key value store on an index with nothing in it. To carry on with one that is already in flash call
+ * flash_kv_mount afterwards.
+ *
+ * @param kv The store.
+ * @param ctx The flash the index is on, e.g. flash_default_ctx().
+ * @param id The index.
+ * @param slots The hash table. Give it a good few more slots than there will be keys, lookups slow down as it fills.
+ * @param slot_count The number of slots.
+ * @return flash_status_t
+ */
+flash_status_t flash_kv_init(flash_kv_t * kv, flash_ctx_t * ctx, uint8_t id, flash_kv_slot_t * slots, uint16_t slot_count);
+
+/**
+ * @brief Find the keys already in flash, e.g. after a reboot. The records are walked oldest first and the hash
+ * table rebuilt from them, the cold index first if there is one. Call flash_kv_set_gc before this if it is used.
+ *
+ * @param kv The store.
+ * @param buffer Somewhere to read a page of records into while walking them.
+ * @param buffer_size The size of buffer. At least a page.
+ * @return flash_status_t FLASH_ERROR if there are more keys than the hash table can hold.
+ */
+flash_status_t flash_kv_mount(flash_kv_t * kv, uint8_t * buffer, uint16_t buffer_size);
+
+/**
+ * @brief Set the value of a key.
+ *
+ * @param kv The store.
+ * @param key The key.
+ * @param key_length The number of bytes of key, 1 to FLASH_KV_MAX_KEY.
+ * @param value The value.
+ * @param value_length The number of bytes of value. The record has to fit on a page.
+ * @return flash_status_t FLASH_ERROR if the index or hash table is full.
+ */
+flash_status_t flash_kv_set(flash_kv_t * kv, const uint8_t * key, uint8_t key_length, const uint8_t * value, uint16_t value_length);
+
+/**
+ * @brief Get the value of a key.
+ *
+ * @param kv The store.
+ * @param key The key.
+ * @param key_length The number of bytes of key.
+ * @param value Buffer to read the value into.
+ * @param size The size of value.
+ * @param length Set to the number of bytes in the value.
+ * @return flash_status_t FLASH_DATA_NOT_FOUND if the key isn't set. FLASH_ERROR if the value is bigger than size.
+ */
+flash_status_t flash_kv_get(flash_kv_t * kv, const uint8_t * key, uint8_t key_length, uint8_t * value, uint16_t size, uint16_t * length);
+
+/**
+ * @brief Remove a key by writing a tombstone for it.
+ *
+ * @param kv The store.
+ * @param key The key.
+ * @param key_length The number of bytes of key.
+ * @return flash_status_t FLASH_DATA_NOT_FOUND if the key isn't set. FLASH_ERROR if the index is full.
+ */
+flash_status_t flash_kv_delete(flash_kv_t * kv, const uint8_t * key, uint8_t key_length);
+
+/**
+ * @brief Turn on garbage collection. Pages of the store's index are collected into another index while the store's
+ * index has fewer than free_pages pages free. The cold index holds the live records so give it at least as many pages
+ * as they need plus two, one of which is always kept free for collecting into. Set an erased map, see
+ * flash_set_erased_map, so collected pages aren't erased again when the head gets to them.
+ *
+ * @param kv The store.
+ * @param cold_id The index live records are copied to. Not the store's index.
+ * @param buffer Holds a record while it is copied.
+ * @param buffer_size The size of buffer. At least a page.
+ * @param free_pages How many pages of the store's index to keep free.
+ * @return flash_status_t
+ */
+flash_status_t flash_kv_set_gc(flash_kv_t * kv, uint8_t cold_id, uint8_t * buffer, uint16_t buffer_size, uint32_t free_pages);
+
+/**
+ * @brief Do some garbage collection. Records on the page being collected are looked at and copied one at a time until
+ * either budget is used up, at least one is always done. Once a page has been gone through it is erased as a step of
+ * its own. Call it when there's time, e.g. from an idle loop, until it says there's nothing to do.
+ *
+ * @param kv The store.
+ * @param max_bytes The number of bytes to read and program before stopping. 0 for no limit.
+ * @param max_operations The number of records to look at before stopping. 0 for no limit.
+ * @return flash_status_t FLASH_DATA_NOT_FOUND if there's nothing to collect. FLASH_ERROR if the cold index is full
+ * of live records.
+ */
+flash_status_t flash_kv_gc_step(flash_kv_t * kv, uint32_t max_bytes, uint32_t max_operations);
+
+#endif /* INC_FLASH_KV_H_ */
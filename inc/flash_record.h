@@ -0,0 +1,204 @@
+/**
+ * @file flash_record.h
+ * @brief Self describing records on top of an index. Each record is written to the index with a header holding its
+ * length, a sequence number and a checksum, and ends in a commit marker. Records never cross a page so after a reboot
+ * they can be found again from the start of any page without a checkpoint, and a record whose write was cut short is
+ * skipped.
+ *
+ * A record in flash is laid out as
+ *
+ *   length (2) | ~length (2) | sequence (4) | checksum (4) | data (length) | padding | commit marker (4)
+ *
+ * all little endian, padded with FLASH_EMPTY_VALUE so the commit marker ends on a word boundary and is the last thing
+ * programmed. The checksum is the CRC-32C of the first 8 bytes of the header and the data.
+ */
+
+#ifndef INC_FLASH_RECORD_H_
+#define INC_FLASH_RECORD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash.h"
+
+/* PUBLIC DEFINES */
+
+/**
+ * @brief The number of bytes of a record before its data.
+ */
+#define FLASH_RECORD_HEADER_SIZE 12
+
+/**
+ * @brief The number of bytes of a record that aren't data, not counting padding.
+ */
+#define FLASH_RECORD_OVERHEAD (FLASH_RECORD_HEADER_SIZE + 4)
+
+/**
+ * @brief The value of the commit marker at the end of every record that was written completely.
+ */
+#define FLASH_RECORD_COMMIT 0xC0DEC0DE
+
+/* PUBLIC TYPES */
+
+/**
+ * @brief Records on an index.
+ * @param ctx The flash the index is on.
+ * @param id The index the records are written to.
+ * @param sequence The sequence number the next record gets.
+ * @param last_address Flash address of the record last written with flash_record_write.
+ */
+typedef struct{
+	flash_ctx_t * ctx;
+	uint8_t id;
+	uint32_t sequence;
+	uint32_t last_address;
+}flash_record_log_t;
+
+/**
+ * @brief Which way an iterator walks the records.
+ */
+typedef enum{
+	FLASH_RECORD_OLDEST_FIRST,	/**< From the tail to the head. */
+	FLASH_RECORD_NEWEST_FIRST	/**< From the head back to the tail. */
+}flash_record_direction_t;
+
+/**
+ * @brief Walks the records between the tail and the head of an index without moving the tail. Records are read a
+ * page at a time into a buffer provided by the user and handed out from there.
+ * @param log The records.
+ * @param direction Which way to walk.
+ * @param buffer Holds the records of the page being walked.
+ * @param from Flash address of the first byte in buffer.
+ * @param to Flash address just past the last byte in buffer.
+ * @param offset Where the next record is in buffer, limit if there are no more.
+ * @param limit The number of bytes in buffer.
+ * @param sequence The sequence number of the record last handed out.
+ * @param address Flash address of the record last handed out.
+ * @param done Whether there are no more records.
+ */
+typedef struct{
+	flash_record_log_t * log;
+	flash_record_direction_t direction;
+	uint8_t * buffer;
+	uint32_t from;
+	uint32_t to;
+	uint32_t offset;
+	uint32_t limit;
+	uint32_t sequence;
+	uint32_t address;
+	bool done;
+}flash_record_iter_t;
+
+/* PUBLIC FUNCTION DECLARATIONS */
+
+/**
+ * @brief Start using an index for records. The index should only be written with flash_record_write from here on.
+ * After a reboot call flash_record_recover to find where the records got to.
+ *
+ * @param log The records.
+ * @param ctx The flash the index is on, e.g. flash_default_ctx().
+ * @param id The index.
+ * @return flash_status_t
+ */
+flash_status_t flash_record_init(flash_record_log_t * log, flash_ctx_t * ctx, uint8_t id);
+
+/**
+ * @brief Write a record at the head of the index. If it doesn't fit on the rest of the page at the head the head is
+ * moved to the next page first.
+ *
+ * @param log The records.
+ * @param data The data of the record.
+ * @param length The number of bytes of data. The record has to fit on a page.
+ * @return flash_status_t
+ */
+flash_status_t flash_record_write(flash_record_log_t * log, const uint8_t * data, uint16_t length);
+
+/**
+ * @brief flash_record_write with the data of the record in pieces, written back to back as if they were one buffer.
+ *
+ * @param log The records.
+ * @param iov The pieces of the data.
+ * @param iov_count The number of pieces.
+ * @return flash_status_t
+ */
+flash_status_t flash_record_writev(flash_record_log_t * log, const flash_iovec_t * iov, uint8_t iov_count);
+
+/**
+ * @brief The number of bytes a record takes up in flash, including its header, padding and commit marker.
+ *
+ * @param log The records.
+ * @param length The number of bytes of data.
+ * @return uint32_t The size, 0 if log isn't set up.
+ */
+uint32_t flash_record_size(flash_record_log_t * log, uint16_t length);
+
+/**
+ * @brief Read the record at the tail of the index and move the tail past it. Records that weren't written completely
+ * or don't match their checksum are skipped. Only records that have reached flash are read so flush a buffered index
+ * first.
+ *
+ * @param log The records.
+ * @param data Buffer to read the data of the record into.
+ * @param size The size of data.
+ * @param length Set to the number of bytes of data in the record.
+ * @return flash_status_t FLASH_DATA_NOT_FOUND if there are no more records. FLASH_ERROR if the record is bigger than
+ * size, the tail is left at it.
+ */
+flash_status_t flash_record_read(flash_record_log_t * log, uint8_t * data, uint16_t size, uint16_t * length);
+
+/**
+ * @brief Read the record at an address without moving the tail, e.g. to go through a page of records one at a time.
+ *
+ * @param log The records.
+ * @param address Where the record starts.
+ * @param data Buffer to read the data of the record into.
+ * @param size The size of data.
+ * @param length Set to the number of bytes of data in the record.
+ * @param next Set to where the next record could start. The start of the next page if there are no more records on
+ * this one.
+ * @return flash_status_t FLASH_DATA_NOT_FOUND if there's no complete record at address. FLASH_ERROR if the record is
+ * bigger than size.
+ */
+flash_status_t flash_record_read_at(flash_record_log_t * log, uint32_t address, uint8_t * data, uint16_t size, uint16_t * length, uint32_t * next);
+
+/**
+ * @brief Find the records on the index from the flash alone, without the index page. The head is put after the newest
+ * complete record, the tail at the start of the oldest page of records and the next sequence number follows on from
+ * the newest record.
+ *
+ * @param log The records.
+ * @return flash_status_t FLASH_DATA_NOT_FOUND if there are no records, the index is left empty.
+ */
+flash_status_t flash_record_recover(flash_record_log_t * log);
+
+/**
+ * @brief Start walking the records that have reached flash. The first page to walk is read straight away.
+ *
+ * @param iter The iterator.
+ * @param log The records.
+ * @param direction Which way to walk.
+ * @param buffer Somewhere to read a page of records into. The iterator works in it too, only the data it hands out
+ * is as it is in flash.
+ * @param buffer_size The size of buffer. At least a page.
+ * @return flash_status_t
+ */
+flash_status_t flash_record_iter_begin(flash_record_iter_t * iter, flash_record_log_t * log, flash_record_direction_t direction, uint8_t * buffer, uint16_t buffer_size);
+
+/**
+ * @brief Get the next record. Records that weren't written completely or don't match their checksum are skipped.
+ * The index mustn't be written while it is being walked.
+ *
+ * @param iter The iterator.
+ * @param data Set to point at the data of the record in the iterator's buffer. Only good until the next call.
+ * @param length Set to the number of bytes of data.
+ * @return flash_status_t FLASH_DATA_NOT_FOUND once there are no more records.
+ */
+flash_status_t flash_record_iter_next(flash_record_iter_t * iter, const uint8_t ** data, uint16_t * length);
+
+/**
+ * @brief Finish walking the records. The buffer can be used for something else afterwards.
+ *
+ * @param iter The iterator.
+ */
+void flash_record_iter_end(flash_record_iter_t * iter);
+
+#endif /* INC_FLASH_RECORD_H_ */
@@ -0,0 +1,72 @@
+/**
+ * @file flash_trace.h
+ * @brief Reading trace events on the host. Build the driver with FLASH_ENABLE_TRACE and give it a ring with
+ * flash_set_trace, then get the ring off the target, e.g. with flash_trace_copy or a debugger, and decode it with these.
+ * Nothing here needs FLASH_ENABLE_TRACE.
+ *
+ * An event is 16 bytes, all little endian:
+ *
+ *   timestamp (4) | address (4) | length (4) | type (1) | id (1) | status (1) | reserved (1)
+ *
+ * which is how flash_trace_event_t is laid out in memory on a little endian target.
+ */
+
+#ifndef INC_FLASH_TRACE_H_
+#define INC_FLASH_TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "flash.h"
+
+/* PUBLIC DEFINES */
+
+/**
+ * @brief The number of bytes of an event.
+ */
+#define FLASH_TRACE_EVENT_SIZE 16
+
+/* PUBLIC FUNCTION DECLARATIONS */
+
+/**
+ * @brief Decode an event from the bytes it was copied off the target as.
+ *
+ * @param bytes The event.
+ * @param length The number of bytes there are, at least FLASH_TRACE_EVENT_SIZE.
+ * @param event Set to the event.
+ * @return flash_status_t FLASH_ERROR if there aren't enough bytes or it isn't an event, e.g. a ring that hasn't been
+ * filled yet.
+ */
+flash_status_t flash_trace_decode(const uint8_t * bytes, uint32_t length, flash_trace_event_t * event);
+
+/**
+ * @brief The name of the type of an event, without FLASH_TRACE_EXIT.
+ *
+ * @param type The type.
+ * @return const char* The name, e.g. "index_write", or "unknown".
+ */
+const char * flash_trace_name(uint8_t type);
+
+/**
+ * @brief Write an event as a line of text, without a newline, e.g.
+ *
+ *   120 index_write exit id 0 address 0x00000140 length 8 status 0
+ *
+ * @param event The event.
+ * @param text Where to write it.
+ * @param size The size of text. The line is cut short to fit.
+ * @return int The length of the whole line, as snprintf.
+ */
+int flash_trace_format(const flash_trace_event_t * event, char * text, uint32_t size);
+
+/**
+ * @brief Decode a ring's worth of events, oldest first, and print them a line each. Whatever a driver function did is
+ * indented under it, the way its calls nest. Bytes that aren't events are skipped.
+ *
+ * @param out Where to print them.
+ * @param bytes The events back to back.
+ * @param length The number of bytes.
+ * @return uint32_t The number of events printed.
+ */
+uint32_t flash_trace_print(FILE * out, const uint8_t * bytes, uint32_t length);
+
+#endif /* INC_FLASH_TRACE_H_ */
@@ -6,6 +6,7 @@
  */
 
 #include "flash.h"
+#include "flash_crc.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
@@ -16,667 +17,3850 @@
 #define USER_TO_FLASH_ADDRESS(start_address, user_address) \
   start_address + user_address
 
-/* This is the total number of distinct areas of flash you can have*/
-#define MAX_INDICES 4
+/* Starts a saved wear leveling table, which has every erase counter and the whole map. */
+#define WEAR_TABLE_MAGIC 0x5745524C
+
+/* Starts a saved move of one page, which has the erase counters of the two pages involved. */
+#define WEAR_MOVE_MAGIC 0x5745524D
+
+/* The number of values in a saved move: magic, sequence, the page, where it went and its counter, where it was and its
+ * counter, CRC. */
+#define WEAR_MOVE_VALUES 8
+
+/* Given to wear_save instead of a page to save the whole table. */
+#define WEAR_WHOLE_TABLE UINT32_MAX
+
+/* Add to one of the statistics. Compiled out along with them. */
+#ifdef FLASH_ENABLE_STATS
+#define STATS_ADD(statistic, amount) ((statistic) += (amount))
+#else
+#define STATS_ADD(statistic, amount) ((void)0)
+#endif
+
+/* Record a trace event, or one for a driver function returning status, which it evaluates to. Compiled out along
+ * with tracing, arguments and all. */
+#ifdef FLASH_ENABLE_TRACE
+#define TRACE(ctx, type, id, address, length, status) trace_record((ctx), (type), (id), (address), (length), (status))
+#define TRACE_EXIT(ctx, type, id, address, length, status) trace_exit((ctx), (type), (id), (address), (length), (status))
+#else
+#define TRACE(ctx, type, id, address, length, status) ((void)0)
+#define TRACE_EXIT(ctx, type, id, address, length, status) (status)
+#endif
+
+// PRIVATE TYPES
+
+/* Tracks how far through a list of scatter-gather pieces a write has got. */
+typedef struct
+{
+  const flash_iovec_t *iov;
+  uint8_t iov_count;
+  uint8_t position;
+  uint16_t offset;
+} iov_cursor_t;
+
+/* Collects the bytes of a wear leveling table being saved so they are written a chunk at a time. uint64_t keeps the
+buffer aligned for the user write function. */
+typedef struct
+{
+  uint64_t buffer[FLASH_MAX_WRITE_SIZE / sizeof(uint64_t)];
+  uint16_t length;
+  uint32_t address;
+  uint32_t crc;
+  flash_status_t status;
+} wear_writer_t;
 
 // PRIVATE VARIABLES
-/* This holds the user flash information*/
-static flash_area_t user_flash = {0};
-/* Function to write to flash. Set at init*/
-static flash_write_ptr write = 0;
-/* Function to erase page of flash. */
-static erase_ptr erase = 0;
-/* Function to read from flash. */
-static flash_read_ptr read = 0;
-/* Buffer for padding out what's written to flash. */
-static uint8_t padding_buffer[FLASH_MAX_WRITE_SIZE] = {0x00};
-/* Array of index trackers. */
-static flash_index_t indices[MAX_INDICES] = {0};
-/* The quantity of trackers you have. */
-static uint8_t index_count = 0;
+/* The context used by the functions that don't take one. */
+static flash_ctx_t default_ctx;
+
+// PRIVATE FUNCTION DECLARATIONS
+
+/**
+ * @brief Is the flash initialized.
+ *
+ * @return true User flash is initialized.
+ * @return false User flash is not initialized.
+ */
+static bool initialized(flash_ctx_t *ctx);
+
+/**
+ * @brief Check if an index exists.
+ *
+ * @param id The id of the index.
+ * @return true Index exists.
+ * @return false Index doesn't exist.
+ */
+static bool index_exists(flash_ctx_t *ctx, uint8_t id);
+
+/**
+ * @brief Convert a number of bytes to a number of whole words.
+ * @param number_of_bytes The number of bytes to convert.
+ * @return The number of words to represent the bytes.
+ */
+uint16_t bytes_to_words(flash_ctx_t *ctx, uint32_t number_of_bytes);
+
+/**
+ * @brief Convert a number of words to bytes.
+ *
+ * @param number_of_words Number of words to convert.
+ * @return uint16_t The number of bytes.
+ */
+uint16_t words_to_bytes(flash_ctx_t *ctx, uint16_t number_of_words);
+
+/**
+ * @brief Determine the number of bytes required to write some
+ * data as a word aligned quantity.
+ *
+ * @param num_bytes Quantity of bytes to write.
+ * @return uint16_t The number of bytes required.
+ */
+uint16_t bytes_to_byte_aligned(flash_ctx_t *ctx, uint16_t num_bytes);
+
+/**
+ * @brief Find where a word of user flash is in the erased map.
+ *
+ * @param user_address Address of the word.
+ * @param word Set to the number of the word in the map.
+ * @return true The word is in a page that the map is tracking.
+ * @return false The map doesn't know anything about the word.
+ */
+static bool erased_map_word(flash_ctx_t *ctx, uint32_t user_address, uint32_t *word);
+
+/**
+ * @brief Mark some words of user flash as erased or written in the erased map.
+ *
+ * @param user_address Address of the first word.
+ * @param number_of_words The number of words.
+ * @param erased true if the words are erased, false if they have been written.
+ */
+static void erased_map_mark(flash_ctx_t *ctx, uint32_t user_address, uint32_t number_of_words, bool erased);
+
+/**
+ * @brief Check the erased map for any word in a range that is known to have been written.
+ *
+ * @param user_address Address of the first word.
+ * @param number_of_words The number of words.
+ * @return true At least one word is known to be written.
+ * @return false No word is known to be written. They may be erased or the map doesn't know.
+ */
+static bool erased_map_any_written(flash_ctx_t *ctx, uint32_t user_address, uint32_t number_of_words);
+
+/**
+ * @brief Check the erased map for whether every word in a range is known to be erased.
+ *
+ * @param user_address Address of the first word.
+ * @param number_of_words The number of words.
+ * @return true Every word is known to be erased.
+ * @return false At least one word has been written or the map doesn't know.
+ */
+static bool erased_map_all_erased(flash_ctx_t *ctx, uint32_t user_address, uint32_t number_of_words);
+
+/**
+ * @brief Find the read cache slot holding a page.
+ *
+ * @param page The page.
+ * @return flash_cache_slot_t* The slot or NULL if the page isn't cached.
+ */
+static flash_cache_slot_t *cache_find(flash_ctx_t *ctx, uint32_t page);
+
+/**
+ * @brief Drop any cached copies of some pages.
+ *
+ * @param first_page The first page.
+ * @param number_of_pages The number of pages.
+ */
+static void cache_invalidate(flash_ctx_t *ctx, uint32_t first_page, uint32_t number_of_pages);
+
+/**
+ * @brief Read through the user read function, or from the read cache if it has the pages.
+ *
+ * @param user_address Where to start reading.
+ * @param data Read into this.
+ * @param length The number of bytes to read.
+ * @return flash_status_t
+ */
+static flash_status_t backend_read(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t length);
+
+/**
+ * @brief Program words through the user write function, keeping the erased map and the read cache up to date.
+ *
+ * @param user_address Word aligned address to write at.
+ * @param data The words.
+ * @param number_of_words The number of words.
+ * @return flash_status_t FLASH_NOT_ERASED_ERROR if the erased map knows a word has already been written.
+ */
+static flash_status_t backend_write(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t number_of_words);
+
+/**
+ * @brief Erase pages through the user erase function, keeping the erased map and the read cache up to date.
+ *
+ * @param page_number The first page.
+ * @param number_of_pages The number of pages.
+ * @return flash_status_t
+ */
+static flash_status_t backend_erase(flash_ctx_t *ctx, uint8_t page_number, uint8_t number_of_pages);
+
+/**
+ * @brief Call the user read function, counting and timing the call if statistics are on and tracing it if
+ * tracing is.
+ *
+ * @param address Where to read, including the base address.
+ * @param data Read into this.
+ * @param length The number of bytes to read.
+ * @return flash_status_t What the user read function returned.
+ */
+static flash_status_t call_read(flash_ctx_t *ctx, uint32_t address, uint8_t *data, uint16_t length);
+
+/**
+ * @brief Call the user write function, counting and timing the call if statistics are on and tracing it if
+ * tracing is.
+ *
+ * @param address Where to write, including the base address.
+ * @param data The words.
+ * @param number_of_words The number of words.
+ * @return flash_status_t What the user write function returned.
+ */
+static flash_status_t call_write(flash_ctx_t *ctx, uint32_t address, uint8_t *data, uint16_t number_of_words);
+
+/**
+ * @brief Call the user erase function, counting and timing the call if statistics are on and tracing it if
+ * tracing is.
+ *
+ * @param page_number The first page.
+ * @param number_of_pages The number of pages.
+ * @return flash_status_t What the user erase function returned.
+ */
+static flash_status_t call_erase(flash_ctx_t *ctx, uint8_t page_number, uint8_t number_of_pages);
+
+#ifdef FLASH_ENABLE_STATS
+/**
+ * @brief Count a call to a user implemented function and put how long it took in its histogram.
+ *
+ * @param operation Which function was called.
+ * @param start The stats clock before the call.
+ * @param status What the call returned.
+ */
+static void stats_finish(flash_ctx_t *ctx, flash_stats_op_t operation, uint32_t start, flash_status_t status);
+#endif
+
+#ifdef FLASH_ENABLE_TRACE
+/**
+ * @brief Put an event in the trace ring, if there is one. See flash_trace_type_t for what goes in it.
+ *
+ * @param type What happened.
+ * @param id The index, FLASH_TRACE_NO_ID if it isn't about one.
+ * @param address Depends on type.
+ * @param length Depends on type.
+ * @param status What was returned.
+ */
+static void trace_record(flash_ctx_t *ctx, uint8_t type, uint8_t id, uint32_t address, uint32_t length, flash_status_t status);
+
+/**
+ * @brief Trace a driver function returning.
+ *
+ * @param type The function.
+ * @param id The index, FLASH_TRACE_NO_ID if it isn't about one.
+ * @param address Depends on type.
+ * @param length Depends on type.
+ * @param status What the function is returning.
+ * @return flash_status_t status.
+ */
+static flash_status_t trace_exit(flash_ctx_t *ctx, uint8_t type, uint8_t id, uint32_t address, uint32_t length, flash_status_t status);
+
+/**
+ * @brief The head of an index for a trace event, 0 if there's no such index.
+ *
+ * @param id The index.
+ * @return uint32_t The head.
+ */
+static uint32_t trace_head(flash_ctx_t *ctx, uint8_t id);
+
+/**
+ * @brief The tail of an index for a trace event, 0 if there's no such index.
+ *
+ * @param id The index.
+ * @return uint32_t The tail.
+ */
+static uint32_t trace_tail(flash_ctx_t *ctx, uint8_t id);
+#endif
+
+/**
+ * @brief flash_ctx_write without tracing.
+ */
+static flash_status_t ctx_write(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t data_length);
+
+/**
+ * @brief flash_ctx_writev without tracing.
+ */
+static flash_status_t ctx_writev(flash_ctx_t *ctx, uint32_t user_address, const flash_iovec_t *iov, uint8_t iov_count);
+
+/**
+ * @brief flash_ctx_erase_pages without tracing.
+ */
+static flash_status_t ctx_erase_pages(flash_ctx_t *ctx, uint8_t page_number, uint8_t number_of_pages);
+
+/**
+ * @brief flash_ctx_index_writev without tracing.
+ */
+static flash_status_t ctx_index_writev(flash_ctx_t *ctx, uint8_t id, const flash_iovec_t *iov, uint8_t iov_count);
+
+/**
+ * @brief flash_ctx_index_write_index without tracing.
+ */
+static flash_status_t ctx_index_write_index(flash_ctx_t *ctx, uint8_t id);
+
+/**
+ * @brief Where an address of user flash really is, after wear leveling has moved its page.
+ *
+ * @param user_address The address.
+ * @return uint32_t Address to give the user implemented functions, including the base address.
+ */
+static uint32_t device_address(flash_ctx_t *ctx, uint32_t user_address);
+
+/**
+ * @brief Read through the user read function, a page at a time if wear leveling may have moved the pages apart.
+ *
+ * @param user_address Where to start reading.
+ * @param data Read into this.
+ * @param length The number of bytes to read.
+ * @return flash_status_t
+ */
+static flash_status_t device_read(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t length);
+
+/**
+ * @brief Program words through the user write function, a page at a time if wear leveling may have moved the pages
+ * apart.
+ *
+ * @param user_address Word aligned address to write at.
+ * @param data The words.
+ * @param number_of_words The number of words.
+ * @return flash_status_t
+ */
+static flash_status_t device_write(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t number_of_words);
+
+/**
+ * @brief Erase pages through the user erase function, or through wear leveling if it is on.
+ *
+ * @param page_number The first page.
+ * @param number_of_pages The number of pages.
+ * @return flash_status_t
+ */
+static flash_status_t device_erase(flash_ctx_t *ctx, uint8_t page_number, uint8_t number_of_pages);
+
+/**
+ * @brief Get a pointer to some memory mapped user flash.
+ *
+ * @param user_address Where the span starts.
+ * @param length The number of bytes in the span.
+ * @param data Set to the first byte of the span.
+ * @return true The span is in one piece in memory.
+ * @return false Wear leveling has moved its pages apart.
+ */
+static bool mapped_span(flash_ctx_t *ctx, uint32_t user_address, uint32_t length, const uint8_t **data);
+
+/**
+ * @brief The number of pages wear leveling uses, user and spare. Each has a slot in the table.
+ *
+ * @return uint32_t The number of slots.
+ */
+static uint32_t wear_slot_count(flash_ctx_t *ctx);
+
+/**
+ * @brief The physical page in a slot of the wear leveling table. The user pages come first, then the spare pages.
+ *
+ * @param slot The slot.
+ * @return uint8_t The page.
+ */
+static uint8_t wear_page(flash_ctx_t *ctx, uint32_t slot);
+
+/**
+ * @brief The number of values in a saved wear leveling table: magic, sequence, a counter for every slot, the map and
+ * the CRC.
+ *
+ * @return uint32_t The number of values.
+ */
+static uint32_t wear_table_values(flash_ctx_t *ctx);
+
+/**
+ * @brief The number of bytes something saved on a table page takes up, rounded up to whole words.
+ *
+ * @param values The number of values saved.
+ * @return uint32_t The size.
+ */
+static uint32_t wear_entry_size(flash_ctx_t *ctx, uint32_t values);
+
+/**
+ * @brief Where something on a table page is.
+ *
+ * @param meta The table page, 0 or 1.
+ * @param offset Where on the page.
+ * @return uint32_t The address, including the base address.
+ */
+static uint32_t wear_meta_address(flash_ctx_t *ctx, uint8_t meta, uint32_t offset);
+
+/**
+ * @brief Erase a page of user flash, first moving it onto the least worn free page if it has been erased threshold
+ * times more than that, then move data that doesn't change if it is due.
+ *
+ * @param logical The page relative to the start of user flash.
+ * @return flash_status_t
+ */
+static flash_status_t wear_erase_page(flash_ctx_t *ctx, uint32_t logical);
+
+/**
+ * @brief Move the page of user flash that has been erased least onto the most worn free page if it has been erased
+ * threshold times fewer, so the page it was on can be used by pages that are erased often.
+ *
+ * @param busy The page relative to the start of user flash that has just been erased. Not moved.
+ * @return flash_status_t
+ */
+static flash_status_t wear_migrate(flash_ctx_t *ctx, uint32_t busy);
+
+/**
+ * @brief Copy the written words of one page to another page that has been erased. Erased words are left erased so they
+ * can still be written.
+ *
+ * @param from The slot of the page to copy.
+ * @param to The slot of the page to copy to.
+ * @return flash_status_t
+ */
+static flash_status_t wear_copy_page(flash_ctx_t *ctx, uint32_t from, uint32_t to);
+
+/**
+ * @brief Add a value to a wear leveling table being saved, writing out the chunk collected so far if it is full.
+ *
+ * @param writer The table being saved.
+ * @param value The value. Stored little endian.
+ */
+static void wear_put(flash_ctx_t *ctx, wear_writer_t *writer, uint32_t value);
+
+/**
+ * @brief Write out what a wear leveling table being saved has collected, padded out to a whole word.
+ *
+ * @param writer The table being saved.
+ */
+static void wear_flush(flash_ctx_t *ctx, wear_writer_t *writer);
+
+/**
+ * @brief Save a page having moved, or the whole wear leveling table, after what is already on the table page. If it
+ * doesn't fit the other table page is erased and the whole table saved at the start of it instead.
+ *
+ * @param logical The page relative to the start of user flash that moved. WEAR_WHOLE_TABLE to save the whole table.
+ * @param from The slot the page moved from.
+ * @return flash_status_t
+ */
+static flash_status_t wear_save(flash_ctx_t *ctx, uint32_t logical, uint32_t from);
+
+/**
+ * @brief Check something saved on a table page.
+ *
+ * @param address Where it is, including the base address.
+ * @param magic What it should start with.
+ * @param values The number of values it should have.
+ * @param sequence Set to its sequence number.
+ * @param target Where to copy the values between the sequence number and the CRC. NULL to only check.
+ * @return true It was saved completely.
+ * @return false It isn't there or doesn't match its CRC.
+ */
+static bool wear_check_entry(flash_ctx_t *ctx, uint32_t address, uint32_t magic, uint32_t values, uint32_t *sequence, uint32_t *target);
+
+/**
+ * @brief Load the wear leveling table from the table page whose table is newest, then the moves saved after it.
+ *
+ * @return flash_status_t FLASH_DATA_NOT_FOUND if nothing has been saved. FLASH_ERROR if what was saved makes no sense.
+ */
+static flash_status_t wear_load(flash_ctx_t *ctx);
+
+/**
+ * @brief Work out which pages are free from the map. The table pages are never free.
+ *
+ * @return true The map is good.
+ * @return false The map puts two pages in one place or a page somewhere it can't go.
+ */
+static bool wear_rebuild_spares(flash_ctx_t *ctx);
+
+/**
+ * @brief Check that a write of some length can start at an address.
+ *
+ * @param user_address Where the write would start.
+ * @param data_length The number of bytes to write.
+ * @return true The write can go ahead.
+ * @return false The write is invalid.
+ */
+static bool write_allowed(flash_ctx_t *ctx, uint32_t user_address, uint32_t data_length);
+
+/**
+ * @brief Add up the lengths of some scatter-gather pieces.
+ *
+ * @param iov The pieces.
+ * @param iov_count The number of pieces.
+ * @return uint32_t Total number of bytes.
+ */
+static uint32_t iov_total_length(const flash_iovec_t *iov, uint8_t iov_count);
+
+/**
+ * @brief Move a cursor forward over some bytes without writing them.
+ *
+ * @param cursor The cursor to move.
+ * @param byte_count The number of bytes to skip.
+ */
+static void iov_cursor_skip(iov_cursor_t *cursor, uint16_t byte_count);
+
+/**
+ * @brief Write the next bytes from a cursor out to flash. Runs of whole words inside a piece are written
+ * straight from that piece. Only words that straddle pieces, and the final partial word, are packed into
+ * the padding buffer.
+ *
+ * @param user_address Word aligned place to start writing.
+ * @param cursor Where the data comes from. Moved forward by byte_count.
+ * @param byte_count The number of bytes to write.
+ * @return flash_status_t
+ */
+static flash_status_t write_gather(flash_ctx_t *ctx, uint32_t user_address, iov_cursor_t *cursor, uint16_t byte_count);
+
+/**
+ * @brief The number of bytes from an address up to the end of the page it is on.
+ *
+ * @param user_address The address.
+ * @return uint32_t Bytes left on the page.
+ */
+static uint32_t bytes_to_page_end(flash_ctx_t *ctx, uint32_t user_address);
+
+/**
+ * @brief Move the head of an index forward by some bytes, rounded up to whole words, wrapping at the end of its data space.
+ *
+ * @param index The index to move.
+ * @param bytes_written The number of bytes that were written at the head.
+ */
+static void index_advance_head(flash_ctx_t *ctx, flash_index_t *index, uint16_t bytes_written);
+
+/**
+ * @brief Copy the next bytes from a cursor into a buffer and move the cursor past them.
+ *
+ * @param cursor Where the data comes from.
+ * @param destination Where the data goes.
+ * @param byte_count The number of bytes to copy.
+ */
+static void iov_cursor_copy(iov_cursor_t *cursor, uint8_t *destination, uint16_t byte_count);
+
+/**
+ * @brief Get the page at the head of an index ready to be written. Uses up a page that was erased ahead of time if
+ * there is one, otherwise erases the page and counts a stall.
+ *
+ * @param index The index whose head is at the start of a page.
+ * @return flash_status_t
+ */
+static flash_status_t index_enter_page(flash_ctx_t *ctx, flash_index_t *index);
+
+/**
+ * @brief Erase the next page ahead of the head of an index if it has fewer than erase_ahead_pages erased.
+ *
+ * @param index The index.
+ * @return flash_status_t
+ */
+static flash_status_t index_erase_ahead(flash_ctx_t *ctx, flash_index_t *index);
+
+/**
+ * @brief The number of bytes from one address in the data space of an index to another going forward round the ring.
+ *
+ * @param index The index.
+ * @param from The start address.
+ * @param to The end address.
+ * @return uint32_t The number of bytes.
+ */
+static uint32_t index_ring_distance(flash_index_t *index, uint32_t from, uint32_t to);
+
+/**
+ * @brief Move the tail of an index forward by some bytes, wrapping at the end of its data space.
+ *
+ * @param index The index to move.
+ * @param bytes_read The number of bytes that were read at the tail.
+ */
+static void index_advance_tail(flash_index_t *index, uint32_t bytes_read);
+
+/**
+ * @brief Read from the data space of an index, wrapping back to the start of it at the end.
+ *
+ * @param index The index.
+ * @param user_address Where to start reading.
+ * @param data Read into this.
+ * @param length The number of bytes to read.
+ * @return flash_status_t
+ */
+static flash_status_t index_read_wrapped(flash_ctx_t *ctx, flash_index_t *index, uint32_t user_address, uint8_t *data, uint16_t length);
+
+/**
+ * @brief Check whether an entry on an index page is empty by looking at its first word.
+ *
+ * @param user_address Address of the entry.
+ * @return true The entry is erased.
+ * @return false Index data has been written to the entry.
+ */
+static bool index_entry_empty(flash_ctx_t *ctx, uint32_t user_address);
+
+/**
+ * @brief Write the index to flash if its checkpoint policy says it is due.
+ *
+ * @param index The index.
+ * @param entered_page Whether the head has just moved onto a new page and it has been erased.
+ * @return flash_status_t
+ */
+static flash_status_t index_checkpoint(flash_ctx_t *ctx, flash_index_t *index, bool entered_page);
+
+/**
+ * @brief Move the head of an index past data that was written after the index was, up to the first erased word or
+ * the end of the page the head is on.
+ *
+ * @param index The index.
+ */
+static void index_scan_forward(flash_ctx_t *ctx, flash_index_t *index);
+
+/**
+ * @brief Check the CRC at the end of index data read from an index page.
+ *
+ * @param index The index the data is from.
+ * @param data The head, tail and CRC as read.
+ * @return true The CRC matches the head and tail.
+ */
+static bool index_data_crc_ok(flash_index_t *index, const uint8_t *data);
+
+/**
+ * @brief Write data at the head of an index, wrapping and erasing as needed, and move the head past it.
+ * Does not write the index itself to flash.
+ *
+ * @param index The index to write with.
+ * @param cursor Where the data comes from.
+ * @param data_length The number of bytes to write.
+ * @return flash_status_t
+ */
+static flash_status_t index_append(flash_ctx_t *ctx, flash_index_t *index, iov_cursor_t *cursor, uint16_t data_length);
+
+/**
+ * @brief Put data into the write buffer of an index, flushing it whenever it fills up or one of the
+ * flush thresholds is reached.
+ *
+ * @param id The index to write with.
+ * @param cursor Where the data comes from.
+ * @param data_length The number of bytes to write.
+ * @return flash_status_t
+ */
+static flash_status_t index_buffer_append(flash_ctx_t *ctx, uint8_t id, iov_cursor_t *cursor, uint16_t data_length);
+
+/**
+ * @brief Write buffered data of an index out to flash and write the index if its checkpoint policy says so.
+ *
+ * @param id The index to flush.
+ * @param whole_words_only true to leave a trailing partial word in the buffer so later writes can finish it.
+ * @return flash_status_t
+ */
+static flash_status_t index_buffer_flush(flash_ctx_t *ctx, uint8_t id, bool whole_words_only);
+
+/**
+ * @brief Where the head of an index will be once its buffered data is written to flash.
+ *
+ * @param index The index.
+ * @return uint32_t Address of the head.
+ */
+static uint32_t index_logical_head(flash_index_t *index);
+
+// PRIVATE FUNCTION DEFINITIONS
+
+static bool initialized(flash_ctx_t *ctx)
+{
+  if (ctx->user_flash.number_of_pages == 0)
+  {
+    return false;
+  }
+
+  return true;
+}
+
+static bool index_exists(flash_ctx_t *ctx, uint8_t id)
+{
+  // Check if the index exists
+  if (id >= ctx->index_count || ctx->index_count == 0)
+  {
+    return false;
+  }
+
+  return true;
+}
+uint16_t bytes_to_words(flash_ctx_t *ctx, uint32_t number_of_bytes)
+{
+  uint16_t quotient = number_of_bytes / ctx->user_flash.word_size;
+  uint16_t remainder = number_of_bytes % ctx->user_flash.word_size;
+
+  return (remainder == 0) ? quotient : quotient + 1;
+}
+
+uint16_t words_to_bytes(flash_ctx_t *ctx, uint16_t number_of_words)
+{
+  return number_of_words * ctx->user_flash.word_size;
+}
+
+uint16_t bytes_to_byte_aligned(flash_ctx_t *ctx, uint16_t num_bytes)
+{
+  return words_to_bytes(ctx, bytes_to_words(ctx, num_bytes));
+}
+
+static bool erased_map_word(flash_ctx_t *ctx, uint32_t user_address, uint32_t *word)
+{
+  uint32_t map_start = ctx->user_flash.start_page * ctx->user_flash.page_size;
+
+  if (ctx->erased_map == NULL || user_address < map_start)
+  {
+    return false;
+  }
+
+  uint32_t page = (user_address - map_start) / ctx->user_flash.page_size;
+
+  if (page >= ctx->user_flash.number_of_pages || !(ctx->erased_map_pages[page / 8] & (1 << (page % 8))))
+  {
+    return false;
+  }
+
+  *word = (user_address - map_start) / ctx->user_flash.word_size;
+  return true;
+}
+
+static void erased_map_mark(flash_ctx_t *ctx, uint32_t user_address, uint32_t number_of_words, bool erased)
+{
+  uint32_t word = 0;
+
+  // Every program goes through here, don't walk its words when there's no map to mark.
+  if (ctx->erased_map == NULL)
+  {
+    return;
+  }
+
+  for (uint32_t idx = 0; idx < number_of_words; idx++, user_address += ctx->user_flash.word_size)
+  {
+    if (!erased_map_word(ctx, user_address, &word))
+    {
+      continue;
+    }
+
+    if (erased)
+    {
+      ctx->erased_map[word / 8] |= (1 << (word % 8));
+    }
+    else
+    {
+      ctx->erased_map[word / 8] &= ~(1 << (word % 8));
+    }
+  }
+}
+
+static bool erased_map_any_written(flash_ctx_t *ctx, uint32_t user_address, uint32_t number_of_words)
+{
+  uint32_t word = 0;
+
+  if (ctx->erased_map == NULL)
+  {
+    return false;
+  }
+
+  for (uint32_t idx = 0; idx < number_of_words; idx++, user_address += ctx->user_flash.word_size)
+  {
+    if (erased_map_word(ctx, user_address, &word) && !(ctx->erased_map[word / 8] & (1 << (word % 8))))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool erased_map_all_erased(flash_ctx_t *ctx, uint32_t user_address, uint32_t number_of_words)
+{
+  uint32_t word = 0;
+
+  for (uint32_t idx = 0; idx < number_of_words; idx++, user_address += ctx->user_flash.word_size)
+  {
+    if (!erased_map_word(ctx, user_address, &word) || !(ctx->erased_map[word / 8] & (1 << (word % 8))))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static flash_cache_slot_t *cache_find(flash_ctx_t *ctx, uint32_t page)
+{
+  for (uint8_t idx = 0; idx < ctx->cache_slot_count; idx++)
+  {
+    if (ctx->cache_slots[idx].valid && ctx->cache_slots[idx].page == page)
+    {
+      return &ctx->cache_slots[idx];
+    }
+  }
+
+  return NULL;
+}
+
+static void cache_invalidate(flash_ctx_t *ctx, uint32_t first_page, uint32_t number_of_pages)
+{
+  for (uint8_t idx = 0; idx < ctx->cache_slot_count; idx++)
+  {
+    if (ctx->cache_slots[idx].page >= first_page && ctx->cache_slots[idx].page < first_page + number_of_pages)
+    {
+      ctx->cache_slots[idx].valid = false;
+    }
+  }
+}
+
+static flash_status_t backend_read(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t length)
+{
+  if (ctx->cache_slot_count == 0)
+  {
+    return device_read(ctx, user_address, data, length);
+  }
+
+  uint32_t offset = 0;
+
+  // Serve the read a page at a time.
+  while (offset < length)
+  {
+    uint32_t page = (user_address + offset) / ctx->user_flash.page_size;
+    uint16_t page_offset = (user_address + offset) % ctx->user_flash.page_size;
+    uint16_t chunk = ctx->user_flash.page_size - page_offset;
+    if (chunk > length - offset)
+    {
+      chunk = length - offset;
+    }
+
+    flash_cache_slot_t *slot = cache_find(ctx, page);
+
+    if (slot == NULL)
+    {
+      ctx->cache_misses++;
+
+      // A whole page read is streaming through, caching it would only push out pages that get read again.
+      if (chunk == ctx->user_flash.page_size)
+      {
+        if (device_read(ctx, user_address + offset, &data[offset], chunk) != FLASH_OK)
+        {
+          return FLASH_ERROR;
+        }
+
+        offset += chunk;
+        continue;
+      }
+
+      // Fill an empty slot or else the least recently used one.
+      slot = &ctx->cache_slots[0];
+      for (uint8_t idx = 0; idx < ctx->cache_slot_count && slot->valid; idx++)
+      {
+        flash_cache_slot_t *candidate = &ctx->cache_slots[idx];
+        if (!candidate->valid || candidate->last_used < slot->last_used)
+        {
+          slot = candidate;
+        }
+      }
+
+      slot->valid = false;
+      if (device_read(ctx, page * ctx->user_flash.page_size, slot->data, ctx->user_flash.page_size) != FLASH_OK)
+      {
+        return FLASH_ERROR;
+      }
+
+      slot->page = page;
+      slot->valid = true;
+    }
+    else
+    {
+      ctx->cache_hits++;
+    }
+
+    slot->last_used = ++ctx->cache_clock;
+    memcpy(&data[offset], &slot->data[page_offset], chunk);
+    offset += chunk;
+  }
+
+  return FLASH_OK;
+}
+
+static flash_status_t backend_write(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t number_of_words)
+{
+  // Flash can't be programmed twice without an erase so don't bother the user write function.
+  if (erased_map_any_written(ctx, user_address, number_of_words))
+  {
+    return FLASH_NOT_ERASED_ERROR;
+  }
+
+  flash_status_t status = device_write(ctx, user_address, data, number_of_words);
+
+  // Even a failed write may have programmed some of the words.
+  erased_map_mark(ctx, user_address, number_of_words, false);
+
+  uint32_t length = words_to_bytes(ctx, number_of_words);
+  uint32_t first_page = user_address / ctx->user_flash.page_size;
+  uint32_t last_page = (user_address + length - 1) / ctx->user_flash.page_size;
+
+  if (status != FLASH_OK)
+  {
+    cache_invalidate(ctx, first_page, last_page - first_page + 1);
+    return status;
+  }
+
+  // Keep cached copies of the written pages in step with the flash.
+  for (uint32_t page = first_page; page <= last_page && ctx->cache_slot_count > 0; page++)
+  {
+    flash_cache_slot_t *slot = cache_find(ctx, page);
+    if (slot == NULL)
+    {
+      continue;
+    }
+
+    uint32_t page_start = page * ctx->user_flash.page_size;
+    uint32_t from = (user_address > page_start) ? user_address : page_start;
+    uint32_t to = (user_address + length < page_start + ctx->user_flash.page_size) ? user_address + length : page_start + ctx->user_flash.page_size;
+    memcpy(&slot->data[from - page_start], &data[from - user_address], to - from);
+  }
+
+  return status;
+}
+
+static flash_status_t backend_erase(flash_ctx_t *ctx, uint8_t page_number, uint8_t number_of_pages)
+{
+  flash_status_t status = device_erase(ctx, page_number, number_of_pages);
+
+  cache_invalidate(ctx, page_number, number_of_pages);
+
+  for (uint8_t idx = 0; idx < ctx->index_count; idx++)
+  {
+    flash_index_t *index = &ctx->indices[idx];
+
+    if (index->index_page >= page_number && index->index_page < page_number + number_of_pages)
+    {
+      // A blank index page is written from the start. After a failed erase the page has to be searched.
+      index->index_write_address = index->min_index_address;
+      index->index_write_address_known = (status == FLASH_OK);
+    }
+  }
+
+  if (ctx->erased_map == NULL)
+  {
+    return status;
+  }
+
+  for (uint32_t page = page_number; page < (uint32_t)page_number + number_of_pages; page++)
+  {
+    uint32_t map_page = page - ctx->user_flash.start_page;
+
+    if (status == FLASH_OK)
+    {
+      // Every word on the page is known to be erased now, so the map can start tracking it.
+      ctx->erased_map_pages[map_page / 8] |= (1 << (map_page % 8));
+      erased_map_mark(ctx, page * ctx->user_flash.page_size, ctx->user_flash.page_size / ctx->user_flash.word_size, true);
+    }
+    else
+    {
+      // Don't know how far a failed erase got.
+      ctx->erased_map_pages[map_page / 8] &= ~(1 << (map_page % 8));
+    }
+  }
+
+  return status;
+}
+
+static flash_status_t call_read(flash_ctx_t *ctx, uint32_t address, uint8_t *data, uint16_t length)
+{
+#ifdef FLASH_ENABLE_STATS
+  uint32_t start = (ctx->stats_clock != 0) ? ctx->stats_clock() : 0;
+#endif
+  flash_status_t status = ctx->read(address, data, length);
+
+#ifdef FLASH_ENABLE_STATS
+  ctx->stats.read_bytes += length;
+  stats_finish(ctx, FLASH_STATS_READ, start, status);
+#endif
+  TRACE(ctx, FLASH_TRACE_USER_READ, FLASH_TRACE_NO_ID, address, length, status);
+
+  return status;
+}
+
+static flash_status_t call_write(flash_ctx_t *ctx, uint32_t address, uint8_t *data, uint16_t number_of_words)
+{
+#ifdef FLASH_ENABLE_STATS
+  uint32_t start = (ctx->stats_clock != 0) ? ctx->stats_clock() : 0;
+#endif
+  flash_status_t status = ctx->write(address, data, number_of_words);
+
+#ifdef FLASH_ENABLE_STATS
+  ctx->stats.programmed_bytes += words_to_bytes(ctx, number_of_words);
+  stats_finish(ctx, FLASH_STATS_WRITE, start, status);
+#endif
+  TRACE(ctx, FLASH_TRACE_USER_WRITE, FLASH_TRACE_NO_ID, address, words_to_bytes(ctx, number_of_words), status);
+
+  return status;
+}
+
+static flash_status_t call_erase(flash_ctx_t *ctx, uint8_t page_number, uint8_t number_of_pages)
+{
+#ifdef FLASH_ENABLE_STATS
+  uint32_t start = (ctx->stats_clock != 0) ? ctx->stats_clock() : 0;
+#endif
+  flash_status_t status = ctx->erase(page_number, number_of_pages);
+
+#ifdef FLASH_ENABLE_STATS
+  for (uint32_t page = page_number; page < (uint32_t)page_number + number_of_pages && page <= UINT8_MAX; page++)
+  {
+    ctx->stats.page_erases[page]++;
+  }
+  stats_finish(ctx, FLASH_STATS_ERASE, start, status);
+#endif
+  TRACE(ctx, FLASH_TRACE_USER_ERASE, FLASH_TRACE_NO_ID, page_number, number_of_pages, status);
+
+  return status;
+}
+
+#ifdef FLASH_ENABLE_STATS
+static void stats_finish(flash_ctx_t *ctx, flash_stats_op_t operation, uint32_t start, flash_status_t status)
+{
+  ctx->stats.calls[operation]++;
+
+  if (status != FLASH_OK)
+  {
+    ctx->stats.failures[operation]++;
+  }
+
+  if (ctx->stats_clock == 0)
+  {
+    return;
+  }
+
+  flash_histogram_t *histogram = &ctx->stats.latency[operation];
+  uint32_t elapsed = ctx->stats_clock() - start;
+  uint32_t bucket = 0;
+
+  // Bucket n holds latencies with their highest set bit at n - 1.
+  for (uint32_t remaining = elapsed; remaining > 0 && bucket < FLASH_STATS_BUCKETS - 1; remaining >>= 1)
+  {
+    bucket++;
+  }
+
+  histogram->buckets[bucket]++;
+  histogram->total += elapsed;
+  histogram->max = (elapsed > histogram->max) ? elapsed : histogram->max;
+}
+#endif
+
+static uint32_t device_address(flash_ctx_t *ctx, uint32_t user_address)
+{
+  uint32_t page = user_address / ctx->user_flash.page_size;
+
+  if (ctx->wear.table == NULL || page < ctx->user_flash.start_page || page >= (uint32_t)ctx->user_flash.start_page + ctx->user_flash.number_of_pages)
+  {
+    return user_address + ctx->user_flash.base_address;
+  }
+
+  uint32_t slot = ctx->wear.table[wear_slot_count(ctx) + page - ctx->user_flash.start_page];
+
+  return wear_page(ctx, slot) * ctx->user_flash.page_size + user_address % ctx->user_flash.page_size + ctx->user_flash.base_address;
+}
+
+static flash_status_t device_read(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t length)
+{
+  if (ctx->wear.table == NULL)
+  {
+    return call_read(ctx, user_address + ctx->user_flash.base_address, data, length);
+  }
+
+  uint32_t offset = 0;
+
+  while (offset < length)
+  {
+    uint32_t chunk = bytes_to_page_end(ctx, user_address + offset);
+    if (chunk > (uint32_t)length - offset)
+    {
+      chunk = length - offset;
+    }
+
+    if (call_read(ctx, device_address(ctx, user_address + offset), &data[offset], chunk) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    offset += chunk;
+  }
+
+  return FLASH_OK;
+}
+
+static flash_status_t device_write(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t number_of_words)
+{
+  if (ctx->wear.table == NULL)
+  {
+    return call_write(ctx, user_address + ctx->user_flash.base_address, data, number_of_words);
+  }
+
+  uint32_t length = words_to_bytes(ctx, number_of_words);
+  uint32_t offset = 0;
+
+  while (offset < length)
+  {
+    uint32_t chunk = bytes_to_page_end(ctx, user_address + offset);
+    if (chunk > length - offset)
+    {
+      chunk = length - offset;
+    }
+
+    flash_status_t status = call_write(ctx, device_address(ctx, user_address + offset), &data[offset], chunk / ctx->user_flash.word_size);
+    if (status != FLASH_OK)
+    {
+      return status;
+    }
+
+    offset += chunk;
+  }
+
+  return FLASH_OK;
+}
+
+static flash_status_t device_erase(flash_ctx_t *ctx, uint8_t page_number, uint8_t number_of_pages)
+{
+  if (ctx->wear.table == NULL)
+  {
+    return call_erase(ctx, page_number, number_of_pages);
+  }
+
+  flash_status_t status = FLASH_OK;
+
+  // Each page may have to move somewhere different so they're erased one at a time.
+  for (uint32_t page = page_number; page < (uint32_t)page_number + number_of_pages; page++)
+  {
+    flash_status_t result = FLASH_OK;
+
+    if (page < ctx->user_flash.start_page || page >= (uint32_t)ctx->user_flash.start_page + ctx->user_flash.number_of_pages)
+    {
+      result = call_erase(ctx, page, 1);
+    }
+    else
+    {
+      result = wear_erase_page(ctx, page - ctx->user_flash.start_page);
+    }
+
+    if (result != FLASH_OK)
+    {
+      status = result;
+    }
+  }
+
+  return status;
+}
+
+static bool mapped_span(flash_ctx_t *ctx, uint32_t user_address, uint32_t length, const uint8_t **data)
+{
+  uint32_t address = device_address(ctx, user_address) - ctx->user_flash.base_address;
+
+  // The pages of the span have to follow each other in the flash too.
+  for (uint32_t offset = bytes_to_page_end(ctx, user_address); offset < length; offset += ctx->user_flash.page_size)
+  {
+    if (device_address(ctx, user_address + offset) - ctx->user_flash.base_address != address + offset)
+    {
+      return false;
+    }
+  }
+
+  *data = &ctx->mapped[address];
+  return true;
+}
+
+static uint32_t wear_slot_count(flash_ctx_t *ctx)
+{
+  return (uint32_t)ctx->user_flash.number_of_pages + ctx->wear.spare_pages;
+}
+
+static uint8_t wear_page(flash_ctx_t *ctx, uint32_t slot)
+{
+  if (slot < ctx->user_flash.number_of_pages)
+  {
+    return ctx->user_flash.start_page + slot;
+  }
+
+  return ctx->wear.spare_start_page + (slot - ctx->user_flash.number_of_pages);
+}
+
+static uint32_t wear_table_values(flash_ctx_t *ctx)
+{
+  return 3 + wear_slot_count(ctx) + ctx->user_flash.number_of_pages;
+}
+
+static uint32_t wear_entry_size(flash_ctx_t *ctx, uint32_t values)
+{
+  return ((4 * values + ctx->user_flash.word_size - 1) / ctx->user_flash.word_size) * ctx->user_flash.word_size;
+}
+
+static uint32_t wear_meta_address(flash_ctx_t *ctx, uint8_t meta, uint32_t offset)
+{
+  return wear_page(ctx, ctx->user_flash.number_of_pages + meta) * ctx->user_flash.page_size + offset + ctx->user_flash.base_address;
+}
+
+static flash_status_t wear_erase_page(flash_ctx_t *ctx, uint32_t logical)
+{
+  uint32_t *counts = ctx->wear.table;
+  uint32_t *map = &counts[wear_slot_count(ctx)];
+  uint32_t *spares = &map[ctx->user_flash.number_of_pages];
+  uint32_t least = 0;
+
+  for (uint32_t idx = 1; idx < ctx->wear.spare_pages - 2u; idx++)
+  {
+    if (counts[spares[idx]] < counts[spares[least]])
+    {
+      least = idx;
+    }
+  }
+
+  uint32_t slot = map[logical];
+  bool moved = false;
+
+  // The data on the page is being thrown away so it costs nothing to move it.
+  if (counts[slot] >= counts[spares[least]] && counts[slot] - counts[spares[least]] >= ctx->wear.threshold)
+  {
+    map[logical] = spares[least];
+    spares[least] = slot;
+    slot = map[logical];
+    ctx->wear.remaps++;
+    moved = true;
+  }
+
+  counts[slot]++;
+
+  // The move has to be saved before the new page is written or after a reboot the data would be looked for on the old one.
+  if (moved && wear_save(ctx, logical, spares[least]) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_status_t status = call_erase(ctx, wear_page(ctx, slot), 1);
+  if (status != FLASH_OK)
+  {
+    return status;
+  }
+
+  return wear_migrate(ctx, logical);
+}
+
+static flash_status_t wear_migrate(flash_ctx_t *ctx, uint32_t busy)
+{
+  uint32_t *counts = ctx->wear.table;
+  uint32_t *map = &counts[wear_slot_count(ctx)];
+  uint32_t *spares = &map[ctx->user_flash.number_of_pages];
+  uint32_t coldest = busy;
+  uint32_t most = 0;
+
+  for (uint32_t logical = 0; logical < ctx->user_flash.number_of_pages; logical++)
+  {
+    if (logical != busy && (coldest == busy || counts[map[logical]] < counts[map[coldest]]))
+    {
+      coldest = logical;
+    }
+  }
+
+  for (uint32_t idx = 1; idx < ctx->wear.spare_pages - 2u; idx++)
+  {
+    if (counts[spares[idx]] > counts[spares[most]])
+    {
+      most = idx;
+    }
+  }
+
+  if (coldest == busy)
+  {
+    return FLASH_OK;
+  }
+
+  uint32_t from = map[coldest];
+  uint32_t to = spares[most];
+
+  if (counts[to] < counts[from] || counts[to] - counts[from] < ctx->wear.threshold)
+  {
+    return FLASH_OK;
+  }
+
+  counts[to]++;
+
+  if (call_erase(ctx, wear_page(ctx, to), 1) != FLASH_OK || wear_copy_page(ctx, from, to) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  // Until the table is saved the data is still where it was, so a reboot part way through loses nothing.
+  map[coldest] = to;
+  spares[most] = from;
+  ctx->wear.migrations++;
+
+  return wear_save(ctx, coldest, from);
+}
+
+static flash_status_t wear_copy_page(flash_ctx_t *ctx, uint32_t from, uint32_t to)
+{
+  // Runs of words are written straight from here, so it is kept aligned for the user write function.
+  uint64_t words[FLASH_MAX_WRITE_SIZE / sizeof(uint64_t)];
+  uint8_t *buffer = (uint8_t *)words;
+  uint32_t word_size = ctx->user_flash.word_size;
+  uint32_t chunk_size = (FLASH_MAX_WRITE_SIZE / word_size) * word_size;
+  uint32_t from_address = wear_page(ctx, from) * ctx->user_flash.page_size + ctx->user_flash.base_address;
+  uint32_t to_address = wear_page(ctx, to) * ctx->user_flash.page_size + ctx->user_flash.base_address;
+
+  for (uint32_t offset = 0; offset < ctx->user_flash.page_size; offset += chunk_size)
+  {
+    uint32_t chunk = ctx->user_flash.page_size - offset;
+    if (chunk > chunk_size)
+    {
+      chunk = chunk_size;
+    }
+
+    if (call_read(ctx, from_address + offset, buffer, chunk) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    // Write each run of words that aren't erased, the end of the chunk ends a run.
+    uint32_t run = 0;
+    for (uint32_t word = 0; word <= chunk; word += word_size)
+    {
+      bool erased = true;
+      for (uint32_t idx = word; idx < word + word_size && word < chunk; idx++)
+      {
+        if (buffer[idx] != FLASH_EMPTY_VALUE)
+        {
+          erased = false;
+          break;
+        }
+      }
+
+      if (!erased)
+      {
+        continue;
+      }
+
+      if (word > run && call_write(ctx, to_address + offset + run, &buffer[run], (word - run) / word_size) != FLASH_OK)
+      {
+        return FLASH_ERROR;
+      }
+
+      run = word + word_size;
+    }
+  }
+
+  return FLASH_OK;
+}
+
+static void wear_put(flash_ctx_t *ctx, wear_writer_t *writer, uint32_t value)
+{
+  uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+  uint32_t capacity = (FLASH_MAX_WRITE_SIZE / ctx->user_flash.word_size) * ctx->user_flash.word_size;
+
+  writer->crc = flash_crc32c(writer->crc, bytes, sizeof(bytes));
+
+  for (uint8_t idx = 0; idx < sizeof(bytes); idx++)
+  {
+    ((uint8_t *)writer->buffer)[writer->length++] = bytes[idx];
+
+    if (writer->length == capacity)
+    {
+      wear_flush(ctx, writer);
+    }
+  }
+}
+
+static void wear_flush(flash_ctx_t *ctx, wear_writer_t *writer)
+{
+  if (writer->length == 0)
+  {
+    return;
+  }
+
+  uint16_t words = bytes_to_words(ctx, writer->length);
+  uint8_t *buffer = (uint8_t *)writer->buffer;
+  memset(&buffer[writer->length], FLASH_EMPTY_VALUE, words_to_bytes(ctx, words) - writer->length);
+
+  if (call_write(ctx, writer->address, buffer, words) != FLASH_OK)
+  {
+    writer->status = FLASH_ERROR;
+  }
+
+  writer->address += words_to_bytes(ctx, words);
+  writer->length = 0;
+}
+
+static flash_status_t wear_save(flash_ctx_t *ctx, uint32_t logical, uint32_t from)
+{
+  uint32_t number_of_pages = ctx->user_flash.number_of_pages;
+  uint32_t *counts = ctx->wear.table;
+  uint32_t *map = &counts[wear_slot_count(ctx)];
+  bool whole = (logical == WEAR_WHOLE_TABLE);
+  uint32_t entry_size = wear_entry_size(ctx, whole ? wear_table_values(ctx) : WEAR_MOVE_VALUES);
+
+  // Each table page starts with the whole table. The page that filled up has everything until the other one has its
+  // table, so there is always a complete copy on one of them.
+  if (ctx->wear.meta_offset + entry_size > ctx->user_flash.page_size)
+  {
+    uint8_t meta = 1 - ctx->wear.meta;
+
+    counts[number_of_pages + meta]++;
+    if (call_erase(ctx, wear_page(ctx, number_of_pages + meta), 1) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    ctx->wear.meta = meta;
+    ctx->wear.meta_offset = 0;
+    whole = true;
+    entry_size = wear_entry_size(ctx, wear_table_values(ctx));
+  }
+
+  wear_writer_t writer = {.length = 0, .crc = 0, .status = FLASH_OK};
+  writer.address = wear_meta_address(ctx, ctx->wear.meta, ctx->wear.meta_offset);
+
+  ctx->wear.sequence++;
+  ctx->wear.meta_offset += entry_size;
+
+  wear_put(ctx, &writer, whole ? WEAR_TABLE_MAGIC : WEAR_MOVE_MAGIC);
+  wear_put(ctx, &writer, ctx->wear.sequence);
+
+  if (whole)
+  {
+    // The counters and then the map.
+    for (uint32_t idx = 0; idx < wear_slot_count(ctx) + number_of_pages; idx++)
+    {
+      wear_put(ctx, &writer, ctx->wear.table[idx]);
+    }
+  }
+  else
+  {
+    wear_put(ctx, &writer, logical);
+    wear_put(ctx, &writer, map[logical]);
+    wear_put(ctx, &writer, counts[map[logical]]);
+    wear_put(ctx, &writer, from);
+    wear_put(ctx, &writer, counts[from]);
+  }
+
+  wear_put(ctx, &writer, writer.crc);
+  wear_flush(ctx, &writer);
+
+  return writer.status;
+}
+
+static bool wear_check_entry(flash_ctx_t *ctx, uint32_t address, uint32_t magic, uint32_t values, uint32_t *sequence, uint32_t *target)
+{
+  uint8_t buffer[FLASH_MAX_WRITE_SIZE];
+  uint32_t crc = 0;
+
+  if (address % ctx->user_flash.page_size + wear_entry_size(ctx, values) > ctx->user_flash.page_size)
+  {
+    return false;
+  }
+
+  for (uint32_t first = 0; first < values; first += sizeof(buffer) / 4)
+  {
+    uint32_t count = values - first;
+    if (count > sizeof(buffer) / 4)
+    {
+      count = sizeof(buffer) / 4;
+    }
+
+    if (call_read(ctx, address + 4 * first, buffer, 4 * count) != FLASH_OK)
+    {
+      return false;
+    }
+
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+      uint8_t *bytes = &buffer[4 * idx];
+      uint32_t value = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+
+      if (first + idx == 0 && value != magic)
+      {
+        return false;
+      }
+
+      if (first + idx == 1)
+      {
+        *sequence = value;
+      }
+
+      if (first + idx == values - 1)
+      {
+        return value == crc;
+      }
+
+      crc = flash_crc32c(crc, bytes, 4);
+
+      if (target != NULL && first + idx >= 2)
+      {
+        target[first + idx - 2] = value;
+      }
+    }
+  }
+
+  return false;
+}
+
+static flash_status_t wear_load(flash_ctx_t *ctx)
+{
+  uint32_t number_of_pages = ctx->user_flash.number_of_pages;
+  uint32_t *counts = ctx->wear.table;
+  uint32_t *map = &counts[wear_slot_count(ctx)];
+  uint32_t table_values = wear_table_values(ctx);
+  bool found = false;
+
+  for (uint8_t meta = 0; meta < 2; meta++)
+  {
+    uint32_t sequence = 0;
+
+    if (wear_check_entry(ctx, wear_meta_address(ctx, meta, 0), WEAR_TABLE_MAGIC, table_values, &sequence, NULL) && (!found || (int32_t)(sequence - ctx->wear.sequence) > 0))
+    {
+      found = true;
+      ctx->wear.meta = meta;
+      ctx->wear.sequence = sequence;
+    }
+  }
+
+  if (!found)
+  {
+    return FLASH_DATA_NOT_FOUND;
+  }
+
+  // Go through what was saved on the page in order until something that wasn't saved completely, or nothing.
+  uint32_t offset = 0;
+  uint32_t move[WEAR_MOVE_VALUES - 3];
+
+  while (offset < ctx->user_flash.page_size)
+  {
+    uint32_t address = wear_meta_address(ctx, ctx->wear.meta, offset);
+    uint32_t sequence = 0;
+
+    if (wear_check_entry(ctx, address, WEAR_TABLE_MAGIC, table_values, &sequence, NULL))
+    {
+      wear_check_entry(ctx, address, WEAR_TABLE_MAGIC, table_values, &sequence, counts);
+      offset += wear_entry_size(ctx, table_values);
+    }
+    else if (wear_check_entry(ctx, address, WEAR_MOVE_MAGIC, WEAR_MOVE_VALUES, &sequence, move))
+    {
+      // The page, where it went and its counter, where it was and its counter.
+      if (move[0] >= number_of_pages || move[1] >= wear_slot_count(ctx) || move[3] >= wear_slot_count(ctx))
+      {
+        return FLASH_ERROR;
+      }
+
+      map[move[0]] = move[1];
+      counts[move[1]] = move[2];
+      counts[move[3]] = move[4];
+      offset += wear_entry_size(ctx, WEAR_MOVE_VALUES);
+    }
+    else
+    {
+      break;
+    }
+
+    ctx->wear.sequence = sequence;
+  }
+
+  ctx->wear.meta_offset = offset;
+
+  // Something that was cut short can't be written after, so the next save starts on the other page.
+  uint8_t first[4];
+  if (offset + sizeof(first) <= ctx->user_flash.page_size)
+  {
+    if (call_read(ctx, wear_meta_address(ctx, ctx->wear.meta, offset), first, sizeof(first)) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    if (first[0] != FLASH_EMPTY_VALUE || first[1] != FLASH_EMPTY_VALUE || first[2] != FLASH_EMPTY_VALUE || first[3] != FLASH_EMPTY_VALUE)
+    {
+      ctx->wear.meta_offset = ctx->user_flash.page_size;
+    }
+  }
+
+  return wear_rebuild_spares(ctx) ? FLASH_OK : FLASH_ERROR;
+}
+
+static bool wear_rebuild_spares(flash_ctx_t *ctx)
+{
+  uint32_t number_of_pages = ctx->user_flash.number_of_pages;
+  uint32_t *map = &ctx->wear.table[wear_slot_count(ctx)];
+  uint32_t *spares = &map[number_of_pages];
+  uint32_t spare_count = 0;
+
+  for (uint32_t slot = 0; slot < wear_slot_count(ctx); slot++)
+  {
+    // The table pages are only ever used for the table.
+    if (slot == number_of_pages || slot == number_of_pages + 1)
+    {
+      continue;
+    }
+
+    bool used = false;
+    for (uint32_t logical = 0; logical < number_of_pages && !used; logical++)
+    {
+      used = (map[logical] == slot);
+    }
+
+    if (used)
+    {
+      continue;
+    }
+
+    if (spare_count == ctx->wear.spare_pages - 2u)
+    {
+      return false;
+    }
+
+    spares[spare_count++] = slot;
+  }
+
+  return spare_count == ctx->wear.spare_pages - 2u;
+}
+
+static bool write_allowed(flash_ctx_t *ctx, uint32_t user_address, uint32_t data_length)
+{
+  if (user_address >= ((ctx->user_flash.start_page + ctx->user_flash.number_of_pages) * ctx->user_flash.page_size))
+  {
+    return false;
+  }
+
+  if (ctx->user_flash.word_size == 0)
+  {
+    return false;
+  }
+
+  // Not a word aligned address.
+  if (user_address % ctx->user_flash.word_size != 0)
+  {
+    return false;
+  }
+
+  if (data_length == 0)
+  {
+    return false;
+  }
+
+  if (ctx->write == 0)
+  {
+    return false;
+  }
+
+  return true;
+}
+
+static uint32_t iov_total_length(const flash_iovec_t *iov, uint8_t iov_count)
+{
+  uint32_t total = 0;
+
+  for (uint8_t idx = 0; idx < iov_count; idx++)
+  {
+    total += iov[idx].length;
+  }
+
+  return total;
+}
+
+static void iov_cursor_skip(iov_cursor_t *cursor, uint16_t byte_count)
+{
+  while (cursor->position < cursor->iov_count)
+  {
+    uint16_t available = cursor->iov[cursor->position].length - cursor->offset;
+    uint16_t take = (byte_count < available) ? byte_count : available;
+
+    cursor->offset += take;
+    byte_count -= take;
+
+    // Also steps over empty pieces so callers copying less than a piece at a time don't get stuck on them.
+    if (cursor->offset == cursor->iov[cursor->position].length)
+    {
+      cursor->position++;
+      cursor->offset = 0;
+    }
+    else if (byte_count == 0)
+    {
+      break;
+    }
+  }
+}
+
+static flash_status_t write_gather(flash_ctx_t *ctx, uint32_t user_address, iov_cursor_t *cursor, uint16_t byte_count)
+{
+  uint32_t write_address = user_address;
+  flash_status_t status = FLASH_OK;
+  uint8_t *padding = (uint8_t *)ctx->padding_buffer;
+  uint8_t alignment = (ctx->user_flash.word_size < sizeof(uint64_t)) ? ctx->user_flash.word_size : sizeof(uint64_t);
+
+  while (byte_count > 0)
+  {
+    // Skip over empty pieces.
+    while (cursor->position < cursor->iov_count && cursor->offset == cursor->iov[cursor->position].length)
+    {
+      cursor->position++;
+      cursor->offset = 0;
+    }
+
+    if (cursor->position >= cursor->iov_count)
+    {
+      return FLASH_ERROR;
+    }
+
+    const flash_iovec_t *piece = &cursor->iov[cursor->position];
+    uint16_t available = piece->length - cursor->offset;
+    uint16_t take = (byte_count < available) ? byte_count : available;
+    uint16_t whole_words = take / ctx->user_flash.word_size;
+
+    if (whole_words > 0)
+    {
+      // Whole words inside this piece go straight to the flash if the user write function can read them where they
+      // are. Otherwise they are copied to the padding buffer, a buffer full at a time.
+      uint8_t *source = &piece->data[cursor->offset];
+
+      if ((uintptr_t)source % alignment != 0)
+      {
+        uint16_t capacity = sizeof(ctx->padding_buffer) / ctx->user_flash.word_size;
+        whole_words = (whole_words < capacity) ? whole_words : capacity;
+        memcpy(padding, source, words_to_bytes(ctx, whole_words));
+        source = padding;
+      }
+
+      status = backend_write(ctx, write_address, source, whole_words);
+      if (status != FLASH_OK)
+      {
+        return status;
+      }
+
+      uint16_t bytes_written = words_to_bytes(ctx, whole_words);
+      write_address += bytes_written;
+      byte_count -= bytes_written;
+      iov_cursor_skip(cursor, bytes_written);
+    }
+    else
+    {
+      // Less than a word left in this piece so pack the next word together from as many pieces as it takes.
+      uint8_t fill = 0;
+      memset(padding, FLASH_EMPTY_VALUE, ctx->user_flash.word_size);
+
+      while (fill < ctx->user_flash.word_size && byte_count > 0 && cursor->position < cursor->iov_count)
+      {
+        piece = &cursor->iov[cursor->position];
+        available = piece->length - cursor->offset;
+        take = ctx->user_flash.word_size - fill;
+        take = (take < available) ? take : available;
+        take = (take < byte_count) ? take : byte_count;
+
+        memcpy(&padding[fill], &piece->data[cursor->offset], take);
+        fill += take;
+        byte_count -= take;
+        iov_cursor_skip(cursor, take);
+      }
+
+      STATS_ADD(ctx->stats.padding_bytes, ctx->user_flash.word_size - fill);
+
+      status = backend_write(ctx, write_address, padding, 1);
+      if (status != FLASH_OK)
+      {
+        return status;
+      }
+
+      write_address += ctx->user_flash.word_size;
+    }
+  }
+
+  return FLASH_OK;
+}
+
+static uint32_t bytes_to_page_end(flash_ctx_t *ctx, uint32_t user_address)
+{
+  return ctx->user_flash.page_size - (user_address % ctx->user_flash.page_size);
+}
+
+static void index_advance_head(flash_ctx_t *ctx, flash_index_t *index, uint16_t bytes_written)
+{
+  index->head += bytes_to_byte_aligned(ctx, bytes_written);
+  index->checkpoint_bytes += bytes_to_byte_aligned(ctx, bytes_written);
+  bool wrapped = (index->head >= index->max_data_address);
+  index->head %= index->max_data_address; // Wrap the head by the max address value. Must add start_page address or head will go all the way back to 0.
+  if (index->head < index->min_data_address)
+  {
+    index->head += index->min_data_address;
+  }
+
+  if (wrapped)
+  {
+    STATS_ADD(index->stats.wraps, 1);
+    TRACE(ctx, FLASH_TRACE_WRAP, index - ctx->indices, index->head, 0, FLASH_OK);
+  }
+}
+
+static void iov_cursor_copy(iov_cursor_t *cursor, uint8_t *destination, uint16_t byte_count)
+{
+  while (byte_count > 0 && cursor->position < cursor->iov_count)
+  {
+    const flash_iovec_t *piece = &cursor->iov[cursor->position];
+    uint16_t available = piece->length - cursor->offset;
+    uint16_t take = (byte_count < available) ? byte_count : available;
+
+    memcpy(destination, &piece->data[cursor->offset], take);
+    destination += take;
+    byte_count -= take;
+    iov_cursor_skip(cursor, take);
+  }
+}
+
+static flash_status_t index_enter_page(flash_ctx_t *ctx, flash_index_t *index)
+{
+  // Already erased ahead of time so nothing to wait for.
+  if (index->erased_ahead > 0)
+  {
+    index->erased_ahead--;
+  }
+  // Nothing has been written to it since it was last erased.
+  else if (!erased_map_all_erased(ctx, index->head, ctx->user_flash.page_size / ctx->user_flash.word_size))
+  {
+    index->erase_stalls++;
+    STATS_ADD(index->stats.page_erases, 1);
+
+    if (flash_ctx_erase_pages(ctx, index->head / ctx->user_flash.page_size, 1) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+  }
+
+  return index_checkpoint(ctx, index, true);
+}
+
+static flash_status_t index_checkpoint(flash_ctx_t *ctx, flash_index_t *index, bool entered_page)
+{
+  bool due = false;
+
+  switch (index->checkpoint_policy)
+  {
+    case FLASH_CHECKPOINT_EVERY_WRITE:
+      due = !entered_page;
+      break;
+    case FLASH_CHECKPOINT_RECORDS:
+      due = entered_page || index->checkpoint_records >= index->checkpoint_every;
+      break;
+    case FLASH_CHECKPOINT_BYTES:
+      due = entered_page || index->checkpoint_bytes >= index->checkpoint_every;
+      break;
+    case FLASH_CHECKPOINT_PAGE:
+      due = entered_page;
+      break;
+    case FLASH_CHECKPOINT_MANUAL:
+    default:
+      due = false;
+      break;
+  }
+
+  // The page at the head still holds the data from last time round until the head moves onto it, so a head at the
+  // start of it would have flash_index_load scan old data. It gets written when the page is entered instead.
+  if (!entered_page && index->checkpoint_policy != FLASH_CHECKPOINT_EVERY_WRITE && index->head % ctx->user_flash.page_size == 0)
+  {
+    due = false;
+  }
+
+  if (!due)
+  {
+    return FLASH_OK;
+  }
+
+  return flash_ctx_index_write_index(ctx, index - ctx->indices);
+}
+
+static void index_scan_forward(flash_ctx_t *ctx, flash_index_t *index)
+{
+  // Data is written a word at a time from the head so the first erased word is where the head got to.
+  while (!index_entry_empty(ctx, index->head))
+  {
+    index_advance_head(ctx, index, ctx->user_flash.word_size);
+
+    // The next page hasn't been moved onto, it only holds data from last time round.
+    if (index->head % ctx->user_flash.page_size == 0)
+    {
+      break;
+    }
+  }
+}
+
+static flash_status_t index_erase_ahead(flash_ctx_t *ctx, flash_index_t *index)
+{
+  if (index->erased_ahead >= index->erase_ahead_pages)
+  {
+    return FLASH_OK;
+  }
+
+  // The first page the head moves onto is the one it's at if it's at the start of a page, otherwise the next one.
+  uint8_t data_pages = index->end_page - index->start_page + 1;
+  uint32_t page = index->head / ctx->user_flash.page_size;
+
+  if (index->head % ctx->user_flash.page_size != 0)
+  {
+    page++;
+  }
+
+  page += index->erased_ahead;
+
+  if (page > index->end_page)
+  {
+    page -= data_pages;
+  }
+
+  if (!erased_map_all_erased(ctx, page * ctx->user_flash.page_size, ctx->user_flash.page_size / ctx->user_flash.word_size))
+  {
+    STATS_ADD(index->stats.page_erases, 1);
+
+    if (flash_ctx_erase_pages(ctx, page, 1) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+  }
+
+  index->erased_ahead++;
+
+  return FLASH_OK;
+}
+
+static uint32_t index_ring_distance(flash_index_t *index, uint32_t from, uint32_t to)
+{
+  if (to >= from)
+  {
+    return to - from;
+  }
+
+  return (index->max_data_address - from) + (to - index->min_data_address);
+}
+
+static void index_advance_tail(flash_index_t *index, uint32_t bytes_read)
+{
+  index->tail += bytes_read;
+
+  while (index->tail >= index->max_data_address)
+  {
+    index->tail -= index->max_data_address - index->min_data_address;
+  }
+}
+
+static flash_status_t index_read_wrapped(flash_ctx_t *ctx, flash_index_t *index, uint32_t user_address, uint8_t *data, uint16_t length)
+{
+  uint16_t offset = 0;
+
+  while (offset < length)
+  {
+    uint32_t bytes_before_wrap = index->max_data_address - user_address;
+    uint16_t chunk = (length - offset < bytes_before_wrap) ? length - offset : bytes_before_wrap;
+
+    if (flash_ctx_read(ctx, user_address, &data[offset], chunk) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    offset += chunk;
+    user_address += chunk;
+    if (user_address >= index->max_data_address)
+    {
+      user_address = index->min_data_address;
+    }
+  }
+
+  return FLASH_OK;
+}
+
+static bool index_data_crc_ok(flash_index_t *index, const uint8_t *data)
+{
+  uint32_t crc = 0;
+  memcpy(&crc, &data[sizeof(index->head) * 2], sizeof(crc));
+
+  return crc == flash_crc32c(0, data, sizeof(index->head) * 2);
+}
+
+static bool index_entry_empty(flash_ctx_t *ctx, uint32_t user_address)
+{
+  uint32_t word = 0;
+
+  // The erased map can answer without reading the flash if it is tracking the index page.
+  if (erased_map_word(ctx, user_address, &word))
+  {
+    return ctx->erased_map[word / 8] & (1 << (word % 8));
+  }
+
+  uint8_t empty_word[ctx->user_flash.word_size];
+  memset(empty_word, FLASH_EMPTY_VALUE, ctx->user_flash.word_size);
+
+  uint8_t index_page_data[ctx->user_flash.word_size];
+  memset(index_page_data, 0x00, ctx->user_flash.word_size);
+
+  flash_ctx_read(ctx, user_address, index_page_data, ctx->user_flash.word_size);
+
+  return memcmp(empty_word, index_page_data, ctx->user_flash.word_size) == 0;
+}
+
+static flash_status_t index_append(flash_ctx_t *ctx, flash_index_t *index, iov_cursor_t *cursor, uint16_t data_length)
+{
+  // printf("\nWrite address (head) is %d", index->head);
+
+  // If there's only one page then don't break up the data over the wrap just write it to the start of the page.
+  if ((index->end_page - index->start_page) == 0)
+  {
+    uint16_t bytes_before_wrap = bytes_to_byte_aligned(ctx, index->max_data_address - index->head); // Integral multiple of words before the end of the page.
+
+    if (data_length >= bytes_before_wrap)
+    {
+      if (data_length > ctx->user_flash.page_size)
+      {
+        iov_cursor_skip(cursor, data_length - data_length % ctx->user_flash.word_size);
+        data_length %= ctx->user_flash.word_size;
+      }
+
+      // Return head to start of page.
+      index->head = index->min_data_address;
+    }
+  }
+
+  // Write a page at a time. The head wraps back to the start of the data pages when it gets to the end.
+  while (data_length > 0)
+  {
+    // Each page has to be erased as the head moves onto it as it still holds data from the last time round.
+    if (index->head % ctx->user_flash.page_size == 0)
+    {
+      if (index_enter_page(ctx, index) != FLASH_OK)
+      {
+        return FLASH_ERROR;
+      }
+    }
+
+    uint16_t chunk = bytes_to_page_end(ctx, index->head);
+    if (chunk > data_length)
+    {
+      chunk = data_length;
+    }
+
+    if (write_gather(ctx, index->head, cursor, chunk) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    index_advance_head(ctx, index, chunk);
+    data_length -= chunk;
+  }
+
+  return FLASH_OK;
+}
+
+static flash_status_t index_buffer_append(flash_ctx_t *ctx, uint8_t id, iov_cursor_t *cursor, uint16_t data_length)
+{
+  flash_index_t *index = &ctx->indices[id];
+
+  if (index->write_buffer_length == 0 && ctx->tick != 0)
+  {
+    index->write_buffer_tick = ctx->tick();
+  }
+
+  while (data_length > 0)
+  {
+    uint16_t space = index->write_buffer_size - index->write_buffer_length;
+    uint16_t take = (data_length < space) ? data_length : space;
+
+    iov_cursor_copy(cursor, &index->write_buffer[index->write_buffer_length], take);
+    index->write_buffer_length += take;
+    data_length -= take;
+
+    // A full buffer is always a whole number of words so nothing gets padded.
+    if (index->write_buffer_length == index->write_buffer_size)
+    {
+      if (index_buffer_flush(ctx, id, true) != FLASH_OK)
+      {
+        return FLASH_ERROR;
+      }
+
+      if (ctx->tick != 0)
+      {
+        index->write_buffer_tick = ctx->tick();
+      }
+    }
+  }
+
+  if (index->flush_threshold != 0 && index->write_buffer_length >= index->flush_threshold)
+  {
+    return index_buffer_flush(ctx, id, true);
+  }
+
+  if (index->flush_age != 0 && ctx->tick != 0 && index->write_buffer_length > 0 && (uint32_t)(ctx->tick() - index->write_buffer_tick) >= index->flush_age)
+  {
+    return index_buffer_flush(ctx, id, false);
+  }
+
+  return FLASH_OK;
+}
+
+static flash_status_t index_buffer_flush(flash_ctx_t *ctx, uint8_t id, bool whole_words_only)
+{
+  flash_index_t *index = &ctx->indices[id];
+  uint16_t flush_length = index->write_buffer_length;
+
+  if (whole_words_only)
+  {
+    flush_length -= flush_length % ctx->user_flash.word_size;
+  }
+
+  if (flush_length == 0)
+  {
+    return FLASH_OK;
+  }
+
+  flash_iovec_t piece = {.data = index->write_buffer, .length = flush_length};
+  iov_cursor_t cursor = {.iov = &piece, .iov_count = 1};
+
+  if (index_append(ctx, index, &cursor, flush_length) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  // Keep any partial word that was left behind at the start of the buffer.
+  index->write_buffer_length -= flush_length;
+  memmove(index->write_buffer, &index->write_buffer[flush_length], index->write_buffer_length);
+
+  return index_checkpoint(ctx, index, false);
+}
+
+static uint32_t index_logical_head(flash_index_t *index)
+{
+  uint32_t head = index->head + index->write_buffer_length;
+
+  if (head >= index->max_data_address)
+  {
+    head = head - index->max_data_address + index->min_data_address;
+  }
+
+  return head;
+}
+
+#ifdef FLASH_ENABLE_TRACE
+static void trace_record(flash_ctx_t *ctx, uint8_t type, uint8_t id, uint32_t address, uint32_t length, flash_status_t status)
+{
+  flash_trace_t *trace = &ctx->trace;
+
+  if (trace->events == NULL)
+  {
+    return;
+  }
+
+  flash_trace_event_t *event = &trace->events[trace->count & trace->mask];
+
+  event->timestamp = (trace->clock != 0) ? trace->clock() : 0;
+  event->address = address;
+  event->length = length;
+  event->type = type;
+  event->id = id;
+  event->status = (uint8_t)status;
+  event->reserved = 0;
+  trace->count++;
+}
+
+static flash_status_t trace_exit(flash_ctx_t *ctx, uint8_t type, uint8_t id, uint32_t address, uint32_t length, flash_status_t status)
+{
+  trace_record(ctx, type | FLASH_TRACE_EXIT, id, address, length, status);
+
+  return status;
+}
+
+static uint32_t trace_head(flash_ctx_t *ctx, uint8_t id)
+{
+  return index_exists(ctx, id) ? ctx->indices[id].head : 0;
+}
+
+static uint32_t trace_tail(flash_ctx_t *ctx, uint8_t id)
+{
+  return index_exists(ctx, id) ? ctx->indices[id].tail : 0;
+}
+#endif
+
+static flash_status_t ctx_write(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t data_length)
+{
+  if (!write_allowed(ctx, user_address, data_length))
+  {
+    return FLASH_ERROR;
+  }
+
+  if (data_length > FLASH_MAX_WRITE_SIZE)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (data == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  STATS_ADD(ctx->stats.user_bytes, data_length);
+
+  flash_iovec_t piece = {.data = data, .length = data_length};
+  iov_cursor_t cursor = {.iov = &piece, .iov_count = 1};
+
+  return write_gather(ctx, user_address, &cursor, data_length);
+}
+
+static flash_status_t ctx_writev(flash_ctx_t *ctx, uint32_t user_address, const flash_iovec_t *iov, uint8_t iov_count)
+{
+  if (iov == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  uint32_t data_length = iov_total_length(iov, iov_count);
+
+  if (!write_allowed(ctx, user_address, data_length))
+  {
+    return FLASH_ERROR;
+  }
+
+  if (data_length > UINT16_MAX)
+  {
+    return FLASH_ERROR;
+  }
+
+  for (uint8_t idx = 0; idx < iov_count; idx++)
+  {
+    if (iov[idx].data == NULL && iov[idx].length != 0)
+    {
+      return FLASH_ERROR;
+    }
+  }
+
+  STATS_ADD(ctx->stats.user_bytes, data_length);
+
+  iov_cursor_t cursor = {.iov = iov, .iov_count = iov_count};
+
+  return write_gather(ctx, user_address, &cursor, data_length);
+}
+
+static flash_status_t ctx_erase_pages(flash_ctx_t *ctx, uint8_t page_number, uint8_t number_of_pages)
+{
+  if (page_number < ctx->user_flash.start_page || page_number + number_of_pages > ctx->user_flash.end_page + 1)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (ctx->erase == 0)
+  {
+    return FLASH_ERROR;
+  }
+  else
+  {
+    return backend_erase(ctx, page_number, number_of_pages);
+  }
+}
+
+static flash_status_t ctx_index_writev(flash_ctx_t *ctx, uint8_t id, const flash_iovec_t *iov, uint8_t iov_count)
+{
+  // Check if the index exists
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  if (iov == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  uint32_t total_length = iov_total_length(iov, iov_count);
+
+  if (total_length == 0 || total_length > UINT16_MAX)
+  {
+    return FLASH_ERROR;
+  }
+
+  for (uint8_t idx = 0; idx < iov_count; idx++)
+  {
+    if (iov[idx].data == NULL && iov[idx].length != 0)
+    {
+      return FLASH_ERROR;
+    }
+  }
+
+  flash_index_t *index = &ctx->indices[id];
+  iov_cursor_t cursor = {.iov = iov, .iov_count = iov_count};
+  uint16_t data_length = total_length;
+
+  if (!write_allowed(ctx, index->head, data_length))
+  {
+    return FLASH_ERROR;
+  }
+
+  STATS_ADD(ctx->stats.user_bytes, data_length);
+  STATS_ADD(index->stats.user_bytes, data_length);
+
+  // Buffered indices only go to flash when their buffer is flushed.
+  if (index->write_buffer != NULL)
+  {
+    index->checkpoint_records++;
+    return index_buffer_append(ctx, id, &cursor, data_length);
+  }
+
+  if (index_append(ctx, index, &cursor, data_length) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  index->checkpoint_records++;
+
+  if (index_checkpoint(ctx, index, false) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  return FLASH_OK;
+}
+
+static flash_status_t ctx_index_write_index(flash_ctx_t *ctx, uint8_t id)
+{
+  // Check if the index exists
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t *index = &ctx->indices[id];
+  uint8_t index_data_size = index->index_data_size;
+
+  // The driver knows where it put the last index data unless the index has just been loaded, so only search the
+  // index page for the next spot to write to when it doesn't.
+  if (!index->index_write_address_known)
+  {
+    uint32_t read_address = 0;
+    flash_status_t status = flash_ctx_index_get_index_address(ctx, id, &read_address);
+
+    if (status == FLASH_ERROR)
+    {
+      return FLASH_ERROR;
+    }
+
+    if (status == FLASH_DATA_NOT_FOUND)
+    {
+      index->index_write_address = index->min_index_address;
+    }
+    else
+    {
+      index->index_write_address = read_address + bytes_to_byte_aligned(ctx, index_data_size);
+    }
+
+    index->index_write_address_known = true;
+  }
+
+  if (index->index_write_address + bytes_to_byte_aligned(ctx, index_data_size) > index->max_index_address)
+  {
+    STATS_ADD(index->stats.index_page_erases, 1);
+
+    // Erasing the index page moves index_write_address back to the start of it.
+    if (flash_ctx_erase_pages(ctx, index->index_page, 1) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    TRACE(ctx, FLASH_TRACE_CHECKPOINT_MOVE, id, index->index_write_address, 0, FLASH_OK);
+  }
+
+  uint32_t write_address = index->index_write_address;
+
+  // Write the index data to flash
+  uint8_t write_data[sizeof(index->head) * 2 + sizeof(uint32_t)];
+  memcpy(write_data, &(index->head), sizeof(index->head));
+  memcpy(&write_data[sizeof(index->head)], &(index->tail), sizeof(index->tail));
+
+  if (index->checkpoint_crc)
+  {
+    uint32_t crc = flash_crc32c(0, write_data, sizeof(index->head) * 2);
+    memcpy(&write_data[sizeof(index->head) * 2], &crc, sizeof(crc));
+  }
+
+  // Not through flash_ctx_write so it isn't counted as user data.
+  flash_iovec_t piece = {.data = write_data, .length = index_data_size};
+  iov_cursor_t cursor = {.iov = &piece, .iov_count = 1};
+
+  if (!write_allowed(ctx, write_address, index_data_size) || write_gather(ctx, write_address, &cursor, index_data_size) != FLASH_OK)
+  {
+    // Don't know what made it onto the page.
+    index->index_write_address_known = false;
+    return FLASH_ERROR;
+  }
+  else
+  {
+    STATS_ADD(index->stats.checkpoint_writes, 1);
+    STATS_ADD(index->stats.checkpoint_bytes, bytes_to_byte_aligned(ctx, index_data_size));
+    index->index_write_address = write_address + bytes_to_byte_aligned(ctx, index_data_size);
+    index->checkpoint_records = 0;
+    index->checkpoint_bytes = 0;
+    return FLASH_OK;
+  }
+}
+
+// PUBLIC FUNCTION DEFINITIONS
+
+void flash_ctx_init(flash_ctx_t *ctx, flash_write_ptr write_fn, flash_read_ptr read_fn, erase_ptr erase_fn, uint8_t word_size, uint16_t page_size, uint8_t number_of_pages, uint8_t start_page, uint32_t base_address, flash_endianess_t endianess)
+{
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->write = write_fn;
+  ctx->read = read_fn;
+  ctx->erase = erase_fn;
+  ctx->user_flash.word_size = word_size;
+  ctx->user_flash.page_size = page_size;
+  ctx->user_flash.start_page = start_page;
+  ctx->user_flash.number_of_pages = number_of_pages;
+  ctx->user_flash.end_page = start_page + number_of_pages - 1;
+  ctx->user_flash.endianess = endianess;
+  ctx->user_flash.base_address = base_address;
+}
+
+void flash_ctx_set_tick_source(flash_ctx_t *ctx, flash_tick_ptr tick_fn)
+{
+  ctx->tick = tick_fn;
+}
+
+flash_status_t flash_ctx_poll(flash_ctx_t *ctx)
+{
+  flash_status_t status = FLASH_OK;
+
+  for (uint8_t id = 0; id < ctx->index_count; id++)
+  {
+    flash_index_t *index = &ctx->indices[id];
+
+    // Flush any buffered index data that has been waiting too long.
+    if (ctx->tick != 0 && index->write_buffer_length > 0 && index->flush_age != 0 && (uint32_t)(ctx->tick() - index->write_buffer_tick) >= index->flush_age)
+    {
+      if (index_buffer_flush(ctx, id, false) != FLASH_OK)
+      {
+        status = FLASH_ERROR;
+      }
+    }
+
+    // Only one page per index per call so a call never takes much longer than an erase.
+    if (index_erase_ahead(ctx, index) != FLASH_OK)
+    {
+      status = FLASH_ERROR;
+    }
+  }
+
+  return status;
+}
+
+flash_status_t flash_ctx_write(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint16_t data_length)
+{
+  TRACE(ctx, FLASH_TRACE_WRITE, FLASH_TRACE_NO_ID, user_address, data_length, FLASH_OK);
+
+  return TRACE_EXIT(ctx, FLASH_TRACE_WRITE, FLASH_TRACE_NO_ID, user_address, data_length, ctx_write(ctx, user_address, data, data_length));
+}
+
+flash_status_t flash_ctx_writev(flash_ctx_t *ctx, uint32_t user_address, const flash_iovec_t *iov, uint8_t iov_count)
+{
+  TRACE(ctx, FLASH_TRACE_WRITE, FLASH_TRACE_NO_ID, user_address, (iov != NULL) ? iov_total_length(iov, iov_count) : 0, FLASH_OK);
+
+  return TRACE_EXIT(ctx, FLASH_TRACE_WRITE, FLASH_TRACE_NO_ID, user_address, (iov != NULL) ? iov_total_length(iov, iov_count) : 0, ctx_writev(ctx, user_address, iov, iov_count));
+}
+
+flash_status_t flash_ctx_read(flash_ctx_t *ctx, uint32_t user_read_address, uint8_t *data, uint16_t length)
+{
+  if (user_read_address >= (ctx->user_flash.start_page + ctx->user_flash.number_of_pages) * ctx->user_flash.page_size)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (ctx->read == 0 || data == NULL)
+  {
+    return FLASH_ERROR;
+  }
+  else
+  {
+    return backend_read(ctx, user_read_address, data, length);
+  }
+}
+
+flash_status_t flash_ctx_write_bulk(flash_ctx_t *ctx, uint32_t user_address, uint8_t *data, uint32_t data_length)
+{
+  if (!write_allowed(ctx, user_address, data_length))
+  {
+    return FLASH_ERROR;
+  }
+
+  if (data == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  // The whole write has to fit in the user flash, not just its start.
+  if (data_length > ((ctx->user_flash.start_page + ctx->user_flash.number_of_pages) * ctx->user_flash.page_size) - user_address)
+  {
+    return FLASH_ERROR;
+  }
+
+  STATS_ADD(ctx->stats.user_bytes, data_length);
+
+  uint32_t offset = 0;
+
+  // Stream the data out a page at a time. Only the final chunk can end on a partial word.
+  while (offset < data_length)
+  {
+    uint32_t chunk = bytes_to_page_end(ctx, user_address + offset);
+    if (chunk > data_length - offset)
+    {
+      chunk = data_length - offset;
+    }
+
+    flash_iovec_t piece = {.data = &data[offset], .length = chunk};
+    iov_cursor_t cursor = {.iov = &piece, .iov_count = 1};
+
+    if (write_gather(ctx, user_address + offset, &cursor, chunk) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    offset += chunk;
+  }
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_ctx_read_bulk(flash_ctx_t *ctx, uint32_t user_read_address, uint8_t *data, uint32_t length)
+{
+  uint32_t flash_end = (ctx->user_flash.start_page + ctx->user_flash.number_of_pages) * ctx->user_flash.page_size;
+
+  if (user_read_address >= flash_end || length > flash_end - user_read_address)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (ctx->read == 0 || data == NULL || ctx->user_flash.page_size == 0)
+  {
+    return FLASH_ERROR;
+  }
+
+  uint32_t offset = 0;
+
+  // Read a page at a time so each backend read fits its uint16_t length.
+  while (offset < length)
+  {
+    uint32_t chunk = bytes_to_page_end(ctx, user_read_address + offset);
+    if (chunk > length - offset)
+    {
+      chunk = length - offset;
+    }
+
+    if (backend_read(ctx, user_read_address + offset, &data[offset], chunk) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    offset += chunk;
+  }
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_ctx_erase_pages(flash_ctx_t *ctx, uint8_t page_number, uint8_t number_of_pages)
+{
+  TRACE(ctx, FLASH_TRACE_ERASE_PAGES, FLASH_TRACE_NO_ID, page_number, number_of_pages, FLASH_OK);
+
+  return TRACE_EXIT(ctx, FLASH_TRACE_ERASE_PAGES, FLASH_TRACE_NO_ID, page_number, number_of_pages, ctx_erase_pages(ctx, page_number, number_of_pages));
+}
+
+int flash_ctx_index_register(flash_ctx_t *ctx, uint8_t start_page, uint8_t end_page)
+{
+  if (!initialized(ctx))
+  {
+    // printf("Use flash not initialized\n");
+    return -1;
+  }
+
+  // Minimum number of pages is 2 as you need 1 for the index. Index is alwasy page_start.
+  if ((end_page - start_page) < 1)
+  {
+    // printf("Not enough pages\n");
+    return -1;
+  }
+
+  // End page must be greater than start page
+  if (start_page > end_page)
+  {
+    // printf("Start page is > end page\n");
+    return -1;
+  }
+
+  // Page numbers cannot exceed total available pages numbers
+  if (start_page < ctx->user_flash.start_page || end_page >= ctx->user_flash.start_page + ctx->user_flash.number_of_pages)
+  {
+    // printf("Start or end page outside limit\n");
+    return -1;
+  }
+
+  if (ctx->index_count >= FLASH_MAX_INDICES)
+  {
+    return -1;
+  }
+
+  if (ctx->index_count > 0)
+  {
+    // printf("Checking index count\n");
+    // Check all of the existing indices for overlap
+    for (uint8_t idx = 0; idx < ctx->index_count; idx++)
+    {
+      if ((start_page >= ctx->indices[idx].start_page && start_page <= ctx->indices[idx].end_page) || (end_page >= ctx->indices[idx].start_page && end_page <= ctx->indices[idx].end_page))
+      {
+        // printf("Overlap with existing index\n");
+        return -1;
+      }
+    }
+  }
+
+  flash_index_t new_index = {
+      .index_page = start_page,
+      .start_page = start_page + 1,
+      .end_page = end_page,
+      .head = (start_page + 1) * ctx->user_flash.page_size,
+      .tail = (start_page + 1) * ctx->user_flash.page_size,
+      .min_data_address = (start_page + 1) * ctx->user_flash.page_size,
+      .max_data_address = (end_page + 1) * ctx->user_flash.page_size,
+      .min_index_address = start_page * ctx->user_flash.page_size,
+      .max_index_address = (start_page + 1) * ctx->user_flash.page_size};
+
+  new_index.index_data_size = sizeof(new_index.head) + sizeof(new_index.tail);
+
+  ctx->indices[ctx->index_count] = new_index;
+
+  uint8_t id = ctx->index_count;
+  ctx->index_count++;
+  return id;
+}
+flash_status_t flash_ctx_index_write(flash_ctx_t *ctx, uint8_t id, uint8_t *data, uint16_t data_length)
+{
+  flash_iovec_t piece = {.data = data, .length = data_length};
+
+  return flash_ctx_index_writev(ctx, id, &piece, 1);
+}
+
+// TODO: Add printf back to this to see the write address 
+flash_status_t flash_ctx_index_writev(flash_ctx_t *ctx, uint8_t id, const flash_iovec_t *iov, uint8_t iov_count)
+{
+  TRACE(ctx, FLASH_TRACE_INDEX_WRITE, id, trace_head(ctx, id), (iov != NULL) ? iov_total_length(iov, iov_count) : 0, FLASH_OK);
+
+  flash_status_t status = ctx_index_writev(ctx, id, iov, iov_count);
+
+  return TRACE_EXIT(ctx, FLASH_TRACE_INDEX_WRITE, id, trace_head(ctx, id), (iov != NULL) ? iov_total_length(iov, iov_count) : 0, status);
+}
+
+flash_status_t flash_ctx_index_read(flash_ctx_t *ctx, uint8_t id, uint8_t *data, uint16_t data_length)
+{
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  if (data == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t *index = &ctx->indices[id];
+  uint16_t offset = 0;
+
+  while (index->read_buffer != NULL && offset < data_length)
+  {
+    uint32_t buffered_offset = index_ring_distance(index, index->read_buffer_address, index->tail);
+
+    // Serve what the read ahead buffer already holds.
+    if (buffered_offset < index->read_buffer_length)
+    {
+      uint16_t take = index->read_buffer_length - buffered_offset;
+      if (take > data_length - offset)
+      {
+        take = data_length - offset;
+      }
+
+      memcpy(&data[offset], &index->read_buffer[buffered_offset], take);
+      index_advance_tail(index, take);
+      offset += take;
+      continue;
+    }
+
+    // Read ahead up to the head, as past it the flash is still going to change.
+    uint32_t available = index_ring_distance(index, index->tail, index->head);
+    if (available == 0)
+    {
+      break;
+    }
+
+    uint16_t fill = (available < index->read_buffer_size) ? available : index->read_buffer_size;
+    index->read_buffer_length = 0;
+
+    if (index_read_wrapped(ctx, index, index->tail, index->read_buffer, fill) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    index->read_buffer_address = index->tail;
+    index->read_buffer_length = fill;
+  }
+
+  // Anything not read ahead comes straight from the flash.
+  if (offset < data_length)
+  {
+    if (index_read_wrapped(ctx, index, index->tail, &data[offset], data_length - offset) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    index_advance_tail(index, data_length - offset);
+  }
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_ctx_index_write_bulk(flash_ctx_t *ctx, uint8_t id, uint8_t *data, uint32_t data_length)
+{
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t *index = &ctx->indices[id];
+
+  if (!write_allowed(ctx, index->head, data_length) || data == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  STATS_ADD(ctx->stats.user_bytes, data_length);
+  STATS_ADD(index->stats.user_bytes, data_length);
+
+  // Anything still buffered has to go out first so the data stays in order.
+  if (index_buffer_flush(ctx, id, false) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  uint32_t offset = 0;
+
+  // Stream the data into the index a page at a time, going round the ring as many times as it takes.
+  while (offset < data_length)
+  {
+    // Each page is erased as the head moves onto it as on the second time round it still holds the old data.
+    if (index->head % ctx->user_flash.page_size == 0)
+    {
+      if (index_enter_page(ctx, index) != FLASH_OK)
+      {
+        return FLASH_ERROR;
+      }
+    }
+
+    uint32_t chunk = bytes_to_page_end(ctx, index->head);
+    if (chunk > data_length - offset)
+    {
+      chunk = data_length - offset;
+    }
+
+    flash_iovec_t piece = {.data = &data[offset], .length = chunk};
+    iov_cursor_t cursor = {.iov = &piece, .iov_count = 1};
+
+    if (write_gather(ctx, index->head, &cursor, chunk) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    index_advance_head(ctx, index, chunk);
+    offset += chunk;
+  }
+
+  index->checkpoint_records++;
+
+  // Only one index update for the whole transfer.
+  return index_checkpoint(ctx, index, false);
+}
+
+flash_status_t flash_ctx_index_read_bulk(flash_ctx_t *ctx, uint8_t id, uint8_t *data, uint32_t data_length)
+{
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  if (data == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t *index = &ctx->indices[id];
+  uint32_t offset = 0;
+
+  // The tail moves without going through the read ahead buffer, so what it holds can't be trusted any more.
+  index->read_buffer_length = 0;
+
+  // Read a page at a time from the tail, wrapping back to the start of the data space at the end.
+  while (offset < data_length)
+  {
+    uint32_t chunk = bytes_to_page_end(ctx, index->tail);
+    if (chunk > data_length - offset)
+    {
+      chunk = data_length - offset;
+    }
+
+    if (flash_ctx_read(ctx, index->tail, &data[offset], chunk) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    index->tail += chunk;
+    if (index->tail >= index->max_data_address)
+    {
+      index->tail = index->min_data_address;
+    }
+    offset += chunk;
+  }
+
+  return FLASH_OK;
+}
+
+uint32_t flash_ctx_index_get_head(flash_ctx_t *ctx, uint8_t id)
+{
+  if (!index_exists(ctx, id))
+  {
+    return -1;
+  }
+
+  return index_logical_head(&ctx->indices[id]);
+}
+
+flash_status_t flash_ctx_index_read_rel_head(flash_ctx_t *ctx, uint8_t id, int position, uint8_t *data, uint16_t data_length)
+{
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  // Can't read ahead of head
+  if (position > 0)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t *index = &ctx->indices[id];
+  uint32_t read_address = index_logical_head(index) + position;
+
+  // Check if we reverse wrap
+  if (read_address < index->min_data_address)
+  {
+    read_address = index->max_data_address - (index->min_data_address - read_address);
+  }
+
+  // Check for forward read wrap
+  if ((read_address + data_length) > index->max_data_address)
+  {
+    // Determine how many bytes can be read
+    uint16_t bytes_before_wrap = index->max_data_address - read_address;
+
+    // Read the bytes
+    if (flash_ctx_read(ctx, read_address, data, bytes_before_wrap) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    read_address += bytes_before_wrap;
+    read_address %= index->max_data_address;
+    read_address += index->min_data_address;
+
+    // Read the bytes
+    if (flash_ctx_read(ctx, read_address, &data[bytes_before_wrap], data_length - bytes_before_wrap) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+  }
+  else
+  {
+    if (flash_ctx_read(ctx, read_address, data, data_length) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+  }
+
+  // Data still in the write buffer sits just behind the head so copy it over what was read from flash.
+  int32_t pending = index->write_buffer_length;
+  int32_t first = (-pending - position > 0) ? -pending - position : 0;
+  int32_t last = (-position < data_length) ? -position : data_length;
+
+  if (first < last)
+  {
+    memcpy(&data[first], &index->write_buffer[pending + position + first], last - first);
+  }
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_ctx_index_erase_all_data(flash_ctx_t *ctx, uint8_t id)
+{
+
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t *index = &ctx->indices[id];
+
+  index->head = index->min_data_address;
+  index->write_buffer_length = 0;
+  index->read_buffer_length = 0;
+
+  if (flash_ctx_erase_pages(ctx, index->start_page, index->end_page - index->start_page + 1) != FLASH_OK)
+  {
+    index->erased_ahead = 0;
+    return FLASH_ERROR;
+  }
+
+  // Every data page is blank now so none of them need erasing on the way round.
+  index->erased_ahead = index->end_page - index->start_page + 1;
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_ctx_index_erase_index(flash_ctx_t *ctx, uint8_t id)
+{
+
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t *index = &ctx->indices[id];
+
+  index->head = index->min_data_address;
+  index->write_buffer_length = 0;
+  index->read_buffer_length = 0;
+  index->erased_ahead = 0;
+
+  return flash_ctx_erase_pages(ctx, index->index_page, 1);
+}
+
+flash_status_t flash_ctx_index_write_index(flash_ctx_t *ctx, uint8_t id)
+{
+  TRACE(ctx, FLASH_TRACE_INDEX_WRITE_INDEX, id, trace_head(ctx, id), trace_tail(ctx, id), FLASH_OK);
+
+  return TRACE_EXIT(ctx, FLASH_TRACE_INDEX_WRITE_INDEX, id, trace_head(ctx, id), trace_tail(ctx, id), ctx_index_write_index(ctx, id));
+}
+
+flash_status_t flash_ctx_index_get_index_address(flash_ctx_t *ctx, uint8_t id, uint32_t *address)
+{
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  if (ctx->user_flash.word_size == 0)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t *index = &ctx->indices[id];
+
+  uint8_t index_data_size = index->index_data_size;
+  uint8_t index_data_bytes_aligned = bytes_to_words(ctx, index_data_size) * ctx->user_flash.word_size;
+
+  // Index data is only ever appended to the page after an erase so the page is some written entries followed by
+  // erased ones. Binary search for the first erased entry.
+  uint32_t first = 0;
+  uint32_t last = (index->max_index_address - index->min_index_address) / index_data_bytes_aligned;
+
+  while (first < last)
+  {
+    uint32_t middle = first + (last - first) / 2;
+
+    if (index_entry_empty(ctx, index->min_index_address + middle * index_data_bytes_aligned))
+    {
+      last = middle;
+    }
+    else
+    {
+      first = middle + 1;
+    }
+  }
+
+  // If empty entry at the page start
+  if (first == 0)
+  {
+    return FLASH_DATA_NOT_FOUND;
+  }
+
+  // The latest data is the entry before the first empty one, or the last entry if the page is full.
+  *address = index->min_index_address + (first - 1) * index_data_bytes_aligned;
+  return FLASH_OK;
+}
+
+flash_status_t flash_ctx_index_reset(flash_ctx_t *ctx, uint8_t id)
+{
+  if(!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t * index = &ctx->indices[id];
+
+  index->head = index->start_page*ctx->user_flash.page_size;
+  index->tail = index->head;
+  index->write_buffer_length = 0;
+  index->read_buffer_length = 0;
+  index->erased_ahead = 0;
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_ctx_index_load(flash_ctx_t *ctx, uint8_t id)
+{
+  if(!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t * index = &(ctx->indices[id]);
+  uint32_t index_address = 0;
+
+  // The index page may have been written by someone else since the driver last looked at it.
+  index->index_write_address_known = false;
+
+  // Get the address of the flash index data
+  flash_status_t status = flash_ctx_index_get_index_address(ctx, id, &index_address);
+  if(status != FLASH_OK)
+  {
+    // Could be error or index data not found.
+    return status;
+  }
+
+  uint8_t data_size = index->index_data_size;
+  uint8_t read_data[data_size];
+  uint32_t read_address = index_address;
+
+  while (true)
+  {
+    if(flash_ctx_read(ctx, read_address, read_data, data_size) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    if (!index->checkpoint_crc || index_data_crc_ok(index, read_data))
+    {
+      break;
+    }
+
+    // Half written or corrupted, fall back to the index data written before it.
+    if (read_address == index->min_index_address)
+    {
+      return FLASH_DATA_NOT_FOUND;
+    }
+
+    read_address -= bytes_to_byte_aligned(ctx, data_size);
+  }
+
+  memcpy(&(index->head), &read_data[0], sizeof(index->head));
+  memcpy(&(index->tail), &read_data[sizeof(index->head)], sizeof(index->tail));
+
+  // Bad index data still takes up its spot on the page so the next goes after the newest, good or not.
+  index->index_write_address = index_address + bytes_to_byte_aligned(ctx, data_size);
+  index->index_write_address_known = true;
+  index->write_buffer_length = 0;
+  index->read_buffer_length = 0;
+  index->erased_ahead = 0;
 
-// PRIVATE FUNCTION DECLARATIONS
+  // The index isn't written after every write with the other policies so there may be data after the head that was
+  // loaded, which would stop the next write with FLASH_NOT_ERASED_ERROR.
+  if (index->checkpoint_policy != FLASH_CHECKPOINT_EVERY_WRITE)
+  {
+    index_scan_forward(ctx, index);
+  }
 
-/**
- * @brief Is the flash initialized.
- *
- * @return true User flash is initialized.
- * @return false User flash is not initialized.
- */
-static bool initialized();
+  index->checkpoint_records = 0;
+  index->checkpoint_bytes = 0;
 
-/**
- * @brief Check if an index exists.
- *
- * @param id The id of the index.
- * @return true Index exists.
- * @return false Index doesn't exist.
- */
-static bool index_exists(uint8_t id);
+  return FLASH_OK;
+}
 
-/**
- * @brief Convert a number of bytes to a number of whole words.
- * @param number_of_bytes The number of bytes to convert.
- * @return The number of words to represent the bytes.
- */
-uint16_t bytes_to_words(uint32_t number_of_bytes);
+flash_status_t flash_ctx_index_set_write_buffer(flash_ctx_t *ctx, uint8_t id, uint8_t *buffer, uint16_t buffer_size, uint16_t flush_threshold, uint32_t flush_age)
+{
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
 
-/**
- * @brief Convert a number of words to bytes.
- *
- * @param number_of_words Number of words to convert.
- * @return uint16_t The number of bytes.
- */
-uint16_t words_to_bytes(uint16_t number_of_words);
+  flash_index_t *index = &ctx->indices[id];
 
-/**
- * @brief Determine the number of bytes required to write some
- * data as a word aligned quantity.
- *
- * @param num_bytes Quantity of bytes to write.
- * @return uint16_t The number of bytes required.
- */
-uint16_t bytes_to_byte_aligned(uint16_t num_bytes);
+  // Whatever was buffered before has to be written out before the buffer is swapped.
+  if (index_buffer_flush(ctx, id, false) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
 
-// PRIVATE FUNCTION DEFINITIONS
+  if (buffer == NULL)
+  {
+    index->write_buffer = NULL;
+    index->write_buffer_size = 0;
+    index->flush_threshold = 0;
+    index->flush_age = 0;
+    return FLASH_OK;
+  }
 
-static bool initialized()
-{
-  if (user_flash.number_of_pages == 0)
+  // Buffer has to hold whole words so a full buffer never needs padding, and can't be bigger than the data space.
+  if (buffer_size < ctx->user_flash.word_size || buffer_size % ctx->user_flash.word_size != 0 || buffer_size > index->max_data_address - index->min_data_address)
   {
-    return false;
+    return FLASH_ERROR;
   }
 
-  return true;
+  index->write_buffer = buffer;
+  index->write_buffer_size = buffer_size;
+  index->write_buffer_length = 0;
+  index->flush_threshold = flush_threshold;
+  index->flush_age = flush_age;
+
+  return FLASH_OK;
 }
 
-static bool index_exists(uint8_t id)
+flash_status_t flash_ctx_index_flush(flash_ctx_t *ctx, uint8_t id)
 {
-  // Check if the index exists
-  if (id >= index_count || index_count == 0)
+  if (!index_exists(ctx, id))
   {
-    return false;
+    return FLASH_ERROR;
   }
 
-  return true;
+  return index_buffer_flush(ctx, id, false);
 }
-uint16_t bytes_to_words(uint32_t number_of_bytes)
+
+
+flash_status_t flash_ctx_index_set_erase_ahead(flash_ctx_t *ctx, uint8_t id, uint8_t pages)
 {
-  uint16_t quotient = number_of_bytes / user_flash.word_size;
-  uint16_t remainder = number_of_bytes % user_flash.word_size;
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
 
-  return (remainder == 0) ? quotient : quotient + 1;
+  flash_index_t *index = &ctx->indices[id];
+
+  // The page the head is on always has to be left alone.
+  if (pages > index->end_page - index->start_page)
+  {
+    return FLASH_ERROR;
+  }
+
+  index->erase_ahead_pages = pages;
+
+  return FLASH_OK;
 }
 
-uint16_t words_to_bytes(uint16_t number_of_words)
+uint32_t flash_ctx_index_get_erase_stalls(flash_ctx_t *ctx, uint8_t id)
 {
-  return number_of_words * user_flash.word_size;
+  if (!index_exists(ctx, id))
+  {
+    return 0;
+  }
+
+  return ctx->indices[id].erase_stalls;
 }
 
-uint16_t bytes_to_byte_aligned(uint16_t num_bytes)
+flash_status_t flash_ctx_index_next_page(flash_ctx_t *ctx, uint8_t id)
 {
-  return words_to_bytes(bytes_to_words(num_bytes));
-}
+  if (!index_exists(ctx, id))
+  {
+    return FLASH_ERROR;
+  }
 
-// PUBLIC FUNCTION DEFINITIONS
+  flash_index_t *index = &ctx->indices[id];
 
-void flash_init(flash_write_ptr write_fn, flash_read_ptr read_fn, erase_ptr erase_fn, uint8_t word_size, uint16_t page_size, uint8_t number_of_pages, uint8_t start_page, uint32_t base_address, flash_endianess_t endianess)
-{
-  write = write_fn;
-  read = read_fn;
-  erase = erase_fn;
-  user_flash.word_size = word_size;
-  user_flash.page_size = page_size;
-  user_flash.start_page = start_page;
-  user_flash.number_of_pages = number_of_pages;
-  user_flash.end_page = start_page + number_of_pages - 1;
-  user_flash.endianess = endianess;
-  user_flash.base_address = base_address;
-  index_count = 0;
-  memset(indices, 0, sizeof(indices));
+  // Anything still buffered has to go out first so it stays before the gap.
+  if (index_buffer_flush(ctx, id, false) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (index->head % ctx->user_flash.page_size == 0)
+  {
+    return FLASH_OK;
+  }
+
+  index->head += bytes_to_page_end(ctx, index->head);
+  if (index->head >= index->max_data_address)
+  {
+    index->head = index->min_data_address;
+  }
+
+  return index_checkpoint(ctx, index, false);
 }
 
-flash_status_t flash_write(uint32_t user_address, uint8_t *data, uint16_t data_length)
+flash_status_t flash_ctx_index_set_checkpoint(flash_ctx_t *ctx, uint8_t id, flash_checkpoint_policy_t policy, uint32_t every)
 {
-  if (user_address >= ((user_flash.start_page + user_flash.number_of_pages) * user_flash.page_size))
+  if (!index_exists(ctx, id))
   {
     return FLASH_ERROR;
   }
 
-  if (user_flash.word_size == 0)
+  if (policy > FLASH_CHECKPOINT_MANUAL)
   {
     return FLASH_ERROR;
   }
 
-  // Not a word aligned address.
-  if (user_address % user_flash.word_size != 0)
+  // The counting policies need something to count to.
+  if ((policy == FLASH_CHECKPOINT_RECORDS || policy == FLASH_CHECKPOINT_BYTES) && every == 0)
   {
     return FLASH_ERROR;
   }
 
-  if (data_length == 0)
+  flash_index_t *index = &ctx->indices[id];
+
+  index->checkpoint_policy = policy;
+  index->checkpoint_every = every;
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_ctx_index_set_checkpoint_crc(flash_ctx_t *ctx, uint8_t id, bool enable)
+{
+  if (!index_exists(ctx, id))
   {
     return FLASH_ERROR;
   }
 
-  if (data_length > FLASH_MAX_WRITE_SIZE)
+  flash_index_t *index = &ctx->indices[id];
+
+  index->checkpoint_crc = enable;
+  index->index_data_size = sizeof(index->head) + sizeof(index->tail) + (enable ? sizeof(uint32_t) : 0);
+
+  // Where the next index data goes depends on its size.
+  index->index_write_address_known = false;
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_ctx_set_erased_map(flash_ctx_t *ctx, uint8_t *map, uint32_t map_size)
+{
+  if (map == NULL)
   {
-    return FLASH_ERROR;
+    ctx->erased_map = NULL;
+    return FLASH_OK;
   }
 
-  if (write == 0 || data == NULL)
+  if (!initialized(ctx) || ctx->user_flash.word_size == 0 || map_size < FLASH_ERASED_MAP_SIZE(ctx->user_flash.number_of_pages, ctx->user_flash.page_size, ctx->user_flash.word_size))
   {
     return FLASH_ERROR;
   }
 
-  memset(padding_buffer, 0xFF, FLASH_MAX_WRITE_SIZE); // Reset padding
-  memcpy(padding_buffer, data, data_length);          // Copy data into padding
-  uint16_t words_in_data = data_length / user_flash.word_size;
-  uint8_t remainder = data_length % user_flash.word_size;
+  // Nothing is known until pages are erased through the driver.
+  memset(map, 0, map_size);
+  memset(ctx->erased_map_pages, 0, sizeof(ctx->erased_map_pages));
+  ctx->erased_map = map;
+
+  return FLASH_OK;
+}
 
-  if (remainder != 0)
+bool flash_ctx_is_erased(flash_ctx_t *ctx, uint32_t user_address, uint32_t length)
+{
+  if (ctx->user_flash.word_size == 0 || user_address % ctx->user_flash.word_size != 0)
   {
-    words_in_data += 1; // Add one as there's a partial word in the write data.
+    return false;
   }
 
-  return write(user_address + user_flash.base_address, padding_buffer, words_in_data);
+  return erased_map_all_erased(ctx, user_address, (length + ctx->user_flash.word_size - 1) / ctx->user_flash.word_size);
 }
 
-flash_status_t flash_read(uint32_t user_read_address, uint8_t *data, uint16_t length)
+
+flash_status_t flash_ctx_set_read_cache(flash_ctx_t *ctx, flash_cache_slot_t *slots, uint8_t slot_count, uint8_t *arena, uint32_t arena_size)
 {
-  if (user_read_address >= (user_flash.start_page + user_flash.number_of_pages) * user_flash.page_size)
+  if (slots == NULL || slot_count == 0)
   {
-    return FLASH_ERROR;
+    ctx->cache_slots = NULL;
+    ctx->cache_slot_count = 0;
+    return FLASH_OK;
   }
 
-  if (read == 0 || data == NULL)
+  if (!initialized(ctx) || arena == NULL || arena_size < (uint32_t)slot_count * ctx->user_flash.page_size)
   {
     return FLASH_ERROR;
   }
-  else
+
+  // Each slot gets a page of the arena.
+  for (uint8_t idx = 0; idx < slot_count; idx++)
   {
-    return read(user_read_address + user_flash.base_address, data, length);
+    slots[idx].data = &arena[idx * ctx->user_flash.page_size];
+    slots[idx].page = 0;
+    slots[idx].last_used = 0;
+    slots[idx].valid = false;
   }
+
+  ctx->cache_slots = slots;
+  ctx->cache_slot_count = slot_count;
+  ctx->cache_clock = 0;
+  ctx->cache_hits = 0;
+  ctx->cache_misses = 0;
+
+  return FLASH_OK;
 }
 
-flash_status_t flash_erase_pages(uint8_t page_number, uint8_t number_of_pages)
+void flash_ctx_get_read_cache_counts(flash_ctx_t *ctx, uint32_t *hits, uint32_t *misses)
+{
+  *hits = ctx->cache_hits;
+  *misses = ctx->cache_misses;
+}
+
+
+flash_status_t flash_ctx_index_set_read_ahead(flash_ctx_t *ctx, uint8_t id, uint8_t *buffer, uint16_t buffer_size)
 {
-  if (page_number < user_flash.start_page || page_number + number_of_pages >= user_flash.end_page)
+  if (!index_exists(ctx, id))
   {
     return FLASH_ERROR;
   }
 
-  if (erase == 0)
+  flash_index_t *index = &ctx->indices[id];
+
+  if (buffer != NULL && buffer_size == 0)
   {
     return FLASH_ERROR;
   }
-  else
-  {
-    return erase(page_number, number_of_pages);
-  }
+
+  index->read_buffer = buffer;
+  index->read_buffer_size = (buffer != NULL) ? buffer_size : 0;
+  index->read_buffer_length = 0;
+
+  return FLASH_OK;
 }
 
-int flash_index_register(uint8_t start_page, uint8_t end_page)
+
+flash_status_t flash_ctx_set_wear_leveling(flash_ctx_t *ctx, uint8_t spare_start_page, uint8_t spare_pages, uint32_t threshold, uint32_t *table, uint32_t table_size)
 {
-  if (!initialized())
+  if (table == NULL)
   {
-    // printf("Use flash not initialized\n");
-    return -1;
+    ctx->wear.table = NULL;
+    return FLASH_OK;
   }
 
-  // Minimum number of pages is 2 as you need 1 for the index. Index is alwasy page_start.
-  if ((end_page - start_page) < 1)
+  if (!initialized(ctx) || ctx->user_flash.word_size == 0 || ctx->write == 0 || ctx->read == 0 || ctx->erase == 0)
   {
-    // printf("Not enough pages\n");
-    return -1;
+    return FLASH_ERROR;
   }
 
-  // End page must be greater than start page
-  if (start_page > end_page)
+  if (spare_pages < 3 || threshold == 0 || table_size < FLASH_WEAR_TABLE_SIZE(ctx->user_flash.number_of_pages, spare_pages))
   {
-    // printf("Start page is > end page\n");
-    return -1;
+    return FLASH_ERROR;
   }
 
-  // Page numbers cannot exceed total available pages numbers
-  if (start_page < user_flash.start_page || end_page >= user_flash.start_page + user_flash.number_of_pages)
+  // The spare pages have to be outside the user area.
+  uint32_t spare_end = (uint32_t)spare_start_page + spare_pages;
+  if (spare_end > UINT8_MAX + 1 || (spare_start_page <= ctx->user_flash.end_page && spare_end > ctx->user_flash.start_page))
   {
-    // printf("Start or end page outside limit\n");
-    return -1;
+    return FLASH_ERROR;
   }
 
-  if (index_count > 0)
+  memset(&ctx->wear, 0, sizeof(ctx->wear));
+  ctx->wear.spare_start_page = spare_start_page;
+  ctx->wear.spare_pages = spare_pages;
+  ctx->wear.threshold = threshold;
+
+  uint32_t number_of_pages = ctx->user_flash.number_of_pages;
+
+  if (wear_entry_size(ctx, wear_table_values(ctx)) > ctx->user_flash.page_size)
   {
-    // printf("Checking index count\n");
-    // Check all of the existing indices for overlap
-    for (uint8_t idx = 0; idx < index_count; idx++)
+    return FLASH_ERROR;
+  }
+
+  ctx->wear.table = table;
+
+  flash_status_t status = wear_load(ctx);
+  if (status != FLASH_DATA_NOT_FOUND)
+  {
+    if (status != FLASH_OK)
     {
-      if ((start_page >= indices[idx].start_page && start_page <= indices[idx].end_page) || (end_page >= indices[idx].start_page && end_page <= indices[idx].end_page))
-      {
-        // printf("Overlap with existing index\n");
-        return -1;
-      }
+      ctx->wear.table = NULL;
     }
+
+    return status;
   }
 
-  flash_index_t new_index = {
-      .index_page = start_page,
-      .start_page = start_page + 1,
-      .end_page = end_page,
-      .head = (start_page + 1) * user_flash.page_size,
-      .tail = (start_page + 1) * user_flash.page_size,
-      .min_data_address = (start_page + 1) * user_flash.page_size,
-      .max_data_address = (end_page + 1) * user_flash.page_size,
-      .min_index_address = start_page * user_flash.page_size,
-      .max_index_address = (start_page + 1) * user_flash.page_size};
+  // Nothing saved yet so every page is where it was registered and nothing has been erased.
+  memset(table, 0, wear_slot_count(ctx) * sizeof(uint32_t));
+  for (uint32_t logical = 0; logical < number_of_pages; logical++)
+  {
+    table[wear_slot_count(ctx) + logical] = logical;
+  }
+  wear_rebuild_spares(ctx);
 
-  new_index.index_data_size = sizeof(new_index.head) + sizeof(new_index.tail);
+  // Make the first save erase the first table page.
+  ctx->wear.meta = 1;
+  ctx->wear.meta_offset = ctx->user_flash.page_size;
 
-  indices[index_count] = new_index;
+  return FLASH_OK;
+}
 
-  uint8_t id = index_count;
-  index_count++;
-  return id;
+flash_status_t flash_ctx_save_wear(flash_ctx_t *ctx)
+{
+  if (ctx->wear.table == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  return wear_save(ctx, WEAR_WHOLE_TABLE, 0);
 }
-// TODO: Add printf back to this to see the write address 
-flash_status_t flash_index_write(uint8_t id, uint8_t *data, uint16_t data_length)
+
+flash_status_t flash_ctx_get_erase_count(flash_ctx_t *ctx, uint8_t page, uint32_t *count)
 {
-  // Check if the index exists
-  if (!index_exists(id))
+  if (ctx->wear.table == NULL || count == NULL)
   {
     return FLASH_ERROR;
   }
 
-  flash_index_t *index = &indices[id];
+  for (uint32_t slot = 0; slot < wear_slot_count(ctx); slot++)
+  {
+    if (wear_page(ctx, slot) == page)
+    {
+      *count = ctx->wear.table[slot];
+      return FLASH_OK;
+    }
+  }
 
-  // printf("\nWrite address (head) is %d", index->head);
+  return FLASH_ERROR;
+}
 
-  // uint16_t words_before_wrap = (index->max_data_address - index->head) / user_flash.word_size; // The number of words that can be written before reaching the end of the flash space for this index.
-  // uint16_t bytes_before_wrap = words_before_wrap * user_flash.word_size;                       // The number of bytes that can be written before reaching the end of flash space. Integral multiple of words before wrap.
+flash_status_t flash_ctx_get_wear_stats(flash_ctx_t *ctx, uint32_t endurance, flash_wear_stats_t *stats)
+{
+  if (ctx->wear.table == NULL || stats == NULL)
+  {
+    return FLASH_ERROR;
+  }
 
-  uint16_t words_before_wrap = bytes_to_words(index->max_data_address - index->head); // The number of words that can be written before reaching the end of the flash space for this index.
-  uint16_t bytes_before_wrap = words_to_bytes(words_before_wrap);                       // The number of bytes that can be written before reaching the end of flash space. Integral multiple of words before wrap.
+  memset(stats, 0, sizeof(*stats));
+  stats->pages = wear_slot_count(ctx);
+  stats->min_erases = UINT32_MAX;
+  stats->remaps = ctx->wear.remaps;
+  stats->migrations = ctx->wear.migrations;
 
-  // If there are more bytes to write than left before the end of flash then wrap
-  // printf("\nData length %d > bytes_to_wrap %d  ?", data_length, bytes_before_wrap);
-  if (data_length >= bytes_before_wrap)
+  for (uint32_t slot = 0; slot < stats->pages; slot++)
   {
-    // printf("\n Wrap Section");
-    // If there's only one page then don't break up the data just write to the start of the page.
-    if ((index->end_page - index->start_page) == 0)
-    {
-      if (data_length > user_flash.page_size)
-      {
-        data = &data[data_length - data_length % user_flash.word_size];
-        data_length %= user_flash.word_size;
-      }
+    uint32_t count = ctx->wear.table[slot];
 
-      // Have to erase the wrap page to write to it again.
-      if (flash_erase_pages(index->start_page, 1) != FLASH_OK)
-      {
-        // printf("\nFailed to erase page.");
-        return FLASH_ERROR;
-      }
-      
-      // printf("\nErased 1 page data.");
+    stats->total_erases += count;
+    stats->min_erases = (count < stats->min_erases) ? count : stats->min_erases;
+    stats->max_erases = (count > stats->max_erases) ? count : stats->max_erases;
+  }
 
-      // Return head to start of page.
-      index->head = index->start_page * user_flash.page_size;
+  stats->mean_erases = stats->total_erases / stats->pages;
 
-      if (flash_write(index->head, data, data_length) == FLASH_OK)
-      {
-        uint16_t bytes_written = (data_length % user_flash.word_size == 0) ? data_length : data_length + (user_flash.word_size - data_length % user_flash.word_size);
-        index->head += bytes_written;           // Increment the head by bytes written
-        index->head %= index->max_data_address; // Wrap the head by the max address value. Must add start_page address or head will go all the way back to 0.
-        if (index->head < index->min_data_address)
-        {
-          index->head += index->min_data_address;
-        }
-      }
-      else
-      {
-        // printf("\nFailed to write page.");
-        return FLASH_ERROR;
-      }
-    }
-    else
-    {
+  // If the wear keeps being spread the way it has been the most worn page keeps the same share of the erases.
+  uint64_t remaining = 0;
+  if (stats->max_erases == 0)
+  {
+    remaining = (uint64_t)stats->pages * endurance;
+  }
+  else if (stats->max_erases < endurance)
+  {
+    remaining = (uint64_t)stats->total_erases * (endurance - stats->max_erases) / stats->max_erases;
+  }
 
-      // Write as many bytes as you can before the wrap from the start of the data array.
-      if (flash_write(index->head, data, bytes_before_wrap) != FLASH_OK)
-      {
-        // printf("\nFailed to write.");
-        return FLASH_ERROR;
-      }
-      index->head += bytes_before_wrap;                        // Increment the head by bytes written. This will necessarily be word aligned quantity.
-      index->head %= index->max_data_address;                  // Wrap the head by the max address value. Must add start_page address or head will go all the way back to 0.
-      index->head += index->start_page * user_flash.page_size; // Have to add the start page address or it will go back to 0.
+  stats->remaining_erases = (remaining > UINT32_MAX) ? UINT32_MAX : (uint32_t)remaining;
+
+  return FLASH_OK;
+}
+
+#ifdef FLASH_ENABLE_STATS
+void flash_ctx_set_stats_clock(flash_ctx_t *ctx, flash_tick_ptr clock_fn)
+{
+  ctx->stats_clock = clock_fn;
+}
+
+void flash_ctx_stats_get(flash_ctx_t *ctx, flash_stats_t *stats)
+{
+  if (stats != NULL)
+  {
+    *stats = ctx->stats;
+  }
+}
+
+flash_status_t flash_ctx_index_stats_get(flash_ctx_t *ctx, uint8_t id, flash_index_stats_t *stats)
+{
+  if (!index_exists(ctx, id) || stats == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  *stats = ctx->indices[id].stats;
+
+  return FLASH_OK;
+}
+
+void flash_ctx_stats_reset(flash_ctx_t *ctx)
+{
+  memset(&ctx->stats, 0, sizeof(ctx->stats));
+
+  for (uint8_t id = 0; id < ctx->index_count; id++)
+  {
+    memset(&ctx->indices[id].stats, 0, sizeof(ctx->indices[id].stats));
+  }
+}
+#endif
+
+#ifdef FLASH_ENABLE_TRACE
+flash_status_t flash_ctx_set_trace(flash_ctx_t *ctx, flash_trace_event_t *events, uint32_t event_count, flash_tick_ptr clock_fn)
+{
+  if (events != NULL && (event_count == 0 || (event_count & (event_count - 1)) != 0))
+  {
+    return FLASH_ERROR;
+  }
+
+  ctx->trace.events = events;
+  ctx->trace.mask = (events != NULL) ? event_count - 1 : 0;
+  ctx->trace.count = 0;
+  ctx->trace.clock = clock_fn;
+
+  return FLASH_OK;
+}
 
-      // Have to erase the wrap page to write to it again.
-      if (flash_erase_pages(index->start_page, 1) != FLASH_OK)
-      {
-        // printf("\nFailed to erase page.");
-        return FLASH_ERROR;
-      }
+uint32_t flash_ctx_trace_copy(flash_ctx_t *ctx, flash_trace_event_t *events, uint32_t size, uint32_t *lost)
+{
+  flash_trace_t *trace = &ctx->trace;
+  uint32_t copied = 0;
 
-      // Write the remaining bytes to the new head position
-      uint16_t bytes_after_wrap = data_length - bytes_before_wrap; // Must be word aligned increment.
-      if (flash_write(index->head, &data[bytes_before_wrap], bytes_after_wrap) != FLASH_OK)
-      {
-        // printf("\nFailed to write.");
-        return FLASH_ERROR;
-      }
-      // Integral number of words? yes - bytes_after_wrap else bytes_after_wrap + byte to form whole word.
-      uint16_t bytes_written = (bytes_after_wrap % user_flash.word_size == 0) ? bytes_after_wrap : bytes_after_wrap + (user_flash.word_size - bytes_after_wrap % user_flash.word_size);
-      index->head += bytes_written;
-      index->head %= index->max_data_address; // Wrap the head by the max address value. Must add start_page address or head will go all the way back to 0.
-      if (index->head < index->min_data_address)
-      {
-        index->head += index->min_data_address;
-      }
-    }
-  }
-  // If there aren't more bytes to be written then room remaining just write out all of the bytes
-  else
+  if (trace->events != NULL && events != NULL)
   {
-    if (flash_write(index->head, data, data_length) == FLASH_OK)
-    {
-      uint16_t bytes_written = (data_length % user_flash.word_size == 0) ? data_length : data_length + (user_flash.word_size - data_length % user_flash.word_size);
-      index->head += bytes_written;           // Increment the head by bytes written
-      index->head %= index->max_data_address; // Wrap the head by the max address value. Must add start_page address or head will go all the way back to 0.
-      if (index->head < index->min_data_address)
-      {
-        index->head += index->min_data_address;
-      }
-    }
-    else
+    // Once the ring has gone round all of it holds events.
+    uint32_t held = (trace->count > trace->mask) ? trace->mask + 1 : trace->count;
+    copied = (held < size) ? held : size;
+
+    for (uint32_t idx = 0; idx < copied; idx++)
     {
-      // printf("\nFailed to write. No wrap.");
-      return FLASH_ERROR;
+      events[idx] = trace->events[(trace->count - copied + idx) & trace->mask];
     }
   }
 
-  if (flash_index_write_index(id) != FLASH_OK)
+  if (lost != NULL)
   {
-    // printf("\nFailed to write index.");
-    return FLASH_ERROR;
+    *lost = trace->count - copied;
   }
 
-  return FLASH_OK;
+  return copied;
 }
+#endif
 
-flash_status_t flash_index_read(uint8_t id, uint8_t *data, uint16_t data_length)
+void flash_ctx_set_memory_map(flash_ctx_t *ctx, const uint8_t *mapped)
+{
+  ctx->mapped = mapped;
+}
+
+flash_status_t flash_ctx_read_view(flash_ctx_t *ctx, uint32_t user_address, uint32_t length, flash_view_t *view)
 {
-  if (!index_exists(id))
+  uint32_t flash_end = (ctx->user_flash.start_page + ctx->user_flash.number_of_pages) * ctx->user_flash.page_size;
+
+  if (ctx->mapped == NULL || view == NULL)
   {
     return FLASH_ERROR;
   }
 
-  if (flash_read(indices[id].tail + user_flash.base_address, data, data_length) == FLASH_OK)
+  if (user_address >= flash_end || length > flash_end - user_address)
   {
-    // Update tail
-    indices[id].tail += data_length;
-    return FLASH_OK;
+    return FLASH_ERROR;
   }
-  else
+
+  if (!mapped_span(ctx, user_address, length, &view->data))
   {
     return FLASH_ERROR;
   }
+
+  view->length = length;
+
+  return FLASH_OK;
 }
 
-uint32_t flash_index_get_head(uint8_t id)
+flash_status_t flash_ctx_index_view_rel_head(flash_ctx_t *ctx, uint8_t id, int position, uint32_t length, flash_view_t views[2])
 {
-  if (!index_exists(id))
+  if (!index_exists(ctx, id))
   {
-    return -1;
+    return FLASH_ERROR;
   }
 
-  return indices[id].head;
-}
+  if (ctx->mapped == NULL || views == NULL)
+  {
+    return FLASH_ERROR;
+  }
 
-flash_status_t flash_index_read_rel_head(uint8_t id, int position, uint8_t *data, uint16_t data_length)
-{
-  if (!index_exists(id))
+  flash_index_t *index = &ctx->indices[id];
+  uint32_t data_space = index->max_data_address - index->min_data_address;
+
+  // Can't view ahead of the head or more than the whole data space.
+  if (position > 0 || (uint32_t)(-(int64_t)position) > data_space || length > data_space)
   {
     return FLASH_ERROR;
   }
 
-  // Can't read ahead of head
-  if (position > 0)
+  // Data still in the write buffer isn't in the flash yet.
+  if ((int64_t)position + length > -(int64_t)index->write_buffer_length)
   {
     return FLASH_ERROR;
   }
 
-  flash_index_t *index = &indices[id];
-  uint32_t read_address = index->head + position;
+  uint32_t view_address = index_logical_head(index) + position;
 
   // Check if we reverse wrap
-  if (read_address < index->min_data_address)
+  if (view_address < index->min_data_address)
   {
-    read_address = index->max_data_address - (index->min_data_address - read_address);
+    view_address = index->max_data_address - (index->min_data_address - view_address);
   }
 
-  // Check for forward read wrap
-  if ((read_address + data_length) > index->max_data_address)
-  {
-    // Determine how many bytes can be read
-    uint16_t bytes_before_wrap = index->max_data_address - read_address;
-
-    // Read the bytes
-    if (flash_read(read_address, data, bytes_before_wrap) != FLASH_OK)
-    {
-      return FLASH_ERROR;
-    }
+  uint32_t bytes_before_wrap = index->max_data_address - view_address;
 
-    read_address += bytes_before_wrap;
-    read_address %= index->max_data_address;
-    read_address += index->min_data_address;
+  views[0].length = (length < bytes_before_wrap) ? length : bytes_before_wrap;
+  views[1].length = length - views[0].length;
 
-    // Read the bytes
-    if (flash_read(read_address, &data[bytes_before_wrap], data_length - bytes_before_wrap) != FLASH_OK)
-    {
-      return FLASH_ERROR;
-    }
-  }
-  else
+  if (!mapped_span(ctx, view_address, views[0].length, &views[0].data) || !mapped_span(ctx, index->min_data_address, views[1].length, &views[1].data))
   {
-    if (flash_read(read_address, data, data_length) != FLASH_OK)
-    {
-      return FLASH_ERROR;
-    }
+    return FLASH_ERROR;
   }
 
   return FLASH_OK;
 }
 
-flash_status_t flash_index_erase_all_data(uint8_t id)
+// DEFAULT CONTEXT FUNCTION DEFINITIONS
+
+flash_ctx_t *flash_default_ctx(void)
 {
+  return &default_ctx;
+}
 
-  if (!index_exists(id))
-  {
-    return FLASH_ERROR;
-  }
+void flash_init(flash_write_ptr write_fn, flash_read_ptr read_fn, erase_ptr erase_fn, uint8_t word_size, uint16_t page_size, uint8_t number_of_pages, uint8_t start_page, uint32_t base_address, flash_endianess_t endianess)
+{
+  flash_ctx_init(&default_ctx, write_fn, read_fn, erase_fn, word_size, page_size, number_of_pages, start_page, base_address, endianess);
+}
 
-  flash_index_t *index = &indices[id];
+void flash_set_tick_source(flash_tick_ptr tick_fn)
+{
+  flash_ctx_set_tick_source(&default_ctx, tick_fn);
+}
 
-  index->head = index->min_data_address;
+flash_status_t flash_poll(void)
+{
+  return flash_ctx_poll(&default_ctx);
+}
 
-  return flash_erase_pages(index->start_page, index->end_page - index->start_page + 1);
+flash_status_t flash_write(uint32_t user_address, uint8_t *data, uint16_t write_length)
+{
+  return flash_ctx_write(&default_ctx, user_address, data, write_length);
 }
 
-flash_status_t flash_index_erase_index(uint8_t id)
+flash_status_t flash_writev(uint32_t user_address, const flash_iovec_t *iov, uint8_t iov_count)
 {
+  return flash_ctx_writev(&default_ctx, user_address, iov, iov_count);
+}
 
-  if (!index_exists(id))
-  {
-    return FLASH_ERROR;
-  }
+flash_status_t flash_read(uint32_t user_read_address, uint8_t *data, uint16_t length)
+{
+  return flash_ctx_read(&default_ctx, user_read_address, data, length);
+}
 
-  flash_index_t *index = &indices[id];
+flash_status_t flash_write_bulk(uint32_t user_address, uint8_t *data, uint32_t data_length)
+{
+  return flash_ctx_write_bulk(&default_ctx, user_address, data, data_length);
+}
 
-  index->head = index->min_data_address;
+flash_status_t flash_read_bulk(uint32_t user_read_address, uint8_t *data, uint32_t length)
+{
+  return flash_ctx_read_bulk(&default_ctx, user_read_address, data, length);
+}
 
-  return flash_erase_pages(index->index_page, 1);
+flash_status_t flash_erase_pages(uint8_t page_number, uint8_t number_of_pages)
+{
+  return flash_ctx_erase_pages(&default_ctx, page_number, number_of_pages);
 }
 
-flash_status_t flash_index_write_index(uint8_t id)
+int flash_index_register(uint8_t start_page, uint8_t end_page)
 {
-  // Check if the index exists
-  if (!index_exists(id))
-  {
-    return FLASH_ERROR;
-  }
+  return flash_ctx_index_register(&default_ctx, start_page, end_page);
+}
 
-  // Search for the next spot to write to in the index page.
-  uint32_t read_address = 0;
-  uint32_t write_address = 0;
-  flash_status_t status = flash_index_get_index_address(id, &read_address);
-  // printf("\nRead address %d", read_address);
+flash_status_t flash_index_write(uint8_t id, uint8_t *data, uint16_t byte_count)
+{
+  return flash_ctx_index_write(&default_ctx, id, data, byte_count);
+}
 
-  flash_index_t *index = &indices[id];
-  uint8_t index_data_size = sizeof(index->head) * 2;
+flash_status_t flash_index_writev(uint8_t id, const flash_iovec_t *iov, uint8_t iov_count)
+{
+  return flash_ctx_index_writev(&default_ctx, id, iov, iov_count);
+}
 
-  if (status == FLASH_ERROR)
-  {
-    return FLASH_ERROR;
-  }
+flash_status_t flash_index_read(uint8_t id, uint8_t *data, uint16_t data_length)
+{
+  return flash_ctx_index_read(&default_ctx, id, data, data_length);
+}
 
-  if (status == FLASH_DATA_NOT_FOUND)
-  {
-    write_address = index->min_index_address;
-    // printf(" Write address %d", write_address);
-  }
-  else 
-  {
-    write_address = read_address + bytes_to_byte_aligned(index_data_size);
-    // printf(" Write address %d", write_address);
+flash_status_t flash_index_write_bulk(uint8_t id, uint8_t *data, uint32_t data_length)
+{
+  return flash_ctx_index_write_bulk(&default_ctx, id, data, data_length);
+}
 
-    if(write_address >= index->max_index_address)
-    {
-      if (flash_erase_pages(index->index_page, 1) != FLASH_OK)
-      {
-        return FLASH_ERROR;
-      }
+flash_status_t flash_index_read_bulk(uint8_t id, uint8_t *data, uint32_t data_length)
+{
+  return flash_ctx_index_read_bulk(&default_ctx, id, data, data_length);
+}
 
-      write_address = index->min_index_address;
-      // printf(" Write address %d", write_address);
-    }
-  }
+flash_status_t flash_index_set_write_buffer(uint8_t id, uint8_t *buffer, uint16_t buffer_size, uint16_t flush_threshold, uint32_t flush_age)
+{
+  return flash_ctx_index_set_write_buffer(&default_ctx, id, buffer, buffer_size, flush_threshold, flush_age);
+}
 
-  // Write the index data to flash
-  uint8_t write_data[sizeof(index->head) * 2];
-  memcpy(write_data, &(index->head), index_data_size / 2);
-  memcpy(&write_data[index_data_size / 2], &(index->tail), index_data_size / 2);
+flash_status_t flash_index_flush(uint8_t id)
+{
+  return flash_ctx_index_flush(&default_ctx, id);
+}
 
-  if (flash_write(write_address, write_data, index_data_size) != FLASH_OK)
-  {
-    return FLASH_ERROR;
-  }
-  else
-  {
-    return FLASH_OK;
-  }
+uint32_t flash_index_get_head(uint8_t id)
+{
+  return flash_ctx_index_get_head(&default_ctx, id);
+}
+
+flash_status_t flash_index_read_rel_head(uint8_t id, int position, uint8_t *data, uint16_t data_length)
+{
+  return flash_ctx_index_read_rel_head(&default_ctx, id, position, data, data_length);
+}
+
+flash_status_t flash_index_erase_all_data(uint8_t id)
+{
+  return flash_ctx_index_erase_all_data(&default_ctx, id);
+}
+
+flash_status_t flash_index_erase_index(uint8_t id)
+{
+  return flash_ctx_index_erase_index(&default_ctx, id);
+}
+
+flash_status_t flash_index_write_index(uint8_t id)
+{
+  return flash_ctx_index_write_index(&default_ctx, id);
 }
 
 flash_status_t flash_index_get_index_address(uint8_t id, uint32_t *address)
 {
-  if (!index_exists(id))
-  {
-    return FLASH_ERROR;
-  }
+  return flash_ctx_index_get_index_address(&default_ctx, id, address);
+}
 
-  if (user_flash.word_size == 0)
-  {
-    return FLASH_ERROR;
-  }
+flash_status_t flash_index_reset(uint8_t id)
+{
+  return flash_ctx_index_reset(&default_ctx, id);
+}
 
-  flash_index_t *index = &indices[id];
+flash_status_t flash_index_load(uint8_t id)
+{
+  return flash_ctx_index_load(&default_ctx, id);
+}
 
-  uint32_t read_address = index->min_index_address;
-  uint8_t index_data_size = sizeof(index->head) + sizeof(index->tail);
-  uint8_t index_data_bytes_aligned = bytes_to_words(index_data_size) * user_flash.word_size;
+flash_status_t flash_index_set_erase_ahead(uint8_t id, uint8_t pages)
+{
+  return flash_ctx_index_set_erase_ahead(&default_ctx, id, pages);
+}
 
-  // Search for an empty word in flash. This will indicate that the end of written data has been found.
-  uint8_t empty_word[user_flash.word_size];
-  memset(empty_word, FLASH_EMPTY_VALUE, user_flash.word_size);
+uint32_t flash_index_get_erase_stalls(uint8_t id)
+{
+  return flash_ctx_index_get_erase_stalls(&default_ctx, id);
+}
 
-  uint8_t index_page_data[user_flash.word_size];
-  memset(index_page_data, 0x00, user_flash.word_size);
+flash_status_t flash_index_next_page(uint8_t id)
+{
+  return flash_ctx_index_next_page(&default_ctx, id);
+}
 
-  while (read_address < index->max_index_address)
-  {
-    flash_read(read_address, index_page_data, user_flash.word_size);
+flash_status_t flash_index_set_checkpoint(uint8_t id, flash_checkpoint_policy_t policy, uint32_t every)
+{
+  return flash_ctx_index_set_checkpoint(&default_ctx, id, policy, every);
+}
 
-    // If empty word found
-    if (memcmp(empty_word, index_page_data, user_flash.word_size) == 0)
-    {
-      // If empty word at flash start
-      if (read_address == index->min_index_address)
-      {
-        return FLASH_DATA_NOT_FOUND;
-      }
-      else
-      {
-        // Address is the spot where empty word was found - the index data size
-        *address = read_address - index_data_bytes_aligned;
-        return FLASH_OK;
-      }
-    }
-    else
-    {
-      // Increment by word as index data writes will be word aligned.
-      read_address += user_flash.word_size;
-    }
-  }
+flash_status_t flash_index_set_checkpoint_crc(uint8_t id, bool enable)
+{
+  return flash_ctx_index_set_checkpoint_crc(&default_ctx, id, enable);
+}
 
-  // If we made it to here no empty word was found so the last data is located at the end of the page
-  *address = index->max_index_address - index_data_bytes_aligned;
-  return FLASH_OK;
+flash_status_t flash_set_erased_map(uint8_t *map, uint32_t map_size)
+{
+  return flash_ctx_set_erased_map(&default_ctx, map, map_size);
 }
 
-flash_status_t flash_index_reset(uint8_t id)
+bool flash_is_erased(uint32_t user_address, uint32_t length)
 {
-  if(!index_exists(id))
-  {
-    return FLASH_ERROR;
-  }
+  return flash_ctx_is_erased(&default_ctx, user_address, length);
+}
 
-  flash_index_t * index = &indices[id];
+flash_status_t flash_set_read_cache(flash_cache_slot_t *slots, uint8_t slot_count, uint8_t *arena, uint32_t arena_size)
+{
+  return flash_ctx_set_read_cache(&default_ctx, slots, slot_count, arena, arena_size);
+}
 
-  index->head = index->start_page*user_flash.page_size;
-  index->tail = index->head;
+void flash_get_read_cache_counts(uint32_t *hits, uint32_t *misses)
+{
+  flash_ctx_get_read_cache_counts(&default_ctx, hits, misses);
+}
 
-  return FLASH_OK;
+flash_status_t flash_index_set_read_ahead(uint8_t id, uint8_t *buffer, uint16_t buffer_size)
+{
+  return flash_ctx_index_set_read_ahead(&default_ctx, id, buffer, buffer_size);
 }
 
-flash_status_t flash_index_load(uint8_t id)
+void flash_set_memory_map(const uint8_t *mapped)
 {
-  if(!index_exists(id))
-  {
-    return FLASH_ERROR;
-  }
+  flash_ctx_set_memory_map(&default_ctx, mapped);
+}
 
-  flash_index_t * index = &(indices[id]);
-  uint32_t index_address = 0;
+flash_status_t flash_read_view(uint32_t user_address, uint32_t length, flash_view_t *view)
+{
+  return flash_ctx_read_view(&default_ctx, user_address, length, view);
+}
 
-  // Get the address of the flash index data
-  flash_status_t status = flash_index_get_index_address(id, &index_address);
-  if(status != FLASH_OK)
-  {
-    // Could be error or index data not found.
-    return status;
-  }
+flash_status_t flash_index_view_rel_head(uint8_t id, int position, uint32_t length, flash_view_t views[2])
+{
+  return flash_ctx_index_view_rel_head(&default_ctx, id, position, length, views);
+}
 
-  uint8_t data_size = index->index_data_size;
-  uint8_t read_data[data_size];
+flash_status_t flash_set_wear_leveling(uint8_t spare_start_page, uint8_t spare_pages, uint32_t threshold, uint32_t *table, uint32_t table_size)
+{
+  return flash_ctx_set_wear_leveling(&default_ctx, spare_start_page, spare_pages, threshold, table, table_size);
+}
 
-  if(flash_read(index_address, read_data, data_size) != FLASH_OK)  
-  {
-    return FLASH_ERROR;
-  }
+flash_status_t flash_save_wear(void)
+{
+  return flash_ctx_save_wear(&default_ctx);
+}
+
+flash_status_t flash_get_erase_count(uint8_t page, uint32_t *count)
+{
+  return flash_ctx_get_erase_count(&default_ctx, page, count);
+}
 
-  memcpy(&(index->head), &read_data[0], data_size/2);
-  memcpy(&(index->tail), &read_data[data_size/2], data_size/2);
+flash_status_t flash_get_wear_stats(uint32_t endurance, flash_wear_stats_t *stats)
+{
+  return flash_ctx_get_wear_stats(&default_ctx, endurance, stats);
+}
 
-  return FLASH_OK;
+#ifdef FLASH_ENABLE_STATS
+void flash_set_stats_clock(flash_tick_ptr clock_fn)
+{
+  flash_ctx_set_stats_clock(&default_ctx, clock_fn);
+}
+
+void flash_stats_get(flash_stats_t *stats)
+{
+  flash_ctx_stats_get(&default_ctx, stats);
+}
+
+flash_status_t flash_index_stats_get(uint8_t id, flash_index_stats_t *stats)
+{
+  return flash_ctx_index_stats_get(&default_ctx, id, stats);
+}
+
+void flash_stats_reset(void)
+{
+  flash_ctx_stats_reset(&default_ctx);
+}
+#endif
+
+#ifdef FLASH_ENABLE_TRACE
+flash_status_t flash_set_trace(flash_trace_event_t *events, uint32_t event_count, flash_tick_ptr clock_fn)
+{
+  return flash_ctx_set_trace(&default_ctx, events, event_count, clock_fn);
+}
+
+uint32_t flash_trace_copy(flash_trace_event_t *events, uint32_t size, uint32_t *lost)
+{
+  return flash_ctx_trace_copy(&default_ctx, events, size, lost);
 }
+#endif
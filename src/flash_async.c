@@ -0,0 +1,223 @@
+/**
+ *  flash_async.c
+ *
+ *  Bounded multiple producer, single consumer queue in front of the flash module. Each slot carries a
+ *  sequence number that says whose turn it is to use it so neither submitters nor the worker need a lock.
+ */
+
+#include "flash_async.h"
+#include <stddef.h>
+
+// PRIVATE DEFINES
+
+/* Atomic accesses to fields that are shared between submitters and the worker. */
+#define LOAD_ACQUIRE(pointer) __atomic_load_n(pointer, __ATOMIC_ACQUIRE)
+#define LOAD_RELAXED(pointer) __atomic_load_n(pointer, __ATOMIC_RELAXED)
+#define STORE_RELEASE(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_RELEASE)
+#define COMPARE_EXCHANGE(pointer, expected, desired) \
+  __atomic_compare_exchange_n(pointer, expected, desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define COMPARE_EXCHANGE_RELEASE(pointer, expected, desired) \
+  __atomic_compare_exchange_n(pointer, expected, desired, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+
+// PRIVATE FUNCTION DECLARATIONS
+
+/**
+ * @brief Carry out an operation with the flash module.
+ *
+ * @param op The operation.
+ * @return flash_status_t Result of the flash module function.
+ */
+static flash_status_t execute(flash_ctx_t *ctx, flash_async_op_t *op);
+
+/**
+ * @brief Take the oldest operation off the queue.
+ *
+ * @param queue The queue.
+ * @return flash_async_op_t* The operation or NULL if the queue is empty.
+ */
+static flash_async_op_t *dequeue(flash_async_t *queue);
+
+// PRIVATE FUNCTION DEFINITIONS
+
+static flash_status_t execute(flash_ctx_t *ctx, flash_async_op_t *op)
+{
+  // Index functions only take 16 bit lengths.
+  if (op->type >= FLASH_ASYNC_INDEX_WRITE && op->length > UINT16_MAX)
+  {
+    return FLASH_ERROR;
+  }
+
+  switch (op->type)
+  {
+  case FLASH_ASYNC_WRITE:
+    return flash_ctx_write_bulk(ctx, op->address, op->data, op->length);
+  case FLASH_ASYNC_READ:
+    return flash_ctx_read_bulk(ctx, op->address, op->data, op->length);
+  case FLASH_ASYNC_ERASE:
+    if (op->address > UINT8_MAX || op->length > UINT8_MAX)
+    {
+      return FLASH_ERROR;
+    }
+    return flash_ctx_erase_pages(ctx, op->address, op->length);
+  case FLASH_ASYNC_INDEX_WRITE:
+    return flash_ctx_index_write(ctx, op->id, op->data, op->length);
+  case FLASH_ASYNC_INDEX_READ:
+    return flash_ctx_index_read(ctx, op->id, op->data, op->length);
+  case FLASH_ASYNC_INDEX_READ_REL_HEAD:
+    return flash_ctx_index_read_rel_head(ctx, op->id, op->position, op->data, op->length);
+  case FLASH_ASYNC_INDEX_FLUSH:
+    return flash_ctx_index_flush(ctx, op->id);
+  default:
+    return FLASH_ERROR;
+  }
+}
+
+static flash_async_op_t *dequeue(flash_async_t *queue)
+{
+  // Only the worker takes operations so the dequeue position is never contended.
+  uint32_t position = queue->dequeue_position;
+  flash_async_slot_t *slot = &queue->slots[position & queue->mask];
+
+  // The slot is ready once its submitter has moved the sequence one past the position.
+  if (LOAD_ACQUIRE(&slot->sequence) != position + 1)
+  {
+    return NULL;
+  }
+
+  flash_async_op_t *op = slot->op;
+  queue->dequeue_position = position + 1;
+
+  // Hand the slot back to submitters for the next time round the ring.
+  STORE_RELEASE(&slot->sequence, position + queue->mask + 1);
+
+  return op;
+}
+
+// PUBLIC FUNCTION DEFINITIONS
+
+flash_status_t flash_async_init(flash_async_t *queue, flash_ctx_t *ctx, flash_async_slot_t *slots, uint32_t slot_count)
+{
+  if (queue == NULL || ctx == NULL || slots == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  // Must be a power of two so positions can be masked into slots.
+  if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0)
+  {
+    return FLASH_ERROR;
+  }
+
+  for (uint32_t idx = 0; idx < slot_count; idx++)
+  {
+    slots[idx].op = NULL;
+    slots[idx].sequence = idx;
+  }
+
+  queue->ctx = ctx;
+  queue->slots = slots;
+  queue->mask = slot_count - 1;
+  queue->enqueue_position = 0;
+  queue->dequeue_position = 0;
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_async_submit(flash_async_t *queue, flash_async_op_t *op)
+{
+  if (queue == NULL || queue->slots == NULL || op == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  op->state = FLASH_ASYNC_PENDING;
+
+  uint32_t position = LOAD_RELAXED(&queue->enqueue_position);
+
+  while (true)
+  {
+    flash_async_slot_t *slot = &queue->slots[position & queue->mask];
+    uint32_t sequence = LOAD_ACQUIRE(&slot->sequence);
+    int32_t difference = (int32_t)(sequence - position);
+
+    if (difference == 0)
+    {
+      // Slot is free for this position, claim the position. On failure position is reloaded and we try again.
+      if (COMPARE_EXCHANGE(&queue->enqueue_position, &position, position + 1))
+      {
+        slot->op = op;
+        STORE_RELEASE(&slot->sequence, position + 1);
+        return FLASH_OK;
+      }
+    }
+    else if (difference < 0)
+    {
+      // The worker hasn't taken the operation from a full ring ago yet.
+      op->state = FLASH_ASYNC_IDLE;
+      return FLASH_ERROR;
+    }
+    else
+    {
+      // Another submitter got this position first.
+      position = LOAD_RELAXED(&queue->enqueue_position);
+    }
+  }
+}
+
+bool flash_async_is_complete(flash_async_op_t *op)
+{
+  return LOAD_ACQUIRE(&op->state) == FLASH_ASYNC_COMPLETE;
+}
+
+uint32_t flash_async_process(flash_async_t *queue, uint32_t max_ops)
+{
+  uint32_t processed = 0;
+
+  while (max_ops == 0 || processed < max_ops)
+  {
+    flash_async_op_t *op = dequeue(queue);
+
+    if (op == NULL)
+    {
+      break;
+    }
+
+    op->status = execute(queue->ctx, op);
+
+    if (op->done == NULL)
+    {
+      STORE_RELEASE(&op->state, FLASH_ASYNC_COMPLETE);
+    }
+    else
+    {
+      // Call done before the operation is marked complete so a polling submitter can't reuse it underneath done.
+      // If done submits it again it is pending again and must not be marked complete.
+      uint8_t in_done = FLASH_ASYNC_IN_DONE;
+      op->state = FLASH_ASYNC_IN_DONE;
+      op->done(op);
+      COMPARE_EXCHANGE_RELEASE(&op->state, &in_done, FLASH_ASYNC_COMPLETE);
+    }
+
+    processed++;
+  }
+
+  return processed;
+}
+
+void flash_async_worker(flash_async_t *queue, flash_async_idle_ptr idle)
+{
+  while (true)
+  {
+    if (flash_async_process(queue, 0) > 0)
+    {
+      continue;
+    }
+
+    flash_ctx_poll(queue->ctx);
+
+    if (idle == NULL || !idle(queue))
+    {
+      return;
+    }
+  }
+}
@@ -0,0 +1,687 @@
+/**
+ *  flash_kv.c
+ *
+ *  Key value store kept as records on an index with a hash table in RAM of where the latest record of each key is.
+ */
+
+#include "flash_kv.h"
+#include <stddef.h>
+#include <string.h>
+
+// PRIVATE FUNCTION DECLARATIONS
+
+/**
+ * @brief FNV-1a hash of a key.
+ */
+static uint32_t kv_hash(const uint8_t *key, uint8_t key_length);
+
+/**
+ * @brief Find the slot holding a key.
+ *
+ * @param kv The store.
+ * @param key The key.
+ * @param key_length The number of bytes of key.
+ * @param hash The hash of the key.
+ * @param slot Set to the slot holding the key if it is found, otherwise the empty slot it would go in.
+ * @param value_length If not NULL set to the length of the key's value if it is found.
+ * @return flash_status_t FLASH_DATA_NOT_FOUND if the key isn't in the table.
+ */
+static flash_status_t kv_find(flash_kv_t *kv, const uint8_t *key, uint8_t key_length, uint32_t hash, uint16_t *slot, uint16_t *value_length);
+
+/**
+ * @brief Empty a slot and move later slots of the same probe run back so they can still be found.
+ */
+static void kv_remove(flash_kv_t *kv, uint16_t slot);
+
+/**
+ * @brief Point a key at a record, adding it to the table if it isn't there.
+ *
+ * @return flash_status_t FLASH_ERROR if the table is full.
+ */
+static flash_status_t kv_put(flash_kv_t *kv, const uint8_t *key, uint8_t key_length, uint32_t address);
+
+/**
+ * @brief Whether a record of some length can be written to a log without starting on the page the oldest records are
+ * on.
+ */
+static bool kv_has_room(flash_record_log_t *log, uint16_t length);
+
+/**
+ * @brief The number of whole pages of a log that are free to write to.
+ */
+static uint32_t kv_free_pages(flash_record_log_t *log);
+
+/**
+ * @brief Whether the page the tail of a log is on is finished with, so it can be collected.
+ */
+static bool kv_collectable(flash_record_log_t *log);
+
+/**
+ * @brief Rebuild the hash table from the records of a log, oldest first.
+ */
+static flash_status_t kv_mount_log(flash_kv_t *kv, flash_record_log_t *log, uint8_t *buffer, uint16_t buffer_size);
+
+/**
+ * @brief Choose the page to collect next.
+ *
+ * @return flash_status_t FLASH_DATA_NOT_FOUND if nothing needs collecting.
+ */
+static flash_status_t kv_gc_start(flash_kv_t *kv);
+
+/**
+ * @brief Look at the next record on the page being collected and copy it to the cold log if it is live.
+ *
+ * @param bytes Added to with the number of bytes read and programmed.
+ * @return flash_status_t
+ */
+static flash_status_t kv_gc_record(flash_kv_t *kv, uint32_t *bytes);
+
+/**
+ * @brief Erase the page that has been collected and move the tail of its log past it.
+ */
+static flash_status_t kv_gc_finish(flash_kv_t *kv);
+
+/**
+ * @brief Append a record for a key.
+ */
+static flash_status_t kv_append(flash_kv_t *kv, flash_kv_type_t type, const uint8_t *key, uint8_t key_length, const uint8_t *value, uint16_t value_length);
+
+// PRIVATE FUNCTION DEFINITIONS
+
+static uint32_t kv_hash(const uint8_t *key, uint8_t key_length)
+{
+  uint32_t hash = 2166136261u;
+
+  for (uint8_t idx = 0; idx < key_length; idx++)
+  {
+    hash ^= key[idx];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+static flash_status_t kv_find(flash_kv_t *kv, const uint8_t *key, uint8_t key_length, uint32_t hash, uint16_t *slot, uint16_t *value_length)
+{
+  uint16_t position = hash % kv->slot_count;
+
+  // There is always at least one empty slot so this ends.
+  while (kv->slots[position].address != FLASH_KV_EMPTY_SLOT)
+  {
+    if (kv->slots[position].hash == hash)
+    {
+      // Same hash, check the key in flash really is the same. The record header comes with it for the length.
+      uint8_t stored[FLASH_RECORD_HEADER_SIZE + FLASH_KV_OVERHEAD + FLASH_KV_MAX_KEY];
+      uint16_t stored_length = FLASH_RECORD_HEADER_SIZE + FLASH_KV_OVERHEAD + key_length;
+
+      if (flash_ctx_read(kv->log.ctx, kv->slots[position].address, stored, stored_length) != FLASH_OK)
+      {
+        return FLASH_ERROR;
+      }
+
+      const uint8_t *data = &stored[FLASH_RECORD_HEADER_SIZE];
+      if (data[1] == key_length && memcmp(&data[FLASH_KV_OVERHEAD], key, key_length) == 0)
+      {
+        // The length of the record's data is the first thing in its header, little endian.
+        if (value_length != NULL)
+        {
+          *value_length = (stored[0] | (stored[1] << 8)) - FLASH_KV_OVERHEAD - key_length;
+        }
+
+        *slot = position;
+        return FLASH_OK;
+      }
+    }
+
+    position = (position + 1) % kv->slot_count;
+  }
+
+  *slot = position;
+  return FLASH_DATA_NOT_FOUND;
+}
+
+static void kv_remove(flash_kv_t *kv, uint16_t slot)
+{
+  kv->slots[slot].address = FLASH_KV_EMPTY_SLOT;
+  kv->key_count--;
+
+  // Anything after the gap that would have been put in it or before it has to move into it.
+  uint16_t gap = slot;
+  uint16_t position = (slot + 1) % kv->slot_count;
+
+  while (kv->slots[position].address != FLASH_KV_EMPTY_SLOT)
+  {
+    uint16_t home = kv->slots[position].hash % kv->slot_count;
+    uint16_t from_home = (position + kv->slot_count - home) % kv->slot_count;
+    uint16_t from_gap = (position + kv->slot_count - gap) % kv->slot_count;
+
+    if (from_home >= from_gap)
+    {
+      kv->slots[gap] = kv->slots[position];
+      kv->slots[position].address = FLASH_KV_EMPTY_SLOT;
+      gap = position;
+    }
+
+    position = (position + 1) % kv->slot_count;
+  }
+}
+
+static flash_status_t kv_put(flash_kv_t *kv, const uint8_t *key, uint8_t key_length, uint32_t address)
+{
+  uint32_t hash = kv_hash(key, key_length);
+  uint16_t slot = 0;
+
+  flash_status_t status = kv_find(kv, key, key_length, hash, &slot, NULL);
+  if (status == FLASH_ERROR)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (status == FLASH_DATA_NOT_FOUND)
+  {
+    // Keep one slot empty so lookups always stop.
+    if (kv->key_count + 1 >= kv->slot_count)
+    {
+      return FLASH_ERROR;
+    }
+
+    kv->slots[slot].hash = hash;
+    kv->key_count++;
+  }
+
+  kv->slots[slot].address = address;
+
+  return FLASH_OK;
+}
+
+static bool kv_has_room(flash_record_log_t *log, uint16_t length)
+{
+  flash_ctx_t *ctx = log->ctx;
+  flash_index_t *index = &ctx->indices[log->id];
+  uint16_t page_size = ctx->user_flash.page_size;
+
+  uint32_t size = flash_record_size(log, length);
+  uint32_t oldest_page = index->tail - index->tail % page_size;
+
+  // Where the record will go, records don't cross pages.
+  uint32_t start = index->head;
+  if (start % page_size != 0 && size > page_size - start % page_size)
+  {
+    start += page_size - start % page_size;
+    if (start >= index->max_data_address)
+    {
+      start = index->min_data_address;
+    }
+  }
+
+  // Starting a page erases it so it mustn't be the one the oldest records are on.
+  if (index->head != index->tail && start % page_size == 0 && start == oldest_page)
+  {
+    return false;
+  }
+
+  // Filling the page before that one would leave the head on the tail and the index would look empty.
+  uint32_t end = start + size;
+  if (end >= index->max_data_address)
+  {
+    end = index->min_data_address;
+  }
+
+  return !(end % page_size == 0 && end == oldest_page);
+}
+
+static uint32_t kv_free_pages(flash_record_log_t *log)
+{
+  flash_index_t *index = &log->ctx->indices[log->id];
+  uint16_t page_size = log->ctx->user_flash.page_size;
+  uint32_t data_size = index->max_data_address - index->min_data_address;
+
+  // A page the head is part way through isn't free.
+  uint32_t first_free = index->head;
+  if (first_free % page_size != 0)
+  {
+    first_free += page_size - first_free % page_size;
+    if (first_free >= index->max_data_address)
+    {
+      first_free = index->min_data_address;
+    }
+  }
+
+  if (index->head == index->tail)
+  {
+    return (index->head % page_size == 0) ? data_size / page_size : data_size / page_size - 1;
+  }
+
+  uint32_t oldest_page = index->tail - index->tail % page_size;
+  return ((oldest_page + data_size - first_free) % data_size) / page_size;
+}
+
+static bool kv_collectable(flash_record_log_t *log)
+{
+  flash_index_t *index = &log->ctx->indices[log->id];
+  uint16_t page_size = log->ctx->user_flash.page_size;
+
+  return index->head != index->tail && index->head - index->head % page_size != index->tail - index->tail % page_size;
+}
+
+static flash_status_t kv_append(flash_kv_t *kv, flash_kv_type_t type, const uint8_t *key, uint8_t key_length, const uint8_t *value, uint16_t value_length)
+{
+  if (value_length > UINT16_MAX - FLASH_KV_OVERHEAD - key_length)
+  {
+    return FLASH_ERROR;
+  }
+
+  uint16_t length = FLASH_KV_OVERHEAD + key_length + value_length;
+  if (flash_record_size(&kv->log, length) > kv->log.ctx->user_flash.page_size || !kv_has_room(&kv->log, length))
+  {
+    return FLASH_ERROR;
+  }
+
+  uint8_t prefix[FLASH_KV_OVERHEAD] = {type, key_length};
+
+  flash_iovec_t pieces[3] = {
+      {.data = prefix, .length = sizeof(prefix)},
+      {.data = (uint8_t *)key, .length = key_length},
+      {.data = (uint8_t *)value, .length = value_length}};
+
+  return flash_record_writev(&kv->log, pieces, 3);
+}
+
+static flash_status_t kv_mount_log(flash_kv_t *kv, flash_record_log_t *log, uint8_t *buffer, uint16_t buffer_size)
+{
+  flash_status_t status = flash_record_recover(log);
+  if (status == FLASH_DATA_NOT_FOUND)
+  {
+    return FLASH_OK;
+  }
+  else if (status != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_record_iter_t iter;
+  if (flash_record_iter_begin(&iter, log, FLASH_RECORD_OLDEST_FIRST, buffer, buffer_size) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  // Later records of a key replace earlier ones so the table ends up with the latest.
+  const uint8_t *data = NULL;
+  uint16_t length = 0;
+  while ((status = flash_record_iter_next(&iter, &data, &length)) == FLASH_OK)
+  {
+    // Not one of ours.
+    if (length < FLASH_KV_OVERHEAD || data[1] == 0 || data[1] > FLASH_KV_MAX_KEY || FLASH_KV_OVERHEAD + data[1] > length)
+    {
+      continue;
+    }
+
+    const uint8_t *key = &data[FLASH_KV_OVERHEAD];
+    uint8_t key_length = data[1];
+
+    if (data[0] == FLASH_KV_SET)
+    {
+      status = kv_put(kv, key, key_length, iter.address);
+    }
+    else if (data[0] == FLASH_KV_DELETE)
+    {
+      uint16_t slot = 0;
+      status = kv_find(kv, key, key_length, kv_hash(key, key_length), &slot, NULL);
+      if (status == FLASH_OK)
+      {
+        kv_remove(kv, slot);
+      }
+      else if (status == FLASH_DATA_NOT_FOUND)
+      {
+        status = FLASH_OK;
+      }
+    }
+
+    if (status != FLASH_OK)
+    {
+      break;
+    }
+  }
+
+  flash_record_iter_end(&iter);
+
+  return (status == FLASH_DATA_NOT_FOUND) ? FLASH_OK : FLASH_ERROR;
+}
+
+static flash_status_t kv_gc_start(flash_kv_t *kv)
+{
+  // The cold log is kept with a page to spare so it can always take the live records of one page, from the hot log
+  // or from itself.
+  if (kv_free_pages(&kv->cold) < 2 && kv_collectable(&kv->cold))
+  {
+    flash_index_t *cold = &kv->cold.ctx->indices[kv->cold.id];
+
+    // Been all the way round without freeing anything, it's all live.
+    if (kv->gc_cold_pages > (cold->max_data_address - cold->min_data_address) / kv->cold.ctx->user_flash.page_size)
+    {
+      return FLASH_ERROR;
+    }
+
+    kv->gc_cold_pages++;
+    kv->gc_log = &kv->cold;
+  }
+  else if (kv_free_pages(&kv->log) < kv->gc_free_pages && kv_collectable(&kv->log))
+  {
+    if (kv_free_pages(&kv->cold) < 1)
+    {
+      return FLASH_ERROR;
+    }
+
+    kv->gc_cold_pages = 0;
+    kv->gc_log = &kv->log;
+  }
+  else
+  {
+    return FLASH_DATA_NOT_FOUND;
+  }
+
+  kv->gc_address = kv->gc_log->ctx->indices[kv->gc_log->id].tail;
+
+  return FLASH_OK;
+}
+
+static flash_status_t kv_gc_record(flash_kv_t *kv, uint32_t *bytes)
+{
+  uint16_t length = 0;
+  uint32_t next = 0;
+  flash_status_t status = flash_record_read_at(kv->gc_log, kv->gc_address, kv->gc_buffer, kv->gc_buffer_size, &length, &next);
+
+  if (status == FLASH_ERROR)
+  {
+    return FLASH_ERROR;
+  }
+
+  uint32_t address = kv->gc_address;
+  kv->gc_address = next;
+
+  // Torn, or nothing more on the page.
+  if (status == FLASH_DATA_NOT_FOUND)
+  {
+    return FLASH_OK;
+  }
+
+  *bytes += flash_record_size(kv->gc_log, length);
+
+  const uint8_t *data = kv->gc_buffer;
+  if (length < FLASH_KV_OVERHEAD || data[1] == 0 || data[1] > FLASH_KV_MAX_KEY || FLASH_KV_OVERHEAD + data[1] > length)
+  {
+    return FLASH_OK;
+  }
+
+  const uint8_t *key = &data[FLASH_KV_OVERHEAD];
+  uint8_t key_length = data[1];
+  uint16_t slot = 0;
+
+  status = kv_find(kv, key, key_length, kv_hash(key, key_length), &slot, NULL);
+  if (status == FLASH_ERROR)
+  {
+    return FLASH_ERROR;
+  }
+
+  // A set is live if it is still the latest record of its key. A delete only has to be kept while older records of
+  // its key could still be in the cold log, which is never once the cold log's own oldest page gets to it.
+  bool live = false;
+  if (data[0] == FLASH_KV_SET)
+  {
+    live = status == FLASH_OK && kv->slots[slot].address == address;
+  }
+  else if (data[0] == FLASH_KV_DELETE)
+  {
+    live = status == FLASH_DATA_NOT_FOUND && kv->gc_log == &kv->log;
+  }
+
+  if (!live)
+  {
+    return FLASH_OK;
+  }
+
+  if (!kv_has_room(&kv->cold, length) || flash_record_write(&kv->cold, data, length) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  *bytes += flash_record_size(&kv->cold, length);
+
+  if (data[0] == FLASH_KV_SET)
+  {
+    kv->slots[slot].address = kv->cold.last_address;
+  }
+
+  return FLASH_OK;
+}
+
+static flash_status_t kv_gc_finish(flash_kv_t *kv)
+{
+  flash_ctx_t *ctx = kv->gc_log->ctx;
+  flash_index_t *index = &ctx->indices[kv->gc_log->id];
+  uint16_t page_size = ctx->user_flash.page_size;
+  uint32_t page = index->tail - index->tail % page_size;
+
+  if (flash_ctx_erase_pages(ctx, page / page_size, 1) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  page += page_size;
+  if (page >= index->max_data_address)
+  {
+    page = index->min_data_address;
+  }
+
+  index->tail = page;
+  kv->gc_log = NULL;
+
+  return FLASH_OK;
+}
+
+// PUBLIC FUNCTION DEFINITIONS
+
+flash_status_t flash_kv_init(flash_kv_t *kv, flash_ctx_t *ctx, uint8_t id, flash_kv_slot_t *slots, uint16_t slot_count)
+{
+  if (kv == NULL || slots == NULL || slot_count < 2)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (flash_record_init(&kv->log, ctx, id) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  kv->slots = slots;
+  kv->slot_count = slot_count;
+  kv->key_count = 0;
+  kv->cold.ctx = NULL;
+  kv->gc_log = NULL;
+
+  for (uint16_t idx = 0; idx < slot_count; idx++)
+  {
+    kv->slots[idx].address = FLASH_KV_EMPTY_SLOT;
+  }
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_kv_mount(flash_kv_t *kv, uint8_t *buffer, uint16_t buffer_size)
+{
+  if (kv == NULL || kv->slots == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  for (uint16_t idx = 0; idx < kv->slot_count; idx++)
+  {
+    kv->slots[idx].address = FLASH_KV_EMPTY_SLOT;
+  }
+  kv->key_count = 0;
+  kv->gc_log = NULL;
+  kv->gc_cold_pages = 0;
+
+  // Everything in the cold log was copied there from records older than anything still in the hot log.
+  if (kv->cold.ctx != NULL && kv_mount_log(kv, &kv->cold, buffer, buffer_size) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  return kv_mount_log(kv, &kv->log, buffer, buffer_size);
+}
+
+flash_status_t flash_kv_set(flash_kv_t *kv, const uint8_t *key, uint8_t key_length, const uint8_t *value, uint16_t value_length)
+{
+  if (kv == NULL || kv->slots == NULL || key == NULL || key_length == 0 || key_length > FLASH_KV_MAX_KEY || (value == NULL && value_length > 0))
+  {
+    return FLASH_ERROR;
+  }
+
+  // Make sure the table has room before anything goes to flash.
+  uint32_t hash = kv_hash(key, key_length);
+  uint16_t slot = 0;
+  flash_status_t status = kv_find(kv, key, key_length, hash, &slot, NULL);
+  if (status == FLASH_ERROR || (status == FLASH_DATA_NOT_FOUND && kv->key_count + 1 >= kv->slot_count))
+  {
+    return FLASH_ERROR;
+  }
+
+  if (kv_append(kv, FLASH_KV_SET, key, key_length, value, value_length) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  // The table hasn't changed since so the slot found is still the one.
+  if (status == FLASH_DATA_NOT_FOUND)
+  {
+    kv->slots[slot].hash = hash;
+    kv->key_count++;
+  }
+
+  kv->slots[slot].address = kv->log.last_address;
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_kv_get(flash_kv_t *kv, const uint8_t *key, uint8_t key_length, uint8_t *value, uint16_t size, uint16_t *length)
+{
+  if (kv == NULL || kv->slots == NULL || key == NULL || key_length == 0 || key_length > FLASH_KV_MAX_KEY || length == NULL || (value == NULL && size > 0))
+  {
+    return FLASH_ERROR;
+  }
+
+  uint16_t slot = 0;
+  uint16_t value_length = 0;
+  flash_status_t status = kv_find(kv, key, key_length, kv_hash(key, key_length), &slot, &value_length);
+  if (status != FLASH_OK)
+  {
+    return status;
+  }
+
+  uint32_t address = kv->slots[slot].address;
+
+  *length = value_length;
+  if (value_length > size)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (value_length == 0)
+  {
+    return FLASH_OK;
+  }
+
+  return flash_ctx_read(kv->log.ctx, address + FLASH_RECORD_HEADER_SIZE + FLASH_KV_OVERHEAD + key_length, value, value_length);
+}
+
+flash_status_t flash_kv_delete(flash_kv_t *kv, const uint8_t *key, uint8_t key_length)
+{
+  if (kv == NULL || kv->slots == NULL || key == NULL || key_length == 0 || key_length > FLASH_KV_MAX_KEY)
+  {
+    return FLASH_ERROR;
+  }
+
+  uint16_t slot = 0;
+  flash_status_t status = kv_find(kv, key, key_length, kv_hash(key, key_length), &slot, NULL);
+  if (status != FLASH_OK)
+  {
+    return status;
+  }
+
+  if (kv_append(kv, FLASH_KV_DELETE, key, key_length, NULL, 0) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  kv_remove(kv, slot);
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_kv_set_gc(flash_kv_t *kv, uint8_t cold_id, uint8_t *buffer, uint16_t buffer_size, uint32_t free_pages)
+{
+  if (kv == NULL || kv->log.ctx == NULL || cold_id == kv->log.id || buffer == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  // A whole record has to fit to be copied.
+  if (buffer_size < kv->log.ctx->user_flash.page_size)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (flash_record_init(&kv->cold, kv->log.ctx, cold_id) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  kv->gc_buffer = buffer;
+  kv->gc_buffer_size = buffer_size;
+  kv->gc_free_pages = free_pages;
+  kv->gc_log = NULL;
+  kv->gc_cold_pages = 0;
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_kv_gc_step(flash_kv_t *kv, uint32_t max_bytes, uint32_t max_operations)
+{
+  if (kv == NULL || kv->cold.ctx == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (kv->gc_log == NULL)
+  {
+    flash_status_t status = kv_gc_start(kv);
+    if (status != FLASH_OK)
+    {
+      return status;
+    }
+  }
+
+  uint32_t bytes = 0;
+  uint32_t operations = 0;
+  uint16_t page_size = kv->log.ctx->user_flash.page_size;
+
+  // Always get something done, then stop as soon as either budget is used up.
+  do
+  {
+    // The page is finished once the next record would be on the page after it.
+    if (kv->gc_address % page_size == 0 && kv->gc_address != kv->gc_log->ctx->indices[kv->gc_log->id].tail)
+    {
+      return kv_gc_finish(kv);
+    }
+
+    if (kv_gc_record(kv, &bytes) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    operations++;
+  } while ((max_bytes == 0 || bytes < max_bytes) && (max_operations == 0 || operations < max_operations));
+
+  return FLASH_OK;
+}
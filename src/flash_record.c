@@ -0,0 +1,844 @@
+/**
+ *  flash_record.c
+ *
+ *  Records with a length, sequence number, checksum and commit marker written through an index. A record is never
+ *  split over two pages so every page that holds records starts with one.
+ */
+
+#include "flash_record.h"
+#include "flash_crc.h"
+#include <stddef.h>
+#include <string.h>
+
+// PRIVATE DEFINES
+
+/* Size of the buffer that record data is read through to check its checksum when there's nowhere to keep it. */
+#define RECORD_CHUNK_SIZE 32
+
+// PRIVATE TYPES
+
+/**
+ * @brief What was found where a record could start.
+ */
+typedef enum{
+  RECORD_VALID,       /* A complete record that matches its checksum. */
+  RECORD_TORN,        /* A good header but the write didn't finish or the checksum doesn't match. Can be skipped. */
+  RECORD_ERASED,      /* Nothing has been written here. */
+  RECORD_NONE,        /* Not a record, or no room for one before the end of the page. */
+  RECORD_READ_ERROR
+}record_state_t;
+
+/**
+ * @brief What the header of a record says.
+ * @param length The number of bytes of data.
+ * @param sequence The sequence number.
+ * @param size The number of bytes the record takes up in flash.
+ */
+typedef struct{
+  uint16_t length;
+  uint32_t sequence;
+  uint32_t size;
+}record_info_t;
+
+// PRIVATE FUNCTION DECLARATIONS
+
+/**
+ * @brief The number of bytes a record takes up in flash, rounded up to whole words.
+ *
+ * @param length The number of bytes of data.
+ * @return uint32_t The size.
+ */
+static uint32_t record_size(flash_ctx_t *ctx, uint16_t length);
+
+/**
+ * @brief Check the header of a record.
+ *
+ * @param header The first FLASH_RECORD_HEADER_SIZE bytes of the record.
+ * @param page_left The number of bytes from the start of the record to the end of its page.
+ * @param info Set to what the header says.
+ * @return record_state_t RECORD_VALID if the header is good and the record fits on the page.
+ */
+static record_state_t record_parse_header(flash_ctx_t *ctx, const uint8_t *header, uint32_t page_left, record_info_t *info);
+
+/**
+ * @brief Check for a record at the start of some bytes that have already been read from flash.
+ *
+ * @param bytes The bytes.
+ * @param available The number of bytes.
+ * @param page_left The number of bytes from the start of the record to the end of its page.
+ * @param info Set to what the header says if there is one.
+ * @return record_state_t What was found.
+ */
+static record_state_t record_parse(flash_ctx_t *ctx, const uint8_t *bytes, uint32_t available, uint32_t page_left, record_info_t *info);
+
+/**
+ * @brief Check for a record at an address.
+ *
+ * @param address Where the record would start.
+ * @param buffer The data of the record is read through this to check the checksum. If it is big enough it holds the
+ * data afterwards.
+ * @param buffer_size The size of buffer. Must not be 0.
+ * @param info Set to what the header says if there is one.
+ * @return record_state_t What was found.
+ */
+static record_state_t record_inspect(flash_ctx_t *ctx, uint32_t address, uint8_t *buffer, uint16_t buffer_size, record_info_t *info);
+
+/**
+ * @brief Read the next stretch of records an iterator is to walk into its buffer, a page or less. Walking newest
+ * first the records are then linked back to front, see iter_link_records.
+ *
+ * @param iter The iterator. from and to say what to read.
+ * @return flash_status_t
+ */
+static flash_status_t iter_load(flash_record_iter_t *iter);
+
+/**
+ * @brief Check every record in an iterator's buffer once and chain the complete ones together newest first. The
+ * checksum of each in the buffer is replaced by the offset of the complete record before it, or limit for the first,
+ * and offset is set to the newest. Records can only be found going forwards from their headers so without this
+ * every step back would walk the page again.
+ *
+ * @param iter The iterator.
+ */
+static void iter_link_records(flash_record_iter_t *iter);
+
+/**
+ * @brief Move an iterator onto the page after the one it has finished with.
+ *
+ * @param iter The iterator.
+ * @return true There is another page to walk.
+ */
+static bool iter_next_page(flash_record_iter_t *iter);
+
+/**
+ * @brief Move an iterator onto the page before the one it has finished with.
+ *
+ * @param iter The iterator.
+ * @return true There is another page to walk.
+ */
+static bool iter_previous_page(flash_record_iter_t *iter);
+
+/**
+ * @brief The number of bytes from one address in the data space of an index to another going forward round the ring.
+ */
+static uint32_t ring_distance(flash_index_t *index, uint32_t from, uint32_t to);
+
+/**
+ * @brief Move the tail of the index forward, stopping at the head and wrapping at the end of its data space.
+ *
+ * @param index The index.
+ * @param bytes The number of bytes to move it.
+ */
+static void record_advance_tail(flash_index_t *index, uint32_t bytes);
+
+/**
+ * @brief Whether one sequence number comes after another, allowing for them wrapping round.
+ *
+ * @return true a is newer than b.
+ */
+static bool sequence_newer(uint32_t a, uint32_t b);
+
+static void put_u16(uint8_t *bytes, uint16_t value);
+static void put_u32(uint8_t *bytes, uint32_t value);
+static uint16_t get_u16(const uint8_t *bytes);
+static uint32_t get_u32(const uint8_t *bytes);
+
+// PRIVATE FUNCTION DEFINITIONS
+
+static uint32_t record_size(flash_ctx_t *ctx, uint16_t length)
+{
+  uint32_t word_size = ctx->user_flash.word_size;
+  uint32_t size = FLASH_RECORD_OVERHEAD + length;
+
+  return (size + word_size - 1) / word_size * word_size;
+}
+
+static record_state_t record_parse_header(flash_ctx_t *ctx, const uint8_t *header, uint32_t page_left, record_info_t *info)
+{
+  if (page_left < FLASH_RECORD_OVERHEAD)
+  {
+    return RECORD_NONE;
+  }
+
+  info->length = get_u16(&header[0]);
+  info->sequence = get_u32(&header[4]);
+  info->size = record_size(ctx, info->length);
+
+  // The length is stored twice so it can be trusted before the rest of the record is.
+  if ((uint16_t)~info->length != get_u16(&header[2]))
+  {
+    uint8_t erased[FLASH_RECORD_HEADER_SIZE];
+    memset(erased, FLASH_EMPTY_VALUE, sizeof(erased));
+
+    return (memcmp(header, erased, sizeof(erased)) == 0) ? RECORD_ERASED : RECORD_NONE;
+  }
+
+  if (info->size > page_left)
+  {
+    return RECORD_NONE;
+  }
+
+  return RECORD_VALID;
+}
+
+static record_state_t record_parse(flash_ctx_t *ctx, const uint8_t *bytes, uint32_t available, uint32_t page_left, record_info_t *info)
+{
+  if (available < FLASH_RECORD_HEADER_SIZE)
+  {
+    return RECORD_NONE;
+  }
+
+  record_state_t state = record_parse_header(ctx, bytes, page_left, info);
+  if (state != RECORD_VALID)
+  {
+    return state;
+  }
+
+  if (info->size > available || get_u32(&bytes[info->size - 4]) != FLASH_RECORD_COMMIT)
+  {
+    return RECORD_TORN;
+  }
+
+  uint32_t crc = flash_crc32c(flash_crc32c(0, bytes, 8), &bytes[FLASH_RECORD_HEADER_SIZE], info->length);
+  if (crc != get_u32(&bytes[8]))
+  {
+    return RECORD_TORN;
+  }
+
+  return RECORD_VALID;
+}
+
+static record_state_t record_inspect(flash_ctx_t *ctx, uint32_t address, uint8_t *buffer, uint16_t buffer_size, record_info_t *info)
+{
+  uint32_t page_left = ctx->user_flash.page_size - address % ctx->user_flash.page_size;
+
+  if (page_left < FLASH_RECORD_OVERHEAD)
+  {
+    return RECORD_NONE;
+  }
+
+  uint8_t header[FLASH_RECORD_HEADER_SIZE];
+  if (flash_ctx_read(ctx, address, header, sizeof(header)) != FLASH_OK)
+  {
+    return RECORD_READ_ERROR;
+  }
+
+  record_state_t state = record_parse_header(ctx, header, page_left, info);
+  if (state != RECORD_VALID)
+  {
+    return state;
+  }
+
+  uint8_t commit[4];
+  if (flash_ctx_read(ctx, address + info->size - sizeof(commit), commit, sizeof(commit)) != FLASH_OK)
+  {
+    return RECORD_READ_ERROR;
+  }
+
+  if (get_u32(commit) != FLASH_RECORD_COMMIT)
+  {
+    return RECORD_TORN;
+  }
+
+  uint32_t crc = flash_crc32c(0, header, 8);
+  for (uint16_t offset = 0; offset < info->length;)
+  {
+    uint16_t chunk = (info->length - offset < buffer_size) ? info->length - offset : buffer_size;
+
+    if (flash_ctx_read(ctx, address + FLASH_RECORD_HEADER_SIZE + offset, buffer, chunk) != FLASH_OK)
+    {
+      return RECORD_READ_ERROR;
+    }
+
+    crc = flash_crc32c(crc, buffer, chunk);
+    offset += chunk;
+  }
+
+  if (crc != get_u32(&header[8]))
+  {
+    return RECORD_TORN;
+  }
+
+  return RECORD_VALID;
+}
+
+static flash_status_t iter_load(flash_record_iter_t *iter)
+{
+  iter->offset = 0;
+  iter->limit = iter->to - iter->from;
+
+  if (flash_ctx_read(iter->log->ctx, iter->from, iter->buffer, iter->limit) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  if (iter->direction == FLASH_RECORD_NEWEST_FIRST)
+  {
+    iter_link_records(iter);
+  }
+
+  return FLASH_OK;
+}
+
+static void iter_link_records(flash_record_iter_t *iter)
+{
+  flash_ctx_t *ctx = iter->log->ctx;
+  uint16_t page_size = ctx->user_flash.page_size;
+  uint32_t newest = iter->limit;
+  uint32_t offset = 0;
+  record_info_t info;
+
+  while (offset < iter->limit)
+  {
+    uint32_t page_left = page_size - (iter->from + offset) % page_size;
+    record_state_t state = record_parse(ctx, &iter->buffer[offset], iter->limit - offset, page_left, &info);
+
+    if (state != RECORD_VALID && state != RECORD_TORN)
+    {
+      break;
+    }
+
+    if (state == RECORD_VALID)
+    {
+      put_u32(&iter->buffer[offset + 8], newest);
+      newest = offset;
+    }
+
+    offset += info.size;
+  }
+
+  iter->offset = newest;
+}
+
+static bool iter_next_page(flash_record_iter_t *iter)
+{
+  flash_index_t *index = &iter->log->ctx->indices[iter->log->id];
+  uint16_t page_size = iter->log->ctx->user_flash.page_size;
+
+  if (iter->to == index->head)
+  {
+    return false;
+  }
+
+  iter->from = (iter->to >= index->max_data_address) ? index->min_data_address : iter->to;
+
+  uint32_t page_left = page_size - iter->from % page_size;
+  uint32_t left = ring_distance(index, iter->from, index->head);
+  iter->to = iter->from + ((left < page_left) ? left : page_left);
+
+  return true;
+}
+
+static bool iter_previous_page(flash_record_iter_t *iter)
+{
+  flash_index_t *index = &iter->log->ctx->indices[iter->log->id];
+  uint16_t page_size = iter->log->ctx->user_flash.page_size;
+
+  if (iter->from == index->tail)
+  {
+    return false;
+  }
+
+  iter->to = (iter->from <= index->min_data_address) ? index->max_data_address : iter->from;
+
+  // Start at the tail if it is on this page, otherwise at the start of the page.
+  uint32_t page_start = (iter->to - 1) - (iter->to - 1) % page_size;
+  uint32_t left = ring_distance(index, index->tail, iter->to);
+  iter->from = (left < iter->to - page_start) ? iter->to - left : page_start;
+
+  return true;
+}
+
+static uint32_t ring_distance(flash_index_t *index, uint32_t from, uint32_t to)
+{
+  return (to >= from) ? to - from : index->max_data_address - from + to - index->min_data_address;
+}
+
+static void record_advance_tail(flash_index_t *index, uint32_t bytes)
+{
+  uint32_t available = ring_distance(index, index->tail, index->head);
+
+  if (bytes >= available)
+  {
+    index->tail = index->head;
+    return;
+  }
+
+  index->tail += bytes;
+  if (index->tail >= index->max_data_address)
+  {
+    index->tail = index->tail - index->max_data_address + index->min_data_address;
+  }
+}
+
+static bool sequence_newer(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) > 0;
+}
+
+static void put_u16(uint8_t *bytes, uint16_t value)
+{
+  bytes[0] = value & 0xFF;
+  bytes[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *bytes, uint32_t value)
+{
+  put_u16(&bytes[0], value & 0xFFFF);
+  put_u16(&bytes[2], value >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *bytes)
+{
+  return bytes[0] | (bytes[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *bytes)
+{
+  return get_u16(&bytes[0]) | ((uint32_t)get_u16(&bytes[2]) << 16);
+}
+
+// PUBLIC FUNCTION DEFINITIONS
+
+flash_status_t flash_record_init(flash_record_log_t *log, flash_ctx_t *ctx, uint8_t id)
+{
+  if (log == NULL || ctx == NULL || id >= ctx->index_count)
+  {
+    return FLASH_ERROR;
+  }
+
+  log->ctx = ctx;
+  log->id = id;
+  log->sequence = 0;
+  log->last_address = 0;
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_record_write(flash_record_log_t *log, const uint8_t *data, uint16_t length)
+{
+  flash_iovec_t piece = {.data = (uint8_t *)data, .length = length};
+
+  return flash_record_writev(log, &piece, 1);
+}
+
+flash_status_t flash_record_writev(flash_record_log_t *log, const flash_iovec_t *iov, uint8_t iov_count)
+{
+  // Room for the header, padding and commit marker pieces.
+  if (log == NULL || log->ctx == NULL || (iov == NULL && iov_count > 0) || iov_count > UINT8_MAX - 3)
+  {
+    return FLASH_ERROR;
+  }
+
+  uint32_t length = 0;
+  for (uint8_t idx = 0; idx < iov_count; idx++)
+  {
+    if (iov[idx].data == NULL && iov[idx].length > 0)
+    {
+      return FLASH_ERROR;
+    }
+
+    length += iov[idx].length;
+  }
+
+  flash_ctx_t *ctx = log->ctx;
+
+  if (length > UINT16_MAX || record_size(ctx, length) > ctx->user_flash.page_size)
+  {
+    return FLASH_ERROR;
+  }
+
+  uint32_t size = record_size(ctx, length);
+
+  uint32_t head = flash_ctx_index_get_head(ctx, log->id);
+  if (head == (uint32_t)-1)
+  {
+    return FLASH_ERROR;
+  }
+
+  // Records don't cross pages so that a page can be read without the one before it.
+  if (size > ctx->user_flash.page_size - head % ctx->user_flash.page_size)
+  {
+    if (flash_ctx_index_next_page(ctx, log->id) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+
+    head = flash_ctx_index_get_head(ctx, log->id);
+  }
+
+  uint8_t header[FLASH_RECORD_HEADER_SIZE];
+  put_u16(&header[0], length);
+  put_u16(&header[2], ~length);
+  put_u32(&header[4], log->sequence);
+
+  uint32_t crc = flash_crc32c(0, header, 8);
+  for (uint8_t idx = 0; idx < iov_count; idx++)
+  {
+    crc = flash_crc32c(crc, iov[idx].data, iov[idx].length);
+  }
+  put_u32(&header[8], crc);
+
+  uint8_t padding[ctx->user_flash.word_size];
+  memset(padding, FLASH_EMPTY_VALUE, sizeof(padding));
+
+  uint8_t commit[4];
+  put_u32(commit, FLASH_RECORD_COMMIT);
+
+  // The commit marker goes last so it only gets to flash if everything before it did.
+  flash_iovec_t pieces[iov_count + 3];
+  pieces[0] = (flash_iovec_t){.data = header, .length = sizeof(header)};
+  memcpy(&pieces[1], iov, iov_count * sizeof(flash_iovec_t));
+  pieces[iov_count + 1] = (flash_iovec_t){.data = padding, .length = size - FLASH_RECORD_OVERHEAD - length};
+  pieces[iov_count + 2] = (flash_iovec_t){.data = commit, .length = sizeof(commit)};
+
+  if (flash_ctx_index_writev(ctx, log->id, pieces, iov_count + 3) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  log->last_address = head;
+  log->sequence++;
+
+  return FLASH_OK;
+}
+
+uint32_t flash_record_size(flash_record_log_t *log, uint16_t length)
+{
+  if (log == NULL || log->ctx == NULL)
+  {
+    return 0;
+  }
+
+  return record_size(log->ctx, length);
+}
+
+flash_status_t flash_record_read(flash_record_log_t *log, uint8_t *data, uint16_t size, uint16_t *length)
+{
+  if (log == NULL || log->ctx == NULL || log->id >= log->ctx->index_count || data == NULL || size == 0 || length == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_ctx_t *ctx = log->ctx;
+  flash_index_t *index = &ctx->indices[log->id];
+
+  while (index->tail != index->head)
+  {
+    record_info_t info;
+
+    switch (record_inspect(ctx, index->tail, data, size, &info))
+    {
+    case RECORD_VALID:
+      if (info.length > size)
+      {
+        return FLASH_ERROR;
+      }
+
+      record_advance_tail(index, info.size);
+      *length = info.length;
+      return FLASH_OK;
+    case RECORD_TORN:
+      record_advance_tail(index, info.size);
+      break;
+    case RECORD_ERASED:
+    case RECORD_NONE:
+      // Nothing more on this page.
+      record_advance_tail(index, ctx->user_flash.page_size - index->tail % ctx->user_flash.page_size);
+      break;
+    case RECORD_READ_ERROR:
+    default:
+      return FLASH_ERROR;
+    }
+  }
+
+  return FLASH_DATA_NOT_FOUND;
+}
+
+flash_status_t flash_record_read_at(flash_record_log_t *log, uint32_t address, uint8_t *data, uint16_t size, uint16_t *length, uint32_t *next)
+{
+  if (log == NULL || log->ctx == NULL || data == NULL || size == 0 || length == NULL || next == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_ctx_t *ctx = log->ctx;
+  record_info_t info;
+
+  switch (record_inspect(ctx, address, data, size, &info))
+  {
+  case RECORD_VALID:
+    *next = address + info.size;
+    *length = info.length;
+    return (info.length > size) ? FLASH_ERROR : FLASH_OK;
+  case RECORD_TORN:
+    *next = address + info.size;
+    return FLASH_DATA_NOT_FOUND;
+  case RECORD_ERASED:
+  case RECORD_NONE:
+    // Nothing more on this page.
+    *next = address + ctx->user_flash.page_size - address % ctx->user_flash.page_size;
+    return FLASH_DATA_NOT_FOUND;
+  case RECORD_READ_ERROR:
+  default:
+    return FLASH_ERROR;
+  }
+}
+
+flash_status_t flash_record_recover(flash_record_log_t *log)
+{
+  if (log == NULL || log->ctx == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_ctx_t *ctx = log->ctx;
+
+  if (flash_ctx_index_reset(ctx, log->id) != FLASH_OK)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t *index = &ctx->indices[log->id];
+  uint16_t page_size = ctx->user_flash.page_size;
+  uint8_t chunk[RECORD_CHUNK_SIZE];
+  record_info_t info;
+
+  // Every page with records on it starts with one so the first records say which pages are newest and oldest.
+  bool found = false;
+  uint32_t newest_page = 0;
+  uint32_t newest_sequence = 0;
+  uint32_t oldest_page = 0;
+  uint32_t oldest_sequence = 0;
+
+  for (uint32_t page = index->start_page; page <= index->end_page; page++)
+  {
+    record_state_t state = record_inspect(ctx, page * page_size, chunk, sizeof(chunk), &info);
+
+    if (state == RECORD_READ_ERROR)
+    {
+      return FLASH_ERROR;
+    }
+
+    if (state != RECORD_VALID)
+    {
+      continue;
+    }
+
+    if (!found || sequence_newer(info.sequence, newest_sequence))
+    {
+      newest_page = page;
+      newest_sequence = info.sequence;
+    }
+
+    if (!found || sequence_newer(oldest_sequence, info.sequence))
+    {
+      oldest_page = page;
+      oldest_sequence = info.sequence;
+    }
+
+    found = true;
+  }
+
+  if (!found)
+  {
+    return FLASH_DATA_NOT_FOUND;
+  }
+
+  // The head is after the last record on the newest page.
+  uint32_t address = newest_page * page_size;
+  uint32_t page_end = address + page_size;
+  uint32_t sequence = newest_sequence;
+
+  while (address < page_end)
+  {
+    record_state_t state = record_inspect(ctx, address, chunk, sizeof(chunk), &info);
+
+    if (state == RECORD_READ_ERROR)
+    {
+      return FLASH_ERROR;
+    }
+
+    if (state == RECORD_VALID)
+    {
+      sequence = info.sequence;
+      address += info.size;
+    }
+    else if (state == RECORD_TORN)
+    {
+      address += info.size;
+    }
+    else
+    {
+      // Whatever is here can't be written over so carry on from the next page.
+      if (state != RECORD_ERASED)
+      {
+        address = page_end;
+      }
+      break;
+    }
+  }
+
+  if (address >= index->max_data_address)
+  {
+    address = index->min_data_address;
+  }
+
+  index->head = address;
+  index->tail = oldest_page * page_size;
+  log->sequence = sequence + 1;
+
+  return FLASH_OK;
+}
+
+flash_status_t flash_record_iter_begin(flash_record_iter_t *iter, flash_record_log_t *log, flash_record_direction_t direction, uint8_t *buffer, uint16_t buffer_size)
+{
+  if (iter == NULL || log == NULL || log->ctx == NULL || log->id >= log->ctx->index_count || buffer == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  // A page is read at a time.
+  if (buffer_size < log->ctx->user_flash.page_size)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_index_t *index = &log->ctx->indices[log->id];
+
+  iter->log = log;
+  iter->direction = direction;
+  iter->buffer = buffer;
+  iter->offset = 0;
+  iter->limit = 0;
+  iter->sequence = 0;
+  iter->address = 0;
+
+  // Nothing to walk, the page stepping below stops straight away.
+  iter->from = index->tail;
+  iter->to = index->tail;
+
+  if (index->tail == index->head)
+  {
+    iter->done = true;
+    return FLASH_OK;
+  }
+
+  if (direction == FLASH_RECORD_OLDEST_FIRST)
+  {
+    // Pretend the page before the tail has just been finished with.
+    iter->to = index->tail;
+    iter_next_page(iter);
+  }
+  else
+  {
+    iter->from = index->head;
+    iter_previous_page(iter);
+  }
+
+  iter->done = false;
+
+  return iter_load(iter);
+}
+
+flash_status_t flash_record_iter_next(flash_record_iter_t *iter, const uint8_t **data, uint16_t *length)
+{
+  if (iter == NULL || iter->log == NULL || data == NULL || length == NULL)
+  {
+    return FLASH_ERROR;
+  }
+
+  flash_ctx_t *ctx = iter->log->ctx;
+  uint16_t page_size = ctx->user_flash.page_size;
+  record_info_t info;
+
+  while (!iter->done)
+  {
+    // Going backwards the next record is at offset, already checked, and links to the one before it.
+    if (iter->direction == FLASH_RECORD_NEWEST_FIRST)
+    {
+      uint32_t found = iter->offset;
+
+      if (found < iter->limit)
+      {
+        iter->offset = get_u32(&iter->buffer[found + 8]);
+        *data = &iter->buffer[found + FLASH_RECORD_HEADER_SIZE];
+        *length = get_u16(&iter->buffer[found]);
+        iter->sequence = get_u32(&iter->buffer[found + 4]);
+        iter->address = iter->from + found;
+        return FLASH_OK;
+      }
+    }
+    else
+    {
+      // Going forwards it is the first complete one from offset.
+      uint32_t offset = iter->offset;
+      uint32_t found = iter->limit;
+      uint32_t found_length = 0;
+      uint32_t found_sequence = 0;
+
+      while (offset < iter->limit)
+      {
+        uint32_t page_left = page_size - (iter->from + offset) % page_size;
+        record_state_t state = record_parse(ctx, &iter->buffer[offset], iter->limit - offset, page_left, &info);
+
+        if (state != RECORD_VALID && state != RECORD_TORN)
+        {
+          // Nothing more on this page.
+          offset = iter->limit;
+          break;
+        }
+
+        if (state == RECORD_VALID)
+        {
+          found = offset;
+          found_length = info.length;
+          found_sequence = info.sequence;
+        }
+
+        offset += info.size;
+
+        if (state == RECORD_VALID)
+        {
+          break;
+        }
+      }
+
+      if (found < iter->limit)
+      {
+        iter->offset = offset;
+        *data = &iter->buffer[found + FLASH_RECORD_HEADER_SIZE];
+        *length = found_length;
+        iter->sequence = found_sequence;
+        iter->address = iter->from + found;
+        return FLASH_OK;
+      }
+    }
+
+    bool more = (iter->direction == FLASH_RECORD_OLDEST_FIRST) ? iter_next_page(iter) : iter_previous_page(iter);
+    if (!more)
+    {
+      iter->done = true;
+      break;
+    }
+
+    if (iter_load(iter) != FLASH_OK)
+    {
+      return FLASH_ERROR;
+    }
+  }
+
+  return FLASH_DATA_NOT_FOUND;
+}
+
+void flash_record_iter_end(flash_record_iter_t *iter)
+{
+  if (iter == NULL)
+  {
+    return;
+  }
+
+  iter->log = NULL;
+  iter->buffer = NULL;
+  iter->done = true;
+}
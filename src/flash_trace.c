@@ -0,0 +1,158 @@
+/**
+ *  flash_trace.c
+ *
+ *  Turns the trace events recorded by flash.c back into something readable. Kept apart from the driver so it can be
+ *  built on the host on its own.
+ */
+
+#include "flash_trace.h"
+
+// PRIVATE DEFINES
+
+/* The deepest driver functions are indented when printed. They only call each other a few deep. */
+#define TRACE_MAX_DEPTH 8
+
+// PRIVATE FUNCTION DECLARATIONS
+
+/**
+ * @brief Read a little endian value.
+ *
+ * @param bytes The first byte of it.
+ * @return uint32_t The value.
+ */
+static uint32_t read_le32(const uint8_t *bytes);
+
+/**
+ * @brief Whether an event is a driver function being called or returning, which have enter and exit events.
+ *
+ * @param type The type, without FLASH_TRACE_EXIT.
+ * @return true If it is.
+ */
+static bool is_driver_function(uint8_t type);
+
+// PRIVATE FUNCTION DEFINITIONS
+
+static uint32_t read_le32(const uint8_t *bytes)
+{
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static bool is_driver_function(uint8_t type)
+{
+  return type >= FLASH_TRACE_WRITE && type <= FLASH_TRACE_INDEX_WRITE_INDEX;
+}
+
+// PUBLIC FUNCTION DEFINITIONS
+
+flash_status_t flash_trace_decode(const uint8_t *bytes, uint32_t length, flash_trace_event_t *event)
+{
+  if (bytes == NULL || event == NULL || length < FLASH_TRACE_EVENT_SIZE)
+  {
+    return FLASH_ERROR;
+  }
+
+  event->timestamp = read_le32(&bytes[0]);
+  event->address = read_le32(&bytes[4]);
+  event->length = read_le32(&bytes[8]);
+  event->type = bytes[12];
+  event->id = bytes[13];
+  event->status = bytes[14];
+  event->reserved = bytes[15];
+
+  uint8_t type = event->type & ~FLASH_TRACE_EXIT;
+
+  // Only driver functions return, and erased or zeroed memory isn't an event.
+  if (type < FLASH_TRACE_WRITE || type > FLASH_TRACE_CHECKPOINT_MOVE || event->reserved != 0)
+  {
+    return FLASH_ERROR;
+  }
+
+  if ((event->type & FLASH_TRACE_EXIT) && !is_driver_function(type))
+  {
+    return FLASH_ERROR;
+  }
+
+  return FLASH_OK;
+}
+
+const char *flash_trace_name(uint8_t type)
+{
+  switch (type & ~FLASH_TRACE_EXIT)
+  {
+  case FLASH_TRACE_WRITE:
+    return "write";
+  case FLASH_TRACE_ERASE_PAGES:
+    return "erase_pages";
+  case FLASH_TRACE_INDEX_WRITE:
+    return "index_write";
+  case FLASH_TRACE_INDEX_WRITE_INDEX:
+    return "index_write_index";
+  case FLASH_TRACE_USER_READ:
+    return "user_read";
+  case FLASH_TRACE_USER_WRITE:
+    return "user_write";
+  case FLASH_TRACE_USER_ERASE:
+    return "user_erase";
+  case FLASH_TRACE_WRAP:
+    return "wrap";
+  case FLASH_TRACE_CHECKPOINT_MOVE:
+    return "checkpoint_move";
+  default:
+    return "unknown";
+  }
+}
+
+int flash_trace_format(const flash_trace_event_t *event, char *text, uint32_t size)
+{
+  uint8_t type = event->type & ~FLASH_TRACE_EXIT;
+  const char *when = "";
+
+  if (is_driver_function(type))
+  {
+    when = (event->type & FLASH_TRACE_EXIT) ? " exit" : " enter";
+  }
+
+  if (event->id == FLASH_TRACE_NO_ID)
+  {
+    return snprintf(text, size, "%lu %s%s address 0x%08lX length %lu status %u", (unsigned long)event->timestamp,
+                    flash_trace_name(type), when, (unsigned long)event->address, (unsigned long)event->length, event->status);
+  }
+
+  return snprintf(text, size, "%lu %s%s id %u address 0x%08lX length %lu status %u", (unsigned long)event->timestamp,
+                  flash_trace_name(type), when, event->id, (unsigned long)event->address, (unsigned long)event->length, event->status);
+}
+
+uint32_t flash_trace_print(FILE *out, const uint8_t *bytes, uint32_t length)
+{
+  uint32_t printed = 0;
+  uint32_t depth = 0;
+  char text[128];
+
+  for (uint32_t offset = 0; offset + FLASH_TRACE_EVENT_SIZE <= length; offset += FLASH_TRACE_EVENT_SIZE)
+  {
+    flash_trace_event_t event;
+
+    if (flash_trace_decode(&bytes[offset], length - offset, &event) != FLASH_OK)
+    {
+      continue;
+    }
+
+    // A ring that has gone round can start part way into a call, so its exit has nothing to go back out of.
+    bool exit = (event.type & FLASH_TRACE_EXIT) != 0;
+    if (exit && depth > 0)
+    {
+      depth--;
+    }
+
+    flash_trace_format(&event, text, sizeof(text));
+    fprintf(out, "%*s%s\n", (int)(2 * ((depth < TRACE_MAX_DEPTH) ? depth : TRACE_MAX_DEPTH)), "", text);
+    printed++;
+
+    if (!exit && is_driver_function(event.type))
+    {
+      depth++;
+    }
+  }
+
+  return printed;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file bench.h
+ * @brief Tiny harness for timing the driver against the spy backend. Benchmarks register themselves with
+ * BENCH() and are all run by bench_main.cpp.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+/* PUBLIC TYPES */
+
+/**
+ * @brief A benchmark body.
+ */
+typedef void (*bench_fn)(void);
+
+/**
+ * @brief Adds a benchmark to the list that gets run. Use the BENCH() macro rather than this directly.
+ */
+struct bench_registrar
+{
+    bench_registrar(const char * name, bench_fn fn);
+};
+
+/* PUBLIC DEFINES */
+
+/**
+ * @brief Define and register a benchmark.
+ */
+#define BENCH(name) \
+    static void bench_##name(void); \
+    static bench_registrar bench_registrar_##name(#name, bench_##name); \
+    static void bench_##name(void)
+
+/* PUBLIC FUNCTION DECLARATIONS */
+
+/**
+ * @brief Monotonic time in nanoseconds.
+ */
+uint64_t bench_now_ns(void);
+
+/**
+ * @brief Report the timing of a benchmark case.
+ *
+ * @param name Name of the case.
+ * @param ops Number of operations that were timed.
+ * @param elapsed_ns Total time taken for all the operations.
+ */
+void bench_report(const char * name, uint32_t ops, uint64_t elapsed_ns);
+
+/**
+ * @brief Report some other measurement of a benchmark case.
+ *
+ * @param name Name of the case.
+ * @param metric What was measured.
+ * @param value The measured value.
+ */
+void bench_metric(const char * name, const char * metric, double value);
+
+#endif
@@ -0,0 +1,60 @@
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <string.h>
+#include "../spies/flash_spy.h"
+}
+
+bench_backend_counts_t bench_backend_counts;
+
+/* Word size of the spy so programmed bytes can be counted. */
+static uint8_t backend_word_size = 0;
+/* Page size of the spy, for giving the driver fewer pages. */
+static uint16_t backend_page_size = 0;
+
+static flash_status_t counting_write(uint32_t write_address, uint8_t * data, uint16_t number_of_words)
+{
+    bench_backend_counts.write_calls++;
+    bench_backend_counts.bytes_programmed += number_of_words * backend_word_size;
+    return flash_spy_write(write_address, data, number_of_words);
+}
+
+static flash_status_t counting_read(uint32_t read_address, uint8_t * data, uint16_t read_length)
+{
+    bench_backend_counts.read_calls++;
+    bench_backend_counts.bytes_read += read_length;
+    return flash_spy_read(read_address, data, read_length);
+}
+
+static flash_status_t counting_erase(uint8_t start_page, uint8_t number_of_pages)
+{
+    bench_backend_counts.erase_calls++;
+    bench_backend_counts.pages_erased += number_of_pages;
+    return flash_spy_erase_pages(start_page, number_of_pages);
+}
+
+void bench_backend_init(uint8_t word_size, uint16_t page_size, uint8_t number_of_pages)
+{
+    backend_word_size = word_size;
+    backend_page_size = page_size;
+    flash_spy_init(word_size, page_size, page_size * number_of_pages);
+    flash_init(counting_write, counting_read, counting_erase, word_size, page_size, number_of_pages, 0, 0, FLASH_ENDIANESS_LITTLE);
+    bench_backend_reset_counts();
+}
+
+void bench_backend_set_user_pages(uint8_t number_of_pages)
+{
+    flash_init(counting_write, counting_read, counting_erase, backend_word_size, backend_page_size, number_of_pages, 0, 0, FLASH_ENDIANESS_LITTLE);
+}
+
+void bench_backend_deinit(void)
+{
+    flash_init(0, 0, 0, 0, 0, 0, 0, 0, FLASH_ENDIANESS_LITTLE);
+    flash_spy_deinit();
+}
+
+void bench_backend_reset_counts(void)
+{
+    memset(&bench_backend_counts, 0, sizeof(bench_backend_counts));
+}
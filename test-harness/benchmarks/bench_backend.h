@@ -0,0 +1,64 @@
+/**
+ * @file bench_backend.h
+ * @brief Wraps the spy flash functions to count the calls the driver makes to them.
+ */
+
+#ifndef BENCH_BACKEND_H
+#define BENCH_BACKEND_H
+
+extern "C"
+{
+#include "../../inc/flash.h"
+}
+
+/* PUBLIC TYPES */
+
+/**
+ * @brief Counts of calls into the spy backend.
+ */
+typedef struct{
+	uint32_t write_calls;
+	uint32_t bytes_programmed;
+	uint32_t read_calls;
+	uint32_t bytes_read;
+	uint32_t erase_calls;
+	uint32_t pages_erased;
+}bench_backend_counts_t;
+
+/* PUBLIC VARIABLES */
+
+/**
+ * @brief Counts since the last bench_backend_init.
+ */
+extern bench_backend_counts_t bench_backend_counts;
+
+/* PUBLIC FUNCTION DECLARATIONS */
+
+/**
+ * @brief Initialise the spy and the flash driver to use the counting backend.
+ *
+ * @param word_size Word size of the flash.
+ * @param page_size Page size of the flash.
+ * @param number_of_pages Number of pages in the flash. The driver gets all of them starting from page 0.
+ */
+void bench_backend_init(uint8_t word_size, uint16_t page_size, uint8_t number_of_pages);
+
+/**
+ * @brief Give the driver only the first few pages of the flash, e.g. to leave the rest for wear leveling. Call after
+ * bench_backend_init, it initialises the driver again.
+ *
+ * @param number_of_pages Number of pages the driver gets starting from page 0.
+ */
+void bench_backend_set_user_pages(uint8_t number_of_pages);
+
+/**
+ * @brief Free the spy.
+ */
+void bench_backend_deinit(void);
+
+/**
+ * @brief Zero the counts.
+ */
+void bench_backend_reset_counts(void);
+
+#endif
@@ -0,0 +1,45 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_RECORD_SIZE 16
+#define BENCH_LAPS 4
+#define BENCH_RECORDS (BENCH_LAPS * 8 * BENCH_PAGE_SIZE / BENCH_RECORD_SIZE)
+
+/* Append records to an 8 data page index for several laps with a checkpoint policy and measure how much more is
+ * programmed and erased than the records themselves. */
+static void append_with_checkpoint(const char * name, flash_checkpoint_policy_t policy, uint32_t every)
+{
+    uint8_t record[BENCH_RECORD_SIZE] = {0x11};
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(0, 8);
+    flash_index_set_checkpoint(id, policy, every);
+    flash_index_erase_index(id);
+    bench_backend_reset_counts();
+
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_RECORDS; idx++)
+    {
+        flash_index_write(id, record, sizeof(record));
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, BENCH_RECORDS, elapsed);
+    bench_metric(name, "write amplification", (double)bench_backend_counts.bytes_programmed / (BENCH_RECORDS * BENCH_RECORD_SIZE));
+    bench_metric(name, "program calls/record", (double)bench_backend_counts.write_calls / BENCH_RECORDS);
+    bench_metric(name, "pages erased", bench_backend_counts.pages_erased);
+
+    bench_backend_deinit();
+}
+
+BENCH(index_checkpoint_policies)
+{
+    append_with_checkpoint("checkpoint every write", FLASH_CHECKPOINT_EVERY_WRITE, 0);
+    append_with_checkpoint("checkpoint every 16 records", FLASH_CHECKPOINT_RECORDS, 16);
+    append_with_checkpoint("checkpoint every 1024 bytes", FLASH_CHECKPOINT_BYTES, 1024);
+    append_with_checkpoint("checkpoint on page", FLASH_CHECKPOINT_PAGE, 0);
+    append_with_checkpoint("checkpoint manual", FLASH_CHECKPOINT_MANUAL, 0);
+}
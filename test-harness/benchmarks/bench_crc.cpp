@@ -0,0 +1,51 @@
+#include "bench.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "../../inc/flash_crc.h"
+}
+
+#define BENCH_BYTES (64u * 1024 * 1024)
+
+/* CRC the same buffer over and over, BENCH_BYTES in total. */
+static void crc_throughput(flash_crc_impl_t impl, const char * impl_name, uint32_t length)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "crc32c %s %u bytes", impl_name, length);
+
+    static uint8_t data[4096];
+    for (uint32_t idx = 0; idx < sizeof(data); idx++)
+    {
+        data[idx] = idx * 37 + 11;
+    }
+
+    uint32_t ops = BENCH_BYTES / length;
+    volatile uint32_t crc = 0;
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < ops; idx++)
+    {
+        crc = flash_crc32c_impl(impl, crc, data, length);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, ops, elapsed);
+    bench_metric(name, "MB/s", (double)ops * length * 1000.0 / elapsed);
+}
+
+BENCH(crc32c)
+{
+    uint32_t lengths[] = {16, 256, 4096};
+
+    if (!flash_crc_hardware_available())
+    {
+        printf("No CRC-32C instruction, hardware is slicing-by-8\n");
+    }
+
+    for (uint8_t idx = 0; idx < sizeof(lengths) / sizeof(lengths[0]); idx++)
+    {
+        crc_throughput(FLASH_CRC_BYTEWISE, "bytewise", lengths[idx]);
+        crc_throughput(FLASH_CRC_SLICE8, "slice8", lengths[idx]);
+        crc_throughput(FLASH_CRC_HARDWARE, "hardware", lengths[idx]);
+    }
+}
@@ -0,0 +1,83 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "../spies/flash_spy.h"
+}
+
+#define BENCH_PAGE_SIZE 4096
+#define BENCH_PAGES 16
+#define BENCH_RECORD_SIZE 32
+#define BENCH_LAPS 2
+#define BENCH_RECORDS (BENCH_LAPS * 8 * BENCH_PAGE_SIZE / BENCH_RECORD_SIZE)
+#define BENCH_POLL_INTERVAL 8
+
+/* A simulated device and the word size that goes with it. */
+typedef struct{
+    const char * name;
+    const flash_spy_timing_t * timing;
+    uint8_t word_size;
+}bench_device_t;
+
+static const bench_device_t devices[] = {
+    {"STM32WB", &flash_spy_timing_stm32wb, 8},
+    {"SPI NOR", &flash_spy_timing_spi_nor, 1},
+};
+
+/* Append records to an 8 data page index for a couple of laps on a simulated device, calling flash_poll between bursts
+ * of writes as idle time, and report how long the device was busy rather than how long the host took. */
+static void append_on_device(const bench_device_t * device, const char * strategy, flash_checkpoint_policy_t policy, uint32_t every, uint8_t erase_ahead_pages)
+{
+    char name[96];
+    snprintf(name, sizeof(name), "%s, %s", device->name, strategy);
+    uint8_t record[BENCH_RECORD_SIZE] = {0x11};
+
+    bench_backend_init(device->word_size, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(1, 9);
+    flash_index_set_checkpoint(id, policy, every);
+    flash_index_set_erase_ahead(id, erase_ahead_pages);
+    flash_index_erase_index(id);
+    flash_spy_set_timing(device->timing);
+
+    uint64_t elapsed = 0;
+    uint64_t write_path_ns = 0;
+    uint64_t slowest_ns = 0;
+    for (uint32_t idx = 0; idx < BENCH_RECORDS; idx++)
+    {
+        if (idx % BENCH_POLL_INTERVAL == 0)
+        {
+            flash_poll();
+        }
+
+        uint64_t device_start = flash_spy_clock_ns();
+        uint64_t start = bench_now_ns();
+        flash_index_write(id, record, sizeof(record));
+        elapsed += bench_now_ns() - start;
+        uint64_t taken = flash_spy_clock_ns() - device_start;
+
+        write_path_ns += taken;
+        slowest_ns = (taken > slowest_ns) ? taken : slowest_ns;
+    }
+
+    bench_report(name, BENCH_RECORDS, elapsed);
+    bench_metric(name, "device us/record", flash_spy_clock_ns() / 1000.0 / BENCH_RECORDS);
+    bench_metric(name, "device us/record on the write path", write_path_ns / 1000.0 / BENCH_RECORDS);
+    bench_metric(name, "slowest write device us", slowest_ns / 1000.0);
+
+    bench_backend_deinit();
+}
+
+/* Simulated device time of checkpointing and erasing strategies. The host time of the same runs is in the other
+ * benchmarks, with an instant spy it hides what erasing and programming really cost. */
+BENCH(device_time)
+{
+    for (uint8_t idx = 0; idx < sizeof(devices) / sizeof(devices[0]); idx++)
+    {
+        append_on_device(&devices[idx], "checkpoint every write", FLASH_CHECKPOINT_EVERY_WRITE, 0, 0);
+        append_on_device(&devices[idx], "checkpoint every 16 records", FLASH_CHECKPOINT_RECORDS, 16, 0);
+        append_on_device(&devices[idx], "checkpoint on page", FLASH_CHECKPOINT_PAGE, 0, 0);
+        append_on_device(&devices[idx], "checkpoint on page, erase 2 pages ahead", FLASH_CHECKPOINT_PAGE, 0, 2);
+    }
+}
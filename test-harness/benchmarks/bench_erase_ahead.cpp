@@ -0,0 +1,57 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_RECORD_SIZE 64
+#define BENCH_LAPS 10
+#define BENCH_RECORDS (BENCH_LAPS * 8 * BENCH_PAGE_SIZE / BENCH_RECORD_SIZE)
+#define BENCH_POLL_INTERVAL 8
+
+/* Append records to an 8 data page index for several laps, calling flash_poll between bursts of writes as idle time. */
+static void append_laps(const char * name, uint8_t erase_ahead_pages)
+{
+    uint8_t record[BENCH_RECORD_SIZE] = {0x11};
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(1, 9);
+    flash_index_set_erase_ahead(id, erase_ahead_pages);
+
+    uint64_t elapsed = 0;
+    uint64_t slowest = 0;
+    uint32_t write_path_erases = 0;
+    for (uint32_t idx = 0; idx < BENCH_RECORDS; idx++)
+    {
+        if (idx % BENCH_POLL_INTERVAL == 0)
+        {
+            flash_poll();
+        }
+
+        uint32_t erases_before = bench_backend_counts.pages_erased;
+        uint64_t start = bench_now_ns();
+        flash_index_write(id, record, sizeof(record));
+        uint64_t taken = bench_now_ns() - start;
+        write_path_erases += bench_backend_counts.pages_erased - erases_before;
+
+        elapsed += taken;
+        slowest = (taken > slowest) ? taken : slowest;
+    }
+
+    bench_report(name, BENCH_RECORDS, elapsed);
+    bench_metric(name, "erase stalls", flash_index_get_erase_stalls(id));
+    bench_metric(name, "pages erased on the write path", write_path_erases);
+    bench_metric(name, "slowest write ns", (double)slowest);
+
+    bench_backend_deinit();
+}
+
+BENCH(index_append_erase_inline)
+{
+    append_laps("index append 64 bytes, erase inline", 0);
+}
+
+BENCH(index_append_erase_ahead)
+{
+    append_laps("index append 64 bytes, erase 2 pages ahead", 2);
+}
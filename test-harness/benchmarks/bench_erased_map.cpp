@@ -0,0 +1,51 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_CHECKPOINTS 200
+#define BENCH_LOOKUPS 1000
+
+static uint8_t map[FLASH_ERASED_MAP_SIZE(BENCH_PAGES, BENCH_PAGE_SIZE, BENCH_WORD_SIZE)];
+
+/* Find the latest index data on an index page that has BENCH_CHECKPOINTS entries on it. */
+static void lookup_index_address(const char * name, bool use_map)
+{
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    if (use_map)
+    {
+        flash_set_erased_map(map, sizeof(map));
+    }
+
+    int id = flash_index_register(1, 9);
+    flash_index_erase_index(id);
+    for (uint32_t idx = 0; idx < BENCH_CHECKPOINTS; idx++)
+    {
+        flash_index_write_index(id);
+    }
+
+    bench_backend_reset_counts();
+    uint32_t address = 0;
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_LOOKUPS; idx++)
+    {
+        flash_index_get_index_address(id, &address);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, BENCH_LOOKUPS, elapsed);
+    bench_metric(name, "flash reads/lookup", (double)bench_backend_counts.read_calls / BENCH_LOOKUPS);
+
+    bench_backend_deinit();
+}
+
+BENCH(index_address_lookup_reading_flash)
+{
+    lookup_index_address("index address lookup, 200 entries, flash reads", false);
+}
+
+BENCH(index_address_lookup_erased_map)
+{
+    lookup_index_address("index address lookup, 200 entries, erased map", true);
+}
@@ -0,0 +1,141 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <pthread.h>
+#include <sched.h>
+#include "../../inc/flash_async.h"
+}
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 4
+#define BENCH_RECORD_SIZE 24
+#define BENCH_PRODUCERS 4
+#define BENCH_RECORDS_PER_PRODUCER 20000
+#define BENCH_IN_FLIGHT 8
+#define BENCH_SLOTS 64
+
+static int bench_index;
+static pthread_mutex_t flash_lock = PTHREAD_MUTEX_INITIALIZER;
+static flash_async_t queue;
+static flash_async_slot_t slots[BENCH_SLOTS];
+static volatile bool producers_running;
+
+/* Each producer writes its records straight to the index, taking a lock around every call. */
+static void * locked_producer(void * arg)
+{
+    uint8_t record[BENCH_RECORD_SIZE] = {0};
+    record[0] = (uint8_t)(uintptr_t)arg;
+    for (uint32_t idx = 0; idx < BENCH_RECORDS_PER_PRODUCER; idx++)
+    {
+        pthread_mutex_lock(&flash_lock);
+        flash_index_write(bench_index, record, BENCH_RECORD_SIZE);
+        pthread_mutex_unlock(&flash_lock);
+    }
+    return NULL;
+}
+
+/* Each producer keeps a few records in flight in the queue, reusing an operation once it is complete. */
+static void * queued_producer(void * arg)
+{
+    uint8_t records[BENCH_IN_FLIGHT][BENCH_RECORD_SIZE] = {{0}};
+    flash_async_op_t ops[BENCH_IN_FLIGHT] = {};
+    uint32_t submitted = 0;
+    uint32_t completed = 0;
+
+    while (completed < BENCH_RECORDS_PER_PRODUCER)
+    {
+        for (uint8_t slot = 0; slot < BENCH_IN_FLIGHT; slot++)
+        {
+            flash_async_op_t * op = &ops[slot];
+            if (op->state == FLASH_ASYNC_PENDING && !flash_async_is_complete(op))
+            {
+                continue;
+            }
+            if (flash_async_is_complete(op))
+            {
+                completed++;
+                op->state = FLASH_ASYNC_IDLE;
+            }
+            if (submitted < BENCH_RECORDS_PER_PRODUCER)
+            {
+                records[slot][0] = (uint8_t)(uintptr_t)arg;
+                op->type = FLASH_ASYNC_INDEX_WRITE;
+                op->id = bench_index;
+                op->data = records[slot];
+                op->length = BENCH_RECORD_SIZE;
+                if (flash_async_submit(&queue, op) == FLASH_OK)
+                {
+                    submitted++;
+                }
+            }
+        }
+        sched_yield();
+    }
+    return NULL;
+}
+
+/* The worker yields while the queue is empty and stops once the producers are done. */
+static bool worker_idle(flash_async_t * idle_queue)
+{
+    (void)idle_queue;
+    sched_yield();
+    return producers_running;
+}
+
+static void * worker(void * arg)
+{
+    (void)arg;
+    flash_async_worker(&queue, worker_idle);
+    flash_async_process(&queue, 0);
+    return NULL;
+}
+
+/* Time the producers until all their records are written. */
+static void run_producers(const char * name, void * (*producer)(void *))
+{
+    pthread_t threads[BENCH_PRODUCERS];
+    uint64_t start = bench_now_ns();
+    for (uintptr_t idx = 0; idx < BENCH_PRODUCERS; idx++)
+    {
+        pthread_create(&threads[idx], NULL, producer, (void *)idx);
+    }
+    for (uint8_t idx = 0; idx < BENCH_PRODUCERS; idx++)
+    {
+        pthread_join(threads[idx], NULL);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, BENCH_PRODUCERS * BENCH_RECORDS_PER_PRODUCER, elapsed);
+}
+
+BENCH(index_write_from_threads_with_lock)
+{
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    // One data page so the ring wraps and erases the same way in both cases.
+    bench_index = flash_index_register(0, 1);
+
+    run_producers("4 threads, index write under a mutex", locked_producer);
+
+    bench_backend_deinit();
+}
+
+BENCH(index_write_from_threads_through_queue)
+{
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    // One data page so the ring wraps and erases the same way in both cases.
+    bench_index = flash_index_register(0, 1);
+    flash_async_init(&queue, flash_default_ctx(), slots, BENCH_SLOTS);
+
+    pthread_t worker_thread;
+    producers_running = true;
+    pthread_create(&worker_thread, NULL, worker, NULL);
+
+    run_producers("4 threads, index write through the async queue", queued_producer);
+
+    producers_running = false;
+    pthread_join(worker_thread, NULL);
+    bench_backend_deinit();
+}
@@ -0,0 +1,111 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <string.h>
+#include "../spies/flash_spy.h"
+}
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_BLOB_SIZE (8 * BENCH_PAGE_SIZE)
+#define BENCH_REPEATS 200
+
+static uint8_t blob[BENCH_BLOB_SIZE];
+
+/* Report a transfer rate along with the timing. */
+static void report_transfer(const char * name, uint64_t elapsed_ns)
+{
+    bench_report(name, BENCH_REPEATS, elapsed_ns);
+    bench_metric(name, "MB/s", (double)BENCH_BLOB_SIZE * BENCH_REPEATS * 1e3 / elapsed_ns);
+    bench_metric(name, "backend calls/transfer", (double)(bench_backend_counts.write_calls + bench_backend_counts.read_calls) / BENCH_REPEATS);
+}
+
+BENCH(blob_write_in_max_size_calls)
+{
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    memset(blob, 0x5A, sizeof(blob));
+
+    uint64_t elapsed = 0;
+    for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++)
+    {
+        flash_spy_erase_all();
+        uint64_t start = bench_now_ns();
+        for (uint32_t offset = 0; offset < BENCH_BLOB_SIZE; offset += FLASH_MAX_WRITE_SIZE)
+        {
+            flash_write(offset, &blob[offset], FLASH_MAX_WRITE_SIZE);
+        }
+        elapsed += bench_now_ns() - start;
+    }
+
+    report_transfer("blob write, FLASH_MAX_WRITE_SIZE calls", elapsed);
+    bench_backend_deinit();
+}
+
+BENCH(blob_write_bulk)
+{
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    memset(blob, 0x5A, sizeof(blob));
+
+    uint64_t elapsed = 0;
+    for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++)
+    {
+        flash_spy_erase_all();
+        uint64_t start = bench_now_ns();
+        flash_write_bulk(0, blob, BENCH_BLOB_SIZE);
+        elapsed += bench_now_ns() - start;
+    }
+
+    report_transfer("blob write, flash_write_bulk", elapsed);
+    bench_backend_deinit();
+}
+
+BENCH(blob_read_in_max_size_calls)
+{
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+
+    uint64_t start = bench_now_ns();
+    for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++)
+    {
+        for (uint32_t offset = 0; offset < BENCH_BLOB_SIZE; offset += FLASH_MAX_WRITE_SIZE)
+        {
+            flash_read(offset, &blob[offset], FLASH_MAX_WRITE_SIZE);
+        }
+    }
+
+    report_transfer("blob read, FLASH_MAX_WRITE_SIZE calls", bench_now_ns() - start);
+    bench_backend_deinit();
+}
+
+BENCH(blob_read_bulk)
+{
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+
+    uint64_t start = bench_now_ns();
+    for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++)
+    {
+        flash_read_bulk(0, blob, BENCH_BLOB_SIZE);
+    }
+
+    report_transfer("blob read, flash_read_bulk", bench_now_ns() - start);
+    bench_backend_deinit();
+}
+
+BENCH(blob_index_write_bulk_wrapping)
+{
+    // Six data pages so every blob wraps the index somewhere.
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(1, 7);
+    memset(blob, 0x5A, sizeof(blob));
+
+    uint64_t start = bench_now_ns();
+    for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++)
+    {
+        flash_index_write_bulk(id, blob, BENCH_BLOB_SIZE);
+    }
+
+    report_transfer("blob index write, flash_index_write_bulk", bench_now_ns() - start);
+    bench_backend_deinit();
+}
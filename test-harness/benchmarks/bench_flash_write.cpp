@@ -0,0 +1,74 @@
+#include "bench.h"
+
+extern "C"
+{
+#include <string.h>
+#include "../../inc/flash.h"
+#include "../spies/flash_spy.h"
+}
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_FLASH_SIZE 32768
+#define BENCH_RECORDS 100000
+
+/* The record the driver is currently writing and how many bytes the backend got from somewhere else. */
+static const uint8_t * record_start = NULL;
+static const uint8_t * record_end = NULL;
+static uint32_t staged_bytes = 0;
+
+/* Spy backend that counts every byte handed over from outside the caller's record as staged. */
+static flash_status_t counting_write(uint32_t write_address, uint8_t * data, uint16_t number_of_words)
+{
+    if (data < record_start || data >= record_end)
+    {
+        staged_bytes += number_of_words * BENCH_WORD_SIZE;
+    }
+    return flash_spy_write(write_address, data, number_of_words);
+}
+
+/* Write records of record_size back to back, starting again from an erased flash whenever it fills up. */
+static void write_records(const char * name, uint16_t record_size)
+{
+    flash_spy_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_FLASH_SIZE);
+    flash_init(counting_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_FLASH_SIZE / BENCH_PAGE_SIZE, 0, 0, FLASH_ENDIANESS_LITTLE);
+
+    uint8_t record[FLASH_MAX_WRITE_SIZE];
+    memset(record, 0x5A, sizeof(record));
+    record_start = record;
+    record_end = record + record_size;
+    staged_bytes = 0;
+
+    uint16_t record_footprint = ((record_size + BENCH_WORD_SIZE - 1) / BENCH_WORD_SIZE) * BENCH_WORD_SIZE;
+    uint32_t address = 0;
+
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_RECORDS; idx++)
+    {
+        if (address + record_footprint > BENCH_FLASH_SIZE)
+        {
+            flash_spy_erase_all();
+            address = 0;
+        }
+        flash_write(address, record, record_size);
+        address += record_footprint;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, BENCH_RECORDS, elapsed);
+    bench_metric(name, "staged bytes/record", (double)staged_bytes / BENCH_RECORDS);
+    // Before whole words were handed straight to the backend the padding buffer was reset and the record copied in.
+    bench_metric(name, "previously staged bytes/record", FLASH_MAX_WRITE_SIZE + record_size);
+
+    flash_spy_deinit();
+}
+
+BENCH(flash_write_aligned_record)
+{
+    write_records("flash_write 64 byte record", 64);
+}
+
+BENCH(flash_write_unaligned_record)
+{
+    write_records("flash_write 61 byte record", 61);
+}
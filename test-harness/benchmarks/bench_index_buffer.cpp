@@ -0,0 +1,60 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_RECORD_SIZE 12
+#define BENCH_RECORDS 900
+#define BENCH_ROUNDS 20
+
+/* Append small records to an index with a write buffer of buffer_size, 0 for none. */
+static void append_records(const char * name, uint16_t buffer_size)
+{
+    static uint8_t buffer[BENCH_PAGE_SIZE];
+    uint8_t record[BENCH_RECORD_SIZE] = {0x11};
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(1, 9);
+    if (buffer_size > 0)
+    {
+        flash_index_set_write_buffer(id, buffer, buffer_size, 0, 0);
+    }
+
+    // Each round stays inside one lap of the index so no page needs erasing mid round.
+    uint64_t elapsed = 0;
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+        flash_index_erase_all_data(id);
+        flash_index_reset(id);
+
+        uint64_t start = bench_now_ns();
+        for (uint32_t idx = 0; idx < BENCH_RECORDS; idx++)
+        {
+            flash_index_write(id, record, sizeof(record));
+        }
+        flash_index_flush(id);
+        elapsed += bench_now_ns() - start;
+    }
+
+    bench_report(name, BENCH_RECORDS * BENCH_ROUNDS, elapsed);
+    bench_metric(name, "program calls/record", (double)bench_backend_counts.write_calls / (BENCH_RECORDS * BENCH_ROUNDS));
+    bench_metric(name, "programmed bytes/record", (double)bench_backend_counts.bytes_programmed / (BENCH_RECORDS * BENCH_ROUNDS));
+
+    bench_backend_deinit();
+}
+
+BENCH(index_append_unbuffered)
+{
+    append_records("index append 12 bytes, no buffer", 0);
+}
+
+BENCH(index_append_word_buffer)
+{
+    append_records("index append 12 bytes, 64 byte buffer", 64);
+}
+
+BENCH(index_append_page_buffer)
+{
+    append_records("index append 12 bytes, page buffer", BENCH_PAGE_SIZE);
+}
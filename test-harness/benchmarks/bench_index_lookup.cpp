@@ -0,0 +1,76 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <stdio.h>
+}
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 4096
+#define BENCH_PAGES 16
+#define BENCH_LOOKUPS 1000
+
+/* Find the latest index data on an index page filled to fill_percent with index entries. */
+static void lookup_at_fill(uint8_t fill_percent)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "index address lookup, page %u%% full", fill_percent);
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(1, 9);
+    flash_index_erase_index(id);
+
+    uint32_t entries = (BENCH_PAGE_SIZE / BENCH_WORD_SIZE) * fill_percent / 100;
+    for (uint32_t idx = 0; idx < entries; idx++)
+    {
+        flash_index_write_index(id);
+    }
+
+    bench_backend_reset_counts();
+    uint32_t address = 0;
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_LOOKUPS; idx++)
+    {
+        flash_index_get_index_address(id, &address);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, BENCH_LOOKUPS, elapsed);
+    bench_metric(name, "flash reads/lookup", (double)bench_backend_counts.read_calls / BENCH_LOOKUPS);
+
+    bench_backend_deinit();
+}
+
+BENCH(index_address_lookup_by_fill)
+{
+    lookup_at_fill(0);
+    lookup_at_fill(10);
+    lookup_at_fill(50);
+    lookup_at_fill(90);
+    lookup_at_fill(100);
+}
+
+/* Write index data over and over, wrapping round the index page a few times. */
+BENCH(index_write_index)
+{
+    const char * name = "index write index";
+    uint32_t writes = 4 * (BENCH_PAGE_SIZE / BENCH_WORD_SIZE);
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(1, 9);
+    flash_index_erase_index(id);
+
+    bench_backend_reset_counts();
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < writes; idx++)
+    {
+        flash_index_write_index(id);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, writes, elapsed);
+    bench_metric(name, "flash reads/write", (double)bench_backend_counts.read_calls / writes);
+
+    bench_backend_deinit();
+}
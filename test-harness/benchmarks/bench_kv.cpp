@@ -0,0 +1,75 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include "../../inc/flash_kv.h"
+}
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_MAX_KEYS 128
+#define BENCH_GETS 100000
+
+static flash_kv_slot_t slots[2 * BENCH_MAX_KEYS];
+
+/* Set a number of keys round and round until the index is nearly full, then get them all over and over. */
+static void kv_keys(uint16_t key_count, uint16_t value_size)
+{
+    char name[64];
+    uint8_t key[16];
+    uint8_t value[64] = {0};
+    uint16_t length = 0;
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(0, 12);
+    flash_index_set_checkpoint(id, FLASH_CHECKPOINT_PAGE, 0);
+    flash_kv_t kv;
+    flash_kv_init(&kv, flash_default_ctx(), id, slots, 2 * key_count);
+    bench_backend_reset_counts();
+
+    // About 10 of the 12 data pages.
+    uint32_t record_size = flash_record_size(&kv.log, FLASH_KV_OVERHEAD + 8 + value_size);
+    uint32_t sets = 10 * (BENCH_PAGE_SIZE / record_size);
+
+    snprintf(name, sizeof(name), "kv set %u keys %u byte values", key_count, value_size);
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < sets; idx++)
+    {
+        snprintf((char *)key, sizeof(key), "key%05u", (unsigned)(idx % key_count));
+        flash_kv_set(&kv, key, 8, value, value_size);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, sets, elapsed);
+    bench_metric(name, "program calls/set", (double)bench_backend_counts.write_calls / sets);
+
+    bench_backend_reset_counts();
+    snprintf(name, sizeof(name), "kv get %u keys %u byte values", key_count, value_size);
+    start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_GETS; idx++)
+    {
+        snprintf((char *)key, sizeof(key), "key%05u", (unsigned)(idx % key_count));
+        flash_kv_get(&kv, key, 8, value, sizeof(value), &length);
+    }
+    elapsed = bench_now_ns() - start;
+
+    bench_report(name, BENCH_GETS, elapsed);
+    bench_metric(name, "backend reads/get", (double)bench_backend_counts.read_calls / BENCH_GETS);
+
+    bench_backend_deinit();
+}
+
+BENCH(kv)
+{
+    uint16_t key_counts[] = {16, 64, 128};
+
+    for (uint8_t idx = 0; idx < sizeof(key_counts) / sizeof(key_counts[0]); idx++)
+    {
+        kv_keys(key_counts[idx], 16);
+        kv_keys(key_counts[idx], 64);
+    }
+}
@@ -0,0 +1,88 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "../../inc/flash_kv.h"
+}
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_COLD_KEYS 32
+#define BENCH_HOT_KEYS 4
+#define BENCH_UPDATES 4000
+
+static flash_kv_slot_t slots[4 * (BENCH_COLD_KEYS + BENCH_HOT_KEYS)];
+static uint8_t gc_buffer[BENCH_PAGE_SIZE];
+static uint8_t erased_map[FLASH_ERASED_MAP_SIZE(BENCH_PAGES, BENCH_PAGE_SIZE, BENCH_WORD_SIZE)];
+
+/* A few keys updated over and over among many that are set once, collecting with a budget after every set. */
+static void kv_gc(const char * budget_name, uint32_t max_bytes, uint32_t max_operations)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "kv gc %s", budget_name);
+
+    uint8_t key[16];
+    uint8_t value[64] = {0};
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    flash_set_erased_map(erased_map, sizeof(erased_map));
+    int hot_id = flash_index_register(0, 6);
+    int cold_id = flash_index_register(7, 14);
+    flash_index_set_checkpoint(hot_id, FLASH_CHECKPOINT_PAGE, 0);
+    flash_index_set_checkpoint(cold_id, FLASH_CHECKPOINT_PAGE, 0);
+
+    flash_kv_t kv;
+    flash_kv_init(&kv, flash_default_ctx(), hot_id, slots, sizeof(slots) / sizeof(slots[0]));
+    flash_kv_set_gc(&kv, cold_id, gc_buffer, sizeof(gc_buffer), 2);
+
+    for (uint16_t idx = 0; idx < BENCH_COLD_KEYS; idx++)
+    {
+        snprintf((char *)key, sizeof(key), "cold%04u", idx);
+        flash_kv_set(&kv, key, 8, value, sizeof(value));
+    }
+    bench_backend_reset_counts();
+
+    uint32_t steps = 0;
+    uint32_t failed = 0;
+    uint64_t longest = 0;
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_UPDATES; idx++)
+    {
+        snprintf((char *)key, sizeof(key), "hot%05u", (unsigned)(idx % BENCH_HOT_KEYS));
+        value[0] = idx;
+        if (flash_kv_set(&kv, key, 8, value, sizeof(value)) != FLASH_OK)
+        {
+            failed++;
+        }
+
+        // One step per set, as if there were a little idle time between them.
+        uint64_t step_start = bench_now_ns();
+        if (flash_kv_gc_step(&kv, max_bytes, max_operations) == FLASH_OK)
+        {
+            steps++;
+        }
+        uint64_t step_time = bench_now_ns() - step_start;
+        longest = (step_time > longest) ? step_time : longest;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    uint32_t record_size = flash_record_size(&kv.log, FLASH_KV_OVERHEAD + 8 + sizeof(value));
+    bench_report(name, BENCH_UPDATES, elapsed);
+    bench_metric(name, "failed sets", failed);
+    bench_metric(name, "gc steps/set", (double)steps / BENCH_UPDATES);
+    bench_metric(name, "longest step ns", (double)longest);
+    bench_metric(name, "bytes programmed/record byte", (double)bench_backend_counts.bytes_programmed / ((double)BENCH_UPDATES * record_size));
+    bench_metric(name, "pages erased", bench_backend_counts.pages_erased);
+
+    bench_backend_deinit();
+}
+
+BENCH(kv_gc)
+{
+    kv_gc("whole page", 0, 0);
+    kv_gc("512 bytes", 512, 0);
+    kv_gc("2 records", 0, 2);
+}
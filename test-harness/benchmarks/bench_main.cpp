@@ -0,0 +1,103 @@
+#include "bench.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+/* The most benchmarks that can be registered. */
+#define BENCH_MAX 64
+
+struct bench_entry
+{
+    const char * name;
+    bench_fn fn;
+};
+
+static bench_entry benches[BENCH_MAX];
+static int bench_count = 0;
+
+/* Whether to print results as CSV rows of case, metric and value instead of lining them up to read. */
+static bool csv = false;
+
+/* Print a CSV field, quoted as case names can have commas in them. */
+static void csv_field(const char * text)
+{
+    putchar('"');
+    for (const char * character = text; *character != 0; character++)
+    {
+        if (*character == '"')
+        {
+            putchar('"');
+        }
+        putchar(*character);
+    }
+    putchar('"');
+}
+
+bench_registrar::bench_registrar(const char * name, bench_fn fn)
+{
+    if (bench_count < BENCH_MAX)
+    {
+        benches[bench_count].name = name;
+        benches[bench_count].fn = fn;
+        bench_count++;
+    }
+}
+
+uint64_t bench_now_ns(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void bench_report(const char * name, uint32_t ops, uint64_t elapsed_ns)
+{
+    double ns_per_op = ops ? (double)elapsed_ns / ops : 0;
+    double ops_per_sec = elapsed_ns ? ops * 1e9 / elapsed_ns : 0;
+
+    if (csv)
+    {
+        bench_metric(name, "ops", ops);
+        bench_metric(name, "ns/op", ns_per_op);
+        bench_metric(name, "ops/s", ops_per_sec);
+        return;
+    }
+
+    printf("%-48s %10u ops %12.1f ns/op %14.0f ops/s\n", name, ops, ns_per_op, ops_per_sec);
+}
+
+void bench_metric(const char * name, const char * metric, double value)
+{
+    if (csv)
+    {
+        csv_field(name);
+        putchar(',');
+        csv_field(metric);
+        printf(",%.10g\n", value);
+        return;
+    }
+
+    printf("%-48s %s = %.2f\n", name, metric, value);
+}
+
+/* Run every benchmark, or only those whose name contains the filter. "--csv" first prints machine readable results. */
+int main(int ac, char ** av)
+{
+    int arg = 1;
+    if (arg < ac && strcmp(av[arg], "--csv") == 0)
+    {
+        csv = true;
+        arg++;
+        printf("case,metric,value\n");
+    }
+
+    const char * filter = (arg < ac) ? av[arg] : NULL;
+
+    for (int idx = 0; idx < bench_count; idx++)
+    {
+        if (filter == NULL || strstr(benches[idx].name, filter) != NULL)
+        {
+            benches[idx].fn();
+        }
+    }
+
+    return 0;
+}
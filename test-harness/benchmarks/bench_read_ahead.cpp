@@ -0,0 +1,57 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_RECORD_SIZE 32
+#define BENCH_RECORDS 400
+#define BENCH_ROUNDS 50
+
+/* Fill an index with records then drain it record by record with flash_index_read. */
+static void drain_records(const char * name, uint16_t read_ahead_size)
+{
+    static uint8_t read_ahead[BENCH_PAGE_SIZE];
+    uint8_t record[BENCH_RECORD_SIZE] = {0x11};
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(1, 9);
+    if (read_ahead_size > 0)
+    {
+        flash_index_set_read_ahead(id, read_ahead, read_ahead_size);
+    }
+
+    uint64_t elapsed = 0;
+    uint32_t reads = 0;
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (uint32_t idx = 0; idx < BENCH_RECORDS; idx++)
+        {
+            flash_index_write(id, record, sizeof(record));
+        }
+
+        bench_backend_reset_counts();
+        uint64_t start = bench_now_ns();
+        for (uint32_t idx = 0; idx < BENCH_RECORDS; idx++)
+        {
+            flash_index_read(id, record, sizeof(record));
+        }
+        elapsed += bench_now_ns() - start;
+        reads += bench_backend_counts.read_calls;
+    }
+
+    bench_report(name, BENCH_RECORDS * BENCH_ROUNDS, elapsed);
+    bench_metric(name, "flash reads/record", (double)reads / (BENCH_RECORDS * BENCH_ROUNDS));
+
+    bench_backend_deinit();
+}
+
+BENCH(drain_index_record_by_record)
+{
+    drain_records("drain 32 byte records, no read ahead", 0);
+}
+
+BENCH(drain_index_with_page_read_ahead)
+{
+    drain_records("drain 32 byte records, page read ahead", BENCH_PAGE_SIZE);
+}
@@ -0,0 +1,63 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_RECORD_SIZE 32
+#define BENCH_RECORDS 200
+#define BENCH_LATEST 8
+#define BENCH_READS 100000
+#define BENCH_CACHE_SLOTS 4
+
+static flash_cache_slot_t slots[BENCH_CACHE_SLOTS];
+static uint8_t arena[BENCH_CACHE_SLOTS * BENCH_PAGE_SIZE];
+
+/* Consumers re-reading the latest few records behind the head of an index. */
+static void reread_latest(const char * name, bool use_cache)
+{
+    uint8_t record[BENCH_RECORD_SIZE] = {0x11};
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    if (use_cache)
+    {
+        flash_set_read_cache(slots, BENCH_CACHE_SLOTS, arena, sizeof(arena));
+    }
+
+    int id = flash_index_register(1, 9);
+    for (uint32_t idx = 0; idx < BENCH_RECORDS; idx++)
+    {
+        flash_index_write(id, record, sizeof(record));
+    }
+
+    bench_backend_reset_counts();
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_READS; idx++)
+    {
+        int position = -(int)((idx % BENCH_LATEST) + 1) * BENCH_RECORD_SIZE;
+        flash_index_read_rel_head(id, position, record, sizeof(record));
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, BENCH_READS, elapsed);
+    bench_metric(name, "flash reads/read", (double)bench_backend_counts.read_calls / BENCH_READS);
+    if (use_cache)
+    {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        flash_get_read_cache_counts(&hits, &misses);
+        bench_metric(name, "hit rate", (double)hits / (hits + misses));
+    }
+
+    bench_backend_deinit();
+}
+
+BENCH(reread_latest_records_uncached)
+{
+    reread_latest("re-read latest 8 records, no cache", false);
+}
+
+BENCH(reread_latest_records_cached)
+{
+    reread_latest("re-read latest 8 records, 4 page cache", true);
+}
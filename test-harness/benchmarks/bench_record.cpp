@@ -0,0 +1,65 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "../../inc/flash_record.h"
+}
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_BYTES (4 * 8 * BENCH_PAGE_SIZE)
+
+/* Write payloads of one size for a few laps of an 8 data page index, either as they are or as records. */
+static void write_payloads(uint16_t payload_size, bool framed)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "index write %u bytes%s", payload_size, framed ? " as records" : "");
+
+    uint8_t payload[256];
+    for (uint16_t idx = 0; idx < sizeof(payload); idx++)
+    {
+        payload[idx] = idx;
+    }
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(0, 8);
+    flash_index_set_checkpoint(id, FLASH_CHECKPOINT_PAGE, 0);
+    flash_record_log_t log;
+    flash_record_init(&log, flash_default_ctx(), id);
+    bench_backend_reset_counts();
+
+    uint32_t writes = BENCH_BYTES / payload_size;
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < writes; idx++)
+    {
+        if (framed)
+        {
+            flash_record_write(&log, payload, payload_size);
+        }
+        else
+        {
+            flash_index_write(id, payload, payload_size);
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, writes, elapsed);
+    bench_metric(name, "bytes programmed/payload byte", (double)bench_backend_counts.bytes_programmed / ((double)writes * payload_size));
+    bench_metric(name, "program calls/write", (double)bench_backend_counts.write_calls / writes);
+
+    bench_backend_deinit();
+}
+
+BENCH(record_encoding_overhead)
+{
+    uint16_t sizes[] = {16, 64, 256};
+
+    for (uint8_t idx = 0; idx < sizeof(sizes) / sizeof(sizes[0]); idx++)
+    {
+        write_payloads(sizes[idx], false);
+        write_payloads(sizes[idx], true);
+    }
+}
@@ -0,0 +1,81 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "../../inc/flash_record.h"
+}
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_FULL_PAGES 7
+
+/* Fill most of an 8 data page index with records of one size then read them all back, either at the tail or with an
+ * iterator going the given way. */
+static void read_records(uint16_t payload_size, bool iterate, flash_record_direction_t direction)
+{
+    char name[64];
+    const char * how = !iterate ? "read" : (direction == FLASH_RECORD_OLDEST_FIRST) ? "iterate" : "iterate newest first";
+    snprintf(name, sizeof(name), "%s %u byte records", how, payload_size);
+
+    uint8_t payload[256] = {0};
+    static uint8_t buffer[BENCH_PAGE_SIZE];
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    int id = flash_index_register(0, 8);
+    flash_index_set_checkpoint(id, FLASH_CHECKPOINT_PAGE, 0);
+    flash_record_log_t log;
+    flash_record_init(&log, flash_default_ctx(), id);
+
+    // Stop short of the tail, the index would write over it.
+    uint32_t record_size = (FLASH_RECORD_OVERHEAD + payload_size + BENCH_WORD_SIZE - 1) / BENCH_WORD_SIZE * BENCH_WORD_SIZE;
+    uint32_t records = BENCH_FULL_PAGES * (BENCH_PAGE_SIZE / record_size);
+    for (uint32_t idx = 0; idx < records; idx++)
+    {
+        flash_record_write(&log, payload, payload_size);
+    }
+    bench_backend_reset_counts();
+
+    uint32_t found = 0;
+    uint64_t start = bench_now_ns();
+    if (iterate)
+    {
+        flash_record_iter_t iter;
+        const uint8_t * data;
+        uint16_t length;
+        flash_record_iter_begin(&iter, &log, direction, buffer, sizeof(buffer));
+        while (flash_record_iter_next(&iter, &data, &length) == FLASH_OK)
+        {
+            found++;
+        }
+        flash_record_iter_end(&iter);
+    }
+    else
+    {
+        uint16_t length;
+        while (flash_record_read(&log, buffer, sizeof(buffer), &length) == FLASH_OK)
+        {
+            found++;
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, found, elapsed);
+    bench_metric(name, "backend reads/record", (double)bench_backend_counts.read_calls / found);
+
+    bench_backend_deinit();
+}
+
+BENCH(record_iterate)
+{
+    uint16_t sizes[] = {16, 64, 256};
+
+    for (uint8_t idx = 0; idx < sizeof(sizes) / sizeof(sizes[0]); idx++)
+    {
+        read_records(sizes[idx], false, FLASH_RECORD_OLDEST_FIRST);
+        read_records(sizes[idx], true, FLASH_RECORD_OLDEST_FIRST);
+        read_records(sizes[idx], true, FLASH_RECORD_NEWEST_FIRST);
+    }
+}
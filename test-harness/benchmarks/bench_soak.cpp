@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "../spies/flash_spy.h"
+}
+
+/* The geometry in user_code/user_flash.h, 50 pages of STM32WB flash. */
+#define SOAK_WORD_SIZE 8
+#define SOAK_PAGE_SIZE 4096
+#define SOAK_PAGES 50
+#define SOAK_RECORD_SIZE 16
+#define SOAK_LAPS 20
+
+/* Fill a page of the spy a word at a time, which used to scan the rest of the page on every word. */
+static void fill_page(uint16_t page_size)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "spy fill %u byte page by word", page_size);
+    uint32_t pages = 16;
+    uint8_t word[SOAK_WORD_SIZE] = {0};
+
+    flash_spy_init(SOAK_WORD_SIZE, page_size, pages * page_size);
+
+    uint64_t start = bench_now_ns();
+    for (uint32_t address = 0; address < pages * page_size; address += SOAK_WORD_SIZE)
+    {
+        flash_spy_write(address, word, 1);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, pages * page_size / SOAK_WORD_SIZE, elapsed);
+    flash_spy_deinit();
+}
+
+BENCH(spy_fill_page)
+{
+    fill_page(256);
+    fill_page(4096);
+    fill_page(32768);
+}
+
+/* Append records round an index on the whole production sized user area for many laps. */
+BENCH(soak_index_write)
+{
+    const char * name = "soak index write 16 bytes, 200 KiB user area";
+    uint8_t record[SOAK_RECORD_SIZE] = {0x11};
+    uint32_t data_pages = SOAK_PAGES - 3;
+    uint32_t records = SOAK_LAPS * data_pages * SOAK_PAGE_SIZE / SOAK_RECORD_SIZE;
+
+    bench_backend_init(SOAK_WORD_SIZE, SOAK_PAGE_SIZE, SOAK_PAGES);
+    int id = flash_index_register(0, data_pages);
+    flash_index_set_checkpoint(id, FLASH_CHECKPOINT_PAGE, 0);
+    flash_index_erase_index(id);
+    bench_backend_reset_counts();
+
+    uint32_t failures = 0;
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < records; idx++)
+    {
+        failures += (flash_index_write(id, record, sizeof(record)) != FLASH_OK);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, records, elapsed);
+    bench_metric(name, "failed writes", failures);
+    bench_metric(name, "pages erased", bench_backend_counts.pages_erased);
+    bench_metric(name, "soak seconds", elapsed / 1e9);
+
+    bench_backend_deinit();
+}
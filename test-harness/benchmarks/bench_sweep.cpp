@@ -0,0 +1,195 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include "../spies/flash_spy.h"
+}
+
+/* Every geometry gets the same 60 KiB of flash. That is 240 of the smallest pages, close to the 255 a uint8_t page
+ * count allows, and a whole number of the largest. */
+#define BENCH_FLASH_SIZE 61440
+#define BENCH_RECORD_SIZE 32
+#define BENCH_OPS 20000
+#define BENCH_LOOKUPS 1000
+
+static const uint8_t word_sizes[] = {4, 8, 16};
+static const uint16_t page_sizes[] = {256, 1024, 4096};
+
+/* Name a case after the geometry it ran on so the results can be told apart. */
+static void case_name(char * name, uint32_t size, uint8_t word_size, uint16_t page_size, const char * operation)
+{
+    snprintf(name, size, "sweep word %u page %u %s", word_size, page_size, operation);
+}
+
+/* Write records back to back, erasing the flash untimed whenever it fills up. */
+static void sweep_write(uint8_t word_size, uint16_t page_size)
+{
+    char name[96];
+    case_name(name, sizeof(name), word_size, page_size, "flash_write");
+
+    bench_backend_init(word_size, page_size, BENCH_FLASH_SIZE / page_size);
+
+    uint8_t record[BENCH_RECORD_SIZE];
+    memset(record, 0x5A, sizeof(record));
+    uint32_t address = 0;
+    uint64_t elapsed = 0;
+
+    for (uint32_t idx = 0; idx < BENCH_OPS; idx++)
+    {
+        if (address + BENCH_RECORD_SIZE > BENCH_FLASH_SIZE)
+        {
+            flash_spy_erase_all();
+            address = 0;
+        }
+        uint64_t start = bench_now_ns();
+        flash_write(address, record, sizeof(record));
+        elapsed += bench_now_ns() - start;
+        address += BENCH_RECORD_SIZE;
+    }
+
+    bench_report(name, BENCH_OPS, elapsed);
+    bench_backend_deinit();
+}
+
+/* Read records back to back round the whole flash. */
+static void sweep_read(uint8_t word_size, uint16_t page_size)
+{
+    char name[96];
+    case_name(name, sizeof(name), word_size, page_size, "flash_read");
+
+    bench_backend_init(word_size, page_size, BENCH_FLASH_SIZE / page_size);
+
+    uint8_t record[BENCH_RECORD_SIZE];
+    uint32_t address = 0;
+
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_OPS; idx++)
+    {
+        flash_read(address, record, sizeof(record));
+        address = (address + BENCH_RECORD_SIZE) % BENCH_FLASH_SIZE;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(name, BENCH_OPS, elapsed);
+    bench_backend_deinit();
+}
+
+/* Append records to an index on the whole flash. Without wrapping the data pages are erased untimed before the first
+ * pass and again whenever the head would go round the end, so only writes to erased pages are measured. Wrapping
+ * pays for erasing each page as the head comes round to it. */
+static void sweep_index_write(uint8_t word_size, uint16_t page_size, bool wrapping)
+{
+    char name[96];
+    case_name(name, sizeof(name), word_size, page_size, wrapping ? "flash_index_write wrapping" : "flash_index_write");
+
+    uint8_t pages = BENCH_FLASH_SIZE / page_size;
+    bench_backend_init(word_size, page_size, pages);
+    int id = flash_index_register(0, pages - 1);
+    flash_index_erase_index(id);
+    if (!wrapping)
+    {
+        flash_index_erase_all_data(id);
+    }
+
+    uint8_t record[BENCH_RECORD_SIZE];
+    memset(record, 0x5A, sizeof(record));
+    uint32_t data_space = (uint32_t)(pages - 1) * page_size;
+    uint32_t written = 0;
+    uint64_t elapsed = 0;
+
+    bench_backend_reset_counts();
+    for (uint32_t idx = 0; idx < BENCH_OPS; idx++)
+    {
+        if (!wrapping && written + BENCH_RECORD_SIZE > data_space)
+        {
+            // Untimed and left out of the erase count.
+            uint32_t pages_erased = bench_backend_counts.pages_erased;
+            flash_index_erase_all_data(id);
+            bench_backend_counts.pages_erased = pages_erased;
+            written = 0;
+        }
+        uint64_t start = bench_now_ns();
+        flash_index_write(id, record, sizeof(record));
+        elapsed += bench_now_ns() - start;
+        written += BENCH_RECORD_SIZE;
+    }
+
+    bench_report(name, BENCH_OPS, elapsed);
+    bench_metric(name, "pages erased/1000 writes", 1000.0 * bench_backend_counts.pages_erased / BENCH_OPS);
+    bench_backend_deinit();
+}
+
+/* Find and load the latest index data on an index page filled to fill_percent with index entries. */
+static void sweep_index_lookup(uint8_t word_size, uint16_t page_size, uint8_t fill_percent)
+{
+    char lookup_name[96];
+    char load_name[96];
+    char operation[64];
+    snprintf(operation, sizeof(operation), "flash_index_get_index_address %u%% full", fill_percent);
+    case_name(lookup_name, sizeof(lookup_name), word_size, page_size, operation);
+    snprintf(operation, sizeof(operation), "flash_index_load %u%% full", fill_percent);
+    case_name(load_name, sizeof(load_name), word_size, page_size, operation);
+
+    uint8_t pages = BENCH_FLASH_SIZE / page_size;
+    bench_backend_init(word_size, page_size, pages);
+    int id = flash_index_register(0, pages - 1);
+    flash_index_erase_index(id);
+
+    // The head and tail take 8 bytes, padded out to a whole word.
+    uint32_t entry_size = (8 > word_size) ? 8 : word_size;
+    uint32_t entries = (page_size / entry_size) * fill_percent / 100;
+    for (uint32_t idx = 0; idx < entries; idx++)
+    {
+        flash_index_write_index(id);
+    }
+
+    bench_backend_reset_counts();
+    uint32_t address = 0;
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_LOOKUPS; idx++)
+    {
+        flash_index_get_index_address(id, &address);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_report(lookup_name, BENCH_LOOKUPS, elapsed);
+    bench_metric(lookup_name, "flash reads/lookup", (double)bench_backend_counts.read_calls / BENCH_LOOKUPS);
+
+    bench_backend_reset_counts();
+    start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_LOOKUPS; idx++)
+    {
+        flash_index_load(id);
+    }
+    elapsed = bench_now_ns() - start;
+
+    bench_report(load_name, BENCH_LOOKUPS, elapsed);
+    bench_metric(load_name, "flash reads/load", (double)bench_backend_counts.read_calls / BENCH_LOOKUPS);
+
+    bench_backend_deinit();
+}
+
+/* The core operations on every combination of word and page size. Run with --csv for results to compare between
+ * builds. */
+BENCH(sweep)
+{
+    for (uint8_t word = 0; word < sizeof(word_sizes) / sizeof(word_sizes[0]); word++)
+    {
+        for (uint8_t page = 0; page < sizeof(page_sizes) / sizeof(page_sizes[0]); page++)
+        {
+            uint8_t word_size = word_sizes[word];
+            uint16_t page_size = page_sizes[page];
+
+            sweep_write(word_size, page_size);
+            sweep_read(word_size, page_size);
+            sweep_index_write(word_size, page_size, false);
+            sweep_index_write(word_size, page_size, true);
+            sweep_index_lookup(word_size, page_size, 0);
+            sweep_index_lookup(word_size, page_size, 50);
+            sweep_index_lookup(word_size, page_size, 100);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#include "bench.h"
+#include "bench_backend.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+}
+
+#define BENCH_WORD_SIZE 8
+#define BENCH_PAGE_SIZE 2048
+#define BENCH_PAGES 16
+#define BENCH_USER_PAGES 10
+#define BENCH_SPARE_PAGES (BENCH_PAGES - BENCH_USER_PAGES)
+#define BENCH_RECORD_SIZE 64
+#define BENCH_WRITES 40000
+#define BENCH_ENDURANCE 10000
+
+static uint32_t table[FLASH_WEAR_TABLE_SIZE(BENCH_USER_PAGES, BENCH_SPARE_PAGES)];
+
+/* A busy log on three pages next to an index whose data never changes, with the wear spread at some threshold. */
+static void wear(const char * threshold_name, uint32_t threshold)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "wear %s", threshold_name);
+
+    bench_backend_init(BENCH_WORD_SIZE, BENCH_PAGE_SIZE, BENCH_PAGES);
+    bench_backend_set_user_pages(BENCH_USER_PAGES);
+    flash_set_wear_leveling(BENCH_USER_PAGES, BENCH_SPARE_PAGES, threshold, table, sizeof(table) / sizeof(table[0]));
+
+    int busy_id = flash_index_register(0, 2);
+    int idle_id = flash_index_register(3, 8);
+
+    uint8_t record[BENCH_RECORD_SIZE];
+    memset(record, 0x5A, sizeof(record));
+    for (uint16_t idx = 0; idx < 4 * BENCH_PAGE_SIZE / BENCH_RECORD_SIZE; idx++)
+    {
+        flash_index_write(idle_id, record, sizeof(record));
+    }
+    bench_backend_reset_counts();
+
+    uint64_t start = bench_now_ns();
+    for (uint32_t idx = 0; idx < BENCH_WRITES; idx++)
+    {
+        record[0] = idx;
+        flash_index_write(busy_id, record, sizeof(record));
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    flash_wear_stats_t stats;
+    flash_get_wear_stats(BENCH_ENDURANCE, &stats);
+
+    // The writes it would take for the most worn page to reach its endurance at the rate pages were erased here.
+    double erases_per_write = (double)stats.total_erases / BENCH_WRITES;
+    double lifetime = ((double)stats.total_erases + stats.remaining_erases) / erases_per_write;
+
+    bench_report(name, BENCH_WRITES, elapsed);
+    bench_metric(name, "max erases", stats.max_erases);
+    bench_metric(name, "min erases", stats.min_erases);
+    bench_metric(name, "remaps", stats.remaps);
+    bench_metric(name, "migrations", stats.migrations);
+    bench_metric(name, "pages erased/1000 writes", 1000.0 * bench_backend_counts.pages_erased / BENCH_WRITES);
+    bench_metric(name, "lifetime writes (millions)", lifetime / 1e6);
+
+    bench_backend_deinit();
+}
+
+BENCH(wear)
+{
+    // Counters only, pages never move.
+    wear("off", UINT32_MAX);
+    wear("threshold 64", 64);
+    wear("threshold 16", 16);
+    wear("threshold 4", 4);
+}
@@ -1,6 +1,13 @@
+/* For mmap and ftruncate, used to map flash images. */
+#define _POSIX_C_SOURCE 200809L
+
 #include "flash_spy.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "CppUTest/MemoryLeakDetectorNewMacros.h"
 #include "CppUTest/MemoryLeakDetectorMallocMacros.h"
 
@@ -12,43 +19,186 @@ uint8_t word_size = 0;
 /* The page size of the flash. */
 uint16_t page_size = 0;
 /* The total size of the flash. */
-uint16_t flash_size = 0;
+uint32_t flash_size = 0;
 
 /* This is the simulated flash that will be written to, read from and erased. */
 uint8_t * flash = 0;
+/* Set when the simulated flash is a memory mapped image file rather than allocated. */
+bool flash_is_image = false;
+
+/* For each page, the offset just past the last byte on it that isn't FLASH_EMPTY_VALUE, 0 if it is all erased. A write
+ * is allowed at or after it, so the rest of the page doesn't have to be looked at. */
+static uint16_t * watermarks = 0;
+/* The number of pages, counting a partial one at the end. */
+static uint32_t page_count = 0;
+
+/* How long things take on the virtual clock. All 0 for instant. */
+static flash_spy_timing_t timing = {0};
+/* The virtual clock in nanoseconds. */
+static uint64_t clock_ns = 0;
+
+// Public Variables
+
+/* 64 bit program 81.7 us, 4 KiB page erase 22 ms, 3 wait states so about 8 ns a byte once the ART misses. */
+const flash_spy_timing_t flash_spy_timing_stm32wb = {
+    .program_setup_ns = 0,
+    .program_word_ns = 81700,
+    .erase_page_ns = 22000000,
+    .read_setup_ns = 50,
+    .read_byte_ns = 8,
+};
+
+/* First byte 30 us then 2.5 us a byte, 4 KiB sector erase 45 ms, 40 bits of command, address and dummy then 8 bits a
+ * byte at 50 MHz. */
+const flash_spy_timing_t flash_spy_timing_spi_nor = {
+    .program_setup_ns = 30000,
+    .program_word_ns = 2500,
+    .erase_page_ns = 45000000,
+    .read_setup_ns = 800,
+    .read_byte_ns = 160,
+};
 
 // Private Function Declarations
 
+/**
+ * @brief Set up the page count and the watermarks from what is in the flash.
+ */
+static void watermarks_init(void);
+
+/**
+ * @brief Move the watermarks of the pages some bytes have just been written to.
+ * 
+ * @param address Where the bytes start.
+ * @param length The number of bytes.
+ */
+static void watermarks_update(uint32_t address, uint32_t length);
+
 // Private Function Definitions
 
+static void watermarks_init(void)
+{
+    page_count = (flash_size + page_size - 1) / page_size;
+    watermarks = (uint16_t*)malloc(page_count * sizeof(uint16_t));
+
+    for(uint32_t page = 0; page < page_count; page++)
+    {
+        uint32_t start = page * page_size;
+        uint32_t end = (start + page_size < flash_size) ? start + page_size : flash_size;
+        while(end > start && flash[end - 1] == FLASH_EMPTY_VALUE)
+        {
+            end--;
+        }
+        watermarks[page] = end - start;
+    }
+}
+
+static void watermarks_update(uint32_t address, uint32_t length)
+{
+    // Only the last byte written that isn't erased matters, and only on the page it's on and the pages before it.
+    uint32_t end = address + length;
+    while(end > address)
+    {
+        if(flash[end - 1] != FLASH_EMPTY_VALUE)
+        {
+            uint32_t page = (end - 1) / page_size;
+            uint16_t offset = end - page * page_size;
+            if(offset > watermarks[page])
+            {
+                watermarks[page] = offset;
+            }
+            end = page * page_size;
+        }
+        else
+        {
+            end--;
+        }
+    }
+}
+
 // Public Function Definitions
 
-void flash_spy_init(uint8_t word_size_init, uint16_t page_size_init, uint16_t flash_size_init)
+void flash_spy_init(uint8_t word_size_init, uint16_t page_size_init, uint32_t flash_size_init)
 {
     word_size = word_size_init;
     page_size = page_size_init;
     flash_size = flash_size_init;
     flash = (uint8_t*)malloc(flash_size);
     memset(flash, FLASH_EMPTY_VALUE, flash_size);
+    watermarks_init();
+}
+
+flash_status_t flash_spy_init_image(uint8_t word_size_init, uint16_t page_size_init, uint32_t flash_size_init, const char * path)
+{
+    int file = open(path, O_RDWR | O_CREAT, 0644);
+    if(file < 0)
+    {
+        return FLASH_ERROR;
+    }
+
+    // A new image starts out erased, an existing one keeps what was written to it.
+    off_t existing_size = lseek(file, 0, SEEK_END);
+    if(existing_size < (off_t)flash_size_init && ftruncate(file, flash_size_init) != 0)
+    {
+        close(file);
+        return FLASH_ERROR;
+    }
+
+    void * image = mmap(NULL, flash_size_init, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+    if(image == MAP_FAILED)
+    {
+        return FLASH_ERROR;
+    }
+
+    word_size = word_size_init;
+    page_size = page_size_init;
+    flash_size = flash_size_init;
+    flash = (uint8_t*)image;
+    flash_is_image = true;
+    if(existing_size < (off_t)flash_size_init)
+    {
+        memset(&flash[existing_size], FLASH_EMPTY_VALUE, flash_size_init - existing_size);
+    }
+    watermarks_init();
+
+    return FLASH_OK;
 }
 
 void flash_spy_deinit()
 {
+    if(flash_is_image)
+    {
+        munmap(flash, flash_size);
+    }
+    else
+    {
+        free(flash);
+    }
+    free(watermarks);
+
     word_size = 0;
     page_size = 0;
     flash_size = 0;
-    free(flash);
+    flash = 0;
+    flash_is_image = false;
+    watermarks = 0;
+    page_count = 0;
+    memset(&timing, 0, sizeof(timing));
+    clock_ns = 0;
 }
 
 flash_status_t flash_spy_erase_pages(uint8_t page_number, uint8_t number_of_pages)
 {
-    memset(&flash[page_number*page_size], 0xFF, page_size);
+    memset(&flash[page_number*page_size], 0xFF, page_size*number_of_pages);
+    memset(&watermarks[page_number], 0, number_of_pages * sizeof(uint16_t));
+    clock_ns += (uint64_t)timing.erase_page_ns * number_of_pages;
     return FLASH_OK;
 }
 
 flash_status_t flash_spy_read(uint32_t user_read_address, uint8_t *data, uint16_t read_length)
 {
     memcpy(data, &flash[user_read_address], read_length);
+    clock_ns += timing.read_setup_ns + (uint64_t)timing.read_byte_ns * read_length;
     return FLASH_OK;
 }
 
@@ -59,23 +209,64 @@ flash_status_t flash_spy_write(uint32_t user_write_address, uint8_t *data, uint1
         return FLASH_ERROR;
     }
 
+    // The device is busy for the write even if it turns out the flash wasn't erased.
+    clock_ns += timing.program_setup_ns + (uint64_t)timing.program_word_ns * number_words;
+
+    uint32_t length = (uint32_t)number_words * word_size;
+    if(user_write_address >= flash_size || length > flash_size - user_write_address)
+    {
+        return FLASH_ERROR;
+    }
+
     // Determine what page the address is on
-    uint8_t page = user_write_address/page_size;
+    uint32_t page = user_write_address/page_size;
 
-    // Check if the rest of the page that is to be written to is clear (all value empty 0xFF)
-    for(uint32_t idx = user_write_address; idx < (page+1) * page_size; idx++)
+    // The rest of the page that is to be written to has to be clear (all value empty 0xFF), which it is from the
+    // watermark on.
+    if(user_write_address - page * page_size < watermarks[page])
     {
-        if(flash[idx] != FLASH_EMPTY_VALUE)
-        {
-            return FLASH_ERROR;
-        }
+        return FLASH_ERROR;
     }
 
-    memcpy(&flash[user_write_address], data, number_words*word_size);
+    memcpy(&flash[user_write_address], data, length);
+    watermarks_update(user_write_address, length);
     return FLASH_OK;
 }
 
 void flash_spy_erase_all(void)
 {
     memset(flash, FLASH_EMPTY_VALUE, flash_size);
+    memset(watermarks, 0, page_count * sizeof(uint16_t));
+}
+
+const uint8_t * flash_spy_memory(void)
+{
+    return flash;
+}
+
+void flash_spy_set_timing(const flash_spy_timing_t * timing_init)
+{
+    if(timing_init == NULL)
+    {
+        memset(&timing, 0, sizeof(timing));
+    }
+    else
+    {
+        timing = *timing_init;
+    }
+}
+
+uint64_t flash_spy_clock_ns(void)
+{
+    return clock_ns;
+}
+
+uint32_t flash_spy_clock_us(void)
+{
+    return (uint32_t)(clock_ns / 1000);
+}
+
+void flash_spy_clock_reset(void)
+{
+    clock_ns = 0;
 }
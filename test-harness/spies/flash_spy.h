@@ -6,6 +6,38 @@
 // PUBLIC DEFINES
 #define FLASH_SPY_SIZE 100
 
+// PUBLIC TYPES
+
+/**
+ * @brief How long the simulated flash takes to do things, see flash_spy_set_timing. The time is added to a virtual
+ * clock rather than waited for so benchmarks can compare how long the device would be busy.
+ * @param program_setup_ns Time for each call to write, e.g. sending the command and address.
+ * @param program_word_ns Time to program each word.
+ * @param erase_page_ns Time to erase each page.
+ * @param read_setup_ns Time for each call to read.
+ * @param read_byte_ns Time to read each byte.
+ */
+typedef struct{
+	uint32_t program_setup_ns;
+	uint32_t program_word_ns;
+	uint32_t erase_page_ns;
+	uint32_t read_setup_ns;
+	uint32_t read_byte_ns;
+}flash_spy_timing_t;
+
+// PUBLIC VARIABLES
+
+/**
+ * @brief STM32WB internal flash at 64 MHz, typical figures from the datasheet. Use an 8 byte word and 4 KiB pages.
+ */
+extern const flash_spy_timing_t flash_spy_timing_stm32wb;
+
+/**
+ * @brief A typical SPI NOR flash, e.g. a W25Q series part, read at 50 MHz on one data line. Use a 1 byte word and
+ * 4 KiB pages, the sector size. Programming a whole 256 byte page takes about 0.7 ms.
+ */
+extern const flash_spy_timing_t flash_spy_timing_spi_nor;
+
 // PUBLIC FUNCTION DECLARATIONS
 
 /**
@@ -15,10 +47,23 @@
  * @param page_size_init This is the size of the page. 
  * @param flash_size_init This is the size of the total flash mem.
  */
-void flash_spy_init(uint8_t word_size_init, uint16_t page_size_init, uint16_t flash_size_init);
+void flash_spy_init(uint8_t word_size_init, uint16_t page_size_init, uint32_t flash_size_init);
+
+/**
+ * @brief Initialize the spy module with its flash memory mapped from an image file, the way flash is mapped on an
+ * MCU with XIP flash. What is written stays in the file so a later init from it sees the same flash.
+ * 
+ * @param word_size_init This is the minimum write size of the simulation flash module.
+ * @param page_size_init This is the size of the page. 
+ * @param flash_size_init This is the size of the total flash mem.
+ * @param path The image file. Created, erased, if it doesn't exist.
+ * @return flash_status_t 
+ */
+flash_status_t flash_spy_init_image(uint8_t word_size_init, uint16_t page_size_init, uint32_t flash_size_init, const char * path);
 
 /**
- * @brief Frees the memory allocated to the flash and sets the other state variables to 0.
+ * @brief Frees the memory allocated to the flash, or unmaps the image, and sets the other state variables to 0. The
+ * timing goes back to instant and the virtual clock to 0.
  */
 void flash_spy_deinit();
 
@@ -42,7 +87,8 @@ flash_status_t flash_spy_erase_pages(uint8_t page_number, uint8_t number_of_page
 flash_status_t flash_spy_read(uint32_t user_read_address, uint8_t *data, uint16_t read_length);
 
 /**
- * @brief Write to the simulate flash (a big array.)
+ * @brief Write to the simulate flash (a big array.) Fails unless everything from the address to the end of its page is
+ * erased. Each page remembers how far it has been written so this doesn't depend on the size of the page.
  * 
  * @param [in] user_write_address The address to write to. Must be word aligned. I.e. integral multiple of word size.
  * @param [in] data The byte array of data to write.
@@ -53,4 +99,38 @@ flash_status_t flash_spy_write(uint32_t user_write_address, uint8_t *data, uint1
 
 void flash_spy_erase_all(void);
 
-#endif
\ No newline at end of file
+/**
+ * @brief The simulated flash memory, for reading it in place like memory mapped flash.
+ * 
+ * @return const uint8_t* The first byte of the simulated flash.
+ */
+const uint8_t * flash_spy_memory(void);
+
+/**
+ * @brief Make reads, writes and erases take time on the virtual clock. Set after flash_spy_init as
+ * flash_spy_deinit clears it.
+ * 
+ * @param timing How long each takes, e.g. &flash_spy_timing_stm32wb. Copied. NULL to make them instant again.
+ */
+void flash_spy_set_timing(const flash_spy_timing_t * timing);
+
+/**
+ * @brief The virtual clock, how long the simulated flash has been busy.
+ * 
+ * @return uint64_t Nanoseconds since the clock was last reset.
+ */
+uint64_t flash_spy_clock_ns(void);
+
+/**
+ * @brief The virtual clock in microseconds, to give the driver as a tick or stats clock so it sees device time.
+ * 
+ * @return uint32_t Microseconds since the clock was last reset.
+ */
+uint32_t flash_spy_clock_us(void);
+
+/**
+ * @brief Put the virtual clock back to 0.
+ */
+void flash_spy_clock_reset(void);
+
+#endif
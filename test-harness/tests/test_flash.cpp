@@ -308,18 +308,16 @@ TEST(Test, can_write_to_erased_cell_after_write)
 /* Cannot try to erase a page > than the max page */
 TEST(Test, cannot_erase_a_page_exceeding_flash_size)
 {
-    // Try to erase page > flash size
-    uint8_t pages_in_flash = FLASH_SIZE / PAGE_SIZE;
-    // Because the pages are zero based you can't try to erase the nth page.
+    // Try to erase the first page after the user flash
+    uint8_t pages_in_flash = START_PAGE + NUMBER_PAGES;
     ERASE_ERROR_TEXT(pages_in_flash, 1, "Failed to fail at erasing too many pages.");
 }
 
 /* Cannot erase page count that exceed limit*/
 TEST(Test, cannot_erase_more_pages_than_proceeding_start_pages)
 {
-    // Try to erase page > flash size
-    uint8_t pages_in_flash = FLASH_SIZE / PAGE_SIZE;
-    // Because the pages are zero based you can't try to erase the nth page.
+    // Try to erase the last user page and the one after it
+    uint8_t pages_in_flash = START_PAGE + NUMBER_PAGES;
     ERASE_ERROR_TEXT(pages_in_flash - 1, 2, "Failed to fail at erasing too many pages.");
 }
 
@@ -813,4 +811,1342 @@ TEST(Test, load_index_after_index_reset_and_many_writes)
 
     // 7. Compare the new head to the old head
     CHECK_EQUAL_TEXT(old_head, new_head, "Old head does not equal new head");
-}
\ No newline at end of file
+}
+
+/* Backend that records the buffer it was handed so tests can see where the data came from. */
+static uint8_t * last_backend_data = NULL;
+static flash_status_t recording_write(uint32_t write_address, uint8_t * data, uint16_t number_of_words)
+{
+    last_backend_data = data;
+    return flash_spy_write(write_address, data, number_of_words);
+}
+
+/*
+Word aligned data should be handed to the backend straight from the caller's buffer without being copied.
+*/
+TEST(Test, word_aligned_write_is_not_copied)
+{
+    flash_init(recording_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+
+    uint64_t words[2] = {0};
+    uint8_t * write_data = (uint8_t *)words;
+    write_data[0] = 0x01;
+    WRITE_OK(START_PAGE * PAGE_SIZE, write_data, 2*WORD_SIZE);
+
+    POINTERS_EQUAL_TEXT(write_data, last_backend_data, "Aligned data was staged before writing");
+}
+
+/*
+Whole words that aren't aligned in the caller's buffer are copied so the backend can read them a word at a time.
+*/
+TEST(Test, unaligned_write_is_staged_aligned)
+{
+    flash_init(recording_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+
+    uint64_t words[3] = {0};
+    uint8_t * write_data = (uint8_t *)words + 1;
+    for (uint8_t idx = 0; idx < 2*WORD_SIZE; idx++)
+    {
+        write_data[idx] = idx + 1;
+    }
+    WRITE_OK(START_PAGE * PAGE_SIZE, write_data, 2*WORD_SIZE);
+
+    CHECK_TEXT(last_backend_data != write_data, "Unaligned data was handed to the backend");
+    CHECK_EQUAL(0, (uintptr_t)last_backend_data % WORD_SIZE);
+
+    uint8_t read_data[2*WORD_SIZE] = {0};
+    FLASH_READ_OK(START_PAGE * PAGE_SIZE, read_data, 2*WORD_SIZE);
+    MEMCMP_EQUAL(write_data, read_data, 2*WORD_SIZE);
+}
+
+/* More unaligned whole words than the padding buffer holds are copied a buffer full at a time. */
+TEST(Test, unaligned_writev_bigger_than_padding_buffer)
+{
+    uint64_t words[41] = {0};
+    uint8_t * write_data = (uint8_t *)words + 3;
+    uint16_t write_size = 40 * WORD_SIZE;
+    for (uint16_t idx = 0; idx < write_size; idx++)
+    {
+        write_data[idx] = (uint8_t)(idx * 7);
+    }
+    flash_iovec_t piece = {write_data, write_size};
+    CHECK_EQUAL(FLASH_OK, flash_writev(START_PAGE * PAGE_SIZE, &piece, 1));
+
+    uint8_t read_data[40 * WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_read_bulk(START_PAGE * PAGE_SIZE, read_data, write_size));
+    MEMCMP_EQUAL(write_data, read_data, write_size);
+}
+
+/*
+Data with a partial trailing word has its whole words written as is and only the last word padded.
+*/
+TEST(Test, write_whole_words_and_partial_tail)
+{
+    uint16_t write_size = 2*WORD_SIZE + 3;
+    uint8_t write_data[2*WORD_SIZE + 3] = {0};
+    for(uint8_t idx = 0; idx < write_size; idx++)
+    {
+        write_data[idx] = idx;
+    }
+    WRITE_OK(START_PAGE * PAGE_SIZE, write_data, write_size);
+
+    // Read back the three words that should have been written
+    uint8_t read_data[3*WORD_SIZE] = {0};
+    FLASH_READ_OK(START_PAGE * PAGE_SIZE, read_data, 3*WORD_SIZE);
+
+    // Data followed by padding in the last word
+    uint8_t expected_data[3*WORD_SIZE] = {0};
+    memset(expected_data, FLASH_EMPTY_VALUE, 3*WORD_SIZE);
+    memcpy(expected_data, write_data, write_size);
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, 3*WORD_SIZE, "Data or padding not as expected");
+}
+
+/*
+Pieces of a scatter-gather write end up in flash back to back as if they were one buffer.
+*/
+TEST(Test, writev_packs_pieces_into_words)
+{
+    uint8_t header[3] = {0xA0, 0xA1, 0xA2};
+    uint8_t payload[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    uint8_t trailer[2] = {0xB0, 0xB1};
+    flash_iovec_t pieces[3] = {{header, sizeof(header)}, {payload, sizeof(payload)}, {trailer, sizeof(trailer)}};
+
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_writev(START_PAGE * PAGE_SIZE, pieces, 3), "Scatter-gather write failed");
+
+    // Expected data is the pieces one after the other followed by padding
+    uint8_t expected_data[2*WORD_SIZE] = {0};
+    memset(expected_data, FLASH_EMPTY_VALUE, 2*WORD_SIZE);
+    memcpy(expected_data, header, sizeof(header));
+    memcpy(&expected_data[sizeof(header)], payload, sizeof(payload));
+    memcpy(&expected_data[sizeof(header) + sizeof(payload)], trailer, sizeof(trailer));
+
+    uint8_t read_data[2*WORD_SIZE] = {0};
+    FLASH_READ_OK(START_PAGE * PAGE_SIZE, read_data, 2*WORD_SIZE);
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, 2*WORD_SIZE, "Pieces not packed together");
+}
+
+/*
+Empty pieces in the middle of a scatter-gather write are skipped over.
+*/
+TEST(Test, writev_skips_empty_pieces)
+{
+    uint8_t header[3] = {0xA0, 0xA1, 0xA2};
+    uint8_t trailer[2] = {0xB0, 0xB1};
+    flash_iovec_t pieces[3] = {{header, sizeof(header)}, {header, 0}, {trailer, sizeof(trailer)}};
+
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_writev(START_PAGE * PAGE_SIZE, pieces, 3), "Scatter-gather write failed");
+
+    uint8_t expected_data[WORD_SIZE] = {0xA0, 0xA1, 0xA2, 0xB0, 0xB1, FLASH_EMPTY_VALUE, FLASH_EMPTY_VALUE, FLASH_EMPTY_VALUE};
+    uint8_t read_data[WORD_SIZE] = {0};
+    FLASH_READ_OK(START_PAGE * PAGE_SIZE, read_data, WORD_SIZE);
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, WORD_SIZE, "Pieces not packed together");
+}
+
+/*
+A scatter-gather write with no data in it is an error just like a zero length write.
+*/
+TEST(Test, writev_zero_length)
+{
+    uint8_t data[1] = {0};
+    flash_iovec_t pieces[2] = {{data, 0}, {data, 0}};
+
+    CHECK_EQUAL(FLASH_ERROR, flash_writev(START_PAGE * PAGE_SIZE, pieces, 2));
+    CHECK_EQUAL(FLASH_ERROR, flash_writev(START_PAGE * PAGE_SIZE, NULL, 0));
+}
+
+/*
+A scatter-gather write with an index gets split over the wrap just like a normal index write.
+*/
+TEST(Test, index_writev_over_wrap)
+{
+    // Two data pages so the data is split at the wrap rather than moved to the start of the page.
+    int id = 0;
+    REGISTER_ID_OK_TEXT(START_PAGE, START_PAGE + 2, id, "Failed to register new index");
+
+    // Fill up to one word before the end of the data space
+    uint16_t fill_size = 2*PAGE_SIZE - WORD_SIZE;
+    uint8_t fill_data[2*PAGE_SIZE - WORD_SIZE] = {0};
+    WRITE_INDEX_OK_TEXT(id, fill_data, fill_size, "Failed to fill index");
+
+    // Two words in three pieces so the wrap lands in the middle of a piece
+    uint8_t first[5] = {1, 2, 3, 4, 5};
+    uint8_t second[6] = {6, 7, 8, 9, 10, 11};
+    uint8_t third[5] = {12, 13, 14, 15, 16};
+    flash_iovec_t pieces[3] = {{first, sizeof(first)}, {second, sizeof(second)}, {third, sizeof(third)}};
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_writev(id, pieces, 3), "Scatter-gather index write failed");
+
+    // Head is one word past the start of the data space
+    CHECK_EQUAL_TEXT((START_PAGE + 1)*PAGE_SIZE + WORD_SIZE, flash_index_get_head(id), "Head not wrapped");
+
+    // Read back over the wrap
+    uint8_t read_data[2*WORD_SIZE] = {0};
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_read_rel_head(id, -2*WORD_SIZE, read_data, 2*WORD_SIZE), "Read relative to head failed.");
+
+    uint8_t expected_data[2*WORD_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, 2*WORD_SIZE, "Data not equivalent");
+}
+
+/*
+Bulk writes and reads aren't limited by the maximum write size and can go over page boundaries.
+*/
+TEST(Test, bulk_write_and_read_beyond_maximum_write_size)
+{
+    uint32_t write_size = FLASH_MAX_WRITE_SIZE + 3*PAGE_SIZE + 3;
+    uint8_t write_data[FLASH_MAX_WRITE_SIZE + 3*PAGE_SIZE + 3] = {0};
+    for(uint32_t idx = 0; idx < write_size; idx++)
+    {
+        write_data[idx] = idx;
+    }
+
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_write_bulk(START_PAGE*PAGE_SIZE, write_data, write_size), "Bulk write failed");
+
+    uint8_t read_data[FLASH_MAX_WRITE_SIZE + 3*PAGE_SIZE + 3] = {0};
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_read_bulk(START_PAGE*PAGE_SIZE, read_data, write_size), "Bulk read failed");
+    MEMCMP_EQUAL_TEXT(write_data, read_data, write_size, "Read back doesn't match written");
+}
+
+/*
+The whole of a bulk transfer has to be inside the user flash, not just its start.
+*/
+TEST(Test, bulk_transfer_past_end_of_flash)
+{
+    uint32_t flash_end = (START_PAGE + NUMBER_PAGES)*PAGE_SIZE;
+    uint8_t data[2*WORD_SIZE] = {0};
+
+    CHECK_EQUAL(FLASH_ERROR, flash_write_bulk(flash_end - WORD_SIZE, data, 2*WORD_SIZE));
+    CHECK_EQUAL(FLASH_ERROR, flash_read_bulk(flash_end - WORD_SIZE, data, 2*WORD_SIZE));
+}
+
+/*
+A bulk index write bigger than the whole index keeps going round it. Each page is erased as the head gets to it
+so the rest of the head's page is empty and the page after it still holds the previous time round.
+*/
+TEST(Test, bulk_index_write_wraps_many_times)
+{
+    int id = 0;
+    REGISTER_ID_OK_TEXT(START_PAGE, START_PAGE + 2, id, "Failed to register new index");
+    uint16_t data_space = 2*PAGE_SIZE;
+
+    // Two times round plus a bit
+    uint32_t write_size = 2*data_space + 22;
+    uint8_t write_data[2*2*PAGE_SIZE + 22] = {0};
+    for(uint32_t idx = 0; idx < write_size; idx++)
+    {
+        write_data[idx] = idx;
+    }
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_write_bulk(id, write_data, write_size), "Bulk index write failed");
+
+    // Head is just past the last partial word
+    CHECK_EQUAL_TEXT((START_PAGE + 1)*PAGE_SIZE + ALIGNED_BYTES(22), flash_index_get_head(id), "Head not where expected");
+
+    // Reading the whole space back from the head: the empty rest of the first page, the second page from the time
+    // before, then the 22 bytes from the last time round and their padding.
+    uint8_t expected_data[2*PAGE_SIZE] = {0};
+    memset(expected_data, FLASH_EMPTY_VALUE, data_space);
+    memcpy(&expected_data[PAGE_SIZE - ALIGNED_BYTES(22)], &write_data[data_space + PAGE_SIZE], PAGE_SIZE);
+    memcpy(&expected_data[data_space - ALIGNED_BYTES(22)], &write_data[2*data_space], 22);
+
+    uint8_t read_data[2*PAGE_SIZE] = {0};
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_read_rel_head(id, -data_space, read_data, data_space), "Read relative to head failed.");
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, data_space, "Data not equivalent");
+}
+
+/*
+A bulk index read from the tail wraps round to the start of the data space.
+*/
+TEST(Test, bulk_index_read_wraps_tail)
+{
+    int id = 0;
+    REGISTER_ID_OK_TEXT(START_PAGE, START_PAGE + 2, id, "Failed to register new index");
+    uint16_t data_space = 2*PAGE_SIZE;
+
+    uint8_t write_data[2*PAGE_SIZE] = {0};
+    for(uint32_t idx = 0; idx < data_space; idx++)
+    {
+        write_data[idx] = idx;
+    }
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_write_bulk(id, write_data, data_space - WORD_SIZE), "Bulk index write failed");
+
+    // Read the whole space then carry on over the wrap
+    uint8_t read_data[2*PAGE_SIZE + WORD_SIZE] = {0};
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_read_bulk(id, read_data, data_space + WORD_SIZE), "Bulk index read failed");
+
+    uint8_t expected_data[2*PAGE_SIZE + WORD_SIZE] = {0};
+    memcpy(expected_data, write_data, data_space - WORD_SIZE);
+    memset(&expected_data[data_space - WORD_SIZE], FLASH_EMPTY_VALUE, WORD_SIZE);
+    memcpy(&expected_data[data_space], write_data, WORD_SIZE);
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, data_space + WORD_SIZE, "Data not equivalent");
+}
+
+/* Tick count handed to the driver by tests. */
+static uint32_t test_ticks = 0;
+static uint32_t test_tick(void)
+{
+    return test_ticks;
+}
+
+/*
+Writes to a buffered index stay in RAM, packed together, until the buffer fills. Reading relative to the head still sees them.
+*/
+TEST(Test, buffered_index_holds_writes_until_full)
+{
+    int id = 0;
+    REGISTER_ID_OK_TEXT(START_PAGE, START_PAGE + 2, id, "Failed to register new index");
+    uint8_t buffer[2*WORD_SIZE] = {0};
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_set_write_buffer(id, buffer, sizeof(buffer), 0, 0), "Failed to set write buffer");
+
+    // Three 5 byte records fit in the buffer without any padding between them
+    uint8_t record[5] = {0};
+    for(uint8_t idx = 0; idx < 3; idx++)
+    {
+        memset(record, idx + 1, sizeof(record));
+        WRITE_INDEX_OK_TEXT(id, record, sizeof(record), "Buffered write failed");
+    }
+
+    // Nothing in flash yet
+    uint8_t empty[3*5] = {0};
+    memset(empty, FLASH_EMPTY_VALUE, sizeof(empty));
+    uint8_t flash_data[3*5] = {0};
+    FLASH_READ_OK((START_PAGE + 1)*PAGE_SIZE, flash_data, sizeof(flash_data));
+    MEMCMP_EQUAL_TEXT(empty, flash_data, sizeof(flash_data), "Buffered data written too soon");
+
+    // Head includes the buffered bytes and reads relative to it see them
+    CHECK_EQUAL_TEXT((START_PAGE + 1)*PAGE_SIZE + 15, flash_index_get_head(id), "Head doesn't include buffered data");
+    uint8_t expected_data[3*5] = {1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3};
+    uint8_t read_data[3*5] = {0};
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_read_rel_head(id, -15, read_data, 15), "Read relative to head failed.");
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, sizeof(read_data), "Buffered data not read back");
+
+    // A fourth record fills the buffer so the two full words are written and the last byte stays buffered
+    memset(record, 4, sizeof(record));
+    WRITE_INDEX_OK_TEXT(id, record, sizeof(record), "Buffered write failed");
+
+    uint8_t expected_flash[2*WORD_SIZE] = {1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 4};
+    uint8_t written_data[2*WORD_SIZE] = {0};
+    FLASH_READ_OK((START_PAGE + 1)*PAGE_SIZE, written_data, sizeof(written_data));
+    MEMCMP_EQUAL_TEXT(expected_flash, written_data, sizeof(written_data), "Full buffer not written");
+    CHECK_EQUAL_TEXT((START_PAGE + 1)*PAGE_SIZE + 20, flash_index_get_head(id), "Head doesn't include buffered data");
+
+    // The index was written along with the data
+    uint32_t index_address = 0;
+    CHECK_EQUAL(FLASH_OK, flash_index_get_index_address(id, &index_address));
+}
+
+/*
+Flushing a buffered index writes everything, padding the partial word.
+*/
+TEST(Test, flush_buffered_index)
+{
+    int id = 0;
+    REGISTER_ID_OK_TEXT(START_PAGE, START_PAGE + 2, id, "Failed to register new index");
+    uint8_t buffer[2*WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_index_set_write_buffer(id, buffer, sizeof(buffer), 0, 0));
+
+    uint8_t record[3] = {7, 8, 9};
+    WRITE_INDEX_OK_TEXT(id, record, sizeof(record), "Buffered write failed");
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_flush(id), "Flush failed");
+
+    uint8_t expected_data[WORD_SIZE] = {7, 8, 9, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    uint8_t read_data[WORD_SIZE] = {0};
+    FLASH_READ_OK((START_PAGE + 1)*PAGE_SIZE, read_data, WORD_SIZE);
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, WORD_SIZE, "Flushed data not padded");
+
+    // Head moved on to the next whole word
+    CHECK_EQUAL_TEXT((START_PAGE + 1)*PAGE_SIZE + WORD_SIZE, flash_index_get_head(id), "Head not word aligned after flush");
+
+    // Index written so it can be loaded
+    CHECK_EQUAL(FLASH_OK, flash_index_reset(id));
+    CHECK_EQUAL(FLASH_OK, flash_index_load(id));
+    CHECK_EQUAL_TEXT((START_PAGE + 1)*PAGE_SIZE + WORD_SIZE, flash_index_get_head(id), "Loaded head doesn't match");
+}
+
+/*
+Buffered data is written once enough bytes are waiting.
+*/
+TEST(Test, buffered_index_flushes_at_threshold)
+{
+    int id = 0;
+    REGISTER_ID_OK_TEXT(START_PAGE, START_PAGE + 2, id, "Failed to register new index");
+    uint8_t buffer[4*WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_index_set_write_buffer(id, buffer, sizeof(buffer), WORD_SIZE, 0));
+
+    // Not enough to reach the threshold
+    uint8_t record[WORD_SIZE + 2] = {0};
+    WRITE_INDEX_OK_TEXT(id, record, WORD_SIZE - 1, "Buffered write failed");
+    uint8_t read_data[WORD_SIZE] = {0};
+    FLASH_READ_OK((START_PAGE + 1)*PAGE_SIZE, read_data, WORD_SIZE);
+    CHECK_EQUAL_TEXT(FLASH_EMPTY_VALUE, read_data[0], "Written before threshold");
+
+    // Over the threshold, the whole word goes out
+    WRITE_INDEX_OK_TEXT(id, record, 3, "Buffered write failed");
+    FLASH_READ_OK((START_PAGE + 1)*PAGE_SIZE, read_data, WORD_SIZE);
+    uint8_t expected_data[WORD_SIZE] = {0};
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, WORD_SIZE, "Not written at threshold");
+}
+
+/*
+Buffered data that has waited long enough is written by flash_poll.
+*/
+TEST(Test, buffered_index_flushes_on_age)
+{
+    int id = 0;
+    REGISTER_ID_OK_TEXT(START_PAGE, START_PAGE + 2, id, "Failed to register new index");
+    uint8_t buffer[4*WORD_SIZE] = {0};
+    test_ticks = 100;
+    flash_set_tick_source(test_tick);
+    CHECK_EQUAL(FLASH_OK, flash_index_set_write_buffer(id, buffer, sizeof(buffer), 0, 50));
+
+    uint8_t record[2] = {0x12, 0x34};
+    WRITE_INDEX_OK_TEXT(id, record, sizeof(record), "Buffered write failed");
+
+    // Not old enough yet
+    test_ticks = 149;
+    CHECK_EQUAL(FLASH_OK, flash_poll());
+    uint8_t read_data[2] = {0};
+    FLASH_READ_OK((START_PAGE + 1)*PAGE_SIZE, read_data, 2);
+    CHECK_EQUAL_TEXT(FLASH_EMPTY_VALUE, read_data[0], "Written before it aged");
+
+    // Old enough
+    test_ticks = 150;
+    CHECK_EQUAL(FLASH_OK, flash_poll());
+    FLASH_READ_OK((START_PAGE + 1)*PAGE_SIZE, read_data, 2);
+    MEMCMP_EQUAL_TEXT(record, read_data, 2, "Not written when aged");
+}
+
+/*
+A write buffer has to be a whole number of words.
+*/
+TEST(Test, write_buffer_must_be_whole_words)
+{
+    int id = 0;
+    REGISTER_ID_OK_TEXT(START_PAGE, START_PAGE + 2, id, "Failed to register new index");
+    uint8_t buffer[WORD_SIZE + 1] = {0};
+    CHECK_EQUAL(FLASH_ERROR, flash_index_set_write_buffer(id, buffer, sizeof(buffer), 0, 0));
+}
+
+/* Two contexts on different pages of the same flash don't share indices or data. */
+TEST(Test, contexts_are_independent)
+{
+    flash_ctx_t ctx_a;
+    flash_ctx_t ctx_b;
+    uint8_t start_page_b = NUMBER_PAGES/2;
+    flash_ctx_init(&ctx_a, (flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, start_page_b - START_PAGE, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+    flash_ctx_init(&ctx_b, (flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES/2 - 1, start_page_b, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+
+    int id_a = flash_ctx_index_register(&ctx_a, START_PAGE, START_PAGE + 2);
+    int id_b = flash_ctx_index_register(&ctx_b, start_page_b, start_page_b + 2);
+    CHECK_EQUAL_TEXT(0, id_a, "First index of a context isn't 0");
+    CHECK_EQUAL_TEXT(0, id_b, "Contexts share indices");
+    CHECK_EQUAL_TEXT((uint32_t)-1, flash_index_get_head(0), "Default context has an index");
+
+    uint8_t data_a[WORD_SIZE] = {1, 1, 1, 1, 1, 1, 1, 1};
+    uint8_t data_b[WORD_SIZE] = {2, 2, 2, 2, 2, 2, 2, 2};
+    CHECK_EQUAL(FLASH_OK, flash_ctx_index_write(&ctx_a, id_a, data_a, WORD_SIZE));
+    CHECK_EQUAL(FLASH_OK, flash_ctx_index_write(&ctx_b, id_b, data_b, WORD_SIZE));
+
+    uint8_t read_data[WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_ctx_index_read_rel_head(&ctx_a, id_a, -WORD_SIZE, read_data, WORD_SIZE));
+    MEMCMP_EQUAL_TEXT(data_a, read_data, WORD_SIZE, "Context a data overwritten");
+    CHECK_EQUAL(FLASH_OK, flash_ctx_index_read_rel_head(&ctx_b, id_b, -WORD_SIZE, read_data, WORD_SIZE));
+    MEMCMP_EQUAL_TEXT(data_b, read_data, WORD_SIZE, "Context b data overwritten");
+
+    // Context b's data is in the second half of the flash.
+    flash_spy_read((start_page_b + 1) * PAGE_SIZE, read_data, WORD_SIZE);
+    MEMCMP_EQUAL(data_b, read_data, WORD_SIZE);
+}
+
+/* A context only has room for FLASH_MAX_INDICES indices. */
+TEST(Test, register_too_many_indices)
+{
+    for (uint8_t idx = 0; idx < FLASH_MAX_INDICES; idx++)
+    {
+        CHECK_EQUAL(idx, flash_index_register(START_PAGE + 2 * idx, START_PAGE + 2 * idx + 1));
+    }
+
+    CHECK_EQUAL_TEXT(-1, flash_index_register(START_PAGE + 2 * FLASH_MAX_INDICES, START_PAGE + 2 * FLASH_MAX_INDICES + 1), "Registered more than FLASH_MAX_INDICES");
+}
+
+/* Pages erased ahead by flash_poll save writes from erasing. */
+TEST(Test, erase_ahead_avoids_stalls)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 4);
+    CHECK_EQUAL(FLASH_OK, flash_index_set_erase_ahead(id, 2));
+
+    CHECK_EQUAL(FLASH_OK, flash_poll());
+    CHECK_EQUAL(FLASH_OK, flash_poll());
+
+    uint8_t write_data[PAGE_SIZE];
+    memset(write_data, 0x11, PAGE_SIZE);
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, PAGE_SIZE));
+    memset(write_data, 0x22, PAGE_SIZE);
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, PAGE_SIZE));
+    CHECK_EQUAL_TEXT(0, flash_index_get_erase_stalls(id), "Write waited for an erase");
+
+    // Nothing erased ahead any more so the next page is erased by the write.
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, WORD_SIZE));
+    CHECK_EQUAL(1, flash_index_get_erase_stalls(id));
+
+    // Erasing ahead leaves the data behind the head alone.
+    CHECK_EQUAL(FLASH_OK, flash_poll());
+    CHECK_EQUAL(FLASH_OK, flash_poll());
+    uint8_t read_data[PAGE_SIZE];
+    CHECK_EQUAL(FLASH_OK, flash_index_read_rel_head(id, -(PAGE_SIZE + WORD_SIZE), read_data, PAGE_SIZE));
+    MEMCMP_EQUAL(write_data, read_data, PAGE_SIZE);
+}
+
+/* Each page is erased as the head comes back round to it, not just the first one. */
+TEST(Test, index_pages_erased_on_every_lap)
+{
+    uint8_t data_pages = 3;
+    int id = flash_index_register(START_PAGE, START_PAGE + data_pages);
+
+    uint8_t write_data[WORD_SIZE];
+    for (uint8_t lap = 1; lap <= 2; lap++)
+    {
+        memset(write_data, lap, WORD_SIZE);
+        for (uint16_t idx = 0; idx < data_pages * PAGE_SIZE / WORD_SIZE; idx++)
+        {
+            CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, WORD_SIZE));
+        }
+    }
+
+    uint8_t read_data[WORD_SIZE];
+    for (uint8_t page = 1; page <= data_pages; page++)
+    {
+        flash_spy_read((START_PAGE + page) * PAGE_SIZE, read_data, WORD_SIZE);
+        MEMCMP_EQUAL_TEXT(write_data, read_data, WORD_SIZE, "Second lap didn't overwrite the first");
+    }
+}
+
+/* An index can use the last pages of the user flash, including erasing them and erasing them ahead. */
+TEST(Test, index_on_last_user_pages)
+{
+    uint8_t user_pages = 8;
+    flash_init((flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, user_pages, 0, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+    ERASE_OK_TEXT(user_pages - 1, 1, "Couldn't erase the last user page");
+
+    int id = flash_index_register(user_pages - 3, user_pages - 1);
+    CHECK_EQUAL(FLASH_OK, flash_index_set_erase_ahead(id, 1));
+    CHECK_EQUAL(FLASH_OK, flash_poll());
+
+    uint8_t write_data[2 * WORD_SIZE];
+    memset(write_data, 0x5A, sizeof(write_data));
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_write(id, write_data, sizeof(write_data)), "First write to the index failed");
+
+    // Go round the index so every page is erased when the head enters it.
+    for (uint8_t idx = 0; idx < 2 * PAGE_SIZE / sizeof(write_data); idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, sizeof(write_data)));
+    }
+
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_all_data(id));
+}
+
+/* The page the head is on can't be erased ahead. */
+TEST(Test, erase_ahead_window_too_big)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 3);
+    CHECK_EQUAL(FLASH_ERROR, flash_index_set_erase_ahead(id, 3));
+    CHECK_EQUAL(FLASH_OK, flash_index_set_erase_ahead(id, 2));
+}
+
+/* Backend that counts reads so tests can see what was answered from RAM. */
+static uint32_t backend_reads = 0;
+static flash_status_t counting_read(uint32_t read_address, uint8_t * data, uint16_t read_length)
+{
+    backend_reads++;
+    return flash_spy_read(read_address, data, read_length);
+}
+
+/* The erased map only knows about pages erased since it was set and follows writes to them. */
+TEST(Test, erased_map_follows_erase_and_write)
+{
+    static uint8_t map[FLASH_ERASED_MAP_SIZE(NUMBER_PAGES, PAGE_SIZE, WORD_SIZE)];
+    CHECK_EQUAL(FLASH_ERROR, flash_set_erased_map(map, sizeof(map) - 1));
+    CHECK_EQUAL(FLASH_OK, flash_set_erased_map(map, sizeof(map)));
+
+    uint32_t address = (START_PAGE + 1) * PAGE_SIZE;
+    CHECK_FALSE_TEXT(flash_is_erased(address, PAGE_SIZE), "Map knows about a page before it was erased");
+
+    ERASE_OK_TEXT(START_PAGE + 1, 1, "Erase failed");
+    CHECK_TRUE(flash_is_erased(address, PAGE_SIZE));
+
+    uint8_t write_data[WORD_SIZE + 1] = {0};
+    WRITE_OK(address, write_data, WORD_SIZE + 1);
+    CHECK_FALSE(flash_is_erased(address, WORD_SIZE));
+    CHECK_FALSE(flash_is_erased(address + WORD_SIZE, WORD_SIZE));
+    CHECK_TRUE(flash_is_erased(address + 2*WORD_SIZE, PAGE_SIZE - 2*WORD_SIZE));
+}
+
+/* The map keeps up with erases and index writes that reach page 255, the last page there can be. */
+TEST(Test, erased_map_on_last_possible_page)
+{
+    uint8_t start_page = 200;
+    uint8_t user_pages = 56;
+    flash_spy_deinit();
+    flash_spy_init(WORD_SIZE, PAGE_SIZE, (start_page + user_pages) * PAGE_SIZE);
+    flash_init((flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, user_pages, start_page, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+    static uint8_t map[FLASH_ERASED_MAP_SIZE(56, PAGE_SIZE, WORD_SIZE)];
+    CHECK_EQUAL(FLASH_OK, flash_set_erased_map(map, sizeof(map)));
+
+    ERASE_OK_TEXT(255, 1, "Erase of page 255 failed");
+    CHECK_TRUE(flash_is_erased(255 * PAGE_SIZE, PAGE_SIZE));
+
+    int id = flash_index_register(253, 255);
+    uint8_t write_data[2 * WORD_SIZE] = {0};
+    for (uint8_t idx = 0; idx < 2 * PAGE_SIZE / sizeof(write_data) + 1; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, sizeof(write_data)));
+    }
+    CHECK_FALSE(flash_is_erased(254 * PAGE_SIZE, WORD_SIZE));
+}
+
+/* Writing over written flash fails without calling the user write function. */
+TEST(Test, erased_map_stops_write_to_written_word)
+{
+    static uint8_t map[FLASH_ERASED_MAP_SIZE(NUMBER_PAGES, PAGE_SIZE, WORD_SIZE)];
+    flash_init(recording_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+    flash_set_erased_map(map, sizeof(map));
+    ERASE_OK_TEXT(START_PAGE, 1, "Erase failed");
+
+    uint8_t write_data[WORD_SIZE] = {0};
+    WRITE_OK(START_PAGE * PAGE_SIZE, write_data, WORD_SIZE);
+
+    last_backend_data = NULL;
+    CHECK_EQUAL(FLASH_NOT_ERASED_ERROR, flash_write(START_PAGE * PAGE_SIZE, write_data, WORD_SIZE));
+    POINTERS_EQUAL_TEXT(NULL, last_backend_data, "User write function was called");
+}
+
+/* Once the index page has been erased the latest index data is found without reading the flash. */
+TEST(Test, erased_map_finds_index_data_without_reads)
+{
+    static uint8_t map[FLASH_ERASED_MAP_SIZE(NUMBER_PAGES, PAGE_SIZE, WORD_SIZE)];
+    flash_init((flash_write_ptr)flash_spy_write, counting_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+    flash_set_erased_map(map, sizeof(map));
+
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_index(id));
+    CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+    CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+
+    backend_reads = 0;
+    uint32_t address = 0;
+    CHECK_EQUAL(FLASH_OK, flash_index_get_index_address(id, &address));
+    CHECK_EQUAL(START_PAGE * PAGE_SIZE + WORD_SIZE, address);
+    CHECK_EQUAL_TEXT(0, backend_reads, "Index page was read");
+}
+
+/* The latest index data is found at every fill level of the index page without reading every entry. */
+TEST(Test, index_address_lookup_reads_are_logarithmic)
+{
+    flash_init((flash_write_ptr)flash_spy_write, counting_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_index(id));
+
+    uint32_t entries = PAGE_SIZE / WORD_SIZE;
+    uint32_t address = 0;
+    for (uint32_t written = 0; written <= entries; written++)
+    {
+        backend_reads = 0;
+        if (written == 0)
+        {
+            CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_index_get_index_address(id, &address));
+        }
+        else
+        {
+            CHECK_EQUAL(FLASH_OK, flash_index_get_index_address(id, &address));
+            CHECK_EQUAL(START_PAGE * PAGE_SIZE + (written - 1) * WORD_SIZE, address);
+        }
+        CHECK_TEXT(backend_reads <= 3, "More reads than a binary search over the entries");
+
+        if (written < entries)
+        {
+            CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+        }
+    }
+}
+
+/* Writing index data doesn't search the index page for where to put it. */
+TEST(Test, write_index_without_reads)
+{
+    flash_init((flash_write_ptr)flash_spy_write, counting_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_index(id));
+
+    backend_reads = 0;
+    for (uint32_t idx = 0; idx < 2 * PAGE_SIZE / WORD_SIZE + 1; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+    }
+    CHECK_EQUAL_TEXT(0, backend_reads, "Index page was searched");
+
+    uint32_t address = 0;
+    CHECK_EQUAL(FLASH_OK, flash_index_get_index_address(id, &address));
+    CHECK_EQUAL(START_PAGE * PAGE_SIZE, address);
+}
+
+/* After loading, index data is written after what was loaded. */
+TEST(Test, write_index_after_load)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_index(id));
+    CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+    CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+
+    // Something else writes index data to the page behind the driver's back.
+    uint8_t index_data[WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_write(START_PAGE * PAGE_SIZE + 2 * WORD_SIZE, index_data, WORD_SIZE));
+
+    CHECK_EQUAL(FLASH_OK, flash_index_load(id));
+    CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+
+    uint32_t address = 0;
+    CHECK_EQUAL(FLASH_OK, flash_index_get_index_address(id, &address));
+    CHECK_EQUAL(START_PAGE * PAGE_SIZE + 3 * WORD_SIZE, address);
+}
+
+/* Write records with a checkpoint policy then load the index as if after a reboot and check the head came back. */
+static void check_checkpoint_recovery(flash_checkpoint_policy_t policy, uint32_t every, uint8_t writes)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 3);
+    CHECK_EQUAL(FLASH_OK, flash_index_set_checkpoint(id, policy, every));
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_index(id));
+
+    uint8_t record[5] = {1, 2, 3, 4, 5};
+    for (uint8_t idx = 0; idx < writes; idx++)
+    {
+        record[0] = idx;
+        CHECK_EQUAL(FLASH_OK, flash_index_write(id, record, sizeof(record)));
+    }
+
+    uint32_t head = flash_index_get_head(id);
+    CHECK_EQUAL(FLASH_OK, flash_index_reset(id));
+    CHECK_EQUAL(FLASH_OK, flash_index_load(id));
+    CHECK_EQUAL(head, flash_index_get_head(id));
+}
+
+TEST(Test, checkpoint_every_records_recovers_head)
+{
+    // Goes round both the data pages and the index page more than once.
+    check_checkpoint_recovery(FLASH_CHECKPOINT_RECORDS, 3, 29);
+}
+
+TEST(Test, checkpoint_every_bytes_recovers_head)
+{
+    check_checkpoint_recovery(FLASH_CHECKPOINT_BYTES, 2 * WORD_SIZE, 14);
+}
+
+TEST(Test, checkpoint_on_page_recovers_head)
+{
+    check_checkpoint_recovery(FLASH_CHECKPOINT_PAGE, 0, 14);
+}
+
+/* With the page policy the index is only written when the head moves onto a new page. */
+TEST(Test, checkpoint_on_page_writes_once_per_page)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 3);
+    CHECK_EQUAL(FLASH_OK, flash_index_set_checkpoint(id, FLASH_CHECKPOINT_PAGE, 0));
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_index(id));
+
+    uint8_t record[WORD_SIZE] = {0};
+    for (uint8_t idx = 0; idx < 2 * PAGE_SIZE / WORD_SIZE; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_index_write(id, record, sizeof(record)));
+    }
+
+    // One for each of the two pages written.
+    uint32_t address = 0;
+    CHECK_EQUAL(FLASH_OK, flash_index_get_index_address(id, &address));
+    CHECK_EQUAL(START_PAGE * PAGE_SIZE + WORD_SIZE, address);
+}
+
+/* With the manual policy loading starts from what was last written with flash_index_write_index and scans past the
+data written since, so the next write goes after it. */
+TEST(Test, checkpoint_manual_loads_last_write_index)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 3);
+    CHECK_EQUAL(FLASH_OK, flash_index_set_checkpoint(id, FLASH_CHECKPOINT_MANUAL, 0));
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_index(id));
+
+    uint8_t record[WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, record, sizeof(record)));
+    CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_index_load(id));
+
+    CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+    uint32_t head = flash_index_get_head(id);
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, record, sizeof(record)));
+
+    CHECK_EQUAL(FLASH_OK, flash_index_load(id));
+    CHECK_EQUAL(head + WORD_SIZE, flash_index_get_head(id));
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_index_write(id, record, sizeof(record)), "Write after load hit unerased flash");
+}
+
+TEST(Test, checkpoint_counting_policy_needs_count)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 3);
+    CHECK_EQUAL(FLASH_ERROR, flash_index_set_checkpoint(id, FLASH_CHECKPOINT_RECORDS, 0));
+    CHECK_EQUAL(FLASH_ERROR, flash_index_set_checkpoint(id, FLASH_CHECKPOINT_BYTES, 0));
+    CHECK_EQUAL(FLASH_ERROR, flash_index_set_checkpoint(id + 1, FLASH_CHECKPOINT_PAGE, 0));
+}
+
+/* With a CRC on the index data, loading skips back past index data that was only partly written. */
+TEST(Test, checkpoint_crc_skips_torn_index_data)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 3);
+    CHECK_EQUAL(FLASH_OK, flash_index_set_checkpoint(id, FLASH_CHECKPOINT_MANUAL, 0));
+    CHECK_EQUAL(FLASH_OK, flash_index_set_checkpoint_crc(id, true));
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_index(id));
+
+    uint8_t record[WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, record, sizeof(record)));
+    CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+    uint32_t head = flash_index_get_head(id);
+
+    // The head and tail of the next index data made it to flash but the power went before its CRC did.
+    uint32_t address = 0;
+    CHECK_EQUAL(FLASH_OK, flash_index_get_index_address(id, &address));
+    uint8_t torn[WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_write(address + 2 * WORD_SIZE, torn, sizeof(torn)));
+
+    CHECK_EQUAL(FLASH_OK, flash_index_load(id));
+    CHECK_EQUAL(head, flash_index_get_head(id));
+
+    // The torn one still takes up its spot, which fills the index page, so the next index data starts it again.
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, record, sizeof(record)));
+    CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+    CHECK_EQUAL(FLASH_OK, flash_index_get_index_address(id, &address));
+    CHECK_EQUAL(START_PAGE * PAGE_SIZE, address);
+    CHECK_EQUAL(FLASH_OK, flash_index_load(id));
+    CHECK_EQUAL(head + WORD_SIZE, flash_index_get_head(id));
+}
+
+TEST(Test, checkpoint_crc_no_good_index_data)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 3);
+    CHECK_EQUAL(FLASH_OK, flash_index_set_checkpoint_crc(id, true));
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_index(id));
+
+    uint8_t torn[WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_write(START_PAGE * PAGE_SIZE, torn, sizeof(torn)));
+    CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_index_load(id));
+}
+
+/* Index data with a CRC doesn't fill the index page exactly on small words, so the last whole one is the last on the page. */
+TEST(Test, checkpoint_crc_stays_on_index_page)
+{
+    uint8_t word_size = 4;
+    REINIT_FLASH_CUSTOM(word_size, FLASH_ENDIANESS_LITTLE);
+    int id = flash_index_register(START_PAGE, START_PAGE + 3);
+    CHECK_EQUAL(FLASH_OK, flash_index_set_checkpoint_crc(id, true));
+    CHECK_EQUAL(FLASH_OK, flash_index_erase_all_data(id));
+
+    // 12 bytes each so only two fit on the index page, the third starts it again.
+    uint32_t address = 0;
+    for (uint8_t idx = 0; idx < 3; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_index_write_index(id));
+    }
+    CHECK_EQUAL(FLASH_OK, flash_index_get_index_address(id, &address));
+    CHECK_EQUAL(START_PAGE * PAGE_SIZE, address);
+
+    uint8_t expected_data[PAGE_SIZE];
+    uint8_t read_data[PAGE_SIZE];
+    memset(expected_data, FLASH_EMPTY_VALUE, PAGE_SIZE);
+    flash_spy_read((START_PAGE + 1) * PAGE_SIZE, read_data, PAGE_SIZE);
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, PAGE_SIZE, "Index data spilled into the first data page");
+
+    uint8_t record[WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, record, sizeof(record)));
+}
+
+/* Repeated reads of a page are served from the read cache. */
+TEST(Test, read_cache_hits_and_misses)
+{
+    static flash_cache_slot_t slots[2];
+    static uint8_t arena[2 * PAGE_SIZE];
+    flash_init((flash_write_ptr)flash_spy_write, counting_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+    CHECK_EQUAL(FLASH_ERROR, flash_set_read_cache(slots, 2, arena, sizeof(arena) - 1));
+    CHECK_EQUAL(FLASH_OK, flash_set_read_cache(slots, 2, arena, sizeof(arena)));
+
+    uint8_t write_data[WORD_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8};
+    WRITE_OK(START_PAGE * PAGE_SIZE, write_data, WORD_SIZE);
+
+    backend_reads = 0;
+    uint8_t read_data[WORD_SIZE] = {0};
+    for (uint8_t idx = 0; idx < 5; idx++)
+    {
+        FLASH_READ_OK(START_PAGE * PAGE_SIZE, read_data, WORD_SIZE);
+        MEMCMP_EQUAL(write_data, read_data, WORD_SIZE);
+    }
+
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    flash_get_read_cache_counts(&hits, &misses);
+    CHECK_EQUAL(4, hits);
+    CHECK_EQUAL(1, misses);
+    CHECK_EQUAL_TEXT(1, backend_reads, "Cached page read from flash again");
+}
+
+/* Writes and erases keep the cached pages the same as the flash. */
+TEST(Test, read_cache_follows_write_and_erase)
+{
+    static flash_cache_slot_t slots[2];
+    static uint8_t arena[2 * PAGE_SIZE];
+    CHECK_EQUAL(FLASH_OK, flash_set_read_cache(slots, 2, arena, sizeof(arena)));
+
+    uint8_t read_data[2 * WORD_SIZE] = {0};
+    FLASH_READ_OK(START_PAGE * PAGE_SIZE, read_data, 2 * WORD_SIZE);
+
+    uint8_t write_data[2 * WORD_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    WRITE_OK(START_PAGE * PAGE_SIZE, write_data, 2 * WORD_SIZE - 5);
+    memset(&write_data[2 * WORD_SIZE - 5], FLASH_EMPTY_VALUE, 5);
+    FLASH_READ_OK(START_PAGE * PAGE_SIZE, read_data, 2 * WORD_SIZE);
+    MEMCMP_EQUAL_TEXT(write_data, read_data, 2 * WORD_SIZE, "Cache missed a write");
+
+    ERASE_OK_TEXT(START_PAGE, 1, "Erase failed");
+    memset(write_data, FLASH_EMPTY_VALUE, sizeof(write_data));
+    FLASH_READ_OK(START_PAGE * PAGE_SIZE, read_data, 2 * WORD_SIZE);
+    MEMCMP_EQUAL_TEXT(write_data, read_data, 2 * WORD_SIZE, "Cache missed an erase");
+}
+
+/* When the cache is full the least recently used page makes way. */
+TEST(Test, read_cache_replaces_least_recently_used)
+{
+    static flash_cache_slot_t slots[2];
+    static uint8_t arena[2 * PAGE_SIZE];
+    flash_set_read_cache(slots, 2, arena, sizeof(arena));
+
+    uint8_t read_data[WORD_SIZE];
+    FLASH_READ_OK(1 * PAGE_SIZE, read_data, WORD_SIZE);
+    FLASH_READ_OK(2 * PAGE_SIZE, read_data, WORD_SIZE);
+    FLASH_READ_OK(1 * PAGE_SIZE, read_data, WORD_SIZE);
+    FLASH_READ_OK(3 * PAGE_SIZE, read_data, WORD_SIZE);
+
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    FLASH_READ_OK(1 * PAGE_SIZE, read_data, WORD_SIZE);
+    flash_get_read_cache_counts(&hits, &misses);
+    CHECK_EQUAL_TEXT(2, hits, "Recently used page was replaced");
+
+    FLASH_READ_OK(2 * PAGE_SIZE, read_data, WORD_SIZE);
+    flash_get_read_cache_counts(&hits, &misses);
+    CHECK_EQUAL_TEXT(4, misses, "Least recently used page wasn't replaced");
+}
+
+/* Reading from the tail carries on from the start of the data pages when it gets to the end. */
+TEST(Test, index_read_wraps_tail)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    uint16_t data_space = 2 * PAGE_SIZE;
+
+    uint8_t write_data[2 * PAGE_SIZE];
+    uint8_t read_data[2 * PAGE_SIZE];
+    memset(write_data, 0x11, sizeof(write_data));
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, data_space - 2 * WORD_SIZE));
+    CHECK_EQUAL(FLASH_OK, flash_index_read(id, read_data, data_space - 2 * WORD_SIZE));
+
+    for (uint16_t idx = 0; idx < 4 * WORD_SIZE; idx++)
+    {
+        write_data[idx] = idx;
+    }
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, 4 * WORD_SIZE));
+    CHECK_EQUAL(FLASH_OK, flash_index_read(id, read_data, 4 * WORD_SIZE));
+    MEMCMP_EQUAL_TEXT(write_data, read_data, 4 * WORD_SIZE, "Read didn't follow the wrap");
+}
+
+/* With a read ahead buffer, draining records costs one flash read per buffer full. */
+TEST(Test, index_read_ahead)
+{
+    flash_init((flash_write_ptr)flash_spy_write, counting_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    uint8_t read_ahead[PAGE_SIZE];
+    CHECK_EQUAL(FLASH_OK, flash_index_set_read_ahead(id, read_ahead, sizeof(read_ahead)));
+
+    uint8_t write_data[WORD_SIZE];
+    for (uint8_t record = 0; record < 6; record++)
+    {
+        memset(write_data, record, WORD_SIZE);
+        CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, WORD_SIZE));
+    }
+
+    backend_reads = 0;
+    uint8_t read_data[WORD_SIZE];
+    for (uint8_t record = 0; record < 6; record++)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_index_read(id, read_data, WORD_SIZE));
+        memset(write_data, record, WORD_SIZE);
+        MEMCMP_EQUAL(write_data, read_data, WORD_SIZE);
+    }
+    CHECK_EQUAL_TEXT(2, backend_reads, "Expected one read per page of records");
+
+    // Data written after the read ahead is still seen.
+    memset(write_data, 0x77, WORD_SIZE);
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, WORD_SIZE));
+    CHECK_EQUAL(FLASH_OK, flash_index_read(id, read_data, WORD_SIZE));
+    MEMCMP_EQUAL(write_data, read_data, WORD_SIZE);
+}
+
+/* A bulk read moves the tail past whatever was read ahead, so it isn't served again once the index goes round. */
+TEST(Test, index_read_bulk_drops_read_ahead)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    uint16_t data_space = 2 * PAGE_SIZE;
+    uint8_t read_ahead[PAGE_SIZE];
+    CHECK_EQUAL(FLASH_OK, flash_index_set_read_ahead(id, read_ahead, sizeof(read_ahead)));
+
+    uint8_t write_data[2 * PAGE_SIZE];
+    memset(write_data, 0x11, sizeof(write_data));
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, 2 * WORD_SIZE));
+    uint8_t read_data[2 * PAGE_SIZE];
+    CHECK_EQUAL(FLASH_OK, flash_index_read(id, read_data, WORD_SIZE));
+
+    // Go round so the data that was read ahead is overwritten.
+    memset(write_data, 0x22, sizeof(write_data));
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, data_space - 2 * WORD_SIZE));
+    memset(write_data, 0x33, sizeof(write_data));
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, 2 * WORD_SIZE));
+
+    // A whole lap brings the tail back to where it was.
+    CHECK_EQUAL(FLASH_OK, flash_index_read_bulk(id, read_data, data_space));
+
+    CHECK_EQUAL(FLASH_OK, flash_index_read(id, read_data, WORD_SIZE));
+    MEMCMP_EQUAL_TEXT(write_data, read_data, WORD_SIZE, "Read served from a stale read ahead buffer");
+}
+
+/* Views point straight into the mapped flash. */
+TEST(Test, read_view_points_into_mapped_flash)
+{
+    flash_view_t view;
+    CHECK_EQUAL_TEXT(FLASH_ERROR, flash_read_view(START_PAGE * PAGE_SIZE, WORD_SIZE, &view), "View of flash that isn't mapped");
+
+    flash_set_memory_map(flash_spy_memory());
+    uint8_t write_data[WORD_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8};
+    WRITE_OK(START_PAGE * PAGE_SIZE, write_data, WORD_SIZE);
+
+    CHECK_EQUAL(FLASH_OK, flash_read_view(START_PAGE * PAGE_SIZE, WORD_SIZE, &view));
+    POINTERS_EQUAL(flash_spy_memory() + START_PAGE * PAGE_SIZE, view.data);
+    CHECK_EQUAL(WORD_SIZE, view.length);
+    MEMCMP_EQUAL(write_data, view.data, WORD_SIZE);
+
+    CHECK_EQUAL_TEXT(FLASH_ERROR, flash_read_view((START_PAGE + NUMBER_PAGES) * PAGE_SIZE - WORD_SIZE, 2 * WORD_SIZE, &view), "View past the end of flash");
+}
+
+/* An index view over the wrap comes back in two pieces. */
+TEST(Test, index_view_splits_at_wrap)
+{
+    flash_set_memory_map(flash_spy_memory());
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    uint16_t data_space = 2 * PAGE_SIZE;
+
+    uint8_t write_data[2 * PAGE_SIZE];
+    memset(write_data, 0x11, sizeof(write_data));
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, data_space - WORD_SIZE));
+    memset(write_data, 0x22, 2 * WORD_SIZE);
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, 2 * WORD_SIZE));
+
+    flash_view_t views[2];
+    CHECK_EQUAL(FLASH_OK, flash_index_view_rel_head(id, -2 * WORD_SIZE, 2 * WORD_SIZE, views));
+    CHECK_EQUAL(WORD_SIZE, views[0].length);
+    CHECK_EQUAL(WORD_SIZE, views[1].length);
+    POINTERS_EQUAL(flash_spy_memory() + (START_PAGE + 1) * PAGE_SIZE, views[1].data);
+    MEMCMP_EQUAL(write_data, views[0].data, WORD_SIZE);
+    MEMCMP_EQUAL(write_data, views[1].data, WORD_SIZE);
+}
+
+/* Buffered data has no place in flash to view yet. */
+TEST(Test, index_view_of_buffered_data)
+{
+    flash_set_memory_map(flash_spy_memory());
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    uint8_t buffer[PAGE_SIZE];
+    flash_index_set_write_buffer(id, buffer, sizeof(buffer), 0, 0);
+
+    uint8_t write_data[WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, WORD_SIZE));
+
+    flash_view_t views[2];
+    CHECK_EQUAL(FLASH_ERROR, flash_index_view_rel_head(id, -WORD_SIZE, WORD_SIZE, views));
+    CHECK_EQUAL(FLASH_OK, flash_index_flush(id));
+    CHECK_EQUAL(FLASH_OK, flash_index_view_rel_head(id, -WORD_SIZE, WORD_SIZE, views));
+    CHECK_EQUAL(0, views[1].length);
+}
+
+TEST_GROUP(TestWear)
+{
+#define WEAR_PAGE_SIZE 256
+#define WEAR_USER_PAGES 8
+#define WEAR_SPARE_PAGES 6
+#define WEAR_FLASH_SIZE ((WEAR_USER_PAGES + WEAR_SPARE_PAGES) * WEAR_PAGE_SIZE)
+#define WEAR_THRESHOLD 4
+
+    uint32_t table[FLASH_WEAR_TABLE_SIZE(WEAR_USER_PAGES, WEAR_SPARE_PAGES)];
+
+    void setup()
+    {
+        flash_spy_init(WORD_SIZE, WEAR_PAGE_SIZE, WEAR_FLASH_SIZE);
+        flash_spy_erase_all();
+        start();
+    }
+
+    void teardown()
+    {
+        flash_init(0, 0, 0, 0, 0, 0, 0, 0, FLASH_ENDIANESS_BIG);
+        flash_spy_deinit();
+    }
+
+    /* Start up the way a device would, loading whatever table was saved. */
+    void start()
+    {
+        flash_init((flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, WEAR_PAGE_SIZE, WEAR_USER_PAGES, 0, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+        memset(table, 0, sizeof(table));
+        CHECK_EQUAL(FLASH_OK, flash_set_wear_leveling(WEAR_USER_PAGES, WEAR_SPARE_PAGES, WEAR_THRESHOLD, table, FLASH_WEAR_TABLE_SIZE(WEAR_USER_PAGES, WEAR_SPARE_PAGES)));
+    }
+
+    /* Write a half page at a time to an index on pages 0 to 2, the byte written is the number of the write. */
+    void write_busy(int id, uint16_t writes)
+    {
+        uint8_t write_data[WEAR_PAGE_SIZE / 2];
+        for (uint16_t idx = 0; idx < writes; idx++)
+        {
+            memset(write_data, (uint8_t)idx, sizeof(write_data));
+            CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, sizeof(write_data)));
+        }
+    }
+
+    void check_last_write(int id, uint8_t value)
+    {
+        uint8_t expected[WEAR_PAGE_SIZE / 2];
+        uint8_t read_data[WEAR_PAGE_SIZE / 2];
+        memset(expected, value, sizeof(expected));
+        CHECK_EQUAL(FLASH_OK, flash_index_read_rel_head(id, -(int)sizeof(read_data), read_data, sizeof(read_data)));
+        MEMCMP_EQUAL(expected, read_data, sizeof(read_data));
+    }
+};
+
+/* A busy index is spread over the spare pages and the pages nobody uses instead of wearing out its own. */
+TEST(TestWear, busy_index_is_spread_out)
+{
+    int id = flash_index_register(0, 2);
+    write_busy(id, 400);
+    check_last_write(id, (uint8_t)399);
+
+    // Each data page would have been erased 100 times where it was registered.
+    flash_wear_stats_t stats;
+    CHECK_EQUAL(FLASH_OK, flash_get_wear_stats(10000, &stats));
+    CHECK_EQUAL(WEAR_USER_PAGES + WEAR_SPARE_PAGES, stats.pages);
+    CHECK_COMPARE(stats.max_erases, <, 50);
+    CHECK_COMPARE(stats.max_erases - stats.min_erases, <=, 4 * WEAR_THRESHOLD);
+    CHECK_COMPARE(stats.remaps, >, 0);
+    CHECK_COMPARE(stats.migrations, >, 0);
+    CHECK_EQUAL(stats.total_erases / stats.pages, stats.mean_erases);
+    CHECK_EQUAL((uint64_t)stats.total_erases * (10000 - stats.max_erases) / stats.max_erases, stats.remaining_erases);
+
+    uint32_t total = 0;
+    for (uint8_t page = 0; page < WEAR_USER_PAGES + WEAR_SPARE_PAGES; page++)
+    {
+        uint32_t count = 0;
+        CHECK_EQUAL(FLASH_OK, flash_get_erase_count(page, &count));
+        total += count;
+    }
+    CHECK_EQUAL(stats.total_erases, total);
+
+    uint32_t count = 0;
+    CHECK_EQUAL_TEXT(FLASH_ERROR, flash_get_erase_count(WEAR_USER_PAGES + WEAR_SPARE_PAGES, &count), "Count of a page that isn't used");
+}
+
+/* Data that doesn't change is moved out of the way but can still be read where it was written. */
+TEST(TestWear, idle_data_is_moved)
+{
+    int busy_id = flash_index_register(0, 2);
+    int idle_id = flash_index_register(3, 6);
+    uint8_t idle_data[WEAR_PAGE_SIZE / 2];
+    memset(idle_data, 0x5A, sizeof(idle_data));
+    CHECK_EQUAL(FLASH_OK, flash_index_write(idle_id, idle_data, sizeof(idle_data)));
+
+    write_busy(busy_id, 400);
+
+    flash_wear_stats_t stats;
+    CHECK_EQUAL(FLASH_OK, flash_get_wear_stats(10000, &stats));
+    CHECK_COMPARE(stats.migrations, >, 0);
+
+    // The idle index's index page and first data page have both moved.
+    uint32_t count = 0;
+    CHECK_EQUAL(FLASH_OK, flash_get_erase_count(3, &count));
+    CHECK_COMPARE(count, >, 0);
+    check_last_write(idle_id, 0x5A);
+
+    // And can still be written after moving.
+    memset(idle_data, 0xA5, sizeof(idle_data));
+    CHECK_EQUAL(FLASH_OK, flash_index_write(idle_id, idle_data, sizeof(idle_data)));
+    check_last_write(idle_id, 0xA5);
+}
+
+/* Where the pages went and how worn they are is still known after a reboot. */
+TEST(TestWear, table_survives_reboot)
+{
+    int id = flash_index_register(0, 2);
+    write_busy(id, 300);
+    CHECK_EQUAL(FLASH_OK, flash_save_wear());
+
+    flash_wear_stats_t before;
+    CHECK_EQUAL(FLASH_OK, flash_get_wear_stats(10000, &before));
+
+    start();
+    id = flash_index_register(0, 2);
+    CHECK_EQUAL(FLASH_OK, flash_index_load(id));
+    check_last_write(id, (uint8_t)299);
+
+    flash_wear_stats_t after;
+    CHECK_EQUAL(FLASH_OK, flash_get_wear_stats(10000, &after));
+    CHECK_EQUAL(before.total_erases, after.total_erases);
+    CHECK_EQUAL(before.max_erases, after.max_erases);
+
+    // Carries on from where it was.
+    write_busy(id, 100);
+    check_last_write(id, (uint8_t)99);
+}
+
+/* A table that was only partly saved is ignored and the one before it is used. */
+TEST(TestWear, torn_table_is_skipped)
+{
+    int id = flash_index_register(0, 2);
+    write_busy(id, 100);
+    CHECK_EQUAL(FLASH_OK, flash_save_wear());
+
+    flash_wear_stats_t before;
+    CHECK_EQUAL(FLASH_OK, flash_get_wear_stats(10000, &before));
+
+    // The power goes after the first words of the next table.
+    flash_ctx_t * ctx = flash_default_ctx();
+    if (ctx->wear.meta_offset + 2 * WORD_SIZE > WEAR_PAGE_SIZE)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_save_wear());
+        CHECK_EQUAL(FLASH_OK, flash_get_wear_stats(10000, &before));
+    }
+    uint8_t torn[2 * WORD_SIZE] = {0x4D, 0x52, 0x45, 0x57, 0x99, 0x99, 0x99, 0x99, 1, 2, 3, 4, 5, 6, 7, 8};
+    uint32_t torn_address = (WEAR_USER_PAGES + ctx->wear.meta) * WEAR_PAGE_SIZE + ctx->wear.meta_offset;
+    CHECK_EQUAL(FLASH_OK, flash_spy_write(torn_address, torn, 2));
+
+    start();
+    flash_wear_stats_t after;
+    CHECK_EQUAL(FLASH_OK, flash_get_wear_stats(10000, &after));
+    CHECK_EQUAL(before.total_erases, after.total_erases);
+
+    id = flash_index_register(0, 2);
+    CHECK_EQUAL(FLASH_OK, flash_index_load(id));
+    check_last_write(id, (uint8_t)99);
+}
+
+/* Setups that can't work are refused. */
+TEST(TestWear, bad_setup)
+{
+    uint32_t size = FLASH_WEAR_TABLE_SIZE(WEAR_USER_PAGES, WEAR_SPARE_PAGES);
+    CHECK_EQUAL_TEXT(FLASH_ERROR, flash_set_wear_leveling(WEAR_USER_PAGES - 1, WEAR_SPARE_PAGES, WEAR_THRESHOLD, table, size), "Spare pages in the user area");
+    CHECK_EQUAL_TEXT(FLASH_ERROR, flash_set_wear_leveling(WEAR_USER_PAGES, 2, WEAR_THRESHOLD, table, size), "No free spare page");
+    CHECK_EQUAL_TEXT(FLASH_ERROR, flash_set_wear_leveling(WEAR_USER_PAGES, WEAR_SPARE_PAGES, 0, table, size), "Threshold of 0");
+    CHECK_EQUAL_TEXT(FLASH_ERROR, flash_set_wear_leveling(WEAR_USER_PAGES, WEAR_SPARE_PAGES, WEAR_THRESHOLD, table, size - 1), "Table too small");
+
+    // The saved table has to fit on a page.
+    flash_init((flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, WEAR_USER_PAGES, 0, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+    CHECK_EQUAL_TEXT(FLASH_ERROR, flash_set_wear_leveling(WEAR_USER_PAGES, WEAR_SPARE_PAGES, WEAR_THRESHOLD, table, size), "Table bigger than a page");
+
+    CHECK_EQUAL(FLASH_ERROR, flash_save_wear());
+}
+
+#ifdef FLASH_ENABLE_STATS
+/* Counts up by 5 every time it is read, so every timed call takes 5. */
+static uint32_t stats_clock_now = 0;
+static uint32_t stats_clock(void)
+{
+    stats_clock_now += 5;
+    return stats_clock_now;
+}
+
+/* Padding to a whole word is programmed but isn't user data. */
+TEST(Test, stats_count_user_and_programmed_bytes)
+{
+    uint8_t write_data[WORD_SIZE + 5] = {0};
+    WRITE_OK(START_PAGE * PAGE_SIZE, write_data, sizeof(write_data));
+
+    uint8_t read_data[WORD_SIZE];
+    FLASH_READ_OK(START_PAGE * PAGE_SIZE, read_data, sizeof(read_data));
+    ERASE_OK_TEXT(START_PAGE + 1, 2, "Erase failed");
+
+    flash_stats_t stats;
+    flash_stats_get(&stats);
+    CHECK_EQUAL(sizeof(write_data), stats.user_bytes);
+    CHECK_EQUAL(2 * WORD_SIZE, stats.programmed_bytes);
+    CHECK_EQUAL(WORD_SIZE - 5, stats.padding_bytes);
+    CHECK_EQUAL(WORD_SIZE, stats.read_bytes);
+    CHECK_EQUAL(2, stats.calls[FLASH_STATS_WRITE]);
+    CHECK_EQUAL(1, stats.calls[FLASH_STATS_READ]);
+    CHECK_EQUAL(1, stats.calls[FLASH_STATS_ERASE]);
+    CHECK_EQUAL(0, stats.failures[FLASH_STATS_WRITE]);
+    CHECK_EQUAL(0, stats.page_erases[START_PAGE]);
+    CHECK_EQUAL(1, stats.page_erases[START_PAGE + 1]);
+    CHECK_EQUAL(1, stats.page_erases[START_PAGE + 2]);
+
+    // No clock, no timings.
+    CHECK_EQUAL(0, stats.latency[FLASH_STATS_WRITE].buckets[0]);
+
+    flash_stats_reset();
+    flash_stats_get(&stats);
+    CHECK_EQUAL(0, stats.user_bytes);
+    CHECK_EQUAL(0, stats.calls[FLASH_STATS_WRITE]);
+}
+
+/* An index counts its checkpoints, wraps and the pages it erases. */
+TEST(Test, stats_of_an_index)
+{
+    int id = 0;
+    REGISTER_ID_OK_TEXT(START_PAGE, START_PAGE + 2, id, "Failed to register new index");
+
+    // Twice round the two data pages and a bit, four index entries fit on the index page.
+    uint8_t write_data[WORD_SIZE] = {0};
+    for (uint8_t idx = 0; idx < 10; idx++)
+    {
+        WRITE_INDEX_OK_TEXT(id, write_data, WORD_SIZE, "Index write failed");
+    }
+
+    flash_index_stats_t index_stats;
+    CHECK_EQUAL(FLASH_OK, flash_index_stats_get(id, &index_stats));
+    CHECK_EQUAL(10 * WORD_SIZE, index_stats.user_bytes);
+    CHECK_EQUAL(10, index_stats.checkpoint_writes);
+    CHECK_EQUAL(10 * WORD_SIZE, index_stats.checkpoint_bytes);
+    CHECK_EQUAL(1, index_stats.wraps);
+    CHECK_EQUAL(3, index_stats.page_erases);
+    CHECK_EQUAL(2, index_stats.index_page_erases);
+
+    // Checkpoints aren't user data.
+    flash_stats_t stats;
+    flash_stats_get(&stats);
+    CHECK_EQUAL(10 * WORD_SIZE, stats.user_bytes);
+    CHECK_EQUAL(20 * WORD_SIZE, stats.programmed_bytes);
+    CHECK_EQUAL(2, stats.page_erases[START_PAGE]);
+    CHECK_EQUAL(2, stats.page_erases[START_PAGE + 1]);
+
+    CHECK_EQUAL(FLASH_ERROR, flash_index_stats_get(id + 1, &index_stats));
+}
+
+/* Calls are timed with the stats clock into log scale buckets. */
+TEST(Test, stats_latency_histogram)
+{
+    flash_set_stats_clock(stats_clock);
+
+    uint8_t write_data[WORD_SIZE] = {0};
+    WRITE_OK(START_PAGE * PAGE_SIZE, write_data, sizeof(write_data));
+    WRITE_OK(START_PAGE * PAGE_SIZE + WORD_SIZE, write_data, sizeof(write_data));
+
+    flash_stats_t stats;
+    flash_stats_get(&stats);
+    const flash_histogram_t * histogram = &stats.latency[FLASH_STATS_WRITE];
+
+    // 5 is in the bucket for 4 to 7.
+    CHECK_EQUAL(2, histogram->buckets[3]);
+    CHECK_EQUAL(5, histogram->max);
+    CHECK_EQUAL(10, histogram->total);
+    CHECK_EQUAL(0, stats.latency[FLASH_STATS_READ].buckets[3]);
+}
+#endif
@@ -0,0 +1,196 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <string.h>
+#include "../../inc/flash.h"
+#include "../../inc/flash_async.h"
+#include "../spies/flash_spy.h"
+}
+
+/* Count of completion callbacks and the last operation passed to one. */
+static uint8_t done_count = 0;
+static flash_async_op_t * done_op = NULL;
+static void count_done(flash_async_op_t * op)
+{
+    done_count++;
+    done_op = op;
+}
+
+/* Submits the operation again the first time it completes, and records whether it already looked complete. */
+static flash_async_t * resubmit_queue = NULL;
+static bool complete_in_done = false;
+static void resubmit_once(flash_async_op_t * op)
+{
+    complete_in_done |= flash_async_is_complete(op);
+    if (done_count++ == 0)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_async_submit(resubmit_queue, op));
+    }
+}
+
+TEST_GROUP(TestAsync)
+{
+#define WORD_SIZE 8
+#define PAGE_SIZE 32
+#define FLASH_SIZE 1024
+#define START_PAGE 1
+#define NUMBER_PAGES FLASH_SIZE/PAGE_SIZE
+#define BASE_ADDRESS 0
+#define SLOT_COUNT 4
+
+    flash_async_t queue;
+    flash_async_slot_t slots[SLOT_COUNT];
+
+    void setup()
+    {
+        flash_init((flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+        flash_spy_init(WORD_SIZE, PAGE_SIZE, FLASH_SIZE);
+        CHECK_EQUAL(FLASH_OK, flash_async_init(&queue, flash_default_ctx(), slots, SLOT_COUNT));
+        done_count = 0;
+        done_op = NULL;
+    }
+
+    void teardown()
+    {
+        flash_init(0, 0, 0, 0, 0, 0, 0, 0, FLASH_ENDIANESS_BIG);
+        flash_spy_deinit();
+    }
+};
+
+/* ZERO */
+
+/* The number of slots has to be a power of two. */
+TEST(TestAsync, slot_count_power_of_two)
+{
+    CHECK_EQUAL(FLASH_ERROR, flash_async_init(&queue, flash_default_ctx(), slots, 3));
+    CHECK_EQUAL(FLASH_ERROR, flash_async_init(&queue, flash_default_ctx(), slots, 0));
+}
+
+/* Nothing to process in an empty queue. */
+TEST(TestAsync, process_empty_queue)
+{
+    CHECK_EQUAL(0, flash_async_process(&queue, 0));
+}
+
+/* ONE */
+
+/* A submitted write isn't carried out until the worker processes it. */
+TEST(TestAsync, write_happens_when_processed)
+{
+    uint8_t write_data[WORD_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8};
+    flash_async_op_t op = {};
+    op.type = FLASH_ASYNC_WRITE;
+    op.address = START_PAGE * PAGE_SIZE;
+    op.data = write_data;
+    op.length = WORD_SIZE;
+    op.done = count_done;
+
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_async_submit(&queue, &op), "Submit failed");
+    CHECK_FALSE(flash_async_is_complete(&op));
+
+    uint8_t read_data[WORD_SIZE] = {0};
+    flash_spy_read(START_PAGE * PAGE_SIZE, read_data, WORD_SIZE);
+    CHECK_EQUAL_TEXT(FLASH_EMPTY_VALUE, read_data[0], "Written before processed");
+
+    CHECK_EQUAL(1, flash_async_process(&queue, 0));
+    CHECK_TRUE(flash_async_is_complete(&op));
+    CHECK_EQUAL(FLASH_OK, op.status);
+    CHECK_EQUAL(1, done_count);
+    POINTERS_EQUAL(&op, done_op);
+
+    flash_spy_read(START_PAGE * PAGE_SIZE, read_data, WORD_SIZE);
+    MEMCMP_EQUAL(write_data, read_data, WORD_SIZE);
+}
+
+/* The result of a failed operation is passed back in its status. */
+TEST(TestAsync, failed_operation_status)
+{
+    uint8_t write_data[WORD_SIZE] = {0};
+    flash_async_op_t op = {};
+    op.type = FLASH_ASYNC_WRITE;
+    op.address = 1;
+    op.data = write_data;
+    op.length = WORD_SIZE;
+
+    CHECK_EQUAL(FLASH_OK, flash_async_submit(&queue, &op));
+    flash_async_process(&queue, 0);
+    CHECK_TRUE(flash_async_is_complete(&op));
+    CHECK_EQUAL_TEXT(FLASH_ERROR, op.status, "Unaligned write didn't fail");
+}
+
+/* done is called before the operation is marked complete and can submit it again. */
+TEST(TestAsync, done_can_resubmit_operation)
+{
+    flash_async_op_t op = {};
+    op.type = FLASH_ASYNC_ERASE;
+    op.address = START_PAGE;
+    op.length = 1;
+    op.done = resubmit_once;
+    resubmit_queue = &queue;
+    complete_in_done = false;
+
+    CHECK_EQUAL(FLASH_OK, flash_async_submit(&queue, &op));
+    CHECK_EQUAL(1, flash_async_process(&queue, 1));
+    CHECK_FALSE_TEXT(flash_async_is_complete(&op), "Resubmitted operation marked complete");
+
+    CHECK_EQUAL(1, flash_async_process(&queue, 0));
+    CHECK_TRUE(flash_async_is_complete(&op));
+    CHECK_EQUAL(FLASH_OK, op.status);
+    CHECK_EQUAL(2, done_count);
+    CHECK_FALSE_TEXT(complete_in_done, "Marked complete before done was called");
+}
+
+/* MANY */
+
+/* Submitting to a full queue fails until the worker makes room. */
+TEST(TestAsync, full_queue)
+{
+    flash_async_op_t ops[SLOT_COUNT + 1] = {};
+    for (uint8_t idx = 0; idx < SLOT_COUNT; idx++)
+    {
+        ops[idx].type = FLASH_ASYNC_ERASE;
+        ops[idx].address = START_PAGE;
+        ops[idx].length = 1;
+        CHECK_EQUAL(FLASH_OK, flash_async_submit(&queue, &ops[idx]));
+    }
+
+    ops[SLOT_COUNT].type = FLASH_ASYNC_ERASE;
+    ops[SLOT_COUNT].address = START_PAGE;
+    ops[SLOT_COUNT].length = 1;
+    CHECK_EQUAL_TEXT(FLASH_ERROR, flash_async_submit(&queue, &ops[SLOT_COUNT]), "Submitted to a full queue");
+
+    CHECK_EQUAL(1, flash_async_process(&queue, 1));
+    CHECK_EQUAL_TEXT(FLASH_OK, flash_async_submit(&queue, &ops[SLOT_COUNT]), "No room after processing");
+    CHECK_EQUAL(SLOT_COUNT, flash_async_process(&queue, 0));
+}
+
+/* Operations are carried out in order so a read submitted after an index write sees the written data. */
+TEST(TestAsync, read_sees_earlier_index_write)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    CHECK_COMPARE(id, >=, 0);
+
+    uint8_t write_data[WORD_SIZE + 2] = {9, 8, 7, 6, 5, 4, 3, 2, 1, 0};
+    flash_async_op_t write_op = {};
+    write_op.type = FLASH_ASYNC_INDEX_WRITE;
+    write_op.id = id;
+    write_op.data = write_data;
+    write_op.length = sizeof(write_data);
+
+    uint8_t read_data[WORD_SIZE + 2] = {0};
+    flash_async_op_t read_op = {};
+    read_op.type = FLASH_ASYNC_INDEX_READ_REL_HEAD;
+    read_op.id = id;
+    read_op.position = -2*WORD_SIZE;
+    read_op.data = read_data;
+    read_op.length = sizeof(read_data);
+
+    CHECK_EQUAL(FLASH_OK, flash_async_submit(&queue, &write_op));
+    CHECK_EQUAL(FLASH_OK, flash_async_submit(&queue, &read_op));
+    CHECK_EQUAL(2, flash_async_process(&queue, 0));
+
+    CHECK_EQUAL(FLASH_OK, write_op.status);
+    CHECK_EQUAL(FLASH_OK, read_op.status);
+    MEMCMP_EQUAL_TEXT(write_data, read_data, sizeof(write_data), "Read didn't see the write");
+}
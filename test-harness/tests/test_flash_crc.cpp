@@ -0,0 +1,44 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include "../../inc/flash_crc.h"
+}
+
+TEST_GROUP(TestCrc)
+{
+};
+
+/* The CRC-32C check value. */
+TEST(TestCrc, crc32c_check_value)
+{
+    const uint8_t data[] = "123456789";
+    CHECK_EQUAL(0xE3069283, flash_crc32c(0, data, 9));
+
+    // In two parts.
+    CHECK_EQUAL(0xE3069283, flash_crc32c(flash_crc32c(0, data, 4), &data[4], 5));
+}
+
+/* Every way of calculating the CRC gives the same answer, whatever the length and alignment of the data. */
+TEST(TestCrc, crc32c_implementations_agree)
+{
+    uint8_t data[80];
+    for (uint8_t idx = 0; idx < sizeof(data); idx++)
+    {
+        data[idx] = idx * 37 + 11;
+    }
+
+    const uint8_t check[] = "123456789";
+    CHECK_EQUAL(0xE3069283, flash_crc32c_impl(FLASH_CRC_SLICE8, 0, check, 9));
+    CHECK_EQUAL(0xE3069283, flash_crc32c_impl(FLASH_CRC_HARDWARE, 0, check, 9));
+
+    for (uint8_t offset = 0; offset < 8; offset++)
+    {
+        for (uint8_t length = 0; length <= sizeof(data) - 8; length++)
+        {
+            uint32_t expected = flash_crc32c_impl(FLASH_CRC_BYTEWISE, 0x12345678, &data[offset], length);
+            CHECK_EQUAL(expected, flash_crc32c_impl(FLASH_CRC_SLICE8, 0x12345678, &data[offset], length));
+            CHECK_EQUAL(expected, flash_crc32c_impl(FLASH_CRC_HARDWARE, 0x12345678, &data[offset], length));
+        }
+    }
+}
@@ -0,0 +1,428 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <string.h>
+#include "../../inc/flash.h"
+#include "../../inc/flash_kv.h"
+#include "../spies/flash_spy.h"
+}
+
+TEST_GROUP(TestKv)
+{
+#define WORD_SIZE 8
+#define PAGE_SIZE 64
+#define FLASH_SIZE 1024
+#define START_PAGE 1
+#define NUMBER_PAGES FLASH_SIZE/PAGE_SIZE
+#define BASE_ADDRESS 0
+#define SLOT_COUNT 8
+
+    flash_kv_t kv;
+    flash_kv_slot_t slots[SLOT_COUNT];
+    int id;
+
+    void setup()
+    {
+        flash_init((flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+        flash_spy_init(WORD_SIZE, PAGE_SIZE, FLASH_SIZE);
+
+        // Thirteen data pages.
+        id = flash_index_register(START_PAGE, START_PAGE + 13);
+        CHECK_EQUAL(FLASH_OK, flash_kv_init(&kv, flash_default_ctx(), id, slots, SLOT_COUNT));
+    }
+
+    void teardown()
+    {
+        flash_init(0, 0, 0, 0, 0, 0, 0, 0, FLASH_ENDIANESS_BIG);
+        flash_spy_deinit();
+    }
+
+    flash_status_t set(const char * key, const char * value)
+    {
+        return flash_kv_set(&kv, (const uint8_t *)key, strlen(key), (const uint8_t *)value, strlen(value));
+    }
+
+    /* Check a key has a value. */
+    void check_value(const char * key, const char * value)
+    {
+        uint8_t read_value[PAGE_SIZE] = {0};
+        uint16_t length = 0;
+        CHECK_EQUAL(FLASH_OK, flash_kv_get(&kv, (const uint8_t *)key, strlen(key), read_value, sizeof(read_value), &length));
+        CHECK_EQUAL(strlen(value), length);
+        MEMCMP_EQUAL(value, read_value, length);
+    }
+
+    void check_missing(const char * key)
+    {
+        uint8_t read_value[PAGE_SIZE];
+        uint16_t length = 0;
+        CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_kv_get(&kv, (const uint8_t *)key, strlen(key), read_value, sizeof(read_value), &length));
+    }
+
+    /* Forget everything in RAM and find the keys again from flash, as if after a reboot. */
+    void remount()
+    {
+        uint8_t buffer[PAGE_SIZE];
+        CHECK_EQUAL(FLASH_OK, flash_index_reset(id));
+        CHECK_EQUAL(FLASH_OK, flash_kv_init(&kv, flash_default_ctx(), id, slots, SLOT_COUNT));
+        CHECK_EQUAL(FLASH_OK, flash_kv_mount(&kv, buffer, sizeof(buffer)));
+    }
+};
+
+TEST(TestKv, get_missing_key)
+{
+    check_missing("gain");
+    CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_kv_delete(&kv, (const uint8_t *)"gain", 4));
+}
+
+TEST(TestKv, set_then_get)
+{
+    CHECK_EQUAL(FLASH_OK, set("gain", "12"));
+    CHECK_EQUAL(FLASH_OK, set("offset", "-3"));
+
+    check_value("gain", "12");
+    check_value("offset", "-3");
+    CHECK_EQUAL(2, kv.key_count);
+}
+
+TEST(TestKv, set_again_replaces_value)
+{
+    CHECK_EQUAL(FLASH_OK, set("gain", "12"));
+    CHECK_EQUAL(FLASH_OK, set("gain", "1200"));
+
+    check_value("gain", "1200");
+    CHECK_EQUAL(1, kv.key_count);
+}
+
+TEST(TestKv, empty_value)
+{
+    CHECK_EQUAL(FLASH_OK, set("flag", ""));
+    check_value("flag", "");
+}
+
+TEST(TestKv, delete_key)
+{
+    CHECK_EQUAL(FLASH_OK, set("gain", "12"));
+    CHECK_EQUAL(FLASH_OK, set("offset", "-3"));
+    CHECK_EQUAL(FLASH_OK, flash_kv_delete(&kv, (const uint8_t *)"gain", 4));
+
+    check_missing("gain");
+    check_value("offset", "-3");
+    CHECK_EQUAL(1, kv.key_count);
+}
+
+TEST(TestKv, value_buffer_too_small)
+{
+    CHECK_EQUAL(FLASH_OK, set("serial", "A1B2C3"));
+
+    uint8_t read_value[4];
+    uint16_t length = 0;
+    CHECK_EQUAL(FLASH_ERROR, flash_kv_get(&kv, (const uint8_t *)"serial", 6, read_value, sizeof(read_value), &length));
+    CHECK_EQUAL(6, length);
+}
+
+TEST(TestKv, bad_keys)
+{
+    uint8_t key[FLASH_KV_MAX_KEY + 1] = {0};
+    CHECK_EQUAL(FLASH_ERROR, flash_kv_set(&kv, key, 0, key, 1));
+    CHECK_EQUAL(FLASH_ERROR, flash_kv_set(&kv, key, sizeof(key), key, 1));
+    CHECK_EQUAL(FLASH_OK, flash_kv_set(&kv, key, FLASH_KV_MAX_KEY, key, 1));
+}
+
+/* Mounting finds the latest value of every key and leaves out deleted ones. */
+TEST(TestKv, mount_rebuilds_table)
+{
+    CHECK_EQUAL(FLASH_OK, set("gain", "12"));
+    CHECK_EQUAL(FLASH_OK, set("offset", "-3"));
+    CHECK_EQUAL(FLASH_OK, set("serial", "A1B2C3"));
+    CHECK_EQUAL(FLASH_OK, set("gain", "14"));
+    CHECK_EQUAL(FLASH_OK, flash_kv_delete(&kv, (const uint8_t *)"offset", 6));
+
+    remount();
+
+    check_value("gain", "14");
+    check_missing("offset");
+    check_value("serial", "A1B2C3");
+    CHECK_EQUAL(2, kv.key_count);
+
+    // And carries on from there.
+    CHECK_EQUAL(FLASH_OK, set("offset", "7"));
+    remount();
+    check_value("offset", "7");
+}
+
+/* The oldest records are never written over, once the index is full sets fail and what's there stays readable. */
+TEST(TestKv, full_index)
+{
+    char value[2] = {0};
+    uint8_t sets = 0;
+
+    for (; sets < 100; sets++)
+    {
+        value[0] = 'a' + sets % 26;
+        if (set("gain", value) != FLASH_OK)
+        {
+            break;
+        }
+    }
+
+    // Two 24 byte records to each of the thirteen 64 byte pages.
+    CHECK_EQUAL(26, sets);
+    CHECK_EQUAL(FLASH_ERROR, flash_kv_delete(&kv, (const uint8_t *)"gain", 4));
+
+    value[0] = 'a' + (sets - 1) % 26;
+    check_value("gain", value);
+
+    remount();
+    check_value("gain", value);
+}
+
+/* Records that fill pages exactly stop one short, the head landing on the tail would make the index look empty. */
+TEST(TestKv, full_index_exact_fit)
+{
+    uint8_t sets = 0;
+
+    // 32 byte records, two to a page.
+    while (sets < 100 && set("gain", "0123456789") == FLASH_OK)
+    {
+        sets++;
+    }
+
+    CHECK_EQUAL(25, sets);
+
+    remount();
+    check_value("gain", "0123456789");
+}
+
+TEST(TestKv, hash_table_full)
+{
+    const char * keys[] = {"a", "b", "c", "d", "e", "f", "g"};
+
+    // One slot is always left empty.
+    for (uint8_t idx = 0; idx < SLOT_COUNT - 1; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, set(keys[idx], "1"));
+    }
+    CHECK_EQUAL(FLASH_ERROR, set("h", "1"));
+
+    // Existing keys can still be changed.
+    CHECK_EQUAL(FLASH_OK, set("a", "2"));
+    check_value("a", "2");
+}
+
+/* Keys that share slots can all still be found after some are deleted. */
+TEST(TestKv, delete_keeps_probe_runs)
+{
+    const char * keys[] = {"k0", "k1", "k2", "k3", "k4", "k5"};
+
+    for (uint8_t idx = 0; idx < 6; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, set(keys[idx], keys[idx]));
+    }
+
+    CHECK_EQUAL(FLASH_OK, flash_kv_delete(&kv, (const uint8_t *)"k1", 2));
+    CHECK_EQUAL(FLASH_OK, flash_kv_delete(&kv, (const uint8_t *)"k4", 2));
+
+    for (uint8_t idx = 0; idx < 6; idx++)
+    {
+        if (idx == 1 || idx == 4)
+        {
+            check_missing(keys[idx]);
+        }
+        else
+        {
+            check_value(keys[idx], keys[idx]);
+        }
+    }
+}
+
+TEST_GROUP(TestKvGc)
+{
+    flash_kv_t kv;
+    flash_kv_slot_t slots[SLOT_COUNT];
+    uint8_t gc_buffer[PAGE_SIZE];
+    int hot_id;
+    int cold_id;
+
+    void setup()
+    {
+        flash_init((flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+        flash_spy_init(WORD_SIZE, PAGE_SIZE, FLASH_SIZE);
+
+        // Four data pages each.
+        hot_id = flash_index_register(START_PAGE, START_PAGE + 4);
+        cold_id = flash_index_register(START_PAGE + 5, START_PAGE + 9);
+        CHECK_EQUAL(FLASH_OK, flash_kv_init(&kv, flash_default_ctx(), hot_id, slots, SLOT_COUNT));
+        CHECK_EQUAL(FLASH_OK, flash_kv_set_gc(&kv, cold_id, gc_buffer, sizeof(gc_buffer), 2));
+    }
+
+    void teardown()
+    {
+        flash_init(0, 0, 0, 0, 0, 0, 0, 0, FLASH_ENDIANESS_BIG);
+        flash_spy_deinit();
+    }
+
+    flash_status_t set(const char * key, const char * value)
+    {
+        return flash_kv_set(&kv, (const uint8_t *)key, strlen(key), (const uint8_t *)value, strlen(value));
+    }
+
+    void check_value(const char * key, const char * value)
+    {
+        uint8_t read_value[PAGE_SIZE] = {0};
+        uint16_t length = 0;
+        CHECK_EQUAL(FLASH_OK, flash_kv_get(&kv, (const uint8_t *)key, strlen(key), read_value, sizeof(read_value), &length));
+        CHECK_EQUAL(strlen(value), length);
+        MEMCMP_EQUAL(value, read_value, length);
+    }
+
+    /* Collect until there's nothing left to do. */
+    void collect()
+    {
+        flash_status_t status;
+        for (uint16_t steps = 0; (status = flash_kv_gc_step(&kv, 0, 0)) == FLASH_OK; steps++)
+        {
+            CHECK(steps < 100);
+        }
+        CHECK_EQUAL(FLASH_DATA_NOT_FOUND, status);
+    }
+
+    void remount()
+    {
+        uint8_t buffer[PAGE_SIZE];
+        CHECK_EQUAL(FLASH_OK, flash_index_reset(hot_id));
+        CHECK_EQUAL(FLASH_OK, flash_index_reset(cold_id));
+        CHECK_EQUAL(FLASH_OK, flash_kv_init(&kv, flash_default_ctx(), hot_id, slots, SLOT_COUNT));
+        CHECK_EQUAL(FLASH_OK, flash_kv_set_gc(&kv, cold_id, gc_buffer, sizeof(gc_buffer), 2));
+        CHECK_EQUAL(FLASH_OK, flash_kv_mount(&kv, buffer, sizeof(buffer)));
+    }
+};
+
+TEST(TestKvGc, nothing_to_collect)
+{
+    CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_kv_gc_step(&kv, 0, 0));
+    CHECK_EQUAL(FLASH_OK, set("gain", "12"));
+    CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_kv_gc_step(&kv, 0, 0));
+}
+
+TEST(TestKvGc, needs_cold_index)
+{
+    flash_kv_t plain;
+    CHECK_EQUAL(FLASH_OK, flash_kv_init(&plain, flash_default_ctx(), hot_id, slots, SLOT_COUNT));
+    CHECK_EQUAL(FLASH_ERROR, flash_kv_gc_step(&plain, 0, 0));
+    CHECK_EQUAL(FLASH_ERROR, flash_kv_set_gc(&plain, hot_id, gc_buffer, sizeof(gc_buffer), 2));
+    CHECK_EQUAL(FLASH_ERROR, flash_kv_set_gc(&plain, cold_id, gc_buffer, PAGE_SIZE - 1, 2));
+}
+
+/* Collecting as it goes the store takes many times more sets than fit in its index. */
+TEST(TestKvGc, collection_makes_room)
+{
+    const char * keys[] = {"k0", "k1", "k2", "k3"};
+    char value[3] = {0};
+
+    for (uint16_t idx = 0; idx < 200; idx++)
+    {
+        value[0] = 'a' + idx % 26;
+        value[1] = 'a' + idx / 26;
+        CHECK_EQUAL(FLASH_OK, set(keys[idx % 4], value));
+        collect();
+    }
+
+    for (uint16_t idx = 196; idx < 200; idx++)
+    {
+        value[0] = 'a' + idx % 26;
+        value[1] = 'a' + idx / 26;
+        check_value(keys[idx % 4], value);
+    }
+
+    remount();
+
+    for (uint16_t idx = 196; idx < 200; idx++)
+    {
+        value[0] = 'a' + idx % 26;
+        value[1] = 'a' + idx / 26;
+        check_value(keys[idx % 4], value);
+    }
+    CHECK_EQUAL(4, kv.key_count);
+}
+
+/* Each step stops once its budget is used, the page is erased in a step of its own. */
+TEST(TestKvGc, step_budget)
+{
+    // Two 24 byte records to a page, the first two pages hold the keys that stay live.
+    CHECK_EQUAL(FLASH_OK, set("k0", "v0"));
+    CHECK_EQUAL(FLASH_OK, set("k1", "v1"));
+    CHECK_EQUAL(FLASH_OK, set("k2", "v2"));
+    CHECK_EQUAL(FLASH_OK, set("k3", "v3"));
+    CHECK_EQUAL(FLASH_OK, set("k2", "v4"));
+
+    // Three pages used, one free. One step for each record on the oldest page, one to find there are no more in the
+    // 16 bytes left at its end and one to erase it.
+    for (uint8_t idx = 0; idx < 3; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_kv_gc_step(&kv, 0, 1));
+        CHECK(kv.gc_log != NULL);
+    }
+    CHECK_EQUAL(FLASH_OK, flash_kv_gc_step(&kv, 0, 1));
+    CHECK(kv.gc_log == NULL);
+
+    // Down to one free page again. A budget of a byte still gets one record done.
+    CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_kv_gc_step(&kv, 1, 0));
+    CHECK_EQUAL(FLASH_OK, set("k3", "v5"));
+    CHECK_EQUAL(FLASH_OK, set("k0", "v6"));
+    CHECK_EQUAL(FLASH_OK, flash_kv_gc_step(&kv, 1, 0));
+    CHECK(kv.gc_log != NULL);
+    collect();
+
+    check_value("k0", "v6");
+    check_value("k1", "v1");
+    check_value("k2", "v4");
+    check_value("k3", "v5");
+}
+
+/* A key that was copied to the cold index and then deleted stays deleted after its tombstone is collected. */
+TEST(TestKvGc, delete_survives_collection)
+{
+    CHECK_EQUAL(FLASH_OK, set("gain", "12"));
+    CHECK_EQUAL(FLASH_OK, set("offset", "-3"));
+
+    // Push the first page out so gain and offset go to the cold index.
+    for (uint8_t idx = 0; idx < 6; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, set("count", "1"));
+        collect();
+    }
+
+    CHECK_EQUAL(FLASH_OK, flash_kv_delete(&kv, (const uint8_t *)"gain", 4));
+    for (uint8_t idx = 0; idx < 12; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, set("count", "2"));
+        collect();
+    }
+
+    remount();
+
+    uint8_t read_value[PAGE_SIZE];
+    uint16_t length = 0;
+    CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_kv_get(&kv, (const uint8_t *)"gain", 4, read_value, sizeof(read_value), &length));
+    check_value("offset", "-3");
+    check_value("count", "2");
+}
+
+/* More live data than the cold index can hold. */
+TEST(TestKvGc, cold_index_full)
+{
+    const char * keys[] = {"k0", "k1", "k2", "k3", "k4", "k5", "k6"};
+    flash_status_t status = FLASH_OK;
+
+    for (uint16_t idx = 0; idx < 50 && status != FLASH_ERROR; idx++)
+    {
+        status = set(keys[idx % 7], "value-value-value");
+        while (status == FLASH_OK && (status = flash_kv_gc_step(&kv, 0, 0)) == FLASH_OK)
+        {
+        }
+    }
+
+    CHECK_EQUAL(FLASH_ERROR, status);
+}
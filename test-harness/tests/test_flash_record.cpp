@@ -0,0 +1,275 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <string.h>
+#include "../../inc/flash.h"
+#include "../../inc/flash_record.h"
+#include "../spies/flash_spy.h"
+}
+
+/* Counts reads that reach the backend. */
+static uint32_t backend_reads = 0;
+static flash_status_t counting_read(uint32_t read_address, uint8_t * data, uint16_t read_length)
+{
+    backend_reads++;
+    return flash_spy_read(read_address, data, read_length);
+}
+
+TEST_GROUP(TestRecord)
+{
+#define WORD_SIZE 8
+#define PAGE_SIZE 64
+#define FLASH_SIZE 1024
+#define START_PAGE 1
+#define NUMBER_PAGES FLASH_SIZE/PAGE_SIZE
+#define BASE_ADDRESS 0
+
+    flash_record_log_t log;
+    int id;
+
+    void setup()
+    {
+        flash_init((flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+        flash_spy_init(WORD_SIZE, PAGE_SIZE, FLASH_SIZE);
+
+        // Three data pages.
+        id = flash_index_register(START_PAGE, START_PAGE + 3);
+        CHECK_EQUAL(FLASH_OK, flash_record_init(&log, flash_default_ctx(), id));
+    }
+
+    void teardown()
+    {
+        flash_init(0, 0, 0, 0, 0, 0, 0, 0, FLASH_ENDIANESS_BIG);
+        flash_spy_deinit();
+    }
+
+    /* Write a record holding value in every byte. */
+    void write_record(uint8_t value, uint16_t length)
+    {
+        uint8_t data[PAGE_SIZE];
+        memset(data, value, length);
+        CHECK_EQUAL(FLASH_OK, flash_record_write(&log, data, length));
+    }
+
+    /* Read the next record and check it holds value in every byte. */
+    void read_record(uint8_t value, uint16_t length)
+    {
+        uint8_t data[PAGE_SIZE];
+        uint16_t read_length = 0;
+        CHECK_EQUAL(FLASH_OK, flash_record_read(&log, data, sizeof(data), &read_length));
+        CHECK_EQUAL(length, read_length);
+        for (uint16_t idx = 0; idx < length; idx++)
+        {
+            CHECK_EQUAL(value, data[idx]);
+        }
+    }
+
+    /* Walk the records and check they hold first, first + 1, ... in that order, or counting down when newest first. */
+    void check_iterate(flash_record_direction_t direction, uint8_t first, uint8_t count, uint16_t length)
+    {
+        uint8_t buffer[PAGE_SIZE];
+        flash_record_iter_t iter;
+        CHECK_EQUAL(FLASH_OK, flash_record_iter_begin(&iter, &log, direction, buffer, sizeof(buffer)));
+
+        const uint8_t * data = NULL;
+        uint16_t read_length = 0;
+        for (uint8_t idx = 0; idx < count; idx++)
+        {
+            uint8_t value = (direction == FLASH_RECORD_OLDEST_FIRST) ? first + idx : first - idx;
+            CHECK_EQUAL(FLASH_OK, flash_record_iter_next(&iter, &data, &read_length));
+            CHECK_EQUAL(length, read_length);
+            CHECK_EQUAL(value, data[0]);
+            CHECK_EQUAL(value, data[length - 1]);
+            CHECK_EQUAL(value, iter.sequence);
+        }
+
+        CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_record_iter_next(&iter, &data, &read_length));
+        flash_record_iter_end(&iter);
+    }
+
+    void check_no_more_records()
+    {
+        uint8_t data[PAGE_SIZE];
+        uint16_t read_length = 0;
+        CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_record_read(&log, data, sizeof(data), &read_length));
+    }
+};
+
+TEST(TestRecord, no_records)
+{
+    check_no_more_records();
+    CHECK_EQUAL(FLASH_DATA_NOT_FOUND, flash_record_recover(&log));
+}
+
+/* Records of different lengths come back as they were written. */
+TEST(TestRecord, write_then_read)
+{
+    write_record(0x11, 1);
+    write_record(0x22, 0);
+    write_record(0x33, 13);
+
+    read_record(0x11, 1);
+    read_record(0x22, 0);
+    read_record(0x33, 13);
+    check_no_more_records();
+}
+
+/* A record that doesn't fit on the rest of the page goes on the next one. */
+TEST(TestRecord, records_do_not_cross_pages)
+{
+    write_record(0x11, 20);
+    write_record(0x22, 20);
+
+    CHECK_EQUAL((START_PAGE + 2) * PAGE_SIZE + 40, flash_index_get_head(id));
+
+    read_record(0x11, 20);
+    read_record(0x22, 20);
+    check_no_more_records();
+}
+
+TEST(TestRecord, record_bigger_than_page)
+{
+    uint8_t data[PAGE_SIZE] = {0};
+    CHECK_EQUAL(FLASH_ERROR, flash_record_write(&log, data, PAGE_SIZE - FLASH_RECORD_OVERHEAD + 1));
+    CHECK_EQUAL(FLASH_OK, flash_record_write(&log, data, PAGE_SIZE - FLASH_RECORD_OVERHEAD));
+}
+
+/* A record too big for the buffer is left for a read with a bigger one. */
+TEST(TestRecord, read_buffer_too_small)
+{
+    write_record(0x11, 20);
+
+    uint8_t data[8];
+    uint16_t read_length = 0;
+    CHECK_EQUAL(FLASH_ERROR, flash_record_read(&log, data, sizeof(data), &read_length));
+    read_record(0x11, 20);
+}
+
+/* After going round the data pages the records are found again without the index page. */
+TEST(TestRecord, recover_without_checkpoint)
+{
+    // Two records to a page so this goes round the three data pages once and a bit.
+    for (uint8_t idx = 0; idx < 10; idx++)
+    {
+        write_record(idx, 8);
+    }
+
+    CHECK_EQUAL(FLASH_OK, flash_index_reset(id));
+    CHECK_EQUAL(FLASH_OK, flash_record_recover(&log));
+    CHECK_EQUAL(10, log.sequence);
+
+    // The oldest page left holds records 4 and 5.
+    for (uint8_t idx = 4; idx < 10; idx++)
+    {
+        read_record(idx, 8);
+    }
+    check_no_more_records();
+
+    // Writing carries on after the newest record.
+    write_record(10, 8);
+    read_record(10, 8);
+}
+
+/* A record that was only partly written when the power went is skipped. */
+TEST(TestRecord, torn_record_skipped)
+{
+    write_record(0x11, 4);
+    write_record(0x22, 4);
+
+    // Copy just the header of the second record to the head, as if the power went before the rest was written.
+    uint8_t header[2 * WORD_SIZE];
+    CHECK_EQUAL(FLASH_OK, flash_read((START_PAGE + 1) * PAGE_SIZE + 24, header, sizeof(header)));
+    CHECK_EQUAL(FLASH_OK, flash_write(flash_index_get_head(id), header, sizeof(header)));
+
+    CHECK_EQUAL(FLASH_OK, flash_index_reset(id));
+    CHECK_EQUAL(FLASH_OK, flash_record_recover(&log));
+    CHECK_EQUAL(2, log.sequence);
+
+    write_record(0x33, 4);
+
+    read_record(0x11, 4);
+    read_record(0x22, 4);
+    read_record(0x33, 4);
+    check_no_more_records();
+}
+
+/* The iterator walks every record either way without moving the tail. */
+TEST(TestRecord, iterate_both_ways)
+{
+    for (uint8_t idx = 0; idx < 5; idx++)
+    {
+        write_record(idx, 8);
+    }
+
+    check_iterate(FLASH_RECORD_OLDEST_FIRST, 0, 5, 8);
+    check_iterate(FLASH_RECORD_NEWEST_FIRST, 4, 5, 8);
+
+    read_record(0, 8);
+}
+
+/* Walking starts at the tail and goes round the wrap. */
+TEST(TestRecord, iterate_over_wrap)
+{
+    // Two records to a page so the head ends up on the first data page again.
+    for (uint8_t idx = 0; idx < 7; idx++)
+    {
+        write_record(idx, 8);
+        if (idx < 2)
+        {
+            read_record(idx, 8);
+        }
+    }
+
+    check_iterate(FLASH_RECORD_OLDEST_FIRST, 2, 5, 8);
+    check_iterate(FLASH_RECORD_NEWEST_FIRST, 6, 5, 8);
+}
+
+TEST(TestRecord, iterate_no_records)
+{
+    check_iterate(FLASH_RECORD_OLDEST_FIRST, 0, 0, 0);
+    check_iterate(FLASH_RECORD_NEWEST_FIRST, 0, 0, 0);
+}
+
+TEST(TestRecord, iterate_buffer_smaller_than_page)
+{
+    uint8_t buffer[PAGE_SIZE - 1];
+    flash_record_iter_t iter;
+    CHECK_EQUAL(FLASH_ERROR, flash_record_iter_begin(&iter, &log, FLASH_RECORD_OLDEST_FIRST, buffer, sizeof(buffer)));
+}
+
+/* A torn record in the middle of a page is skipped. */
+TEST(TestRecord, iterate_skips_torn_record)
+{
+    write_record(0, 4);
+
+    // The header of the first record again but nothing after it, as if the power went part way through a write.
+    uint8_t header[2 * WORD_SIZE];
+    CHECK_EQUAL(FLASH_OK, flash_read((START_PAGE + 1) * PAGE_SIZE, header, sizeof(header)));
+    CHECK_EQUAL(FLASH_OK, flash_write(flash_index_get_head(id), header, sizeof(header)));
+    CHECK_EQUAL(FLASH_OK, flash_index_reset(id));
+    CHECK_EQUAL(FLASH_OK, flash_record_recover(&log));
+
+    write_record(1, 4);
+
+    check_iterate(FLASH_RECORD_OLDEST_FIRST, 0, 2, 4);
+    check_iterate(FLASH_RECORD_NEWEST_FIRST, 1, 2, 4);
+}
+
+/* The records on a page come from one read of the backend. */
+TEST(TestRecord, iterate_reads_a_page_at_a_time)
+{
+    flash_init((flash_write_ptr)flash_spy_write, counting_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+    id = flash_index_register(START_PAGE, START_PAGE + 3);
+    CHECK_EQUAL(FLASH_OK, flash_record_init(&log, flash_default_ctx(), id));
+
+    // Six records over three pages.
+    for (uint8_t idx = 0; idx < 6; idx++)
+    {
+        write_record(idx, 8);
+    }
+
+    backend_reads = 0;
+    check_iterate(FLASH_RECORD_OLDEST_FIRST, 0, 6, 8);
+    CHECK_EQUAL(3, backend_reads);
+}
@@ -0,0 +1,254 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <string.h>
+#include "../../inc/flash.h"
+#include "../../inc/flash_trace.h"
+#include "../spies/flash_spy.h"
+}
+
+TEST_GROUP(TestTrace)
+{
+#define WORD_SIZE 8
+#define PAGE_SIZE 64
+#define FLASH_SIZE 1024
+#define START_PAGE 1
+#define NUMBER_PAGES FLASH_SIZE/PAGE_SIZE
+#define BASE_ADDRESS 0
+#define RING_SIZE 256
+
+    flash_trace_event_t ring[RING_SIZE];
+    flash_trace_event_t events[RING_SIZE];
+
+    void setup()
+    {
+        flash_init((flash_write_ptr)flash_spy_write, (flash_read_ptr)flash_spy_read, (erase_ptr)flash_spy_erase_pages, WORD_SIZE, PAGE_SIZE, NUMBER_PAGES, START_PAGE, BASE_ADDRESS, FLASH_ENDIANESS_LITTLE);
+        flash_spy_init(WORD_SIZE, PAGE_SIZE, FLASH_SIZE);
+    }
+
+    void teardown()
+    {
+        flash_init(0, 0, 0, 0, 0, 0, 0, 0, FLASH_ENDIANESS_BIG);
+        flash_spy_deinit();
+    }
+
+    /* Lay an event out the way it comes off the target. */
+    void encode(uint8_t * bytes, uint32_t timestamp, uint8_t type, uint8_t id, uint32_t address, uint32_t length, uint8_t status)
+    {
+        uint32_t values[3] = {timestamp, address, length};
+        for (uint8_t value = 0; value < 3; value++)
+        {
+            for (uint8_t byte = 0; byte < 4; byte++)
+            {
+                bytes[value * 4 + byte] = (uint8_t)(values[value] >> (8 * byte));
+            }
+        }
+        bytes[12] = type;
+        bytes[13] = id;
+        bytes[14] = status;
+        bytes[15] = 0;
+    }
+
+    void check_event(const flash_trace_event_t * event, uint8_t type, uint8_t id, uint32_t address, uint32_t length, uint8_t status)
+    {
+        CHECK_EQUAL(type, event->type);
+        CHECK_EQUAL(id, event->id);
+        CHECK_EQUAL(address, event->address);
+        CHECK_EQUAL(length, event->length);
+        CHECK_EQUAL(status, event->status);
+    }
+};
+
+TEST(TestTrace, decode_event)
+{
+    uint8_t bytes[FLASH_TRACE_EVENT_SIZE];
+    encode(bytes, 0x12345678, FLASH_TRACE_INDEX_WRITE | FLASH_TRACE_EXIT, 2, 0x00000140, 24, FLASH_ERROR);
+
+    flash_trace_event_t event;
+    CHECK_EQUAL(FLASH_OK, flash_trace_decode(bytes, sizeof(bytes), &event));
+    CHECK_EQUAL(0x12345678, event.timestamp);
+    check_event(&event, FLASH_TRACE_INDEX_WRITE | FLASH_TRACE_EXIT, 2, 0x00000140, 24, FLASH_ERROR);
+
+    char text[128];
+    flash_trace_format(&event, text, sizeof(text));
+    STRCMP_EQUAL("305419896 index_write exit id 2 address 0x00000140 length 24 status 1", text);
+
+    encode(bytes, 7, FLASH_TRACE_USER_ERASE, FLASH_TRACE_NO_ID, 3, 1, FLASH_OK);
+    CHECK_EQUAL(FLASH_OK, flash_trace_decode(bytes, sizeof(bytes), &event));
+    flash_trace_format(&event, text, sizeof(text));
+    STRCMP_EQUAL("7 user_erase address 0x00000003 length 1 status 0", text);
+}
+
+TEST(TestTrace, decode_rejects_what_isnt_an_event)
+{
+    uint8_t bytes[FLASH_TRACE_EVENT_SIZE];
+    flash_trace_event_t event;
+
+    // Too short.
+    encode(bytes, 1, FLASH_TRACE_WRITE, FLASH_TRACE_NO_ID, 0, 8, FLASH_OK);
+    CHECK_EQUAL(FLASH_ERROR, flash_trace_decode(bytes, sizeof(bytes) - 1, &event));
+
+    // Only driver functions return.
+    encode(bytes, 1, FLASH_TRACE_WRAP | FLASH_TRACE_EXIT, 0, 0, 0, FLASH_OK);
+    CHECK_EQUAL(FLASH_ERROR, flash_trace_decode(bytes, sizeof(bytes), &event));
+
+    // Zeroed and erased memory.
+    memset(bytes, 0, sizeof(bytes));
+    CHECK_EQUAL(FLASH_ERROR, flash_trace_decode(bytes, sizeof(bytes), &event));
+    memset(bytes, 0xFF, sizeof(bytes));
+    CHECK_EQUAL(FLASH_ERROR, flash_trace_decode(bytes, sizeof(bytes), &event));
+}
+
+/* What a driver function does is indented under it and bytes that aren't events are skipped. */
+TEST(TestTrace, print_nests_calls)
+{
+    uint8_t bytes[5 * FLASH_TRACE_EVENT_SIZE];
+    encode(&bytes[0], 1, FLASH_TRACE_INDEX_WRITE, 0, 128, 8, FLASH_OK);
+    encode(&bytes[16], 2, FLASH_TRACE_USER_WRITE, FLASH_TRACE_NO_ID, 128, 8, FLASH_OK);
+    memset(&bytes[32], 0, FLASH_TRACE_EVENT_SIZE);
+    encode(&bytes[48], 3, FLASH_TRACE_INDEX_WRITE | FLASH_TRACE_EXIT, 0, 136, 8, FLASH_OK);
+    encode(&bytes[64], 4, FLASH_TRACE_WRAP, 0, 128, 0, FLASH_OK);
+
+    FILE * out = tmpfile();
+    CHECK(out != NULL);
+    CHECK_EQUAL(4, flash_trace_print(out, bytes, sizeof(bytes)));
+
+    char text[512] = {0};
+    rewind(out);
+    size_t length = fread(text, 1, sizeof(text) - 1, out);
+    fclose(out);
+    text[length] = 0;
+
+    STRCMP_EQUAL("1 index_write enter id 0 address 0x00000080 length 8 status 0\n"
+                 "  2 user_write address 0x00000080 length 8 status 0\n"
+                 "3 index_write exit id 0 address 0x00000088 length 8 status 0\n"
+                 "4 wrap id 0 address 0x00000080 length 0 status 0\n", text);
+}
+
+#ifdef FLASH_ENABLE_TRACE
+/* Counts up by one every time it is read. */
+static uint32_t trace_clock_now = 0;
+static uint32_t trace_clock(void)
+{
+    return ++trace_clock_now;
+}
+
+/* A write is traced going in, programming the flash and coming out, failures and all. */
+TEST(TestTrace, write_is_traced)
+{
+    trace_clock_now = 0;
+    CHECK_EQUAL(FLASH_OK, flash_set_trace(ring, RING_SIZE, trace_clock));
+
+    uint8_t write_data[WORD_SIZE] = {0};
+    CHECK_EQUAL(FLASH_OK, flash_write(START_PAGE * PAGE_SIZE, write_data, sizeof(write_data)));
+    CHECK_EQUAL(FLASH_ERROR, flash_erase_pages(0, 1));
+
+    uint32_t lost = 1;
+    CHECK_EQUAL(5, flash_trace_copy(events, RING_SIZE, &lost));
+    CHECK_EQUAL(0, lost);
+
+    check_event(&events[0], FLASH_TRACE_WRITE, FLASH_TRACE_NO_ID, START_PAGE * PAGE_SIZE, WORD_SIZE, FLASH_OK);
+    check_event(&events[1], FLASH_TRACE_USER_WRITE, FLASH_TRACE_NO_ID, START_PAGE * PAGE_SIZE, WORD_SIZE, FLASH_OK);
+    check_event(&events[2], FLASH_TRACE_WRITE | FLASH_TRACE_EXIT, FLASH_TRACE_NO_ID, START_PAGE * PAGE_SIZE, WORD_SIZE, FLASH_OK);
+    check_event(&events[3], FLASH_TRACE_ERASE_PAGES, FLASH_TRACE_NO_ID, 0, 1, FLASH_OK);
+    check_event(&events[4], FLASH_TRACE_ERASE_PAGES | FLASH_TRACE_EXIT, FLASH_TRACE_NO_ID, 0, 1, FLASH_ERROR);
+    for (uint8_t idx = 0; idx < 5; idx++)
+    {
+        CHECK_EQUAL((uint32_t)idx + 1, events[idx].timestamp);
+    }
+
+    // The ring is the same bytes the decoder reads on a little endian host.
+    flash_trace_event_t event;
+    CHECK_EQUAL(FLASH_OK, flash_trace_decode((const uint8_t *)&events[1], FLASH_TRACE_EVENT_SIZE, &event));
+    CHECK_EQUAL(0, memcmp(&event, &events[1], sizeof(event)));
+
+    // Stopped.
+    CHECK_EQUAL(FLASH_OK, flash_set_trace(NULL, 0, 0));
+    CHECK_EQUAL(FLASH_OK, flash_write(START_PAGE * PAGE_SIZE + WORD_SIZE, write_data, sizeof(write_data)));
+    CHECK_EQUAL(0, flash_trace_copy(events, RING_SIZE, &lost));
+}
+
+/* A full ring holds the newest events. */
+TEST(TestTrace, ring_keeps_newest)
+{
+    CHECK_EQUAL(FLASH_ERROR, flash_set_trace(ring, 3, 0));
+    CHECK_EQUAL(FLASH_OK, flash_set_trace(ring, 4, 0));
+
+    uint8_t write_data[WORD_SIZE] = {0};
+    for (uint8_t idx = 0; idx < 3; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_write(START_PAGE * PAGE_SIZE + idx * WORD_SIZE, write_data, sizeof(write_data)));
+    }
+
+    uint32_t lost = 0;
+    CHECK_EQUAL(4, flash_trace_copy(events, RING_SIZE, &lost));
+    CHECK_EQUAL(5, lost);
+    CHECK_EQUAL(FLASH_TRACE_WRITE | FLASH_TRACE_EXIT, events[0].type);
+    CHECK_EQUAL(START_PAGE * PAGE_SIZE + WORD_SIZE, events[0].address);
+    CHECK_EQUAL(FLASH_TRACE_WRITE, events[1].type);
+    CHECK_EQUAL(FLASH_TRACE_USER_WRITE, events[2].type);
+    CHECK_EQUAL(FLASH_TRACE_WRITE | FLASH_TRACE_EXIT, events[3].type);
+    CHECK_EQUAL(START_PAGE * PAGE_SIZE + 2 * WORD_SIZE, events[3].address);
+
+    CHECK_EQUAL(2, flash_trace_copy(events, 2, &lost));
+    CHECK_EQUAL(7, lost);
+    CHECK_EQUAL(FLASH_TRACE_USER_WRITE, events[0].type);
+}
+
+/* An index writing round its data space wraps once and fills its index page twice. */
+TEST(TestTrace, index_wraps_and_moves_checkpoints)
+{
+    int id = flash_index_register(START_PAGE, START_PAGE + 2);
+    CHECK_EQUAL(0, id);
+    CHECK_EQUAL(FLASH_OK, flash_set_trace(ring, RING_SIZE, 0));
+
+    uint8_t write_data[WORD_SIZE] = {0};
+    for (uint8_t idx = 0; idx < 17; idx++)
+    {
+        CHECK_EQUAL(FLASH_OK, flash_index_write(id, write_data, sizeof(write_data)));
+    }
+
+    uint32_t lost = 1;
+    uint32_t count = flash_trace_copy(events, RING_SIZE, &lost);
+    CHECK_EQUAL(0, lost);
+
+    uint32_t writes = 0;
+    uint32_t write_indexes = 0;
+    uint32_t wraps = 0;
+    uint32_t moves = 0;
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        switch (events[idx].type)
+        {
+        case FLASH_TRACE_INDEX_WRITE:
+            CHECK_EQUAL(id, events[idx].id);
+            writes++;
+            break;
+        case FLASH_TRACE_INDEX_WRITE_INDEX:
+            write_indexes++;
+            break;
+        case FLASH_TRACE_WRAP:
+            CHECK_EQUAL((START_PAGE + 1) * PAGE_SIZE, events[idx].address);
+            wraps++;
+            break;
+        case FLASH_TRACE_CHECKPOINT_MOVE:
+            CHECK_EQUAL(START_PAGE * PAGE_SIZE, events[idx].address);
+            moves++;
+            break;
+        default:
+            break;
+        }
+    }
+    CHECK_EQUAL(17, writes);
+    CHECK_EQUAL(17, write_indexes);
+    CHECK_EQUAL(1, wraps);
+    CHECK_EQUAL(2, moves);
+
+    // Every call comes back out.
+    FILE * out = tmpfile();
+    CHECK(out != NULL);
+    CHECK_EQUAL(count, flash_trace_print(out, (const uint8_t *)events, count * FLASH_TRACE_EVENT_SIZE));
+    fclose(out);
+}
+#endif
@@ -3,6 +3,8 @@
 extern "C"
 {
 #include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include "../spies/flash_spy.h"
 }
 
@@ -219,3 +221,130 @@ TEST(TestSpy, write_pages_0_to_2_erase_1)
     MEMCMP_EQUAL_TEXT(expected_value, read_data, area_size, "Mem compare after erase.");
 }
 
+
+/* Flash mapped from an image file keeps what was written to it. */
+TEST(TestSpy, image_keeps_data)
+{
+    char path[] = "/tmp/flash_spy_imageXXXXXX";
+    int file = mkstemp(path);
+    CHECK(file >= 0);
+    close(file);
+
+    teardown();
+    CHECK_EQUAL(FLASH_OK, flash_spy_init_image(WORD_SIZE, PAGE_SIZE, FLASH_SIZE, path));
+    uint8_t read_data[WORD_SIZE] = {0};
+    uint8_t expected_data[WORD_SIZE];
+    memset(expected_data, FLASH_EMPTY_VALUE, WORD_SIZE);
+    FLASH_READ_OK(PAGE_SIZE, read_data, WORD_SIZE);
+    MEMCMP_EQUAL_TEXT(expected_data, read_data, WORD_SIZE, "New image isn't erased");
+
+    uint8_t write_data[WORD_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8};
+    WRITE_OK(PAGE_SIZE, write_data, 1);
+    flash_spy_deinit();
+
+    CHECK_EQUAL(FLASH_OK, flash_spy_init_image(WORD_SIZE, PAGE_SIZE, FLASH_SIZE, path));
+    MEMCMP_EQUAL_TEXT(write_data, flash_spy_memory() + PAGE_SIZE, WORD_SIZE, "Image lost the write");
+    CHECK_EQUAL_TEXT(FLASH_ERROR, flash_spy_write(PAGE_SIZE, write_data, 1), "Image forgot the write was programmed");
+    flash_spy_deinit();
+
+    unlink(path);
+    setup();
+}
+
+/* Each operation moves the virtual clock on by how long it would take. */
+TEST(TestSpy, timing_on_virtual_clock)
+{
+    flash_spy_timing_t timing;
+    timing.program_setup_ns = 100;
+    timing.program_word_ns = 10;
+    timing.erase_page_ns = 1000;
+    timing.read_setup_ns = 5;
+    timing.read_byte_ns = 1;
+
+    // Instant until told otherwise.
+    uint8_t write_data[2 * WORD_SIZE] = {0};
+    WRITE_OK(0, write_data, 2);
+    CHECK_EQUAL(0, flash_spy_clock_ns());
+
+    flash_spy_set_timing(&timing);
+    WRITE_OK(2 * WORD_SIZE, write_data, 2);
+    CHECK_EQUAL(120, flash_spy_clock_ns());
+
+    uint8_t read_data[4];
+    FLASH_READ_OK(0, read_data, sizeof(read_data));
+    CHECK_EQUAL(129, flash_spy_clock_ns());
+
+    ERASE_OK_TEXT(0, 2, "Erase failed");
+    CHECK_EQUAL(2129, flash_spy_clock_ns());
+    CHECK_EQUAL(2, flash_spy_clock_us());
+
+    // A failed write still keeps the device busy.
+    WRITE_OK(0, write_data, 1);
+    CHECK_EQUAL(FLASH_ERROR, flash_spy_write(0, write_data, 1));
+    CHECK_EQUAL(2129 + 2 * 110, flash_spy_clock_ns());
+
+    flash_spy_clock_reset();
+    flash_spy_set_timing(NULL);
+    ERASE_OK_TEXT(0, 1, "Erase failed");
+    CHECK_EQUAL(0, flash_spy_clock_ns());
+}
+
+/* Erasing a page costs far more than programming a word on both presets. */
+TEST(TestSpy, timing_presets)
+{
+    CHECK(flash_spy_timing_stm32wb.erase_page_ns > 100 * flash_spy_timing_stm32wb.program_word_ns);
+    CHECK(flash_spy_timing_spi_nor.erase_page_ns > 100 * flash_spy_timing_spi_nor.program_word_ns);
+
+    flash_spy_set_timing(&flash_spy_timing_spi_nor);
+    ERASE_OK_TEXT(0, 1, "Erase failed");
+    CHECK_EQUAL(flash_spy_timing_spi_nor.erase_page_ns, flash_spy_clock_ns());
+
+    // Cleared with the rest of the spy.
+    flash_spy_deinit();
+    flash_spy_init(WORD_SIZE, PAGE_SIZE, FLASH_SIZE);
+    ERASE_OK_TEXT(0, 1, "Erase failed");
+    CHECK_EQUAL(0, flash_spy_clock_ns());
+}
+
+/* Only what was written that isn't erased stops later writes, on every page a write reaches. */
+TEST(TestSpy, write_tracks_programmed_bytes)
+{
+    uint8_t erased_data[WORD_SIZE];
+    memset(erased_data, FLASH_EMPTY_VALUE, WORD_SIZE);
+    uint8_t write_data[3 * WORD_SIZE] = {0};
+
+    // Writing erased values leaves the flash erased.
+    WRITE_OK(PAGE_SIZE + WORD_SIZE, erased_data, 1);
+    WRITE_OK(PAGE_SIZE, write_data, 1);
+    CHECK_EQUAL(FLASH_ERROR, flash_spy_write(PAGE_SIZE, write_data, 1));
+
+    // Runs on into the next page.
+    WRITE_OK(3 * PAGE_SIZE + WORD_SIZE, write_data, 3);
+    CHECK_EQUAL(FLASH_ERROR, flash_spy_write(4 * PAGE_SIZE, write_data, 1));
+
+    ERASE_OK_TEXT(4, 1, "Erase failed");
+    WRITE_OK(4 * PAGE_SIZE, write_data, 1);
+
+    flash_spy_erase_all();
+    WRITE_OK(PAGE_SIZE, write_data, 1);
+}
+
+/* Flash bigger than 64 KiB, e.g. a SPI NOR part. */
+TEST(TestSpy, large_flash)
+{
+    const uint32_t large_size = 1024 * 1024;
+    teardown();
+    flash_spy_init(WORD_SIZE, 4096, large_size);
+
+    uint8_t write_data[WORD_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8};
+    WRITE_OK(large_size - WORD_SIZE, write_data, 1);
+    CHECK_EQUAL(FLASH_ERROR, flash_spy_write(large_size - WORD_SIZE, write_data, 1));
+    CHECK_EQUAL(FLASH_ERROR, flash_spy_write(large_size, write_data, 1));
+
+    uint8_t read_data[WORD_SIZE] = {0};
+    FLASH_READ_OK(large_size - WORD_SIZE, read_data, WORD_SIZE);
+    MEMCMP_EQUAL(write_data, read_data, WORD_SIZE);
+
+    flash_spy_deinit();
+    setup();
+}